@@ -4,15 +4,18 @@
 #include "include/measure.h"
 #include "include/random.h"
 #include "include/path_builder.h"
+#include "include/stroke_fitter.h"
 
 namespace pentrek {
 
 class Scribble : public Content {
     Rect m_rect;
     PathBuilder m_builder;
+    StrokeFitter m_fitter{&m_builder};
     
     struct Rec {
         rcp<Path> path;
+        rcp<Path> tail;     // while drawing, what m_fitter hasn't committed
         rcp<Shader> shader;
     };
     std::vector<Rec> m_recs;
@@ -36,14 +39,23 @@ public:
     }
     
     std::unique_ptr<Click> onFindClick(Point p) override {
-        m_builder.move(p);
-        m_recs.push_back({m_builder.snapshot(), this->make_shader()});
+        m_fitter.begin(p);
+        m_recs.push_back({m_builder.snapshot(), nullptr, this->make_shader()});
         return Click::Make(p, [this](Click* c, bool up) {
+            auto& rec = m_recs.back();
             if (up) {
-                m_recs.back().path = m_builder.detach();
+                m_fitter.finish();
+                rec.path = m_builder.detach();
+                rec.tail = nullptr;
             } else {
-                m_builder.line(c->m_curr);
-                m_recs.back().path = m_builder.snapshot();
+                // m_builder only gets the settled cubics (and its snapshot
+                // doesn't copy them), so the live tail is drawn separately
+                m_fitter.add(c->m_curr);
+                rec.path = m_builder.snapshot();
+                PathBuilder tail;
+                tail.move(rec.path->points().back());
+                m_fitter.addTail(&tail);
+                rec.tail = tail.detach();
             }
         });
     }
@@ -75,6 +87,9 @@ public:
         for (const auto& rec : m_recs) {
             paint.shader(rec.shader);
             canvas->drawPath(rec.path, paint);
+            if (rec.tail) {
+                canvas->drawPath(rec.tail, paint);
+            }
         }
     }
 };
@@ -6,6 +6,7 @@
 #include "include/content.h"
 #include "include/matrix.h"
 #include "include/meta.h"
+#include "include/path_ops.h"
 #include "include/keyframes.h"
 #include "include/random.h"
 #include "include/text_utils.h"
@@ -282,9 +283,14 @@ public:
         canvas->save();
         canvas->translate(50, 450);
         for (size_t i = 0; i < paths.size(); ++i) {
-            canvas->drawPath(paths[i], paint);
             if (m_showOutlines) {
-                canvas->drawPoints(paths[i]->points(), pnt);
+                // variable glyphs often have overlapping contours, which would
+                // show up as seams, so we outline the area they fill instead.
+                auto outline = SimplifyCache::Global().simplify(*paths[i]);
+                canvas->drawPath(outline, paint);
+                canvas->drawPoints(outline->points(), pnt);
+            } else {
+                canvas->drawPath(paths[i], paint);
             }
         }
         canvas->restore();
@@ -6,6 +6,7 @@
 #define _pentrek_js_c2d_h_
 
 #include "include/color.h"
+#include "include/paint.h"
 #include "include/path.h"
 
 using namespace pentrek;
@@ -26,6 +27,9 @@ extern "C" {
                                               int count, bool isStroke);
     extern void ptrk_canvas_setColor(C2DContextID, Color32, bool isStroke);
     extern void ptrk_canvas_setStrokeWidth(C2DContextID, float width);
+    extern void ptrk_canvas_setLineJoin(C2DContextID, StrokeJoin);
+    extern void ptrk_canvas_setLineCap(C2DContextID, StrokeCap);
+    extern void ptrk_canvas_setMiterLimit(C2DContextID, float limit);
 
     extern void ptrk_canvas_onSave(C2DContextID);
     extern void ptrk_canvas_onRestore(C2DContextID);
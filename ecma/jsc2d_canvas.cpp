@@ -86,6 +86,18 @@ void JSC2DCanvas::onUpdateStroke(float width) {
     ptrk_canvas_setStrokeWidth(m_c2d, width);
 }
 
+void JSC2DCanvas::onUpdateJoin(StrokeJoin join) {
+    ptrk_canvas_setLineJoin(m_c2d, join);
+}
+
+void JSC2DCanvas::onUpdateCap(StrokeCap cap) {
+    ptrk_canvas_setLineCap(m_c2d, cap);
+}
+
+void JSC2DCanvas::onUpdateMiterLimit(float limit) {
+    ptrk_canvas_setMiterLimit(m_c2d, limit);
+}
+
 void JSC2DCanvas::onSave() {
     ptrk_canvas_onSave(m_c2d);
     this->INHERITED::onSave();
@@ -117,6 +129,11 @@ void JSC2DCanvas::onDrawRect(const Rect& r, const Paint& p) {
 }
 
 void JSC2DCanvas::onDrawPath(const Path& path, const Paint& p) {
+    if (path.info().m_kind == PathInfo::Kind::rect) {
+        // fillRect/strokeRect don't have to make a Path2D
+        this->onDrawRect(path.bounds(), p);
+        return;
+    }
     this->updatePaint(p);
 
     auto pts = path.points();
@@ -126,3 +143,16 @@ void JSC2DCanvas::onDrawPath(const Path& path, const Paint& p) {
                            vbs.data(), vbs.size(),
                            path.fillType(), p.isStroke());
 }
+
+void JSC2DCanvas::onDrawPathView(const TransformedPathView& view, const Paint& p) {
+    this->updatePaint(p);
+
+    m_mappedPts.resize(view.pointCount());
+    view.mapPoints(m_mappedPts);
+
+    auto vbs = view.verbs();
+    ptrk_canvas_onDrawPath(m_c2d,
+                           m_mappedPts.data(), m_mappedPts.size(),
+                           vbs.data(), vbs.size(),
+                           view.fillType(), p.isStroke());
+}
@@ -7,6 +7,7 @@
 
 #include "ecma/js_c2d.h"
 #include "ports/canvas2d_canvas.h"
+#include <vector>
 
 namespace pentrek {
 
@@ -19,6 +20,7 @@ class JSC2DCanvas : public Canvas2DCanvas {
     using INHERITED = Canvas2DCanvas;
     
     C2DContextID m_c2d;
+    std::vector<Point> m_mappedPts;   // reused by onDrawPathView
 
 public:
     JSC2DCanvas(C2DContextID ref) : m_c2d(ref) {}
@@ -27,6 +29,9 @@ protected:
     void onUpdateShader(const Shader&, bool isStroke) override;
     void onUpdateColor(const Color&, bool isStroke) override;
     void onUpdateStroke(float width) override;
+    void onUpdateJoin(StrokeJoin) override;
+    void onUpdateCap(StrokeCap) override;
+    void onUpdateMiterLimit(float) override;
 
     void onSave() override;
     void onRestore() override;
@@ -34,6 +39,7 @@ protected:
     void onClipPath(const Path&) override;
     void onDrawRect(const Rect&, const Paint&) override;
     void onDrawPath(const Path&, const Paint&) override;
+    void onDrawPathView(const TransformedPathView&, const Paint&) override;
 };
 
 } // namespace
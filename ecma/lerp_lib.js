@@ -57,6 +57,18 @@ mergeInto(LibraryManager.library, {
         const ctx = ptrk_get_object_from_id(ctxID);
         ctx.lineWidth = width;
     },
+    ptrk_canvas_setLineJoin: function(ctxID, join) {
+        const ctx = ptrk_get_object_from_id(ctxID);
+        ctx.lineJoin = ["miter", "round", "bevel"][join];   // StrokeJoin
+    },
+    ptrk_canvas_setLineCap: function(ctxID, cap) {
+        const ctx = ptrk_get_object_from_id(ctxID);
+        ctx.lineCap = ["butt", "round", "square"][cap];     // StrokeCap
+    },
+    ptrk_canvas_setMiterLimit: function(ctxID, limit) {
+        const ctx = ptrk_get_object_from_id(ctxID);
+        ctx.miterLimit = limit;
+    },
 
     ptrk_canvas_onSave: function(ctxID) {
         const ctx = ptrk_get_object_from_id(ctxID);
@@ -0,0 +1,135 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#ifndef _pentrek_cache_h_
+#define _pentrek_cache_h_
+
+#include "include/pentrek_types.h"
+#include <cassert>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace pentrek {
+
+// The parts of LRUCache that don't depend on its types
+class LRUCacheBase {
+public:
+    // For building a key's hash from its fields (e.g. a path's uniqueID, and
+    // the bits of some float parameters)
+    static uint64_t HashMix(uint64_t h, uint64_t word) {
+        h = (h ^ word) * 0x9E3779B97F4A7C15ull;
+        return h ^ (h >> 29);
+    }
+    static uint32_t FloatBits(float);
+
+    static void Tests();
+
+protected:
+    // Returns the median of uses (which it reorders)
+    static uint64_t MedianUse(std::vector<uint64_t>* uses);
+};
+
+/*
+ *  Remembers values (typically something expensive computed from a path),
+ *  keyed by e.g. the path's uniqueID, or its contentHash(). When the cache
+ *  reaches its limit, the least recently used half is dropped.
+ *
+ *  Several values can share a key, so a key can just narrow the search (e.g.
+ *  a hash), with findOrMake's matches() picking the value that fits.
+ *
+ *  All methods are thread-safe.
+ */
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class LRUCache : public LRUCacheBase {
+public:
+    explicit LRUCache(size_t limit) : m_limit(limit) { assert(limit > 0); }
+    LRUCache(const LRUCache&) = delete;
+    LRUCache& operator=(const LRUCache&) = delete;
+
+    /*
+     *  Returns the value under key that matches(value) accepts. If there isn't
+     *  one, it calls make() for one and adds it. make() runs without the lock
+     *  held, so other threads aren't blocked on it. If one of them adds a match
+     *  in the meantime, theirs is returned (and ours is dropped).
+     */
+    template <typename Matches, typename Make>
+    Value findOrMake(const Key& key, Matches matches, Make make) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (const Value* found = this->findLocked(key, matches)) {
+                return *found;
+            }
+        }
+
+        Value value = make();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (const Value* found = this->findLocked(key, matches)) {
+            return *found;
+        }
+        if (m_entries.size() >= m_limit) {
+            this->purgeOldestLocked();
+        }
+        m_entries.insert({key, {value, ++m_useCounter}});
+        return value;
+    }
+
+    template <typename Make> Value findOrMake(const Key& key, Make make) {
+        return this->findOrMake(key, [](const Value&) { return true; }, make);
+    }
+
+    size_t count() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_entries.size();
+    }
+
+    void purgeAll() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries.clear();
+    }
+
+private:
+    struct Entry {
+        Value    m_value;
+        uint64_t m_lastUse;
+    };
+
+    mutable std::mutex m_mutex;
+    std::unordered_multimap<Key, Entry, Hash> m_entries;
+    uint64_t m_useCounter = 0;
+    const size_t m_limit;
+
+    template <typename Matches> const Value* findLocked(const Key& key, Matches& matches) {
+        auto range = m_entries.equal_range(key);
+        for (auto iter = range.first; iter != range.second; ++iter) {
+            if (matches(iter->second.m_value)) {
+                iter->second.m_lastUse = ++m_useCounter;
+                return &iter->second.m_value;
+            }
+        }
+        return nullptr;
+    }
+
+    void purgeOldestLocked() {
+        std::vector<uint64_t> uses;
+        uses.reserve(m_entries.size());
+        for (const auto& iter : m_entries) {
+            uses.push_back(iter.second.m_lastUse);
+        }
+        const uint64_t cutoff = MedianUse(&uses);
+
+        for (auto iter = m_entries.begin(); iter != m_entries.end();) {
+            if (iter->second.m_lastUse < cutoff) {
+                iter = m_entries.erase(iter);
+            } else {
+                ++iter;
+            }
+        }
+    }
+};
+
+} // namespace
+
+#endif
@@ -38,6 +38,7 @@ public:
     void drawPath(const rcp<const Path>& path, const Paint& paint) {
         this->drawPath(*path.get(), paint);
     }
+    void drawPath(const TransformedPathView&, const Paint&);
 
     void drawPoints(Span<const Point>, const Paint&);
     void drawPoint(Point, const Paint&);
@@ -80,6 +81,7 @@ protected:
     
     virtual void onDrawRect(const Rect&, const Paint&);
     virtual void onDrawPath(const Path&, const Paint&) = 0;
+    virtual void onDrawPathView(const TransformedPathView&, const Paint&);
 
 private:
     int m_saveCount = 0;
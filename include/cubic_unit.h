@@ -16,11 +16,18 @@ class CubicUnit {
         complex,
     };
 
-    double da, db, dc;
+    // x_to_y() first finds the segment (in t) that x falls in, then
+    // refines its guess within that segment with Newton's method.
+    static constexpr int kSegments = 16;
+
     Point m_pts[2];
-    Point A, B, C;  // At^3 + Bt^2 + Ct = (x,y)
+    double m_xc[3], m_yc[3];            // At^3 + Bt^2 + Ct = x (or y)
+    double m_xs[kSegments + 1];         // x at t = k / kSegments
     Type m_type;
 
+    // Sets t[i] where the curve reaches x[i], for N values at once (see x_to_y())
+    template <int N> void solveT(const float x[], double t[]) const;
+
     static const Point gDefaultPts[2];
 
     // nearly 1/3, 2/3, but with clean denominators so no repreating digits
@@ -34,8 +41,17 @@ public:
 
     Span<const Point> pts() const { return m_pts; }
 
+    /*
+     *  Returns y on the curve where it reaches x. The t for x is found (in
+     *  double) to well within the spacing between floats, so a larger x never
+     *  gets a smaller t, and (if y's control values are in [0, 1], so y(t) is
+     *  increasing) never a smaller y.
+     */
     float x_to_y(float x) const;
 
+    // Sets y[i] = x_to_y(x[i]), requires the spans to be the same size.
+    void x_to_y(Span<const float> x, Span<float> y) const;
+
     static Span<const Point> DefaultPts() { return gDefaultPts; }
 
     static bool NearlyLinear(Point a, Point b);
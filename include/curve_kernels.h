@@ -0,0 +1,68 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#ifndef _pentrek_curve_kernels_h_
+#define _pentrek_curve_kernels_h_
+
+#include "include/point.h"
+#include <vector>
+
+namespace pentrek {
+
+/*
+ *  Batch versions of the curve functions in geometry.h, for callers that would
+ *  otherwise call them in a loop: one curve at many t values, or many curves
+ *  at one t. Each is written once over a lane type, and instantiated for SSE2,
+ *  NEON, WASM-SIMD (4 lanes each) and scalar. As with PointKernels, Get()
+ *  returns the best set for this CPU.
+ *
+ *  Results match the single-curve functions to within float rounding (they
+ *  are the same formulas, just evaluated in a different order in places).
+ *
+ *  The many-curves versions take the curves as structure-of-arrays: x[k][i]
+ *  and y[k][i] are point k of curve i, as in a PathSegments::Batch.
+ */
+struct CurveKernels {
+    const char* m_name;
+
+    // dst[i] = the curve at t[i]
+    void (*m_quadEval)(Point dst[], const Point src[3], const float t[], size_t n);
+    void (*m_cubicEval)(Point dst[], const Point src[4], const float t[], size_t n);
+
+    // {pos[i], tan[i]} = quad_postan(src, t[i]) or cubic_postan(src, t[i])
+    void (*m_quadPosTan)(Point pos[], Point tan[], const Point src[3], const float t[], size_t n);
+    void (*m_cubicPosTan)(Point pos[], Point tan[], const Point src[4], const float t[], size_t n);
+
+    // Chops the curve at each t (which must be increasing, in [0...1]) into n+1
+    // pieces, which share their end points: dst gets 2n+3 (quad) or 3n+4 (cubic)
+    // points. Each piece is computed directly (not by chopping what is left),
+    // so errors do not accumulate from one to the next.
+    void (*m_quadChop)(Point dst[], const Point src[3], const float t[], size_t n);
+    void (*m_cubicChop)(Point dst[], const Point src[4], const float t[], size_t n);
+
+    // {dstX[i], dstY[i]} = curve i at t
+    void (*m_quadEvalSoA)(float dstX[], float dstY[],
+                          const float* const x[3], const float* const y[3], size_t n, float t);
+    void (*m_cubicEvalSoA)(float dstX[], float dstY[],
+                           const float* const x[4], const float* const y[4], size_t n, float t);
+
+    // Chops curve i at t: {dstX[k][i], dstY[k][i]} is point k of what quad_chop
+    // or cubic_chop would return.
+    void (*m_quadChopSoA)(float* const dstX[5], float* const dstY[5],
+                          const float* const x[3], const float* const y[3], size_t n, float t);
+    void (*m_cubicChopSoA)(float* const dstX[7], float* const dstY[7],
+                           const float* const x[4], const float* const y[4], size_t n, float t);
+
+    static const CurveKernels& Get();
+    static const CurveKernels& Scalar();
+
+    // All of the sets that this CPU can run (the scalar version is first)
+    static std::vector<const CurveKernels*> Available();
+
+    static void Tests();
+};
+
+} // namespace
+
+#endif
@@ -23,6 +23,9 @@ public:
     static rcp<Data> FromMalloc(Span<const uint8_t>);
     static rcp<Data> Unmanaged(Span<const uint8_t>);
     static rcp<Data> File(const char path[]);
+    // Maps the file (read-only) rather than reading it, where the platform
+    // supports that (else this is the same as File). Returns nullptr on failure.
+    static rcp<Data> MapFile(const char path[]);
     
     size_t size() const { return m_buffer.size(); }
     const void* data() const { return m_buffer.data(); }
@@ -0,0 +1,85 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#ifndef _pentrek_flatten_h_
+#define _pentrek_flatten_h_
+
+#include "include/path.h"
+#include <vector>
+
+namespace pentrek {
+
+/*
+ *  A path, approximated with lines: each contour is a run of points in
+ *  m_points, ending (exclusive) at its m_end.
+ */
+class Polylines {
+public:
+    struct Contour {
+        uint32_t m_end;     // index after our last point
+        bool     m_closed;  // if the path closed this contour
+    };
+    std::vector<Point>   m_points;
+    std::vector<Contour> m_contours;
+
+    // Empties us, but keeps our storage for the next use
+    void reset() {
+        m_points.clear();
+        m_contours.clear();
+    }
+
+    size_t count() const { return m_contours.size(); }
+
+    Span<const Point> points(size_t index) const {
+        const uint32_t start = index > 0 ? m_contours[index - 1].m_end : 0;
+        return {m_points.data() + start, m_contours[index].m_end - start};
+    }
+    bool isClosed(size_t index) const { return m_contours[index].m_closed; }
+
+    static void Tests();
+};
+
+/*
+ *  Flattens segments as they arrive, so anything that produces segments (a
+ *  font, SVGPathParser, ContourMeasure::getSegment) can be flattened without
+ *  building a Path first. Call finish() after the last one.
+ *
+ *  This replaces the contents of dst, reusing its storage. Being final, it is
+ *  called directly by producers that take their sink as a template parameter.
+ */
+class PolylineBuilder final : public PathSync {
+public:
+    PolylineBuilder(Polylines* dst, float tolerance, const Matrix& = Matrix::I());
+
+    void move(Point) override;
+    void line(Point) override;
+    void quad(Point, Point) override;
+    void cubic(Point, Point, Point) override;
+    void close() override;
+
+    void finish() { this->endContour(false); }
+
+private:
+    Polylines*   m_dst;
+    const float  m_invTol;
+    const Matrix m_matrix;
+    const bool   m_identity;
+    size_t       m_contourStart = 0;
+
+    Point map(Point p) const { return m_identity ? p : m_matrix * p; }
+    void endContour(bool closed);
+};
+
+// Replaces the contents of dst with the path (transformed by the matrix), with
+// each curve replaced by lines that are within tolerance of it. This reuses
+// dst's storage, so a caller that keeps dst around will (eventually) not allocate.
+void flatten(const Path&, float tolerance, const Matrix&, Polylines* dst);
+
+static inline void flatten(const Path& path, float tolerance, Polylines* dst) {
+    flatten(path, tolerance, Matrix::I(), dst);
+}
+
+} // namespace
+
+#endif
@@ -0,0 +1,42 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#ifndef _pentrek_float_format_h_
+#define _pentrek_float_format_h_
+
+#include "include/pentrek_types.h"
+
+namespace pentrek {
+
+// Enough room for anything the functions below write (they do not add a terminating 0)
+constexpr size_t kMaxFloatChars = 24;
+
+/*
+ *  Writes the shortest decimal string that reads back (e.g. with strtof) as exactly x,
+ *  returning the number of chars written. This is the Ryu algorithm (Adams, 2018),
+ *  so it needs neither printf nor any allocation.
+ *
+ *  As with %g, values in [1e-4 ... 1e9) are written in fixed notation ("0.1", "-250"), others
+ *  in scientific ("1.5e-7", "3e12"). NaN and infinities are written as "nan", "inf".
+ */
+size_t float_to_chars(float x, char dst[]);
+
+/*
+ *  Writes x rounded to (at most) this many digits after the decimal point, without
+ *  trailing zeros (e.g. 2.50 is written as "2.5"). decimals is pinned to [0...9].
+ *  Values too large to be written this way are written as with float_to_chars.
+ */
+size_t float_to_chars_fixed(float x, int decimals, char dst[]);
+
+// Returns the value that reading back float_to_chars_fixed(x, decimals) would produce
+float round_to_decimals(float x, int decimals);
+
+class FloatFormat {
+public:
+    static void Tests();
+};
+
+} // namespace
+
+#endif
@@ -71,6 +71,11 @@ constexpr float kBezierCircleCoeff = 0.5519150244935105707435627f;
 // however, we take 1/tolerance, so the large that value is, the
 // more segments we will need.
 //
+// The result is pinned to [1...kMaxCurveSegments], so we don't go crazy
+// (e.g. for huge coordinates or a tiny tolerance).
+//
+constexpr int kMaxCurveSegments = 1 << 10;
+
 int count_quad_segments(Point, Point, Point, float invTolerance);
 int count_cubic_segments(Point, Point, Point, Point, float invTolerance);
 
@@ -82,6 +87,23 @@ void line_chop(const Point src[2], float t, Point dst[3]);
 void quad_chop(const Point src[3], float t, Point dst[5]);
 void cubic_chop(const Point src[4], float t, Point dst[7]);
 
+// Returns the t values (sorted, unique, in (0,1)) where the curve has a local
+// extremum in X or Y. Chopping at these yields pieces monotonic in both.
+int quad_extrema(const Point src[3], float t[2]);
+int cubic_extrema(const Point src[4], float t[4]);
+
+// The pieces chopped at those extrema are only monotonic to within rounding, so
+// this nudges their control points back to where being monotonic puts them: a
+// quad's between its end points, and a cubic's past the end it leaves and short
+// of the end it arrives at. (A monotonic cubic's control points can still be
+// well outside of its end points, so pinning them to those bounds would bend it.)
+void pin_monotonic(Point pts[], int degree);
+
+// Returns the bounds of the curve itself (rather than its control points),
+// by evaluating it at its extrema (if any) in X and Y.
+Rect quad_tight_bounds(const Point src[3]);
+Rect cubic_tight_bounds(const Point src[4]);
+
 void line_extract(const Point src[2], float t0, float t1, Point dst[2]);
 void quad_extract(const Point src[3], float t0, float t1, Point dst[3]);
 void cubic_extract(const Point src[4], float t0, float t1, Point dst[4]);
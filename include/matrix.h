@@ -12,16 +12,35 @@
 namespace pentrek {
 
 struct Matrix {
-    float m[6];
-    
-    constexpr Matrix() : m{1, 0, 0, 1, 0, 0} {}
-    constexpr Matrix(float a, float b, float c, float d, float e, float f) : m{a, b, c, d, e, f} {}
-    constexpr Matrix(Point u, Point v, Point t) : m{u.x, u.y, v.x, v.y, t.x, t.y} {}
+    // Bits describing what the matrix does to a point (0 means identity)
+    enum TypeMask : uint8_t {
+        kTranslate  = 1 << 0,
+        kScale      = 1 << 1,
+        kAffine     = 1 << 2,   // skew and/or rotation
+    };
+
+private:
+    float   m[6];
+    uint8_t m_type;     // TypeMask bits, computed when we're constructed
+
+    static constexpr uint8_t ComputeType(float a, float b, float c, float d, float e, float f) {
+        return ((e != 0 || f != 0) ? kTranslate : 0)
+             | ((a != 1 || d != 1) ? kScale : 0)
+             | ((b != 0 || c != 0) ? kAffine : 0);
+    }
+
+public:
+    constexpr Matrix() : m{1, 0, 0, 1, 0, 0}, m_type(0) {}
+    constexpr Matrix(float a, float b, float c, float d, float e, float f)
+        : m{a, b, c, d, e, f}, m_type(ComputeType(a, b, c, d, e, f)) {}
+    constexpr Matrix(Point u, Point v, Point t) : Matrix(u.x, u.y, v.x, v.y, t.x, t.y) {}
     Matrix(std::initializer_list<float> il) {
         assert(il.size() == 6);
         memcpy(m, il.begin(), sizeof(float) * 6);
+        m_type = ComputeType(m[0], m[1], m[2], m[3], m[4], m[5]);
     }
     Matrix(const Matrix&) = default;
+    Matrix& operator=(const Matrix&) = default;
     
     bool operator==(const Matrix& o) const {
         for (int i = 0; i < 6; ++i) {
@@ -33,17 +52,20 @@ struct Matrix {
     }
     bool operator!=(const Matrix& o) const { return !(*this == o); }
 
-    bool isIdentity() const;
+    unsigned type() const { return m_type; }
+    bool isIdentity() const { return m_type == 0; }
+    bool isTranslate() const { return (m_type & ~kTranslate) == 0; }    // includes identity
+    bool isScaleTranslate() const { return (m_type & kAffine) == 0; }   // includes translate
 
     static const Matrix& I();
     static Matrix Trans(float x, float y) {
-        return {1, 0, 0, 1, x, y};
+        return Matrix(1, 0, 0, 1, x, y);
     }
     static Matrix Scale(float x, float y) {
-        return {x, 0, 0, y, 0, 0};
+        return Matrix(x, 0, 0, y, 0, 0);
     }
     static Matrix Skew(float x, float y) {
-        return {1, y, x, 1, 0, 0};
+        return Matrix(1, y, x, 1, 0, 0);
     }
     static Matrix Rotate(float radians);
     
@@ -59,23 +81,19 @@ struct Matrix {
         assert(i < 6);
         return m[i];
     }
-    float& operator[](unsigned i) {
-        assert(i < 6);
-        return m[i];
-    }
     
     PENTREK_WARN_UNUSED_RESULT bool invert(Matrix* dst) const;
     Matrix invertOrIdentity() const;
 
     Matrix operator*(const Matrix& o) const {
-        return {
+        return Matrix(
             m[0] * o.m[0] + m[2] * o.m[1],
             m[1] * o.m[0] + m[3] * o.m[1],
             m[0] * o.m[2] + m[2] * o.m[3],
             m[1] * o.m[2] + m[3] * o.m[3],
             m[0] * o.m[4] + m[2] * o.m[5] + m[4],
-            m[1] * o.m[4] + m[3] * o.m[5] + m[5],
-        };
+            m[1] * o.m[4] + m[3] * o.m[5] + m[5]
+        );
     }
 
     Point operator*(Point p) const {
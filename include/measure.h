@@ -8,6 +8,7 @@
 #include "include/matrix.h"
 #include "include/path.h"
 #include "include/refcnt.h"
+#include <vector>
 
 namespace pentrek {
 
@@ -15,7 +16,7 @@ class ContourMeasure : public RefCnt {
 public:
     struct Rec {
         unsigned m_pointIndex : 30; // first point of this curve
-        unsigned m_pointCount : 2;  // 1, 2, 3 (only 0 for last rec)
+        unsigned m_pointCount : 2;  // 1, 2, 3 : line, quad, cubic
         float    m_length;          // distance to the end of this segment
         float    m_tValue;          // t value for the end of this segment
 
@@ -25,6 +26,7 @@ public:
     };
     std::vector<Rec> m_recs;
     std::vector<Point> m_pts;
+    bool m_isClosed = false;
 
     float pin_distance(float distance) const {
         return std::min(std::max(distance, 0.f), this->length());
@@ -34,8 +36,13 @@ public:
     float add_quad(const Point[], float total, float tol);
     float add_cubic(const Point[], float total, float tol);
 
-    Point computeFirstTan(float tol) const;
-    Point computeLastTan(float tol) const;
+    // returns the index of the rec that contains this (pinned) distance
+    size_t findRec(float distance) const;
+    // returns the t value (for the rec's curve) of this distance
+    float recT(size_t index, float distance) const;
+    const Point* recPts(size_t index) const {
+        return &m_pts[m_recs[index].m_pointIndex];
+    }
 
 #ifdef DEBUG
     void validate() const;
@@ -52,35 +59,79 @@ public:
         assert(m_recs.size() > 0);
         return m_recs.back().m_length;
     }
-    
+    bool isClosed() const { return m_isClosed; }
+
+    // returns the {position, unit-tangent} at the (pinned) distance
     std::pair<Point, Point> getPosTan(float distance) const;
+    // same as getPosTan, but distances outside of [0...length] extend the
+    // contour along its first or last tangent.
     std::pair<Point, Point> getPosTanExtend(float distance) const;
 
     Matrix getMatrix(float distance) const;
 
+    // Batch versions of getPosTan and getMatrix, which visit the contour in a
+    // single forward pass. The distances need not be sorted, but increasing
+    // distances avoid an internal sort. Either pos or tan may be empty,
+    // otherwise the outputs must be the same size as distances.
+    void getPosTan(Span<const float> distances, Span<Point> pos, Span<Point> tan) const;
+    void getMatrix(Span<const float> distances, Span<Matrix>) const;
+
     void getSegment(float start, float end, bool doMove, PathSync*) const;
-    
+
+    // These return nullptr if the contour has zero length
     static rcp<ContourMeasure> Make(Span<const Point> pts,
                                     Span<const PathVerb> vbs,
                                     float tol = gDefaultTolerance);
     static rcp<ContourMeasure> Make(const Path& path,
                                     float tol = gDefaultTolerance);
+
+    static void Tests();
 };
 
 class ContourMeasureIter {
     Span<const Point> m_pts;
     Span<const PathVerb> m_vbs;
+    float m_tol;
 
     rcp<ContourMeasure> tryNext();
 public:
-    ContourMeasureIter(Span<const Point> p, Span<const PathVerb> v) : m_pts(p), m_vbs(v) {}
-    ContourMeasureIter(const Path& p) : ContourMeasureIter(p.points(), p.verbs()) {}
+    ContourMeasureIter(Span<const Point> p, Span<const PathVerb> v,
+                       float tol = ContourMeasure::gDefaultTolerance)
+        : m_pts(p), m_vbs(v), m_tol(tol) {}
+    ContourMeasureIter(const Path& p, float tol = ContourMeasure::gDefaultTolerance)
+        : ContourMeasureIter(p.points(), p.verbs(), tol) {}
     ContourMeasureIter(const Path* p) : ContourMeasureIter(p->points(), p->verbs()) {}
     ContourMeasureIter(const rcp<Path>& p) : ContourMeasureIter(p->points(), p->verbs()) {}
 
+    // returns nullptr when there are no more (non-zero length) contours
     rcp<ContourMeasure> next();
 };
 
+/*
+ *  Holds the measures for each (non-zero length) contour in a path.
+ *
+ *  Make() caches its results, keyed by the path's uniqueID and the tolerance,
+ *  so calling it every frame for the same path only measures it once.
+ */
+class PathMeasure : public RefCnt {
+    std::vector<rcp<ContourMeasure>> m_contours;
+    float m_length = 0;
+
+public:
+    PathMeasure(const Path&, float tol);
+
+    Span<const rcp<ContourMeasure>> contours() const { return m_contours; }
+    float length() const { return m_length; }   // sum of all of the contours
+
+    static rcp<PathMeasure> Make(const Path&, float tol = ContourMeasure::gDefaultTolerance);
+    static rcp<PathMeasure> Make(const rcp<Path>& path,
+                                 float tol = ContourMeasure::gDefaultTolerance) {
+        return Make(path.deref(), tol);
+    }
+
+    static void PurgeCache();
+};
+
 } // namespace
 
 #endif
@@ -0,0 +1,55 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#ifndef _pentrek_mikemull_h_
+#define _pentrek_mikemull_h_
+
+#include "include/path_builder.h"
+
+namespace pentrek {
+
+/*
+ *  A MikeMull curve that is kept up to date as its points are edited (e.g.
+ *  while one is being dragged). Moving a point only changes its control points
+ *  and its neighbors', so setPoint() recomputes those three and patches the
+ *  (at most four) cubics that use them in place, rather than rebuilding the
+ *  whole path: the cost does not depend on how many points there are.
+ *
+ *  path() shares the points rather than copying them, so an edit made while a
+ *  path from before it is still alive first copies the points (leaving that
+ *  path as it was), which does depend on how many there are. E.g. a drag loop
+ *  should let go of each frame's path() before its next setPoint().
+ */
+class MikeMullSpline {
+public:
+    MikeMullSpline(const MikeMull&, Span<const Point>);
+
+    const MikeMull& params() const { return m_params; }
+    Span<const Point> points() const { return m_points; }
+    Span<const CtrlPoint> ctrlPoints() const { return m_ctrls; }
+
+    // The path (as path_add_ctrlpoints would build it from ctrlPoints())
+    const PathBuilder& builder() const { return m_builder; }
+    rcp<Path> path() { return m_builder.snapshot(); }
+
+    void setPoint(size_t index, Point);
+
+    // Replaces all of the points (rebuilding everything)
+    void setPoints(Span<const Point>);
+
+    static void Tests();
+
+private:
+    MikeMull                m_params;
+    std::vector<Point>      m_points;
+    std::vector<CtrlPoint>  m_ctrls;
+    PathBuilder             m_builder;
+
+    CtrlPoint computeCtrl(size_t index) const;
+    void patch(size_t index);
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,56 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#ifndef _pentrek_morph_h_
+#define _pentrek_morph_h_
+
+#include "include/path.h"
+
+namespace pentrek {
+
+/*
+ *  Path::Lerp requires two paths with the same structure. MorphPair takes any
+ *  two paths (e.g. two glyphs) and, once, makes a version of each that has it:
+ *
+ *  - Lines and quads become cubics (and a close gets its closing segment), so
+ *    every contour is a move and a run of cubics.
+ *  - Contours are paired up by how close their centroids and areas are. One
+ *    with no partner (when the counts differ) is paired with a point at its
+ *    centroid, so it grows from (or shrinks to) there.
+ *  - Where two paired contours go around in opposite directions, b's is
+ *    reversed, so they do not turn inside out along the way.
+ *  - The contour with fewer cubics has its longest ones split until the
+ *    counts match.
+ *  - For closed contours, b's starting point is rotated to whichever cubic
+ *    boundary minimizes the total distance its points travel (relative to
+ *    the centroids, so this does not depend on where the shapes are).
+ *
+ *  Drawing a frame is then just lerp(t), which is Path::Lerp (a vectorized
+ *  blend of the matched points). Like Path::Lerp, the result has a's fill type.
+ */
+class MorphPair {
+public:
+    MorphPair(const Path& a, const Path& b);
+
+    // The same shapes as the inputs (to within float rounding), but with
+    // identical verbs and point counts.
+    const rcp<Path>& a() const { return m_a; }
+    const rcp<Path>& b() const { return m_b; }
+
+    rcp<Path> lerp(float t) const { return Path::Lerp(m_a.get(), m_b.get(), t); }
+
+    // Reuses dst's storage if it can (see Path::Lerp), e.g. the previous frame
+    rcp<Path> lerp(rcp<Path>&& dst, float t) const {
+        return Path::Lerp(std::move(dst), *m_a, *m_b, t);
+    }
+
+    static void Tests();
+
+private:
+    rcp<Path> m_a, m_b;
+};
+
+} // namespace
+
+#endif
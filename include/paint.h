@@ -10,10 +10,21 @@
 
 namespace pentrek {
 
+enum class StrokeJoin : uint8_t {
+    miter, round, bevel
+};
+
+enum class StrokeCap : uint8_t {
+    butt, round, square
+};
+
 class Paint {
     rcp<Shader> m_shader;
     Color fColor{0, 0, 0, 1};
     float fWidth = 1;
+    float fMiterLimit = 10;     // same defaults as Canvas2D
+    StrokeJoin fJoin = StrokeJoin::miter;
+    StrokeCap fCap = StrokeCap::butt;
     uint32_t fFlags = 0;
     
     enum Flags {
@@ -31,6 +42,9 @@ public:
     Color color() const { return fColor; }
     Color32 color32() const { return fColor.color32(); }
     float width() const { return fWidth; }
+    float miterLimit() const { return fMiterLimit; }
+    StrokeJoin join() const { return fJoin; }
+    StrokeCap cap() const { return fCap; }
     
     void stroke(bool isStroke) {
         if (isStroke) {
@@ -46,6 +60,9 @@ public:
         this->color({r, g, b, a});
     }
     void width(float w) { assert(w > 0); fWidth = w; }
+    void miterLimit(float limit) { assert(limit >= 1); fMiterLimit = limit; }
+    void join(StrokeJoin j) { fJoin = j; }
+    void cap(StrokeCap c) { fCap = c; }
     
     Shader* shader() const { return m_shader.get(); }
     rcp<Shader> refShader() const { return m_shader; }
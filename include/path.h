@@ -10,11 +10,14 @@
 #include "include/rect.h"
 #include "include/refcnt.h"
 #include "include/span.h"
+#include "include/unique_id.h"
+#include <atomic>
 #include <vector>
 
 namespace pentrek {
 
 class Data;
+class PathHitIndex;
 class Writer;
 
 enum class PathVerb : uint8_t {
@@ -29,35 +32,185 @@ enum class PathFillType : uint8_t {
     winding, evenodd
 };
 
-class Path : public RefCnt {
+struct SVGPathOptions {
+    // Write relative commands (m, l, q, c), which are usually shorter. Each delta
+    // is taken from where a reader will be (i.e. after the previous rounding),
+    // so errors do not accumulate along a contour.
+    bool m_relative = false;
+
+    // If >= 0, coordinates are rounded to this many decimal places (at most 9).
+    // Otherwise they are written with the fewest digits that read back exactly.
+    int  m_decimals = -1;
+};
+
+/*
+ *  What a path's shape is, as far as callers that want a fast path care
+ *  (e.g. a rect can be drawn as a rect, and a convex polygon can be hit-tested
+ *  against its edges' half-planes). See Path::info().
+ */
+struct PathInfo {
+    enum class Kind : uint8_t {
+        empty,      // no segments
+        line,       // a single line segment
+        // These two are the path's only contour (and only move), so its
+        // bounds() are the rect's (or the oval's)
+        rect,       // one closed contour of lines around an axis-aligned rect (with area)
+        oval,       // one closed contour of cubics, as addOval/Path::Oval make them
+        polygon,    // any other single contour of lines
+        general,
+    };
+
+    // The signed area, with each contour closed (if it isn't already).
+    // Positive is clockwise (with y pointing down), negative is counter-clockwise.
+    float    m_area;
+    uint32_t m_contourCount;    // (not counting a move with no segments)
+    Kind     m_kind;
+    // One contour, with area, that turns the same way throughout, and only goes
+    // around once. Curves are judged by their control points, so this can be
+    // false for a convex shape, but is never true for a concave one.
+    bool     m_isConvex;
+    bool     m_allLines;        // no quads or cubics
+
+    // Only meaningful if m_area != 0
+    PathDirection direction() const {
+        return m_area < 0 ? PathDirection::ccw : PathDirection::cw;
+    }
+};
+
+/*
+ *  Path is immutable, and is allocated as a single block: the object itself,
+ *  followed by its points and then its verbs. Create them with Make(), or with
+ *  a PathBuilder.
+ */
+class Path final : public UniqueIDRefCnt {
     static constexpr PathFillType kDefFillType = PathFillType::winding;
 
-    std::vector<Point> m_points;
-    std::vector<PathVerb> m_verbs;
-    Rect m_bounds;
-    const PathFillType m_fillType = kDefFillType;
+    const Point*        m_points;   // these point into our trailing storage
+    const PathVerb*     m_verbs;    // (or into m_storage, see Wrap)
+    uint32_t            m_pointCount;
+    uint32_t            m_verbCount;
+    const PathFillType  m_fillType;
+    // Set if m_storage is a PathBuilder's block (see PathBuilder::snapshot), which
+    // we may write to once no one else (builder or snapshot) is using it.
+    bool                m_builderStorage;
+
+    // If not null, our points and verbs live in its buffer, and we hold a ref to it
+    const Data*         m_storage;
+
+    // The bounds are computed the first time they are asked for. If two threads
+    // race to do this, they both write the same values.
+    enum LazyFlags : uint8_t {
+        kBoundsValid      = 1 << 0,
+        kTightBoundsValid = 1 << 1,
+        kContentHashValid = 1 << 2,
+        kInfoValid        = 1 << 3,
+    };
+    mutable std::atomic<uint8_t> m_lazyFlags;
+    mutable Rect        m_bounds;
+    mutable Rect        m_tightBounds;
+    mutable uint64_t    m_contentHash;
+    mutable PathInfo    m_info;
 
-    Path() : m_bounds(Rect::Empty()) {}
+    // Built the first time a large path is hit-tested (see path_hittest.cpp)
+    mutable std::atomic<const PathHitIndex*> m_hitIndex;
 
-public:
-    Path(Span<const Point>, Span<const PathVerb>, PathFillType, const Rect* bounds = nullptr);
-    Path(std::vector<Point>&&, std::vector<PathVerb>&&, PathFillType, const Rect* bounds = nullptr);
-    ~Path() = default;
+    void computeBounds() const;
+    void computeTightBounds() const;
+    void computeContentHash() const;
+    void computeInfo() const;
+    void setBounds(const Rect&);
+    void setInfo(const PathInfo&);
+    // Call this after changing our points in place
+    void invalidateCaches();
 
-    bool empty() const { return m_points.size() == 0; }
+    const PathHitIndex* hitIndex() const;
+    static void DeleteHitIndex(const PathHitIndex*);
+    bool hitTestRect(const Rect&) const;
+
+    Path(size_t pointCount, size_t verbCount, PathFillType);
+
+    // Returns a path with room for these points and verbs, but they (and the
+    // bounds) are uninitialized. The caller must fill them in.
+    static rcp<Path> Alloc(size_t pointCount, size_t verbCount, PathFillType);
+
+    // Wrap, for PathBuilder::snapshot
+    static rcp<Path> WrapBuilderStorage(rcp<Data>, Span<const Point>, Span<const PathVerb>,
+                                        PathFillType);
+    friend class PathBuilder;
+
+    Point* writablePoints() { assert(this->ownsStorage()); return const_cast<Point*>(m_points); }
+    PathVerb* writableVerbs() { assert(this->ownsStorage()); return const_cast<PathVerb*>(m_verbs); }
+
+    // we are allocated with ::operator new(size + trailing storage)
+    static void operator delete(void* ptr) { ::operator delete(ptr); }
+
+public:
+    ~Path() override;
+
+    static rcp<Path> Make(Span<const Point>, Span<const PathVerb>, PathFillType = kDefFillType,
+                          const Rect* bounds = nullptr);
+
+    // Returns a path that uses the points and verbs in place, rather than copying
+    // them. They must live in storage's buffer (e.g. a mapped file), which the
+    // path keeps a ref to, and must not change while the path is alive.
+    static rcp<Path> Wrap(rcp<Data> storage, Span<const Point>, Span<const PathVerb>,
+                          PathFillType = kDefFillType, const Rect* bounds = nullptr);
+
+    bool empty() const { return m_pointCount == 0; }
+    // False if our points and verbs live in someone else's storage (see Wrap),
+    // in which case we never change them in place. A PathBuilder's snapshot owns
+    // its storage once the builder and its other snapshots have let go of it.
+    bool ownsStorage() const;
     PathFillType fillType() const { return m_fillType; }
-    Span<const Point> points() const { return m_points; }
-    Span<const PathVerb> verbs() const { return m_verbs; }
-    const Rect& bounds() const { return m_bounds; }
+    Span<const Point> points() const { return {m_points, m_pointCount}; }
+    Span<const PathVerb> verbs() const { return {m_verbs, m_verbCount}; }
+
+    // The bounds of the points (control points included)
+    const Rect& bounds() const {
+        if (!(m_lazyFlags.load(std::memory_order_acquire) & kBoundsValid)) {
+            this->computeBounds();
+        }
+        return m_bounds;
+    }
+
+    // The bounds of the curves themselves, which may be smaller than bounds()
+    const Rect& tightBounds() const {
+        if (!(m_lazyFlags.load(std::memory_order_acquire) & kTightBoundsValid)) {
+            this->computeTightBounds();
+        }
+        return m_tightBounds;
+    }
 
     std::vector<Point> copyPoints() const;
     std::vector<PathVerb> copyVerbs() const;
 
+    // A hash of our fill type, points and verbs: equal paths have equal hashes
+    // (unlike uniqueID, which is different for every path).
+    uint64_t contentHash() const {
+        if (!(m_lazyFlags.load(std::memory_order_acquire) & kContentHashValid)) {
+            this->computeContentHash();
+        }
+        return m_contentHash;
+    }
+
+    // Computed the first time it is asked for (except that Rect, Oval and
+    // Circle know it when they make the path).
+    const PathInfo& info() const {
+        if (!(m_lazyFlags.load(std::memory_order_acquire) & kInfoValid)) {
+            this->computeInfo();
+        }
+        return m_info;
+    }
+
     bool operator==(const Path& o) const;
     bool operator!=(const Path& o) const { return !(*this == o); }
     
     rcp<Path> transform(const Matrix&) const;
 
+    // If the caller holds the only reference to the path, it is transformed
+    // in place (and given a new uniqueID), otherwise this returns a transformed copy.
+    static rcp<Path> Transform(rcp<Path>&&, const Matrix&);
+
     static rcp<Path> Empty();
     static rcp<Path> Rect(const pentrek::Rect&, PathDirection = PathDirection::ccw);
     static rcp<Path> Oval(const pentrek::Rect&, PathDirection = PathDirection::ccw);
@@ -68,14 +221,33 @@ public:
     // requires a and b have the same structure and size
     static rcp<Path> Lerp(const Path* a, const Path* b, float t);
 
-    bool hitTest(Point, float radius = 1);
+    // Same as Lerp, but if the caller holds the only reference to dst, and it
+    // has the same size and fill type as a (e.g. it is the previous frame's
+    // result), its storage is reused (and it is given a new uniqueID). Once
+    // warmed up, morphing this way does not allocate.
+    static rcp<Path> Lerp(rcp<Path>&& dst, const Path& a, const Path& b, float t);
+
+    // Batch versions, each of which reuses the storage in dst (as above).
+    // dst[i] = Lerp(a[i], b[i], t)
+    static void Lerp(Span<rcp<Path>> dst, Span<const Path* const> a,
+                     Span<const Path* const> b, float t);
+    // dst[i] = Lerp(a, b, t[i])
+    static void Lerp(Span<rcp<Path>> dst, const Path& a, const Path& b, Span<const float> t);
+
+    // Returns true if the point is inside the path, respecting its fillType
+    bool contains(Point) const;
+
+    // Returns true if the point is inside the path, or if the path's outline
+    // passes within radius (in x and y) of it.
+    bool hitTest(Point, float radius = 1) const;
+    // Returns true if any part of the rect is inside the path, or touches its outline
     bool hitTest(const IRect&) const;
 
     template <typename M, typename L, typename Q, typename C, typename X>
     void visit(M m, L l, Q q, C c, X x) const {
         const Point* movePt = nullptr;
-        const Point* p = m_points.data();
-        for (auto v : m_verbs) {
+        const Point* p = m_points;
+        for (auto v : this->verbs()) {
             switch (v) {
                 case PathVerb::move:
                     m(p);
@@ -91,9 +263,23 @@ public:
                     break;
             }
         }
-        assert(p == m_points.data() + m_points.size());
+        assert(p == m_points + m_pointCount);
     }
-    
+
+    /*
+     *  Sends the path to sink, which can be any type with PathSync's methods
+     *  (move, line, quad, cubic, close). They are resolved at compile time, so
+     *  for a concrete sink (e.g. PathBuilder, which is final) there is no
+     *  virtual dispatch per segment, and small sinks inline into the loop.
+     */
+    template <typename Sink> void replay(Sink* sink) const {
+        this->visit([sink](const Point* p) { sink->move(p[0]); },
+                    [sink](const Point* p) { sink->line(p[0]); },
+                    [sink](const Point* p) { sink->quad(p[0], p[1]); },
+                    [sink](const Point* p) { sink->cubic(p[0], p[1], p[2]); },
+                    [sink](Point, Point) { sink->close(); });
+    }
+
     class Iter {
         Span<const Point>    m_pts;
         Span<const PathVerb> m_vbs;
@@ -112,8 +298,10 @@ public:
     
     void dump() const;  // printf debugging
 
-    void writeSVGString(Writer*) const;
-    rcp<Data> asSVGData() const;
+    // Writes the path as SVG path data (e.g. "M1,2L3,4Z"), buffering the
+    // output so the writer sees a few large writes.
+    void writeSVGString(Writer*, const SVGPathOptions& = {}) const;
+    rcp<Data> asSVGData(const SVGPathOptions& = {}) const;
 
     static void Tests();
 };
@@ -126,6 +314,44 @@ static inline rcp<Path> operator*(const Matrix& m, const rcp<Path>& p) {
     return p->transform(m);
 }
 
+static inline rcp<Path> operator*(const Matrix& m, rcp<Path>&& p) {
+    return Path::Transform(std::move(p), m);
+}
+
+/*
+ *  A non-owning reference to a path, plus a matrix to apply to its points.
+ *  Nothing is copied up front: the points are mapped on demand (or by the backend).
+ *  The path must outlive the view.
+ */
+class TransformedPathView {
+    const Path* m_path;
+    Matrix      m_matrix;
+
+public:
+    TransformedPathView(const Path& path, const Matrix& mx) : m_path(&path), m_matrix(mx) {}
+    TransformedPathView(const rcp<Path>& path, const Matrix& mx)
+        : TransformedPathView(path.deref(), mx) {}
+
+    const Path& path() const { return *m_path; }
+    const Matrix& matrix() const { return m_matrix; }
+
+    PathFillType fillType() const { return m_path->fillType(); }
+    Span<const PathVerb> verbs() const { return m_path->verbs(); }
+    size_t pointCount() const { return m_path->points().size(); }
+
+    // dst.size() must be >= pointCount()
+    void mapPoints(Span<Point> dst) const { m_matrix.map(dst, m_path->points()); }
+
+    rcp<Path> copyPath() const { return m_path->transform(m_matrix); }
+};
+
+/*
+ *  The interface for anything that consumes segments as they are produced.
+ *
+ *  Producers that know their sink's type should take it as a template
+ *  parameter instead (see Path::replay): the sink then only needs these
+ *  methods, not this base class, and the calls are not virtual.
+ */
 class PathSync {
 public:
     virtual ~PathSync() {}
@@ -161,12 +387,31 @@ struct CtrlPoint {
 
 rcp<Path> path_from_ctrlpoints(Span<const CtrlPoint>, bool doClose);
 
+/*
+ *  A smooth curve through a list of points (a variant of Catmull-Rom). At each
+ *  point, the tangent is parallel to the line between its neighbors, and the
+ *  handles (prev, next) together are m_tanScale times that line's length (so
+ *  with the default scale, 4 points on a circle make a very good circle).
+ *
+ *  If m_useC2 is true, the two handles are the same length, so the curve's
+ *  speed (not just its direction) is continuous through the point. If it is
+ *  false, each handle's share follows the length of its own side, which keeps
+ *  the curve from overshooting where the points are unevenly spaced.
+ *
+ *  Each handle is at most m_maxTanLength. A point's control points only depend
+ *  on it and its neighbors (see MikeMullSpline, which uses this to update
+ *  only what changes when a point moves).
+ */
 struct MikeMull {
     float m_tanScale = kBezierCircleCoeff;
     float m_maxTanLength = std::numeric_limits<float>::infinity();
     bool m_isClosed = false;
     bool m_useC2 = true;
     
+    // The control points for curr, given its neighbors (at the ends of an open
+    // curve, pass curr as the missing neighbor).
+    CtrlPoint ctrlPoint(Point prev, Point curr, Point next) const;
+
     std::vector<CtrlPoint> ctrlPoints(Span<const Point>) const;
     rcp<Path> path(Span<const Point>) const;
 };
@@ -5,28 +5,144 @@
 #ifndef _pentrek_path_builder_h_
 #define _pentrek_path_builder_h_
 
+#include "include/data.h"
 #include "include/path.h"
+#include <algorithm>
+#include <utility>
 #include <vector>
 
 namespace pentrek {
 
-class PathBuilder : public PathSync {
+/*
+ *  Our points and verbs live in a single block, which snapshot() shares with the
+ *  paths it returns (rather than copying them into each one). A snapshot only
+ *  sees what we had when it was taken, and we only ever append past that, so
+ *  taking one as we grow costs O(1). Changing anything a snapshot can see (or
+ *  outgrowing the block) moves us to a new block first, leaving the old one to
+ *  the snapshots. detach() copies into a path of its own (and keeps the block
+ *  for reuse), unless snapshots are sharing the block, in which case it hands
+ *  the block to the path it returns.
+ */
+class PathBuilder final : public PathSync {
     static constexpr PathFillType kDefFillType = PathFillType::winding;
 
 public:
-    std::vector<Point> m_points;
-    std::vector<PathVerb> m_verbs;
+    /*
+     *  The subset of std::vector that we need (inserting only at the end).
+     *  Writing over something a snapshot can see first takes us off of the
+     *  block it is sharing, so the non-const data() (which can write anywhere)
+     *  always checks, while [] and writable() only check what they give access
+     *  to. Iterating is read-only, as are front() and back(), and appending
+     *  only writes past what the snapshots see, so those never have to move.
+     */
+    template <typename T> class Array {
+    public:
+        Array(PathBuilder* owner) : m_owner(owner) {}
+        Array(const Array&) = delete;
+        Array& operator=(const Array&) = delete;
+
+        size_t size() const { return m_size; }
+        size_t capacity() const { return m_capacity; }
+        bool empty() const { return m_size == 0; }
+
+        const T* data() const { return m_data; }
+        const T* begin() const { return m_data; }
+        const T* end() const { return m_data + m_size; }
+        const T& operator[](size_t i) const { assert(i < m_size); return m_data[i]; }
+        const T& front() const { return (*this)[0]; }
+        const T& back() const { return (*this)[m_size - 1]; }
+
+        T* data() { this->willWrite(0); return m_data; }
+        T& operator[](size_t i) { assert(i < m_size); this->willWrite(i); return m_data[i]; }
+        // Write access to just [first, first + count)
+        Span<T> writable(size_t first, size_t count) {
+            assert(first <= m_size && count <= m_size - first);
+            this->willWrite(first);
+            return {m_data + first, count};
+        }
+
+        void push_back(T value) { *this->append(1) = value; }
+
+        template <typename Iter> void insert(const T* pos, Iter first, Iter last) {
+            assert(pos == m_data + m_size);
+            std::copy(first, last, this->append(std::distance(first, last)));
+        }
+        void insert(const T* pos, std::initializer_list<T> src) {
+            this->insert(pos, src.begin(), src.end());
+        }
+        template <typename Iter> void assign(Iter first, Iter last) {
+            this->clear();
+            this->insert(m_data, first, last);
+        }
+
+        void resize(size_t n) {
+            if (n > m_size) {
+                std::fill_n(this->append(n - m_size), n - m_size, T());
+            }
+            m_size = n;
+        }
+        void clear() { m_size = 0; }
+        // Unlike std::vector, this grows geometrically (so callers can reserve
+        // a little more each time they add something).
+        void reserve(size_t n) {
+            if (n > m_capacity) {
+                m_owner->grow(this, std::max(n, m_capacity * 2));
+            }
+        }
+
+    private:
+        PathBuilder* m_owner;
+        T*           m_data = nullptr;
+        size_t       m_size = 0;
+        size_t       m_capacity = 0;
+        size_t       m_frozen = 0;  // how many of us a snapshot may be looking at
+
+        // Takes src's storage (we stay with our builder, since we point back to it)
+        void take(Array* src) {
+            m_data = std::exchange(src->m_data, nullptr);
+            m_size = std::exchange(src->m_size, 0);
+            m_capacity = std::exchange(src->m_capacity, 0);
+            m_frozen = std::exchange(src->m_frozen, 0);
+        }
+
+        // Called before writing from first on (only the start matters, since
+        // the snapshots see a prefix of us)
+        void willWrite(size_t first) {
+            if (first < m_frozen) {
+                m_owner->unshare();
+            }
+        }
+
+        // Returns where to write the next n, which we now count in our size
+        T* append(size_t n) {
+            if (m_size < m_frozen) {
+                m_owner->unshare();     // e.g. after clear(), we'd overwrite a snapshot's
+            }
+            if (m_capacity - m_size < n) {
+                m_owner->grow(this, std::max({m_size + n, m_capacity * 2, (size_t)8}));
+            }
+            T* dst = m_data + m_size;
+            m_size += n;
+            return dst;
+        }
+
+        friend class PathBuilder;
+    };
+
+    Array<Point> m_points{this};
+    Array<PathVerb> m_verbs{this};
     PathFillType m_fillType = kDefFillType;
 
     PathBuilder() = default;
-    PathBuilder(const PathBuilder&) = default;
-    PathBuilder(PathBuilder&&) = default;
+    PathBuilder(const PathBuilder&);
+    PathBuilder(PathBuilder&&);
     ~PathBuilder() = default;
 
     PathBuilder(const Path&, const Matrix&);
     PathBuilder(const Path& src) : PathBuilder(src, Matrix::I()) {}
 
-    PathBuilder& operator=(const PathBuilder&) = default;
+    PathBuilder& operator=(const PathBuilder&);
+    PathBuilder& operator=(PathBuilder&&);
 
     rcp<Path> snapshot();    // does not affect the builder
     rcp<Path> detach();      // leaves the builder empty
@@ -37,11 +153,34 @@ public:
 
     void incReserve(size_t ptsDelta, size_t vbsDelta) override;
 
-    void move(Point) override;
-    void line(Point) override;
-    void quad(Point, Point) override;
-    void cubic(Point, Point, Point) override;
-    void close() override;
+    // These are inline (and we are final), so a producer that knows it has a
+    // PathBuilder (see Path::replay) appends without any calls.
+    void move(Point p) override {
+        m_verbs.push_back(PathVerb::move);
+        m_points.push_back(p);
+    }
+    void line(Point p) override {
+        assert(this->readyForSegment());
+        m_verbs.push_back(PathVerb::line);
+        m_points.push_back(p);
+    }
+    void quad(Point p1, Point p2) override {
+        assert(this->readyForSegment());
+        m_verbs.push_back(PathVerb::quad);
+        m_points.push_back(p1);
+        m_points.push_back(p2);
+    }
+    void cubic(Point p1, Point p2, Point p3) override {
+        assert(this->readyForSegment());
+        m_verbs.push_back(PathVerb::cubic);
+        m_points.push_back(p1);
+        m_points.push_back(p2);
+        m_points.push_back(p3);
+    }
+    void close() override {
+        assert(this->readyForSegment());
+        m_verbs.push_back(PathVerb::close);
+    }
 
     void move(float x, float y) { this->move({x, y}); }
     void line(float x, float y) { this->line({x, y}); }
@@ -66,12 +205,41 @@ public:
     void addPath(const rcp<Path>& path, const Matrix& mx) {
         this->addPath(path.deref(), mx);
     }
+    void addPath(const TransformedPathView& view) {
+        this->addPath(view.path(), view.matrix());
+    }
 
     void transformInPlace(const Matrix&);
+
+    // Replaces our contents with Path::Lerp(a, b, t), reusing our storage.
+    // Requires a and b have the same structure and size.
+    void setLerp(const Path& a, const Path& b, float t);
+
+private:
+    rcp<Data> m_block;      // our points, followed by our verbs (or null)
+
+    // Moves us to a new block, with room for this many points and verbs
+    void reallocate(size_t pointCapacity, size_t verbCapacity);
+    void grow(const Array<Point>*, size_t capacity) {
+        this->reallocate(capacity, m_verbs.capacity());
+    }
+    void grow(const Array<PathVerb>*, size_t capacity) {
+        this->reallocate(m_points.capacity(), capacity);
+    }
+    // Called before writing over something that a snapshot may be looking at
+    void unshare();
+
+#ifdef DEBUG
+    bool readyForSegment() const;
+#endif
 };
 
 void path_add_ctrlpoints(PathBuilder* dst, Span<const CtrlPoint>, bool doClose);
 
+// The points used by addRect and addOval (move, 3 lines, close) and (move, 4 cubics, close)
+void rect_points(const Rect&, PathDirection, Point dst[4]);
+void oval_points(const Rect&, PathDirection, Point dst[13]);
+
 } // namespace
 
 #endif
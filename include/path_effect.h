@@ -0,0 +1,50 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#ifndef _pentrek_path_effect_h_
+#define _pentrek_path_effect_h_
+
+#include "include/measure.h"
+#include "include/path.h"
+#include "include/refcnt.h"
+#include "include/span.h"
+
+namespace pentrek {
+
+/*
+ *  Turns a path into (typically) pieces of it, by extracting segments with
+ *  ContourMeasure::getSegment.
+ *
+ *  Effects are immutable and cheap to make, so animating one (e.g. its phase)
+ *  just means making a new one each frame. The expensive part, measuring the
+ *  path, is cached (see PathMeasure::Make), or can be held by the caller and
+ *  passed to apply() directly.
+ */
+class PathEffect : public RefCnt {
+public:
+    // intervals alternate between on and off lengths, starting with on. If
+    // there are an odd number, they are repeated to make an even number.
+    // The phase is how far into the intervals each contour starts.
+    // Returns nullptr if an interval is negative, or if they are all zero.
+    // A contour that would get more than a million dashes (e.g. if the
+    // intervals are tiny next to its length) is left as is, undashed.
+    static rcp<PathEffect> Dash(Span<const float> intervals, float phase);
+
+    // start and end are fractions of the total length of all of the contours,
+    // and offset is added to both (wrapping around the end of the path).
+    static rcp<PathEffect> Trim(float start, float end, float offset = 0);
+
+    virtual void apply(const PathMeasure&, PathSync*) const = 0;
+
+    void apply(const Path& path, PathSync* sink) const {
+        this->apply(*PathMeasure::Make(path), sink);
+    }
+    rcp<Path> apply(const Path&) const;
+
+    static void Tests();
+};
+
+} // namespace
+
+#endif
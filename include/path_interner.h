@@ -0,0 +1,54 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#ifndef _pentrek_path_interner_h_
+#define _pentrek_path_interner_h_
+
+#include "include/path.h"
+#include <mutex>
+#include <unordered_map>
+
+namespace pentrek {
+
+/*
+ *  Maps paths to a single shared instance for each distinct content (fill
+ *  type, points and verbs), so repeated paths (e.g. the same glyph, or a
+ *  shape rebuilt every frame) can share one object, and be keyed by its
+ *  uniqueID.
+ *
+ *  The interner holds a ref on each path, but periodically drops any that it
+ *  is the only owner of, so it does not keep unused paths alive for long.
+ *
+ *  All methods are thread-safe.
+ */
+class PathInterner {
+public:
+    PathInterner() = default;
+    PathInterner(const PathInterner&) = delete;
+    PathInterner& operator=(const PathInterner&) = delete;
+
+    // Returns the shared path equal to this one. If there isn't one yet, this
+    // path becomes it.
+    rcp<Path> intern(rcp<Path>);
+
+    size_t count() const;
+
+    // Drops all paths that only the interner is holding
+    void purgeUnused();
+
+    static PathInterner& Global();
+
+private:
+    mutable std::mutex m_mutex;
+    std::unordered_multimap<uint64_t, rcp<Path>> m_paths;   // keyed by contentHash()
+    size_t m_purgeAt = kMinPurgeCount;
+
+    static constexpr size_t kMinPurgeCount = 256;
+
+    void purgeUnusedLocked();
+};
+
+} // namespace
+
+#endif
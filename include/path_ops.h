@@ -0,0 +1,73 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#ifndef _pentrek_path_ops_h_
+#define _pentrek_path_ops_h_
+
+#include "include/cache.h"
+#include "include/path.h"
+
+namespace pentrek {
+
+enum class PathOp : uint8_t {
+    kUnion,
+    kIntersect,
+    kDifference,    // a - b
+    kXor,
+};
+
+/*
+ *  Boolean operations on the areas that paths fill (respecting their fill types).
+ *
+ *  The results are made of non-overlapping contours, each oriented the same
+ *  way, so they fill the same with either fill type. Curves are kept as curves:
+ *  pieces of a curve that weren't cut by another edge are rejoined.
+ */
+class PathOps {
+public:
+    static rcp<Path> Op(const Path& a, const Path& b, PathOp);
+
+    // Resolves self-overlapping contours into the outline of the area the path fills
+    static rcp<Path> Simplify(const Path&);
+
+    // Like Simplify, but the inside is only where the winding is positive, i.e.
+    // inside more cw contours than ccw ones (whatever the path's fill type).
+    // This drops the loops in an offset curve that go backwards.
+    static rcp<Path> SimplifyPositive(const Path&);
+
+    static void Tests();
+};
+
+/*
+ *  Remembers the results of PathOps::Simplify, keyed by the source path's
+ *  contents (not its uniqueID), so e.g. the same glyph outline, which the font
+ *  returns as a new path each time, is only simplified once.
+ *
+ *  All methods are thread-safe.
+ */
+class SimplifyCache {
+public:
+    static constexpr size_t kDefaultLimit = 512;
+
+    SimplifyCache(size_t limit = kDefaultLimit) : m_cache(limit) {}
+
+    rcp<Path> simplify(const Path&);
+
+    size_t count() const { return m_cache.count(); }
+    void purgeAll() { m_cache.purgeAll(); }
+
+    static SimplifyCache& Global();
+
+private:
+    struct Entry {
+        rcp<const Path> m_source;   // to check for hash collisions
+        rcp<Path>       m_result;
+    };
+
+    LRUCache<uint64_t, Entry> m_cache;  // keyed by contentHash()
+};
+
+} // namespace
+
+#endif
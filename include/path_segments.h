@@ -0,0 +1,81 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#ifndef _pentrek_path_segments_h_
+#define _pentrek_path_segments_h_
+
+#include "include/path.h"
+#include <vector>
+
+namespace pentrek {
+
+/*
+ *  A path's segments, grouped by kind (lines, quads, cubics) into batches laid
+ *  out as structure-of-arrays, for code that processes many segments at once:
+ *  rather than stepping through the verbs and branching on each one, it runs
+ *  a straight loop over each batch, which the compiler can vectorize.
+ *
+ *  In a batch, point k of segment i (k == 0 being where it starts) is
+ *  {x(k)[i], y(k)[i]}. Segments are also numbered in path order (across all
+ *  kinds), and index()[i] is that number, so results can be put back in order.
+ *  A close adds a line back to the contour's start, if it isn't already there.
+ *
+ *  reset() reuses our storage, so a PathSegments that is kept around does not
+ *  allocate once it has grown to fit.
+ */
+class PathSegments {
+public:
+    class Batch {
+    public:
+        size_t count() const { return m_count; }
+
+        // k is in [0 ... degree]
+        Span<const float> x(int k) const { return {m_coords.data() + (2*k) * m_stride, m_count}; }
+        Span<const float> y(int k) const { return {m_coords.data() + (2*k + 1) * m_stride, m_count}; }
+        Span<const uint32_t> index() const { return {m_index.data(), m_count}; }
+
+        Point point(int k, size_t i) const { return {this->x(k)[i], this->y(k)[i]}; }
+
+    private:
+        std::vector<float>    m_coords;
+        std::vector<uint32_t> m_index;
+        size_t                m_count = 0;
+        size_t                m_stride = 0;     // between the arrays in m_coords
+
+        friend class PathSegments;
+    };
+
+    struct Contour {
+        uint32_t m_end;     // number (in path order) after our last segment
+        bool     m_closed;
+    };
+
+    void reset(const Path&);
+
+    const Batch& lines() const  { return m_batches[0]; }
+    const Batch& quads() const  { return m_batches[1]; }
+    const Batch& cubics() const { return m_batches[2]; }
+
+    // The batch for a segment verb (line, quad or cubic)
+    const Batch& batch(PathVerb v) const {
+        assert(v == PathVerb::line || v == PathVerb::quad || v == PathVerb::cubic);
+        return m_batches[(int)v - 1];
+    }
+
+    size_t count() const { return m_count; }    // all segments, of every kind
+
+    // Contours with no segments (just a move) are skipped
+    Span<const Contour> contours() const { return m_contours; }
+
+    static void Tests();
+
+private:
+    Batch                m_batches[3];
+    std::vector<Contour> m_contours;
+    size_t               m_count = 0;
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,78 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#ifndef _pentrek_path_svg_h_
+#define _pentrek_path_svg_h_
+
+#include "include/data.h"
+#include "include/path.h"
+
+namespace pentrek {
+
+/*
+ *  Parses SVG path data (the "d" attribute), sending each segment to a PathSync
+ *  as soon as it is complete. It handles the whole command set: absolute and
+ *  relative, H and V, the smooth curves S and T, and arcs (as cubics).
+ *
+ *  It does not allocate, and holds at most one partial number between calls
+ *  to write(), so a file of any size can be parsed in one pass with bounded
+ *  memory, either mapped (see Data::MapFile) or read in pieces.
+ *
+ *  Invalid data stops the parse. As SVG renderers do, whatever was complete
+ *  before the error has already been sent to the sink.
+ *  Numbers longer than kMaxNumberChars are treated as errors.
+ */
+class SVGPathParser {
+public:
+    static constexpr size_t kMaxNumberChars = 64;
+
+    SVGPathParser(PathSync* dst) : m_dst(dst) {}
+
+    // Parses the next piece of the data. Pieces may be split anywhere, even in
+    // the middle of a number. Returns false (and ignores any more data) after an error.
+    bool write(Span<const char>);
+
+    // Call after the last piece. Returns false if the data was not valid.
+    bool finish();
+
+    // One-shot versions
+    static bool Parse(Span<const char>, PathSync*);
+    static bool Parse(const Data& data, PathSync* dst) { return Parse(data.cspan(), dst); }
+
+    // Returns nullptr if the data is not valid
+    static rcp<Path> MakePath(Span<const char>, PathFillType = PathFillType::winding);
+
+    static void Tests();
+
+private:
+    PathSync*   m_dst;
+
+    Point       m_current = {0, 0};
+    Point       m_start = {0, 0};       // of the current contour, where Z returns to
+    Point       m_lastCtrl = {0, 0};    // of the previous segment, for S and T
+    char        m_cmd = 0;              // upper case, or 0 before the first command
+    char        m_prevCmd = 0;          // the previous segment's command
+    bool        m_relative = false;
+    bool        m_needsMove = false;    // the contour was closed, so drawing starts a new one
+    bool        m_needsArgs = false;    // a command letter has had no segments yet
+    bool        m_error = false;
+
+    int         m_argCount = 0;
+    float       m_args[7];
+
+    size_t      m_carryLen = 0;
+    char        m_carry[kMaxNumberChars];
+
+    const char* parse(const char* p, const char* end, bool final);
+    bool command(char);
+    void segment();
+    bool fail() {
+        m_error = true;
+        return false;
+    }
+};
+
+} // namespace
+
+#endif
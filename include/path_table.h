@@ -0,0 +1,70 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#ifndef _pentrek_path_table_h_
+#define _pentrek_path_table_h_
+
+#include "include/data.h"
+#include "include/path.h"
+
+namespace pentrek {
+
+enum class PathEncoding : uint8_t {
+    kFloat32,   // exact, and the points can be used in place (see PathTable::at)
+    kQuant16,   // 16 bits per coordinate, relative to each path's bounds: about
+                // half the size, within bounds.size() / 131070 of the original
+};
+
+/*
+ *  A compact binary encoding for a set of paths (e.g. all of the glyphs in a font),
+ *  designed to be loaded by mapping the file (see Data::MapFile) rather than by
+ *  reading and parsing it.
+ *
+ *  The encoding is a header, a directory (one entry per path: its fill type,
+ *  bounds, and the offsets and counts of its points and verbs), and then each
+ *  path's points followed by its verbs. Everything is aligned for direct access,
+ *  in the platform's byte order (little-endian, on all of our platforms).
+ *
+ *  With kFloat32, the paths returned by at() point into the data (keeping a ref
+ *  to it), so loading costs neither a copy nor a parse. Only the directory and
+ *  the verbs are validated.
+ */
+class PathTable : public RefCnt {
+public:
+    static rcp<Data> Encode(Span<const Path* const>, PathEncoding = PathEncoding::kFloat32);
+    static rcp<Data> Encode(const Path& path, PathEncoding enc = PathEncoding::kFloat32) {
+        const Path* p = &path;
+        return Encode({&p, 1}, enc);
+    }
+
+    // Returns nullptr if the data is not a valid encoding
+    static rcp<PathTable> Make(rcp<Data>);
+
+    // Returns the first path in the data, or nullptr if it isn't valid
+    static rcp<Path> Decode(rcp<Data>);
+
+    size_t count() const { return m_count; }
+    PathEncoding encoding() const { return m_encoding; }
+
+    // Returns nullptr if that path's verbs are not valid (e.g. they need more
+    // points than it has). Each call returns a new path object.
+    rcp<Path> at(size_t index) const;
+
+    static void Tests();
+
+private:
+    struct Header;
+    struct Entry;
+
+    rcp<Data>       m_data;
+    const Entry*    m_entries;
+    size_t          m_count;
+    PathEncoding    m_encoding;
+
+    PathTable(rcp<Data>, const Entry*, size_t count, PathEncoding);
+};
+
+} // namespace
+
+#endif
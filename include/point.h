@@ -78,7 +78,7 @@ struct Point {
     }
     
     bool isZero() const { return x == 0 && y == 0; }
-    bool isNearlyZero(float tol = 1.0f/32678) {
+    bool isNearlyZero(float tol = 1.0f/32678) const {
         return std::abs(x) <= tol && std::abs(y) <= tol;
     }
 
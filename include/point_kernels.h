@@ -0,0 +1,51 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#ifndef _pentrek_point_kernels_h_
+#define _pentrek_point_kernels_h_
+
+#include "include/matrix.h"
+#include "include/rect.h"
+#include <vector>
+
+namespace pentrek {
+
+/*
+ *  Inner loops over arrays of points, with a SIMD version for each instruction
+ *  set we know about (SSE2, AVX2, NEON, WASM-SIMD) and a scalar fallback.
+ *
+ *  Get() returns the best set for the current CPU (chosen once, at runtime).
+ *  Most callers don't need this directly: Matrix::map, Rect::Bounds and
+ *  Path::Lerp all go through it.
+ *
+ *  For all of these, dst may be the same as src (but may not partially overlap).
+ */
+struct PointKernels {
+    const char* m_name;
+
+    // dst[i] = {sx * src[i].x + tx, sy * src[i].y + ty}
+    void (*m_scaleTrans)(Point dst[], const Point src[], size_t n,
+                         float sx, float sy, float tx, float ty);
+
+    // dst[i] = mx * src[i]
+    void (*m_affine)(Point dst[], const Point src[], size_t n, const Matrix& mx);
+
+    // returns the bounds of src[], requires n > 0
+    Rect (*m_bounds)(const Point src[], size_t n);
+
+    // dst[i] = a[i] + (b[i] - a[i]) * t
+    void (*m_lerp)(Point dst[], const Point a[], const Point b[], size_t n, float t);
+
+    static const PointKernels& Get();
+    static const PointKernels& Scalar();
+
+    // All of the sets that this CPU can run (the scalar version is first)
+    static std::vector<const PointKernels*> Available();
+
+    static void Tests();
+};
+
+} // namespace
+
+#endif
@@ -23,6 +23,11 @@ public:
     int32_t debugging_refcnt() const {
         return m_refcnt.load(std::memory_order_relaxed);
     }
+
+    // Returns true if the caller holds the only reference to this object
+    bool unique() const {
+        return 1 == m_refcnt.load(std::memory_order_acquire);
+    }
     
     void ref() const {
         (void)m_refcnt.fetch_add(+1, std::memory_order_relaxed);
@@ -31,8 +31,14 @@ public:
     template <typename U, typename = typename std::enable_if<std::is_same<const U, T>::value>::type>
     constexpr Span(const Span<U>& src) : m_ptr(std::data(src)), m_size(std::size(src)) {}
 
+    // A Span of const T only reads c, so it asks c for its const data (which
+    // for some containers, e.g. PathBuilder's, is cheaper).
     template <typename Container>
-    constexpr Span(Container& c) : Span(std::data(c), std::size(c)) {}
+    constexpr Span(Container& c)
+        : Span(std::data(static_cast<typename std::conditional<std::is_const<T>::value,
+                                                               const Container&,
+                                                               Container&>::type>(c)),
+               std::size(c)) {}
 
     constexpr T& operator [](size_t i) const {
         assert(i < m_size);
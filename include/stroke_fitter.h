@@ -0,0 +1,78 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#ifndef _pentrek_stroke_fitter_h_
+#define _pentrek_stroke_fitter_h_
+
+#include "include/path.h"
+#include <vector>
+
+namespace pentrek {
+
+/*
+ *  Turns a stream of input points (e.g. mouse moves) into a few cubics, as the
+ *  points arrive, in two stages:
+ *
+ *  1. Ramer-Douglas-Peucker, over the points since the last vertex (at most
+ *     m_window of them): while they are all within m_tolerance of the line
+ *     from that vertex to the newest point, they add nothing. When one isn't,
+ *     RDP picks the vertices among them.
+ *  2. Schneider's curve fitting, over the vertices since the last cubic: it fits
+ *     cubics (with G1 joins) to within m_fitTolerance of them. Turns sharper
+ *     than m_cornerAngle are kept as corners.
+ *
+ *  Once a cubic is followed by another (so its end tangent is settled) it is
+ *  committed: sent to dst, and never changed. The rest (the tail) stays live,
+ *  and can be drawn with addTail(). Call finish() to commit the tail.
+ */
+class StrokeFitter {
+public:
+    struct Options {
+        // m_tolerance should be more than the noise in the input, or RDP keeps
+        // most of it (mouse points are rounded to whole pixels).
+        float m_tolerance = 1.0f;
+        float m_fitTolerance = 1.25f;
+        float m_cornerAngle = 1.0f;     // radians
+        int   m_window = 64;
+    };
+
+    StrokeFitter(PathSync* dst, const Options& opts) : m_dst(dst), m_opts(opts) {}
+    StrokeFitter(PathSync* dst) : StrokeFitter(dst, Options()) {}
+
+    void begin(Point);      // starts a stroke (sending dst a move)
+    void add(Point);
+    void finish();          // commits the tail (begin() must be called again)
+
+    // Sends lines for the tail (from the end of what's committed) to sink
+    void addTail(PathSync* sink) const;
+
+    static void Tests();
+
+private:
+    PathSync*   m_dst;
+    Options     m_opts;
+
+    // stage 1: the last vertex, then the points since
+    Point               m_anchor = {0, 0};
+    std::vector<Point>  m_window;
+
+    // stage 2: the end of what's committed, then the vertices since (with the
+    // midpoint of each edge between them, so the fit also stays near the edges)
+    std::vector<Point>  m_samples;
+    Point               m_startTan = {0, 0};   // or zero, if it isn't constrained
+
+    // the last two edges between vertices (m_edges[1] ends at m_samples.back())
+    struct Edge {
+        Point m_dir;
+        float m_length;     // or zero, if there isn't one
+    };
+    Edge                m_edges[2] = {{{0, 0}, 0}, {{0, 0}, 0}};
+
+    void addVertex(Point);
+    void fit(bool final);
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,176 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#ifndef _pentrek_stroker_h_
+#define _pentrek_stroker_h_
+
+#include "include/paint.h"
+#include "include/path.h"
+#include "include/cache.h"
+
+namespace pentrek {
+
+// The parts of a Paint that determine the shape of its stroke
+struct StrokeParams {
+    float       m_width = 1;
+    float       m_miterLimit = 10;
+    StrokeJoin  m_join = StrokeJoin::miter;
+    StrokeCap   m_cap = StrokeCap::butt;
+
+    StrokeParams() = default;
+    StrokeParams(const Paint& p)
+        : m_width(p.width()), m_miterLimit(p.miterLimit()), m_join(p.join()), m_cap(p.cap())
+    {}
+
+    bool operator==(const StrokeParams& o) const {
+        return m_width == o.m_width && m_miterLimit == o.m_miterLimit &&
+               m_join == o.m_join && m_cap == o.m_cap;
+    }
+    bool operator!=(const StrokeParams& o) const { return !(*this == o); }
+};
+
+/*
+ *  Turns a path into the (winding) fill path that covers its stroke.
+ *
+ *  Lines are offset exactly. Curves are offset by cubics that match the offset's
+ *  position and derivative at each end, subdivided until they are within
+ *  tolerance of the true offset curve. Joins that are within tolerance of
+ *  straight are skipped, so dense polylines (e.g. freehand strokes) stay small.
+ */
+class Stroker {
+public:
+    static constexpr float kDefaultTolerance = 0.25f;
+
+    Stroker(const StrokeParams&, float tolerance = kDefaultTolerance);
+
+    rcp<Path> stroke(const Path&) const;
+
+    // Same result as stroking Path::Poly(pts, doClose), without building the path.
+    rcp<Path> strokePoly(Span<const Point>, bool doClose) const;
+
+    const StrokeParams& params() const { return m_params; }
+    float tolerance() const { return m_tolerance; }
+
+    static void Tests();
+
+private:
+    StrokeParams m_params;
+    float        m_tolerance;
+};
+
+/*
+ *  Remembers stroked paths, keyed by the source path's uniqueID and the stroke
+ *  parameters, so shapes that are redrawn every frame are only stroked once.
+ *  Since paths are immutable (and get a new uniqueID if they are changed in
+ *  place), a cached result is never stale.
+ *
+ *  All methods are thread-safe.
+ */
+class StrokeCache {
+public:
+    static constexpr size_t kDefaultLimit = 256;
+
+    StrokeCache(size_t limit = kDefaultLimit) : m_cache(limit) {}
+
+    rcp<Path> stroke(const Path&, const StrokeParams&, float tolerance = Stroker::kDefaultTolerance);
+
+    size_t count() const { return m_cache.count(); }
+    void purgeAll() { m_cache.purgeAll(); }
+
+    static StrokeCache& Global();
+
+private:
+    struct Key {
+        UniqueID     m_pathID;
+        float        m_tolerance;
+        StrokeParams m_params;
+
+        bool operator==(const Key& o) const {
+            return m_pathID == o.m_pathID && m_tolerance == o.m_tolerance &&
+                   m_params == o.m_params;
+        }
+    };
+    struct KeyHash {
+        size_t operator()(const Key&) const;
+    };
+
+    LRUCache<Key, rcp<Path>, KeyHash> m_cache;
+};
+
+/*
+ *  Offsets the area a path fills: outward for a positive distance (outsetting
+ *  it), inward for a negative one (insetting it). The result's edges are all
+ *  (to within tolerance) the distance away from the path's, with the join
+ *  on the outside of each corner (the inside of a corner is just cut off).
+ *
+ *  Curves are offset as the Stroker does, and are also split where the offset
+ *  has a cusp (where the curve turns more tightly than the distance). The parts
+ *  of the offset that fold back over themselves, or turn inside out, are
+ *  removed, so e.g. insetting a circle by more than its radius leaves nothing.
+ *
+ *  The result is made of non-overlapping contours, like PathOps::Simplify's.
+ */
+class Offsetter {
+public:
+    Offsetter(StrokeJoin, float miterLimit = 10, float tolerance = Stroker::kDefaultTolerance);
+
+    rcp<Path> offset(const Path&, float distance) const;
+
+    static void Tests();
+
+private:
+    StrokeJoin m_join;
+    float      m_miterLimit;
+    float      m_tolerance;
+};
+
+/*
+ *  Remembers offset paths, like StrokeCache does stroked ones. An entry is also
+ *  returned for any distance within half of the tolerance of its own (the other
+ *  half goes to offsetting it), so a path whose inset is animated is only
+ *  offset again once the distance has moved on by that much.
+ *
+ *  All methods are thread-safe.
+ */
+class OffsetCache {
+public:
+    static constexpr size_t kDefaultLimit = 256;
+
+    OffsetCache(size_t limit = kDefaultLimit) : m_cache(limit) {}
+
+    rcp<Path> offset(const Path&, float distance, StrokeJoin, float miterLimit = 10,
+                     float tolerance = Stroker::kDefaultTolerance);
+
+    size_t count() const { return m_cache.count(); }
+    void purgeAll() { m_cache.purgeAll(); }
+
+    static OffsetCache& Global();
+
+private:
+    // everything but the distance, which is matched within the tolerance
+    struct Key {
+        UniqueID   m_pathID;
+        float      m_tolerance;
+        float      m_miterLimit;
+        StrokeJoin m_join;
+
+        bool operator==(const Key& o) const {
+            return m_pathID == o.m_pathID && m_tolerance == o.m_tolerance &&
+                   m_miterLimit == o.m_miterLimit && m_join == o.m_join;
+        }
+    };
+    struct KeyHash {
+        size_t operator()(const Key&) const;
+    };
+    struct Entry {
+        float     m_distance;
+        rcp<Path> m_offset;
+    };
+
+    LRUCache<Key, Entry, KeyHash> m_cache;
+};
+
+} // namespace
+
+#endif
@@ -11,12 +11,17 @@
 namespace pentrek {
 
 class UniqueIDRefCnt : public RefCnt {
-    const UniqueID m_uniqueID;
+    UniqueID m_uniqueID;
     
 public:
     UniqueIDRefCnt();
     
     UniqueID uniqueID() const { return m_uniqueID; }
+
+protected:
+    // Call this if the object's contents are changed (e.g. in place), so that
+    // anyone caching by uniqueID will not see the stale version.
+    void newUniqueID();
 };
 
 } // namespace
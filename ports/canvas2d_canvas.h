@@ -19,7 +19,11 @@ class Canvas2DCanvas : public Canvas {
     struct State {
         Style m_fill,
               m_stroke;
-        float m_strokeWidth = 1;
+        // the context's defaults (which are also Paint's)
+        float      m_strokeWidth = 1;
+        float      m_miterLimit = 10;
+        StrokeJoin m_join = StrokeJoin::miter;
+        StrokeCap  m_cap = StrokeCap::butt;
     };
     std::stack<State> m_stack;
     
@@ -61,6 +65,18 @@ public:
                 this->onUpdateStroke(width);
                 top.m_strokeWidth = width;
             }
+            if (top.m_join != p.join()) {
+                this->onUpdateJoin(p.join());
+                top.m_join = p.join();
+            }
+            if (top.m_cap != p.cap()) {
+                this->onUpdateCap(p.cap());
+                top.m_cap = p.cap();
+            }
+            if (top.m_miterLimit != p.miterLimit()) {
+                this->onUpdateMiterLimit(p.miterLimit());
+                top.m_miterLimit = p.miterLimit();
+            }
         } else {
             this->updateStyle(top.m_fill, sh, c, false);
         }
@@ -70,6 +86,9 @@ protected:
     virtual void onUpdateShader(const Shader&, bool isStroke) = 0;
     virtual void onUpdateColor(const Color&, bool isStroke) = 0;
     virtual void onUpdateStroke(float width) = 0;
+    virtual void onUpdateJoin(StrokeJoin) = 0;
+    virtual void onUpdateCap(StrokeCap) = 0;
+    virtual void onUpdateMiterLimit(float) = 0;
 
     void onSave() override {
         m_stack.push(m_stack.top());
@@ -14,38 +14,47 @@
 
 using namespace pentrek;
 
+// These are templates on the sink, so that (for a final sink like PathBuilder)
+// each call appends directly rather than through PathSync's vtable.
+
+template <typename Sink>
 static void ptrk_move_to_func(hb_draw_funcs_t*, void* draw_data, hb_draw_state_t*,
                               float x, float y, void*) {
-    ((PathSync*)draw_data)->move({x, y});
+    ((Sink*)draw_data)->move({x, y});
 }
 
+template <typename Sink>
 static void ptrk_line_to_func(hb_draw_funcs_t*, void* draw_data, hb_draw_state_t*,
                               float x, float y, void*) {
-    ((PathSync*)draw_data)->line({x, y});
+    ((Sink*)draw_data)->line({x, y});
 }
 
+template <typename Sink>
 static void ptrk_quad_to_func(hb_draw_funcs_t*, void* draw_data, hb_draw_state_t*,
                               float x, float y, float x1, float y1, void*) {
-    ((PathSync*)draw_data)->quad({x, y}, {x1, y1});
+    ((Sink*)draw_data)->quad({x, y}, {x1, y1});
 }
 
+template <typename Sink>
 static void ptrk_cubic_to_func(hb_draw_funcs_t*, void* draw_data, hb_draw_state_t*,
                                float x, float y, float x1, float y1, float x2, float y2, void*) {
-    ((PathSync*)draw_data)->cubic({x, y}, {x1, y1}, {x2, y2});
+    ((Sink*)draw_data)->cubic({x, y}, {x1, y1}, {x2, y2});
 }
 
+template <typename Sink>
 static void ptrk_close_func(hb_draw_funcs_t*, void* draw_data, hb_draw_state_t*, void*) {
-    ((PathSync*)draw_data)->close();
+    ((Sink*)draw_data)->close();
 }
 
-static hb_draw_funcs_t* make_ptrk_draw_funcs() {
+// The draw_data passed with these funcs must be a Sink*
+template <typename Sink> static hb_draw_funcs_t* make_ptrk_draw_funcs() {
     auto funcs = hb_draw_funcs_create();
 
-    hb_draw_funcs_set_move_to_func     (funcs, ptrk_move_to_func,  nullptr, nullptr);
-    hb_draw_funcs_set_line_to_func     (funcs, ptrk_line_to_func,  nullptr, nullptr);
-    hb_draw_funcs_set_quadratic_to_func(funcs, ptrk_quad_to_func,  nullptr, nullptr);
-    hb_draw_funcs_set_cubic_to_func    (funcs, ptrk_cubic_to_func, nullptr, nullptr);
-    hb_draw_funcs_set_close_path_func  (funcs, ptrk_close_func,    nullptr, nullptr);
+    hb_draw_funcs_set_move_to_func     (funcs, ptrk_move_to_func<Sink>,  nullptr, nullptr);
+    hb_draw_funcs_set_line_to_func     (funcs, ptrk_line_to_func<Sink>,  nullptr, nullptr);
+    hb_draw_funcs_set_quadratic_to_func(funcs, ptrk_quad_to_func<Sink>,  nullptr, nullptr);
+    hb_draw_funcs_set_cubic_to_func    (funcs, ptrk_cubic_to_func<Sink>, nullptr, nullptr);
+    hb_draw_funcs_set_close_path_func  (funcs, ptrk_close_func<Sink>,    nullptr, nullptr);
 
     return funcs;
 }
@@ -61,7 +70,7 @@ static hb_blob_t* data_to_blob(rcp<Data> data) {
 
 class FontHB : public Font {
     hb_font_t*        m_font;
-    hb_draw_funcs_t*  m_draw_funcs;
+    hb_draw_funcs_t*  m_draw_funcs;   // draws into a PathBuilder
     Array<Axis>       m_axes;
     const float       m_invUpem;
 
@@ -83,7 +92,7 @@ FontHB::FontHB(hb_font_t* font, Span<const Axis> axes, Span<const Coord> coord,
                uint32_t baseID)
     : Font(coord, baseID)
     , m_font(font)  // we take ownership
-    , m_draw_funcs(make_ptrk_draw_funcs())
+    , m_draw_funcs(make_ptrk_draw_funcs<PathBuilder>())
     , m_axes(axes.begin(), axes.end())
     , m_invUpem(1.0f / hb_face_get_upem(hb_font_get_face(font)))
 {
@@ -98,7 +107,9 @@ FontHB::~FontHB() {
 rcp<Path> FontHB::glyphPath(GlyphID glyph) const {
     const auto mx = Matrix::Scale(m_invUpem, -m_invUpem);
 
-    PathBuilder builder;
+    // Reuse the builder's storage between calls, so the only allocation
+    // (once it has grown) is for the path itself.
+    thread_local PathBuilder builder;
     hb_font_get_glyph_shape(m_font, glyph, m_draw_funcs, &builder);
     builder.transformInPlace(mx);
 
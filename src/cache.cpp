@@ -0,0 +1,85 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#include "include/cache.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+using namespace pentrek;
+
+uint32_t LRUCacheBase::FloatBits(float x) {
+    uint32_t bits;
+    memcpy(&bits, &x, 4);
+    return bits;
+}
+
+uint64_t LRUCacheBase::MedianUse(std::vector<uint64_t>* uses) {
+    assert(!uses->empty());
+    auto median = uses->begin() + uses->size() / 2;
+    std::nth_element(uses->begin(), median, uses->end());
+    return *median;
+}
+
+void LRUCacheBase::Tests() {
+#ifdef DEBUG
+    int makes = 0;
+    auto maker = [&](int value) {
+        return [&makes, value]() { makes += 1; return value; };
+    };
+
+    LRUCache<int, int> cache(4);
+    assert(cache.count() == 0);
+
+    assert(cache.findOrMake(1, maker(10)) == 10);
+    assert(cache.findOrMake(1, maker(99)) == 10);   // found, not made
+    assert(makes == 1 && cache.count() == 1);
+
+    // several values under one key, told apart by matches()
+    auto isOdd = [](int v) { return (v & 1) != 0; };
+    assert(cache.findOrMake(1, isOdd, maker(11)) == 11);
+    assert(cache.findOrMake(1, isOdd, maker(13)) == 11);
+    assert(cache.findOrMake(1, maker(12)) != 12);
+    assert(makes == 2 && cache.count() == 2);
+
+    // at the limit, the least recently used half goes
+    cache.findOrMake(2, maker(20));
+    cache.findOrMake(3, maker(30));
+    cache.findOrMake(2, maker(0));
+    cache.findOrMake(3, maker(0));
+    assert(makes == 4 && cache.count() == 4);
+    cache.findOrMake(4, maker(40));
+    assert(makes == 5 && cache.count() == 3);
+    makes = 0;
+    assert(cache.findOrMake(2, maker(0)) == 20);
+    assert(cache.findOrMake(3, maker(0)) == 30);
+    assert(cache.findOrMake(4, maker(0)) == 40);
+    assert(makes == 0);
+    assert(cache.findOrMake(1, maker(0)) == 0);     // was purged
+    assert(makes == 1);
+
+    cache.purgeAll();
+    assert(cache.count() == 0);
+
+    // a custom hash, with a non-trivial value
+    struct Key {
+        uint32_t m_id;
+        float    m_param;
+        bool operator==(const Key& o) const { return m_id == o.m_id && m_param == o.m_param; }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& k) const {
+            return (size_t)HashMix(k.m_id, FloatBits(k.m_param));
+        }
+    };
+    LRUCache<Key, std::string, KeyHash> strings(2);
+    assert(strings.findOrMake({1, 0.5f}, []() { return std::string("a"); }) == "a");
+    assert(strings.findOrMake({1, 0.25f}, []() { return std::string("b"); }) == "b");
+    assert(strings.findOrMake({1, 0.5f}, []() { return std::string("c"); }) == "a");
+    assert(strings.count() == 2);
+
+    assert(HashMix(1, FloatBits(0.5f)) != HashMix(1, FloatBits(0.25f)));
+    assert(FloatBits(1.0f) == 0x3F800000);
+#endif
+}
@@ -101,6 +101,9 @@ void Canvas::clipRect(const Rect& r) { this->onClipRect(r); }
 void Canvas::clipPath(const Path& p) { this->onClipPath(p); }
 void Canvas::drawRect(const Rect& r, const Paint& p) { this->onDrawRect(r, p); }
 void Canvas::drawPath(const Path& path, const Paint& paint) { this->onDrawPath(path, paint); }
+void Canvas::drawPath(const TransformedPathView& view, const Paint& paint) {
+    this->onDrawPathView(view, paint);
+}
 
 // We have defaults for Rects, in case the client just likes paths
 
@@ -111,3 +114,15 @@ void Canvas::onClipRect(const Rect& r) {
 void Canvas::onDrawRect(const Rect& r, const Paint& paint) {
     this->onDrawPath(*Path::Rect(r).get(), paint);
 }
+
+void Canvas::onDrawPathView(const TransformedPathView& view, const Paint& paint) {
+    if (paint.isFill() && !paint.shader()) {
+        // a solid fill looks the same if we apply the matrix to the canvas instead
+        AutoRestore ar(this);
+        this->concat(view.matrix());
+        this->onDrawPath(view.path(), paint);
+    } else {
+        // the stroke width and the shader must not see the matrix
+        this->onDrawPath(*view.copyPath(), paint);
+    }
+}
@@ -18,11 +18,9 @@ bool CubicUnit::NearlyLinear(Point a, Point b) {
     return nearly_eq(a.x, a.y, tol) && nearly_eq(b.x, b.y, tol);
 }
 
-static float find_unit_cubic_root(float A, float B, float C, float D) {
-    float roots[3];
-    DEBUG_CODE(int n =) cubic_unit_roots(A, B, C, D, roots);
-    assert(n == 1);
-    return roots[0];
+// At^3 + Bt^2 + Ct
+static inline double eval_poly(const double c[3], double t) {
+    return ((c[0]*t + c[1])*t + c[2])*t;
 }
 
 ////////////////////
@@ -47,16 +45,22 @@ CubicUnit::CubicUnit(Point b, Point c) {
     // C = 3b
     // D = 0
     
-    da = 3*b.y - 3*c.y + 1;
-    db = 3*c.y - 6*b.y;
-    dc = 3*b.y;
-    
-    auto b3 = 3 * b;
-    auto c3 = 3 * c;
-    A = b3 - c3 + Point{1, 1};
-    B = c3 - b3 - b3;
-    C = b3;
-    
+    m_xc[0] = 3.0*b.x - 3.0*c.x + 1;
+    m_xc[1] = 3.0*c.x - 6.0*b.x;
+    m_xc[2] = 3.0*b.x;
+    m_yc[0] = 3.0*b.y - 3.0*c.y + 1;
+    m_yc[1] = 3.0*c.y - 6.0*b.y;
+    m_yc[2] = 3.0*b.y;
+
+    // Since b.x and c.x are in [0, 1], x only increases with t. We ensure our
+    // samples do too, so that they always bracket the root.
+    m_xs[0] = 0;
+    for (int k = 1; k < kSegments; ++k) {
+        const double x = eval_poly(m_xc, k * (1.0 / kSegments));
+        m_xs[k] = std::min(std::max(x, m_xs[k - 1]), 1.0);
+    }
+    m_xs[kSegments] = 1;
+
     if (NearlyLinear(b, c)) {
         m_type = Type::linear;
     } else {
@@ -64,37 +68,102 @@ CubicUnit::CubicUnit(Point b, Point c) {
     }
 }
 
-// slower than using CubicCoeff, but this one keeps us monotonic
-// in unittests, and CubicCoeff did not...
-#if 0
-static float eval(float b, float c, float t) {
-    const float a = 0, d = 1;
-    
-    float ab = lerp(a, b, t);
-    float bc = lerp(b, c, t);
-    float cd = lerp(c, d, t);
-    float abc = lerp(ab, bc, t);
-    float bcd = lerp(bc, cd, t);
-    return lerp(abc, bcd, t);
+/*
+ *  Each Newton step depends on the one before, so a single solve spends most
+ *  of its time waiting on (double) multiplies and divides. Solving several
+ *  values in lockstep lets the CPU overlap them. Each value still takes exactly
+ *  the steps it would on its own, so the results are the same for any N.
+ */
+template <int N> void CubicUnit::solveT(const float x[], double t[]) const {
+    // Stop once x(t) is within this (relative) amount of x: far less than the
+    // spacing between floats, so our results are in the same order as the x's.
+    constexpr double kTolerance = 1.0 / (1LL << 36);
+    // Newton converges in a few steps; this is only reached by bisecting
+    constexpr int kMaxIterations = 64;
+
+    double lo[N], hi[N];
+    bool done[N];
+    for (int j = 0; j < N; ++j) {
+        // the last sample <= x (there are kSegments, so this takes log2 steps)
+        int k = 0;
+        for (int step = kSegments / 2; step > 0; step >>= 1) {
+            if (m_xs[k + step] <= x[j]) {
+                k += step;
+            }
+        }
+        lo[j] = k * (1.0 / kSegments);
+        hi[j] = lo[j] + 1.0 / kSegments;
+
+        // start by interpolating the samples
+        const double x0 = m_xs[k],
+                     x1 = m_xs[k + 1];
+        t[j] = x1 > x0 ? lo[j] + (x[j] - x0) / (x1 - x0) * (1.0 / kSegments)
+                       : (lo[j] + hi[j]) * 0.5;
+        done[j] = false;
+    }
+
+    int remaining = N;
+    for (int i = 0; i < kMaxIterations && remaining > 0; ++i) {
+        for (int j = 0; j < N; ++j) {
+            if (done[j]) {
+                continue;
+            }
+            const double f = eval_poly(m_xc, t[j]) - x[j];
+            double next = t[j];
+            if (std::abs(f) > x[j] * kTolerance) {
+                if (f < 0) {
+                    lo[j] = t[j];
+                } else {
+                    hi[j] = t[j];
+                }
+                const double slope = (3*m_xc[0]*t[j] + 2*m_xc[1])*t[j] + m_xc[2];
+                next = t[j] - f / slope;
+                // If Newton would leave the bracket (or the slope is 0), bisect instead.
+                if (!(next > lo[j] && next < hi[j])) {
+                    next = (lo[j] + hi[j]) * 0.5;
+                }
+            }
+            if (next == t[j]) {
+                done[j] = true;
+                remaining -= 1;
+            }
+            t[j] = next;
+        }
+    }
 }
-#endif
 
 float CubicUnit::x_to_y(float x) const {
-    constexpr float epsilon = 0.00001f;
-
     x = pin_to_unit(x);
-    if (m_type == Type::linear) {
-        return x;
-    } else if (x <= epsilon || x >= (1 - epsilon)) {
+    if (m_type == Type::linear || x == 0 || x == 1) {
         return x;
     }
+    double t;
+    this->solveT<1>(&x, &t);
+    return (float)eval_poly(m_yc, t);
+}
 
-    auto t = find_unit_cubic_root(A.x, B.x, C.x, -x);
-    assert(float_is_unit(t));
-
-//        eval(m_pts[0].y, m_pts[1].y, t);
-//    float y1 = ((A.y*t + B.y)*t + C.y)*t;
-    return float(((da*t + db)*t + dc)*t);
+void CubicUnit::x_to_y(Span<const float> src, Span<float> dst) const {
+    assert(src.size() == dst.size());
+    constexpr int kLanes = 4;
+
+    const size_t n = src.size();
+    size_t i = 0;
+    if (m_type == Type::complex) {
+        for (; i + kLanes <= n; i += kLanes) {
+            float x[kLanes];
+            double t[kLanes];
+            for (int j = 0; j < kLanes; ++j) {
+                x[j] = pin_to_unit(src[i + j]);
+            }
+            this->solveT<kLanes>(x, t);
+            for (int j = 0; j < kLanes; ++j) {
+                dst[i + j] = (x[j] == 0 || x[j] == 1) ? x[j] : (float)eval_poly(m_yc, t[j]);
+            }
+        }
+    }
+    for (; i < n; ++i) {
+        dst[i] = this->x_to_y(src[i]);
+    }
 }
 
 /////////////////////
@@ -160,5 +229,21 @@ void CubicUnit::Tests() {
         };
         check_mono({pts[0], pts[1]});
     }
+
+    // adjacent floats stay in order, even where x's slope is 0 (at t = 0.5),
+    // and the batch version gives the same results
+    for (float start : {1.0f / 1024, 0.5f - 1.0f / (1 << 20), 1 - 1.0f / (1 << 16)}) {
+        CubicUnit cu({1, 0}, {0, 1});
+        float xs[256], ys[256];
+        xs[0] = start;
+        for (int i = 1; i < 256; ++i) {
+            xs[i] = std::nextafter(xs[i - 1], 2.0f);
+        }
+        cu.x_to_y(xs, ys);
+        for (int i = 0; i < 256; ++i) {
+            assert(ys[i] == cu.x_to_y(xs[i]));
+            assert(i == 0 || ys[i - 1] <= ys[i]);
+        }
+    }
 #endif
 }
@@ -0,0 +1,603 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#include "include/curve_kernels.h"
+#include "include/geometry.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+    #include <immintrin.h>
+    #define PENTREK_KERNELS_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #include <arm_neon.h>
+    #define PENTREK_KERNELS_NEON
+#elif defined(__wasm_simd128__)
+    #include <wasm_simd128.h>
+    #define PENTREK_KERNELS_WASM
+#endif
+
+using namespace pentrek;
+
+/*
+ *  Unlike PointKernels, where each set is written out by hand, these are
+ *  written once (in generic, below) over a "Lanes" type, which supplies:
+ *
+ *      F                   a register of N floats, with + - * /
+ *      Splat, Load, Store  to get floats in and out
+ *      Sqrt
+ *      StorePoints         stores N points, interleaving x and y
+ *      NearlyZeroMask      bit k is set if lane k of both x and y is nearly zero
+ *
+ *  Each kernel handles N values at a time, and the leftovers with ScalarLanes.
+ *  There is no AVX2 set: that needs a target attribute on every function that
+ *  uses it, which a template instantiation can't be given.
+ */
+
+// As Point::isNearlyZero()
+static constexpr float kNearlyZero = 1.0f / 32678;
+
+struct ScalarLanes {
+    using F = float;
+    static constexpr size_t N = 1;
+
+    static F Splat(float v) { return v; }
+    static F Load(const float src[]) { return src[0]; }
+    static void Store(float dst[], F v) { dst[0] = v; }
+    static F Sqrt(F v) { return std::sqrt(v); }
+    static void StorePoints(Point dst[], F x, F y) { dst[0] = {x, y}; }
+    static int NearlyZeroMask(F x, F y) {
+        return std::abs(x) <= kNearlyZero && std::abs(y) <= kNearlyZero;
+    }
+};
+
+#ifdef PENTREK_KERNELS_SSE2
+
+namespace sse2 {
+
+struct F4 { __m128 v; };
+
+static inline F4 operator+(F4 a, F4 b) { return {_mm_add_ps(a.v, b.v)}; }
+static inline F4 operator-(F4 a, F4 b) { return {_mm_sub_ps(a.v, b.v)}; }
+static inline F4 operator*(F4 a, F4 b) { return {_mm_mul_ps(a.v, b.v)}; }
+static inline F4 operator/(F4 a, F4 b) { return {_mm_div_ps(a.v, b.v)}; }
+
+struct Lanes {
+    using F = F4;
+    static constexpr size_t N = 4;
+
+    static F Splat(float v) { return {_mm_set1_ps(v)}; }
+    static F Load(const float src[]) { return {_mm_loadu_ps(src)}; }
+    static void Store(float dst[], F v) { _mm_storeu_ps(dst, v.v); }
+    static F Sqrt(F v) { return {_mm_sqrt_ps(v.v)}; }
+    static void StorePoints(Point dst[], F x, F y) {
+        _mm_storeu_ps(&dst[0].x, _mm_unpacklo_ps(x.v, y.v));
+        _mm_storeu_ps(&dst[2].x, _mm_unpackhi_ps(x.v, y.v));
+    }
+    static int NearlyZeroMask(F x, F y) {
+        const __m128 abs = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+        const __m128 tol = _mm_set1_ps(kNearlyZero);
+        return _mm_movemask_ps(_mm_and_ps(_mm_cmple_ps(_mm_and_ps(x.v, abs), tol),
+                                          _mm_cmple_ps(_mm_and_ps(y.v, abs), tol)));
+    }
+};
+
+} // namespace sse2
+
+#endif
+
+#ifdef PENTREK_KERNELS_NEON
+
+namespace neon {
+
+struct F4 { float32x4_t v; };
+
+static inline F4 operator+(F4 a, F4 b) { return {vaddq_f32(a.v, b.v)}; }
+static inline F4 operator-(F4 a, F4 b) { return {vsubq_f32(a.v, b.v)}; }
+static inline F4 operator*(F4 a, F4 b) { return {vmulq_f32(a.v, b.v)}; }
+
+#ifdef __aarch64__
+static inline F4 operator/(F4 a, F4 b) { return {vdivq_f32(a.v, b.v)}; }
+static inline F4 sqrt_lanes(F4 a) { return {vsqrtq_f32(a.v)}; }
+#else
+// 32bit NEON has neither, and estimates aren't exact, so we do them a lane at a time
+static inline F4 operator/(F4 a, F4 b) {
+    float fa[4], fb[4];
+    vst1q_f32(fa, a.v);
+    vst1q_f32(fb, b.v);
+    for (int i = 0; i < 4; ++i) {
+        fa[i] /= fb[i];
+    }
+    return {vld1q_f32(fa)};
+}
+static inline F4 sqrt_lanes(F4 a) {
+    float fa[4];
+    vst1q_f32(fa, a.v);
+    for (int i = 0; i < 4; ++i) {
+        fa[i] = std::sqrt(fa[i]);
+    }
+    return {vld1q_f32(fa)};
+}
+#endif
+
+struct Lanes {
+    using F = F4;
+    static constexpr size_t N = 4;
+
+    static F Splat(float v) { return {vdupq_n_f32(v)}; }
+    static F Load(const float src[]) { return {vld1q_f32(src)}; }
+    static void Store(float dst[], F v) { vst1q_f32(dst, v.v); }
+    static F Sqrt(F v) { return sqrt_lanes(v); }
+    static void StorePoints(Point dst[], F x, F y) {
+        const float32x4x2_t xy = {{x.v, y.v}};
+        vst2q_f32(&dst[0].x, xy);
+    }
+    static int NearlyZeroMask(F x, F y) {
+        const float32x4_t tol = vdupq_n_f32(kNearlyZero);
+        const uint32x4_t m = vandq_u32(vcaleq_f32(x.v, tol), vcaleq_f32(y.v, tol));
+        return (vgetq_lane_u32(m, 0) & 1)        | (vgetq_lane_u32(m, 1) & 1) << 1 |
+               (vgetq_lane_u32(m, 2) & 1) << 2   | (vgetq_lane_u32(m, 3) & 1) << 3;
+    }
+};
+
+} // namespace neon
+
+#endif
+
+#ifdef PENTREK_KERNELS_WASM
+
+namespace wasm {
+
+struct F4 { v128_t v; };
+
+static inline F4 operator+(F4 a, F4 b) { return {wasm_f32x4_add(a.v, b.v)}; }
+static inline F4 operator-(F4 a, F4 b) { return {wasm_f32x4_sub(a.v, b.v)}; }
+static inline F4 operator*(F4 a, F4 b) { return {wasm_f32x4_mul(a.v, b.v)}; }
+static inline F4 operator/(F4 a, F4 b) { return {wasm_f32x4_div(a.v, b.v)}; }
+
+struct Lanes {
+    using F = F4;
+    static constexpr size_t N = 4;
+
+    static F Splat(float v) { return {wasm_f32x4_splat(v)}; }
+    static F Load(const float src[]) { return {wasm_v128_load(src)}; }
+    static void Store(float dst[], F v) { wasm_v128_store(dst, v.v); }
+    static F Sqrt(F v) { return {wasm_f32x4_sqrt(v.v)}; }
+    static void StorePoints(Point dst[], F x, F y) {
+        wasm_v128_store(&dst[0].x, wasm_i32x4_shuffle(x.v, y.v, 0, 4, 1, 5));
+        wasm_v128_store(&dst[2].x, wasm_i32x4_shuffle(x.v, y.v, 2, 6, 3, 7));
+    }
+    static int NearlyZeroMask(F x, F y) {
+        const v128_t tol = wasm_f32x4_splat(kNearlyZero);
+        return wasm_i32x4_bitmask(wasm_v128_and(wasm_f32x4_le(wasm_f32x4_abs(x.v), tol),
+                                                wasm_f32x4_le(wasm_f32x4_abs(y.v), tol)));
+    }
+};
+
+} // namespace wasm
+
+#endif
+
+namespace generic {
+
+template <typename F> F mix(F a, F b, F t) { return a + (b - a) * t; }
+
+// Calls proc(L(), i) for each group of L::N, then proc(ScalarLanes(), i) for the rest
+template <typename L, typename Proc> void for_lanes(size_t n, Proc proc) {
+    size_t i = 0;
+    for (; i + L::N <= n; i += L::N) {
+        proc(L(), i);
+    }
+    for (; i < n; ++i) {
+        proc(ScalarLanes(), i);
+    }
+}
+
+// The formulas below are the same as QuadCoeff and CubicCoeff (and the chops
+// at one t are the same as in geometry.cpp) so the results match them exactly.
+
+template <typename L> void quad_eval(Point dst[], const Point src[3], const float t[], size_t n) {
+    const auto qc = QuadCoeff::Compute(src);
+    for_lanes<L>(n, [&](auto lanes, size_t i) {
+        using V = decltype(lanes);
+        const auto vt = V::Load(t + i);
+        V::StorePoints(dst + i,
+                       (V::Splat(qc.A.x) * vt + V::Splat(qc.B.x)) * vt + V::Splat(qc.C.x),
+                       (V::Splat(qc.A.y) * vt + V::Splat(qc.B.y)) * vt + V::Splat(qc.C.y));
+    });
+}
+
+template <typename L> void cubic_eval(Point dst[], const Point src[4], const float t[], size_t n) {
+    const auto cc = CubicCoeff::Compute(src);
+    for_lanes<L>(n, [&](auto lanes, size_t i) {
+        using V = decltype(lanes);
+        const auto vt = V::Load(t + i);
+        V::StorePoints(dst + i,
+            ((V::Splat(cc.A.x) * vt + V::Splat(cc.B.x)) * vt + V::Splat(cc.C.x)) * vt + V::Splat(cc.D.x),
+            ((V::Splat(cc.A.y) * vt + V::Splat(cc.B.y)) * vt + V::Splat(cc.C.y)) * vt + V::Splat(cc.D.y));
+    });
+}
+
+// Normalizes the tangents, except any that are nearly zero, which get the
+// scalar version's fallback (recomputed, as they are rare).
+template <typename V, typename Fallback>
+void store_tangents(Point dst[], typename V::F tx, typename V::F ty, Fallback fallback) {
+    const int mask = V::NearlyZeroMask(tx, ty);
+    const auto scale = V::Splat(1) / V::Sqrt(tx * tx + ty * ty);
+    V::StorePoints(dst, tx * scale, ty * scale);
+    for (size_t k = 0; mask && k < V::N; ++k) {
+        if (mask & (1 << k)) {
+            dst[k] = fallback(k);
+        }
+    }
+}
+
+template <typename L> void quad_postan(Point pos[], Point tan[], const Point src[3],
+                                       const float t[], size_t n) {
+    const auto qc = QuadCoeff::Compute(src);
+    for_lanes<L>(n, [&](auto lanes, size_t i) {
+        using V = decltype(lanes);
+        const auto vt = V::Load(t + i);
+        const auto ax = V::Splat(qc.A.x) * vt,
+                   ay = V::Splat(qc.A.y) * vt;
+        V::StorePoints(pos + i, (ax + V::Splat(qc.B.x)) * vt + V::Splat(qc.C.x),
+                                (ay + V::Splat(qc.B.y)) * vt + V::Splat(qc.C.y));
+        store_tangents<V>(tan + i, ax + ax + V::Splat(qc.B.x), ay + ay + V::Splat(qc.B.y),
+                          [&](size_t k) { return pentrek::quad_postan(src, t[i + k]).second; });
+    });
+}
+
+template <typename L> void cubic_postan(Point pos[], Point tan[], const Point src[4],
+                                        const float t[], size_t n) {
+    const auto cc = CubicCoeff::Compute(src);
+    const Point A3 = 3*cc.A, B2 = 2*cc.B;
+    for_lanes<L>(n, [&](auto lanes, size_t i) {
+        using V = decltype(lanes);
+        const auto vt = V::Load(t + i);
+        V::StorePoints(pos + i,
+            ((V::Splat(cc.A.x) * vt + V::Splat(cc.B.x)) * vt + V::Splat(cc.C.x)) * vt + V::Splat(cc.D.x),
+            ((V::Splat(cc.A.y) * vt + V::Splat(cc.B.y)) * vt + V::Splat(cc.C.y)) * vt + V::Splat(cc.D.y));
+        store_tangents<V>(tan + i,
+                          (V::Splat(A3.x) * vt + V::Splat(B2.x)) * vt + V::Splat(cc.C.x),
+                          (V::Splat(A3.y) * vt + V::Splat(B2.y)) * vt + V::Splat(cc.C.y),
+                          [&](size_t k) { return pentrek::cubic_postan(src, t[i + k]).second; });
+    });
+}
+
+/*
+ *  Chopping at many t: piece j runs from lo = t[j-1] to hi = t[j] (with 0 and 1
+ *  at the ends), and its control points are the curve's blossoms: for a quad
+ *  Q(lo,lo) Q(lo,hi) Q(hi,hi), for a cubic C(lo,lo,lo) C(lo,lo,hi) C(lo,hi,hi)
+ *  C(hi,hi,hi). A blossom is de Casteljau's algorithm with a different t at
+ *  each level, so each piece only depends on its own lo and hi.
+ *
+ *  The first point of each piece is the last of the one before, so we only
+ *  write the others. The lanes are pieces, which are not adjacent in dst, so
+ *  we store them into tmp first.
+ */
+
+template <typename L, typename Piece> void chop_pieces(const float t[], size_t n, Piece piece) {
+    // piece 0 (and n) have one end fixed, so they can't be loaded from t
+    piece(ScalarLanes(), 0, 0.0f, n ? t[0] : 1.0f);
+    size_t j = 1;
+    for (; j + L::N <= n; j += L::N) {
+        piece(L(), j, L::Load(t + j - 1), L::Load(t + j));
+    }
+    for (; j <= n; ++j) {
+        piece(ScalarLanes(), j, t[j - 1], j < n ? t[j] : 1.0f);
+    }
+}
+
+template <typename L> void quad_chop(Point dst[], const Point src[3], const float t[], size_t n) {
+    dst[0] = src[0];
+    chop_pieces<L>(t, n, [&](auto lanes, size_t j, auto lo, auto hi) {
+        using V = decltype(lanes);
+        float tmp[4][V::N];    // Q(lo,hi) Q(hi,hi)
+        for (int c = 0; c < 2; ++c) {
+            const float* p = &src[0].x + c;    // x or y
+            const auto p0 = V::Splat(p[0]), p1 = V::Splat(p[2]), p2 = V::Splat(p[4]);
+            const auto l0 = mix(p0, p1, lo), l1 = mix(p1, p2, lo),
+                       h0 = mix(p0, p1, hi), h1 = mix(p1, p2, hi);
+            V::Store(tmp[c],     mix(l0, l1, hi));
+            V::Store(tmp[c + 2], mix(h0, h1, hi));
+        }
+        for (size_t k = 0; k < V::N; ++k) {
+            Point* d = dst + 2*(j + k) + 1;
+            d[0] = {tmp[0][k], tmp[1][k]};
+            d[1] = {tmp[2][k], tmp[3][k]};
+        }
+    });
+    dst[2*n + 2] = src[2];
+}
+
+template <typename L> void cubic_chop(Point dst[], const Point src[4], const float t[], size_t n) {
+    dst[0] = src[0];
+    chop_pieces<L>(t, n, [&](auto lanes, size_t j, auto lo, auto hi) {
+        using V = decltype(lanes);
+        float tmp[6][V::N];    // C(lo,lo,hi) C(lo,hi,hi) C(hi,hi,hi)
+        for (int c = 0; c < 2; ++c) {
+            const float* p = &src[0].x + c;
+            const auto p0 = V::Splat(p[0]), p1 = V::Splat(p[2]),
+                       p2 = V::Splat(p[4]), p3 = V::Splat(p[6]);
+            const auto la = mix(p0, p1, lo), lb = mix(p1, p2, lo), lc = mix(p2, p3, lo),
+                       ha = mix(p0, p1, hi), hb = mix(p1, p2, hi), hc = mix(p2, p3, hi);
+            const auto ll0 = mix(la, lb, lo), ll1 = mix(lb, lc, lo),
+                       hh0 = mix(ha, hb, hi), hh1 = mix(hb, hc, hi);
+            V::Store(tmp[c],     mix(ll0, ll1, hi));
+            V::Store(tmp[c + 2], mix(hh0, hh1, lo));
+            V::Store(tmp[c + 4], mix(hh0, hh1, hi));
+        }
+        for (size_t k = 0; k < V::N; ++k) {
+            Point* d = dst + 3*(j + k) + 1;
+            d[0] = {tmp[0][k], tmp[1][k]};
+            d[1] = {tmp[2][k], tmp[3][k]};
+            d[2] = {tmp[4][k], tmp[5][k]};
+        }
+    });
+    dst[3*n + 3] = src[3];
+}
+
+template <typename L> void quad_eval_soa(float dstX[], float dstY[],
+                                         const float* const x[3], const float* const y[3],
+                                         size_t n, float t) {
+    for (int axis = 0; axis < 2; ++axis) {
+        const float* const* p = axis ? y : x;
+        float* dst = axis ? dstY : dstX;
+        for_lanes<L>(n, [&](auto lanes, size_t i) {
+            using V = decltype(lanes);
+            const auto vt = V::Splat(t);
+            const auto a = V::Load(p[0] + i), b = V::Load(p[1] + i), c = V::Load(p[2] + i);
+            const auto B = b - a;
+            // as QuadCoeff::Compute()
+            V::Store(dst + i, ((c - (b + b) + a) * vt + (B + B)) * vt + a);
+        });
+    }
+}
+
+template <typename L> void cubic_eval_soa(float dstX[], float dstY[],
+                                          const float* const x[4], const float* const y[4],
+                                          size_t n, float t) {
+    for (int axis = 0; axis < 2; ++axis) {
+        const float* const* p = axis ? y : x;
+        float* dst = axis ? dstY : dstX;
+        for_lanes<L>(n, [&](auto lanes, size_t i) {
+            using V = decltype(lanes);
+            const auto vt = V::Splat(t), three = V::Splat(3);
+            const auto a = V::Load(p[0] + i), b = V::Load(p[1] + i),
+                       c = V::Load(p[2] + i), d = V::Load(p[3] + i);
+            // as CubicCoeff::Compute()
+            const auto A = d - three * (c - b) - a,
+                       B = three * (c - (b + b) + a),
+                       C = three * (b - a);
+            V::Store(dst + i, ((A * vt + B) * vt + C) * vt + a);
+        });
+    }
+}
+
+template <typename L> void quad_chop_soa(float* const dstX[5], float* const dstY[5],
+                                         const float* const x[3], const float* const y[3],
+                                         size_t n, float t) {
+    for (int axis = 0; axis < 2; ++axis) {
+        const float* const* p = axis ? y : x;
+        float* const* dst = axis ? dstY : dstX;
+        for_lanes<L>(n, [&](auto lanes, size_t i) {
+            using V = decltype(lanes);
+            const auto vt = V::Splat(t);
+            const auto p0 = V::Load(p[0] + i), p1 = V::Load(p[1] + i), p2 = V::Load(p[2] + i);
+            const auto ab = mix(p0, p1, vt), bc = mix(p1, p2, vt);
+            V::Store(dst[0] + i, p0);
+            V::Store(dst[1] + i, ab);
+            V::Store(dst[2] + i, mix(ab, bc, vt));
+            V::Store(dst[3] + i, bc);
+            V::Store(dst[4] + i, p2);
+        });
+    }
+}
+
+template <typename L> void cubic_chop_soa(float* const dstX[7], float* const dstY[7],
+                                          const float* const x[4], const float* const y[4],
+                                          size_t n, float t) {
+    for (int axis = 0; axis < 2; ++axis) {
+        const float* const* p = axis ? y : x;
+        float* const* dst = axis ? dstY : dstX;
+        for_lanes<L>(n, [&](auto lanes, size_t i) {
+            using V = decltype(lanes);
+            const auto vt = V::Splat(t);
+            const auto p0 = V::Load(p[0] + i), p1 = V::Load(p[1] + i),
+                       p2 = V::Load(p[2] + i), p3 = V::Load(p[3] + i);
+            const auto ab = mix(p0, p1, vt), bc = mix(p1, p2, vt), cd = mix(p2, p3, vt);
+            const auto abc = mix(ab, bc, vt), bcd = mix(bc, cd, vt);
+            V::Store(dst[0] + i, p0);
+            V::Store(dst[1] + i, ab);
+            V::Store(dst[2] + i, abc);
+            V::Store(dst[3] + i, mix(abc, bcd, vt));
+            V::Store(dst[4] + i, bcd);
+            V::Store(dst[5] + i, cd);
+            V::Store(dst[6] + i, p3);
+        });
+    }
+}
+
+template <typename L> CurveKernels make_kernels(const char name[]) {
+    return {
+        name,
+        quad_eval<L>,
+        cubic_eval<L>,
+        quad_postan<L>,
+        cubic_postan<L>,
+        quad_chop<L>,
+        cubic_chop<L>,
+        quad_eval_soa<L>,
+        cubic_eval_soa<L>,
+        quad_chop_soa<L>,
+        cubic_chop_soa<L>,
+    };
+}
+
+} // namespace generic
+
+static const CurveKernels gScalarKernels = generic::make_kernels<ScalarLanes>("scalar");
+
+#ifdef PENTREK_KERNELS_SSE2
+static const CurveKernels gSSE2Kernels = generic::make_kernels<sse2::Lanes>("sse2");
+#endif
+#ifdef PENTREK_KERNELS_NEON
+static const CurveKernels gNEONKernels = generic::make_kernels<neon::Lanes>("neon");
+#endif
+#ifdef PENTREK_KERNELS_WASM
+static const CurveKernels gWASMKernels = generic::make_kernels<wasm::Lanes>("wasm-simd128");
+#endif
+
+std::vector<const CurveKernels*> CurveKernels::Available() {
+    std::vector<const CurveKernels*> all = { &gScalarKernels };
+#ifdef PENTREK_KERNELS_SSE2
+    all.push_back(&gSSE2Kernels);
+#endif
+#ifdef PENTREK_KERNELS_NEON
+    all.push_back(&gNEONKernels);
+#endif
+#ifdef PENTREK_KERNELS_WASM
+    all.push_back(&gWASMKernels);
+#endif
+    return all;
+}
+
+const CurveKernels& CurveKernels::Scalar() { return gScalarKernels; }
+
+const CurveKernels& CurveKernels::Get() {
+    // the last one is the best
+    static const CurveKernels* gBest = Available().back();
+    return *gBest;
+}
+
+//////////////////////////////////////
+
+#include "include/random.h"
+#include <algorithm>
+
+void CurveKernels::Tests() {
+#ifdef DEBUG
+    auto eq = [](Point a, Point b, float tol) {
+        return nearly_eq(a.x, b.x, tol) && nearly_eq(a.y, b.y, tol);
+    };
+    // the chops are computed differently from the single versions
+    constexpr float kChopTol = 1.0f / 1024;
+
+    Random rand;
+    auto rand_pt = [&]() { return Point{rand.nextSF() * 100, rand.nextSF() * 100}; };
+
+    constexpr size_t N = 37;    // not a multiple of 4, so we exercise the leftovers
+    float t[N];
+    for (size_t i = 0; i < N; ++i) {
+        t[i] = rand.nextF();
+    }
+    std::sort(t, t + N);
+    t[0] = 0;   // so the tangent at the start can fall back
+
+    for (int trial = 0; trial < 10; ++trial) {
+        Point quad[3] = {rand_pt(), rand_pt(), rand_pt()};
+        Point cubic[4] = {rand_pt(), rand_pt(), rand_pt(), rand_pt()};
+        if (trial == 0) {
+            quad[1] = quad[0];      // tangent at t == 0 is zero
+            cubic[1] = cubic[0];
+        }
+
+        for (auto k : Available()) {
+            for (size_t n : {(size_t)0, (size_t)1, (size_t)3, (size_t)4, (size_t)5, N}) {
+                Point pos[N], tan[N], chop[3*N + 4];
+
+                k->m_quadPosTan(pos, tan, quad, t, n);
+                for (size_t i = 0; i < n; ++i) {
+                    const auto [p, v] = pentrek::quad_postan(quad, t[i]);
+                    assert(eq(pos[i], p, 1.0f / 4096));
+                    assert(eq(tan[i], v, 1.0f / 4096));
+                }
+                k->m_quadEval(pos, quad, t, n);
+                for (size_t i = 0; i < n; ++i) {
+                    assert(eq(pos[i], QuadCoeff::Compute(quad).eval(t[i]), 1.0f / 4096));
+                }
+
+                k->m_cubicPosTan(pos, tan, cubic, t, n);
+                for (size_t i = 0; i < n; ++i) {
+                    const auto [p, v] = pentrek::cubic_postan(cubic, t[i]);
+                    assert(eq(pos[i], p, 1.0f / 4096));
+                    assert(eq(tan[i], v, 1.0f / 4096));
+                }
+                k->m_cubicEval(pos, cubic, t, n);
+                for (size_t i = 0; i < n; ++i) {
+                    assert(eq(pos[i], CubicCoeff::Compute(cubic).eval(t[i]), 1.0f / 4096));
+                }
+
+                // each piece matches extracting it
+                k->m_quadChop(chop, quad, t, n);
+                assert(chop[0] == quad[0] && chop[2*n + 2] == quad[2]);
+                for (size_t j = 0; j <= n; ++j) {
+                    Point piece[3];
+                    pentrek::quad_extract(quad, j ? t[j - 1] : 0, j < n ? t[j] : 1, piece);
+                    for (int i = 0; i < 3; ++i) {
+                        assert(eq(chop[2*j + i], piece[i], kChopTol));
+                    }
+                }
+                k->m_cubicChop(chop, cubic, t, n);
+                assert(chop[0] == cubic[0] && chop[3*n + 3] == cubic[3]);
+                for (size_t j = 0; j <= n; ++j) {
+                    Point piece[4];
+                    pentrek::cubic_extract(cubic, j ? t[j - 1] : 0, j < n ? t[j] : 1, piece);
+                    for (int i = 0; i < 4; ++i) {
+                        assert(eq(chop[3*j + i], piece[i], kChopTol));
+                    }
+                }
+            }
+        }
+    }
+
+    // many curves at one t
+    float xs[4][N], ys[4][N];
+    for (int c = 0; c < 4; ++c) {
+        for (size_t i = 0; i < N; ++i) {
+            xs[c][i] = rand.nextSF() * 100;
+            ys[c][i] = rand.nextSF() * 100;
+        }
+    }
+    const float* const x[] = {xs[0], xs[1], xs[2], xs[3]};
+    const float* const y[] = {ys[0], ys[1], ys[2], ys[3]};
+    auto curve = [&](size_t i, Point pts[]) {
+        for (int c = 0; c < 4; ++c) {
+            pts[c] = {xs[c][i], ys[c][i]};
+        }
+    };
+
+    for (auto k : Available()) {
+        for (size_t n : {(size_t)1, (size_t)4, (size_t)7, N}) {
+            for (float tt : {0.0f, 0.3f, 1.0f}) {
+                float ex[N], ey[N], cx[7][N], cy[7][N];
+                float* const dx[] = {cx[0], cx[1], cx[2], cx[3], cx[4], cx[5], cx[6]};
+                float* const dy[] = {cy[0], cy[1], cy[2], cy[3], cy[4], cy[5], cy[6]};
+
+                k->m_quadEvalSoA(ex, ey, x, y, n, tt);
+                k->m_quadChopSoA(dx, dy, x, y, n, tt);
+                for (size_t i = 0; i < n; ++i) {
+                    Point pts[4], chop[5];
+                    curve(i, pts);
+                    assert(eq({ex[i], ey[i]}, QuadCoeff::Compute(pts).eval(tt), 1.0f / 4096));
+                    pentrek::quad_chop(pts, tt, chop);
+                    for (int c = 0; c < 5; ++c) {
+                        assert(eq({cx[c][i], cy[c][i]}, chop[c], 1.0f / 4096));
+                    }
+                }
+
+                k->m_cubicEvalSoA(ex, ey, x, y, n, tt);
+                k->m_cubicChopSoA(dx, dy, x, y, n, tt);
+                for (size_t i = 0; i < n; ++i) {
+                    Point pts[4], chop[7];
+                    curve(i, pts);
+                    assert(eq({ex[i], ey[i]}, CubicCoeff::Compute(pts).eval(tt), 1.0f / 4096));
+                    pentrek::cubic_chop(pts, tt, chop);
+                    for (int c = 0; c < 7; ++c) {
+                        assert(eq({cx[c][i], cy[c][i]}, chop[c], 1.0f / 4096));
+                    }
+                }
+            }
+        }
+    }
+#endif
+}
@@ -5,6 +5,14 @@
 #include "include/data.h"
 #include <stdio.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #define PENTREK_HAS_MMAP
+#endif
+
 using namespace pentrek;
 
 Data::Data(Span<uint8_t> buffer, FreeProc proc, void* client)
@@ -82,6 +90,39 @@ rcp<Data> Data::File(const char path[]) {
     return data;
 }
 
+#ifdef PENTREK_HAS_MMAP
+static void munmap_freeproc(void* buffer, size_t size, void*) {
+    munmap(buffer, size);
+}
+#endif
+
+rcp<Data> Data::MapFile(const char path[]) {
+#ifdef PENTREK_HAS_MMAP
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return nullptr;
+    }
+    const size_t size = (size_t)info.st_size;
+    if (size == 0) {
+        close(fd);
+        return Empty();
+    }
+    void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);     // the mapping keeps the file open
+    if (addr == MAP_FAILED) {
+        return nullptr;
+    }
+    return Managed({(const uint8_t*)addr, size}, munmap_freeproc, nullptr);
+#else
+    return File(path);
+#endif
+}
+
 ////////////////////////
 
 static void test_empty() {
@@ -0,0 +1,253 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#include "include/flatten.h"
+#include "include/geometry.h"
+
+using namespace pentrek;
+
+/*
+ *  The curves are evaluated by forward differencing: after the first point,
+ *  each point costs just a few adds (rather than a polynomial evaluation).
+ *
+ *  We step two points at a time, with their x and y interleaved in 4 lanes
+ *  (x0 y0 x1 y1), so the inner loop is a handful of 4-wide adds, which the
+ *  compiler turns into SIMD. Since rounding errors accumulate (especially
+ *  for cubics), we restart from an exact evaluation every kFDRun points.
+ *
+ *  For only a few points, the setup costs more than it saves, so we just
+ *  evaluate them.
+ */
+constexpr int kFDRun = 16;
+constexpr int kMinFDPoints = 6;
+
+namespace {
+
+struct ForwardDiff {
+    float p[4], d1[4], d2[4], d3[4];
+
+    // lanes 2j and 2j+1 get the position and its differences
+    void set(int j, Point pos, Point D1, Point D2, Point D3) {
+        p[2*j]  = pos.x; p[2*j + 1]  = pos.y;
+        d1[2*j] = D1.x;  d1[2*j + 1] = D1.y;
+        d2[2*j] = D2.x;  d2[2*j + 1] = D2.y;
+        d3[2*j] = D3.x;  d3[2*j + 1] = D3.y;
+    }
+
+    // writes dst[i...stop), two at a time, returning stop
+    int run(Point dst[], int i, int stop) {
+        for (; i + 2 <= stop; i += 2) {
+            dst[i]     = {p[0], p[1]};
+            dst[i + 1] = {p[2], p[3]};
+            for (int k = 0; k < 4; ++k) {
+                p[k]  += d1[k];
+                d1[k] += d2[k];
+                d2[k] += d3[k];
+            }
+        }
+        if (i < stop) {
+            dst[i++] = {p[0], p[1]};
+        }
+        return i;
+    }
+};
+
+} // namespace
+
+// Writes the n points after the first (the last being exactly pts[2])
+static void quad_points(const Point pts[3], int n, Point dst[]) {
+    const auto qc = QuadCoeff::Compute(pts);
+    const float h = 1.0f / n;
+    const int count = n - 1;    // dst[i] is at t = (i + 1) * h
+
+    if (n < kMinFDPoints) {
+        for (int i = 0; i < count; ++i) {
+            dst[i] = qc.eval((i + 1) * h);
+        }
+    } else {
+        // P(t) = At^2 + Bt + C, stepping by s = 2h
+        // d1 = P'(t)s + As^2
+        // d2 = 2As^2
+        const float s = 2 * h;
+        const Point D2 = twice(qc.A * (s * s));
+        ForwardDiff fd;
+        int i = 0;
+        while (i < count) {
+            for (int j = 0; j < 2; ++j) {
+                const float t = (i + 1 + j) * h;
+                const Point tan = twice(qc.A * t) + qc.B;
+                fd.set(j, qc.eval(t), tan * s + qc.A * (s * s), D2, {0, 0});
+            }
+            i = fd.run(dst, i, std::min(count, i + kFDRun));
+        }
+    }
+    dst[count] = pts[2];
+}
+
+// Writes the n points after the first (the last being exactly pts[3])
+static void cubic_points(const Point pts[4], int n, Point dst[]) {
+    const auto cc = CubicCoeff::Compute(pts);
+    const float h = 1.0f / n;
+    const int count = n - 1;    // dst[i] is at t = (i + 1) * h
+
+    if (n < kMinFDPoints) {
+        for (int i = 0; i < count; ++i) {
+            dst[i] = cc.eval((i + 1) * h);
+        }
+    } else {
+        // P(t) = At^3 + Bt^2 + Ct + D, stepping by s = 2h
+        // d1 = P'(t)s + P''(t)s^2/2 + P'''s^3/6
+        // d2 = P''(t)s^2 + P'''s^3
+        // d3 = P'''s^3
+        const float s = 2 * h,
+                    s2 = s * s,
+                    s3 = s2 * s;
+        const Point D3 = 6 * cc.A * s3;
+        ForwardDiff fd;
+        int i = 0;
+        while (i < count) {
+            for (int j = 0; j < 2; ++j) {
+                const float t = (i + 1 + j) * h;
+                const Point dd = 6 * cc.A * t + twice(cc.B);    // P''(t)
+                fd.set(j, cc.eval(t),
+                       cc.evalTan(t) * s + dd * (s2 * 0.5f) + cc.A * s3,
+                       dd * s2 + D3,
+                       D3);
+            }
+            i = fd.run(dst, i, std::min(count, i + kFDRun));
+        }
+    }
+    dst[count] = pts[3];
+}
+
+PolylineBuilder::PolylineBuilder(Polylines* dst, float tolerance, const Matrix& mx)
+    : m_dst(dst)
+    , m_invTol(1 / tolerance)
+    , m_matrix(mx)
+    , m_identity(mx.isIdentity())
+{
+    assert(tolerance > 0);
+    dst->reset();
+}
+
+void PolylineBuilder::endContour(bool closed) {
+    auto& pts = m_dst->m_points;
+    if (pts.size() > m_contourStart + 1) {
+        m_dst->m_contours.push_back({castTo<uint32_t>(pts.size()), closed});
+        m_contourStart = pts.size();
+    } else {
+        pts.resize(m_contourStart);     // just a move, so drop it
+    }
+}
+
+void PolylineBuilder::move(Point p) {
+    this->endContour(false);
+    m_dst->m_points.push_back(this->map(p));
+}
+
+void PolylineBuilder::line(Point p) {
+    m_dst->m_points.push_back(this->map(p));
+}
+
+void PolylineBuilder::quad(Point p1, Point p2) {
+    auto& pts = m_dst->m_points;
+    const Point q[3] = {pts.back(), this->map(p1), this->map(p2)};
+    const int n = count_quad_segments(q[0], q[1], q[2], m_invTol);
+    pts.resize(pts.size() + n);
+    quad_points(q, n, pts.data() + pts.size() - n);
+}
+
+void PolylineBuilder::cubic(Point p1, Point p2, Point p3) {
+    auto& pts = m_dst->m_points;
+    const Point c[4] = {pts.back(), this->map(p1), this->map(p2), this->map(p3)};
+    const int n = count_cubic_segments(c[0], c[1], c[2], c[3], m_invTol);
+    pts.resize(pts.size() + n);
+    cubic_points(c, n, pts.data() + pts.size() - n);
+}
+
+void PolylineBuilder::close() {
+    const Point start = m_dst->m_points[m_contourStart];
+    this->endContour(true);
+    // in case the path continues without a move
+    m_dst->m_points.push_back(start);
+}
+
+void pentrek::flatten(const Path& path, float tolerance, const Matrix& mx, Polylines* dst) {
+    PolylineBuilder builder(dst, tolerance, mx);
+    dst->m_points.reserve(path.points().size());
+    path.replay(&builder);
+    builder.finish();
+}
+
+//////////////////////////////////////
+
+void Polylines::Tests() {
+#ifdef DEBUG
+    // Wang's formula
+    assert(count_quad_segments({0, 0}, {5, 0}, {10, 0}, 4) == 1);  // a line
+    assert(count_cubic_segments({0, 0}, {0, 100}, {100, 100}, {100, 0}, 1) ==
+           (int)std::ceil(std::sqrt(0.75f * 100 * std::sqrt(2.0f))));
+    assert(count_cubic_segments({0, 0}, {0, 100}, {100, 100}, {100, 0}, 1000) >
+           count_cubic_segments({0, 0}, {0, 100}, {100, 100}, {100, 0}, 10));
+
+    // Every flattened point is on the curve
+    const Point cubic[] = {{0, 0}, {0, 100}, {100, 100}, {100, -50}};
+    const Point quad[] = {{100, -50}, {50, -100}, {0, 0}};
+    const PathVerb vbs[] = {PathVerb::move, PathVerb::cubic, PathVerb::quad, PathVerb::close};
+    const Point all[] = {cubic[0], cubic[1], cubic[2], cubic[3], quad[1], quad[2]};
+    auto path = Path::Make(all, vbs);
+
+    Polylines lines;
+    for (float tol : {4.0f, 0.25f, 0.01f}) {
+        flatten(*path, tol, &lines);
+        assert(lines.count() == 1);
+        assert(lines.isClosed(0));
+
+        const int nc = count_cubic_segments(cubic[0], cubic[1], cubic[2], cubic[3], 1 / tol);
+        const int nq = count_quad_segments(quad[0], quad[1], quad[2], 1 / tol);
+        const auto pts = lines.points(0);
+        assert(pts.size() == (size_t)(1 + nc + nq));
+
+        const auto cc = CubicCoeff::Compute(cubic);
+        for (int i = 0; i <= nc; ++i) {
+            const Point expected = cc.eval((float)i / nc);
+            assert(nearly_eq(pts[i].x, expected.x, 1.0f / 256));
+            assert(nearly_eq(pts[i].y, expected.y, 1.0f / 256));
+        }
+        const auto qc = QuadCoeff::Compute(quad);
+        for (int i = 0; i <= nq; ++i) {
+            const Point expected = qc.eval((float)i / nq);
+            assert(nearly_eq(pts[nc + i].x, expected.x, 1.0f / 256));
+            assert(nearly_eq(pts[nc + i].y, expected.y, 1.0f / 256));
+        }
+        assert(pts[0] == cubic[0]);
+        assert(pts[nc] == cubic[3]);
+        assert(pts.back() == quad[2]);
+    }
+
+    // The matrix is applied before counting, so scaling up needs more segments
+    const auto n1 = lines.m_points.size();
+    flatten(*path, 0.01f, Matrix::Scale(4, 4), &lines);
+    assert(lines.m_points.size() > n1);
+    assert(lines.points(0)[0] == cubic[0]);
+    assert(lines.points(0).back() == cubic[0]);
+
+    // lines pass through, and moves without segments are dropped
+    auto poly = Path::Poly(cubic, false);
+    flatten(*poly, 1, Matrix::Trans(1, 2), &lines);
+    assert(lines.count() == 1);
+    assert(!lines.isClosed(0));
+    assert(lines.points(0).size() == 4);
+    assert(lines.points(0)[3] == Matrix::Trans(1, 2) * cubic[3]);
+
+    // the same, through the (virtual) PathSync interface
+    Polylines other;
+    PolylineBuilder builder(&other, 1, Matrix::Trans(1, 2));
+    PathSync* sync = &builder;
+    poly->replay(sync);
+    builder.finish();
+    assert(other.m_points == lines.m_points);
+    assert(other.count() == 1 && !other.isClosed(0));
+#endif
+}
@@ -0,0 +1,488 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#include "include/float_format.h"
+#include <cstring>
+
+#ifdef DEBUG
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#endif
+
+using namespace pentrek;
+
+namespace {
+
+/*
+ *  Ryu, specialized for 32-bit floats. See "Ryū: fast float-to-string conversion"
+ *  (Ulf Adams, PLDI 2018) and its reference implementation (f2s.c), which this follows.
+ */
+
+constexpr int kMantissaBits = 23;
+constexpr int kExponentBits = 8;
+constexpr int kBias = 127;
+
+constexpr int kPow5InvBitCount = 59;
+constexpr int kPow5BitCount = 61;
+
+// ceil(2^(59 + pow5bits(i) - 1) / 5^i)
+const uint64_t gPow5InvSplit[] = {
+    576460752303423489u, 461168601842738791u, 368934881474191033u, 295147905179352826u,
+    472236648286964522u, 377789318629571618u, 302231454903657294u, 483570327845851670u,
+    386856262276681336u, 309485009821345069u, 495176015714152110u, 396140812571321688u,
+    316912650057057351u, 507060240091291761u, 405648192073033409u, 324518553658426727u,
+    519229685853482763u, 415383748682786211u, 332306998946228969u, 531691198313966350u,
+    425352958651173080u, 340282366920938464u, 544451787073501542u, 435561429658801234u,
+    348449143727040987u, 557518629963265579u, 446014903970612463u, 356811923176489971u,
+    570899077082383953u, 456719261665907162u, 365375409332725730u,
+};
+
+// 5^i, normalized to its top 61 bits
+const uint64_t gPow5Split[] = {
+    1152921504606846976u, 1441151880758558720u, 1801439850948198400u, 2251799813685248000u,
+    1407374883553280000u, 1759218604441600000u, 2199023255552000000u, 1374389534720000000u,
+    1717986918400000000u, 2147483648000000000u, 1342177280000000000u, 1677721600000000000u,
+    2097152000000000000u, 1310720000000000000u, 1638400000000000000u, 2048000000000000000u,
+    1280000000000000000u, 1600000000000000000u, 2000000000000000000u, 1250000000000000000u,
+    1562500000000000000u, 1953125000000000000u, 1220703125000000000u, 1525878906250000000u,
+    1907348632812500000u, 1192092895507812500u, 1490116119384765625u, 1862645149230957031u,
+    1164153218269348144u, 1455191522836685180u, 1818989403545856475u, 2273736754432320594u,
+    1421085471520200371u, 1776356839400250464u, 2220446049250313080u, 1387778780781445675u,
+    1734723475976807094u, 2168404344971008868u, 1355252715606880542u, 1694065894508600678u,
+    2117582368135750847u, 1323488980084844279u, 1654361225106055349u, 2067951531382569187u,
+    1292469707114105741u, 1615587133892632177u, 2019483917365790221u,
+};
+
+// These approximations are exact for the ranges of e that floats need
+inline uint32_t log10_pow2(int32_t e) { return ((uint32_t)e * 78913) >> 18; }
+inline uint32_t log10_pow5(int32_t e) { return ((uint32_t)e * 732923) >> 20; }
+inline int32_t pow5_bits(int32_t e) { return (int32_t)(((uint32_t)e * 1217359) >> 19) + 1; }
+
+inline bool multiple_of_pow5(uint32_t value, uint32_t p) {
+    uint32_t count = 0;
+    while (value % 5 == 0) {
+        value /= 5;
+        count += 1;
+    }
+    return count >= p;
+}
+
+inline bool multiple_of_pow2(uint32_t value, uint32_t p) {
+    return (value & ((1u << p) - 1)) == 0;
+}
+
+inline uint32_t mul_shift(uint32_t m, uint64_t factor, int32_t shift) {
+    assert(shift > 32);
+    const uint64_t lo = (uint64_t)m * (uint32_t)factor,
+                   hi = (uint64_t)m * (uint32_t)(factor >> 32);
+    return (uint32_t)(((lo >> 32) + hi) >> (shift - 32));
+}
+
+struct Decimal {
+    uint32_t m_digits;  // with no trailing zeros
+    int32_t  m_exp;     // value = m_digits * 10^m_exp
+};
+
+// Returns the shortest decimal that rounds to this (finite, non-zero) float
+Decimal shortest_decimal(uint32_t ieeeMantissa, uint32_t ieeeExponent) {
+    int32_t e2;
+    uint32_t m2;
+    if (ieeeExponent == 0) {
+        e2 = 1 - kBias - kMantissaBits - 2;
+        m2 = ieeeMantissa;
+    } else {
+        e2 = (int32_t)ieeeExponent - kBias - kMantissaBits - 2;
+        m2 = (1u << kMantissaBits) | ieeeMantissa;
+    }
+    const bool acceptBounds = (m2 & 1) == 0;
+
+    // The interval of values that round to this float, times 4: [mm ... mp]
+    const uint32_t mv = 4 * m2,
+                   mp = 4 * m2 + 2,
+                   mmShift = ieeeMantissa != 0 || ieeeExponent <= 1,
+                   mm = 4 * m2 - 1 - mmShift;
+
+    // Convert the interval to decimal
+    uint32_t vr, vp, vm;
+    int32_t e10;
+    bool vmIsTrailingZeros = false,
+         vrIsTrailingZeros = false;
+    uint32_t lastRemovedDigit = 0;
+    if (e2 >= 0) {
+        const uint32_t q = log10_pow2(e2);
+        e10 = (int32_t)q;
+        const int32_t k = kPow5InvBitCount + pow5_bits((int32_t)q) - 1,
+                      i = -e2 + (int32_t)q + k;
+        vr = mul_shift(mv, gPow5InvSplit[q], i);
+        vp = mul_shift(mp, gPow5InvSplit[q], i);
+        vm = mul_shift(mm, gPow5InvSplit[q], i);
+        if (q != 0 && (vp - 1) / 10 <= vm / 10) {
+            // we need the removed digit, even though the loop below won't run
+            const int32_t l = kPow5InvBitCount + pow5_bits((int32_t)(q - 1)) - 1;
+            lastRemovedDigit = mul_shift(mv, gPow5InvSplit[q - 1], -e2 + (int32_t)q - 1 + l) % 10;
+        }
+        if (q <= 9) {
+            // at most one of mp, mv and mm can be a multiple of 5
+            if (mv % 5 == 0) {
+                vrIsTrailingZeros = multiple_of_pow5(mv, q);
+            } else if (acceptBounds) {
+                vmIsTrailingZeros = multiple_of_pow5(mm, q);
+            } else {
+                vp -= multiple_of_pow5(mp, q);
+            }
+        }
+    } else {
+        const uint32_t q = log10_pow5(-e2);
+        e10 = (int32_t)q + e2;
+        const int32_t i = -e2 - (int32_t)q,
+                      k = pow5_bits(i) - kPow5BitCount;
+        int32_t j = (int32_t)q - k;
+        vr = mul_shift(mv, gPow5Split[i], j);
+        vp = mul_shift(mp, gPow5Split[i], j);
+        vm = mul_shift(mm, gPow5Split[i], j);
+        if (q != 0 && (vp - 1) / 10 <= vm / 10) {
+            j = (int32_t)q - 1 - (pow5_bits(i + 1) - kPow5BitCount);
+            lastRemovedDigit = mul_shift(mv, gPow5Split[i + 1], j) % 10;
+        }
+        if (q <= 1) {
+            // mv = 4 * m2, so it has at least two trailing 0 bits
+            vrIsTrailingZeros = true;
+            if (acceptBounds) {
+                vmIsTrailingZeros = mmShift == 1;
+            } else {
+                vp -= 1;
+            }
+        } else if (q < 31) {
+            vrIsTrailingZeros = multiple_of_pow2(mv, q - 1);
+        }
+    }
+
+    // Remove digits while the interval still holds more than one candidate
+    int32_t removed = 0;
+    uint32_t output;
+    if (vmIsTrailingZeros || vrIsTrailingZeros) {
+        // the rare case (~4%), where the bounds or ties need care
+        while (vp / 10 > vm / 10) {
+            vmIsTrailingZeros &= vm % 10 == 0;
+            vrIsTrailingZeros &= lastRemovedDigit == 0;
+            lastRemovedDigit = vr % 10;
+            vr /= 10; vp /= 10; vm /= 10;
+            removed += 1;
+        }
+        if (vmIsTrailingZeros) {
+            while (vm % 10 == 0) {
+                vrIsTrailingZeros &= lastRemovedDigit == 0;
+                lastRemovedDigit = vr % 10;
+                vr /= 10; vp /= 10; vm /= 10;
+                removed += 1;
+            }
+        }
+        if (vrIsTrailingZeros && lastRemovedDigit == 5 && vr % 2 == 0) {
+            lastRemovedDigit = 4;   // exactly halfway: round to even
+        }
+        output = vr + ((vr == vm && (!acceptBounds || !vmIsTrailingZeros)) || lastRemovedDigit >= 5);
+    } else {
+        while (vp / 10 > vm / 10) {
+            lastRemovedDigit = vr % 10;
+            vr /= 10; vp /= 10; vm /= 10;
+            removed += 1;
+        }
+        output = vr + (vr == vm || lastRemovedDigit >= 5);
+    }
+
+    // rounding up can leave a trailing zero (e.g. 9.999 -> 10)
+    int32_t exp = e10 + removed;
+    while (output % 10 == 0) {
+        output /= 10;
+        exp += 1;
+    }
+    return {output, exp};
+}
+
+inline int32_t count_trailing_zeros(uint32_t x) {
+    assert(x != 0);
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctz(x);
+#else
+    int32_t n = 0;
+    while ((x & 1) == 0) {
+        x >>= 1;
+        n += 1;
+    }
+    return n;
+#endif
+}
+
+const uint64_t gPow5[] = {
+    1, 5, 25, 125, 625, 3125, 15625, 78125, 390625, 1953125, 9765625, 48828125,
+    244140625, 1220703125, 6103515625, 30517578125, 152587890625, 762939453125,
+};
+
+/*
+ *  Paths are full of values like 1200, 117.5 or 0.25: small integers, and
+ *  binary fractions with a few digits. Their exact decimal expansion is also
+ *  their shortest representation, so we can skip Ryu for them:
+ *  - integers below 2^24, since floats there are spaced at most 1 apart.
+ *  - up to 6 significant digits, since decimals with that many digits are
+ *    spaced further apart (relative to x) than floats are, so no other one
+ *    can round to the same float.
+ */
+bool short_exact_decimal(uint32_t ieeeMantissa, uint32_t ieeeExponent, Decimal* d) {
+    if (ieeeExponent == 0 || ieeeExponent > kBias + kMantissaBits) {
+        return false;   // denormal, or at least 2^24
+    }
+    // x = m2 * 2^e2, with m2 odd (or x an integer)
+    uint32_t m2 = (1u << kMantissaBits) | ieeeMantissa;
+    int32_t e2 = (int32_t)ieeeExponent - kBias - kMantissaBits;
+    const int32_t shift = std::min(count_trailing_zeros(m2), -e2);
+    m2 >>= shift;
+    e2 += shift;
+
+    uint64_t digits;
+    if (e2 == 0) {
+        digits = m2;
+    } else {
+        // x = m2 * 5^-e2 * 10^e2
+        if (-e2 >= (int32_t)(sizeof(gPow5) / sizeof(gPow5[0]))) {
+            return false;
+        }
+        digits = m2 * gPow5[-e2];
+        if (digits >= 1000000) {
+            return false;
+        }
+    }
+    int32_t exp = e2;
+    while (digits % 10 == 0) {
+        digits /= 10;
+        exp += 1;
+    }
+    *d = {(uint32_t)digits, exp};
+    return true;
+}
+
+const char gDigitPairs[] =
+    "00010203040506070809" "10111213141516171819" "20212223242526272829"
+    "30313233343536373839" "40414243444546474849" "50515253545556575859"
+    "60616263646566676869" "70717273747576777879" "80818283848586878889"
+    "90919293949596979899";
+
+// value must be less than 10^19
+int count_digits(uint64_t value) {
+    int n = 1;
+    for (uint64_t limit = 10; value >= limit; limit *= 10) {
+        n += 1;
+    }
+    return n;
+}
+
+// Writes exactly n digits of value (which must fit), with leading zeros as needed
+void write_digits(uint64_t value, int n, char dst[]) {
+    char* p = dst + n;
+    while (n >= 2) {
+        const auto pair = value % 100;
+        value /= 100;
+        p -= 2;
+        memcpy(p, &gDigitPairs[pair * 2], 2);
+        n -= 2;
+    }
+    if (n) {
+        p[-1] = (char)('0' + value % 10);
+    }
+}
+
+size_t write_special(float x, char dst[]) {
+    const char* str = std::isnan(x) ? "nan" : (x < 0 ? "-inf" : "inf");
+    const size_t n = strlen(str);
+    memcpy(dst, str, n);
+    return n;
+}
+
+const double gPow10[] = {
+    1, 10, 100, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+};
+
+constexpr double kMaxFixed = 1e15;  // keeps the scaled value an exact integer in a double
+
+} // namespace
+
+size_t pentrek::float_to_chars(float x, char dst[]) {
+    uint32_t bits;
+    memcpy(&bits, &x, 4);
+    const bool negative = bits >> 31;
+    const uint32_t ieeeMantissa = bits & ((1u << kMantissaBits) - 1),
+                   ieeeExponent = (bits >> kMantissaBits) & ((1u << kExponentBits) - 1);
+
+    if (ieeeExponent == (1u << kExponentBits) - 1) {
+        return write_special(x, dst);
+    }
+    if (ieeeExponent == 0 && ieeeMantissa == 0) {
+        dst[0] = '0';   // including -0, which readers would not distinguish anyway
+        return 1;
+    }
+
+    Decimal d;
+    if (!short_exact_decimal(ieeeMantissa, ieeeExponent, &d)) {
+        d = shortest_decimal(ieeeMantissa, ieeeExponent);
+    }
+    const int n = count_digits(d.m_digits),
+              point = n + d.m_exp,  // the number of digits before the decimal point
+              sciExp = point - 1;
+
+    char* p = dst;
+    if (negative) {
+        *p++ = '-';
+    }
+    if (sciExp >= -4 && sciExp < 9) {
+        if (d.m_exp >= 0) {             // 1200
+            write_digits(d.m_digits, n, p);
+            p += n;
+            memset(p, '0', d.m_exp);
+            p += d.m_exp;
+        } else if (point > 0) {         // 12.5
+            write_digits(d.m_digits, n, p + 1);
+            memmove(p, p + 1, point);
+            p[point] = '.';
+            p += n + 1;
+        } else {                        // 0.0125
+            *p++ = '0';
+            *p++ = '.';
+            memset(p, '0', -point);
+            p += -point;
+            write_digits(d.m_digits, n, p);
+            p += n;
+        }
+    } else {                            // 1.25e-7
+        write_digits(d.m_digits, n, p + 1);
+        p[0] = p[1];
+        if (n > 1) {
+            p[1] = '.';
+            p += n + 1;
+        } else {
+            p += 1;
+        }
+        *p++ = 'e';
+        int e = sciExp;
+        if (e < 0) {
+            *p++ = '-';
+            e = -e;
+        }
+        const int en = count_digits(e);
+        write_digits(e, en, p);
+        p += en;
+    }
+    assert(p - dst <= (ptrdiff_t)kMaxFloatChars);
+    return p - dst;
+}
+
+size_t pentrek::float_to_chars_fixed(float x, int decimals, char dst[]) {
+    decimals = std::min(std::max(decimals, 0), 9);
+    const double scaled = std::abs((double)x * gPow10[decimals]);
+    if (!(scaled < kMaxFixed)) {
+        return float_to_chars(x, dst);  // too large (or not finite)
+    }
+
+    const auto value = (uint64_t)(scaled + 0.5);
+    char* p = dst;
+    if (value == 0) {
+        *p++ = '0';
+        return 1;
+    }
+    if (x < 0) {
+        *p++ = '-';
+    }
+
+    const auto scale = (uint64_t)gPow10[decimals];
+    const uint64_t whole = value / scale;
+    uint64_t frac = value % scale;
+
+    const int wn = count_digits(whole);
+    write_digits(whole, wn, p);
+    p += wn;
+    if (frac) {
+        int fn = decimals;
+        while (frac % 10 == 0) {
+            frac /= 10;
+            fn -= 1;
+        }
+        *p++ = '.';
+        write_digits(frac, fn, p);
+        p += fn;
+    }
+    assert(p - dst <= (ptrdiff_t)kMaxFloatChars);
+    return p - dst;
+}
+
+float pentrek::round_to_decimals(float x, int decimals) {
+    decimals = std::min(std::max(decimals, 0), 9);
+    const double scaled = std::abs((double)x * gPow10[decimals]);
+    if (!(scaled < kMaxFixed)) {
+        return x;
+    }
+    const double value = (double)(uint64_t)(scaled + 0.5) / gPow10[decimals];
+    return (float)(x < 0 ? -value : value);
+}
+
+//////////////////////////////////
+
+void FloatFormat::Tests() {
+#ifdef DEBUG
+    char buffer[kMaxFloatChars + 1];
+    auto str = [&](size_t n) {
+        assert(n <= kMaxFloatChars);
+        return std::string(buffer, n);
+    };
+    auto shortest = [&](float x) { return str(float_to_chars(x, buffer)); };
+    auto fixed = [&](float x, int d) { return str(float_to_chars_fixed(x, d, buffer)); };
+
+    assert(shortest(0) == "0");
+    assert(shortest(-0.0f) == "0");
+    assert(shortest(1) == "1");
+    assert(shortest(-2.5f) == "-2.5");
+    assert(shortest(0.1f) == "0.1");
+    assert(shortest(1.0f / 3) == "0.33333334");
+    assert(shortest(1200) == "1200");
+    assert(shortest(16777216) == "16777216");
+    assert(shortest(0.0125f) == "0.0125");
+    assert(shortest(0.0001f) == "0.0001");
+    assert(shortest(0.00001f) == "1e-5");
+    assert(shortest(1e9f) == "1e9");
+    assert(shortest(-1.5e-7f) == "-1.5e-7");
+    assert(shortest(3.4028235e38f) == "3.4028235e38");
+    assert(shortest(1e-45f) == "1e-45");    // the smallest denormal
+    assert(shortest(INFINITY) == "inf");
+    assert(shortest(-INFINITY) == "-inf");
+    assert(shortest(NAN) == "nan");
+
+    // round-trips, and is never longer than %.9g
+    uint32_t bits = 1;
+    for (int i = 0; i < 100000; ++i) {
+        bits = bits * 1664525 + 1013904223;
+        float x;
+        memcpy(&x, &bits, 4);
+        if (!std::isfinite(x)) {
+            continue;
+        }
+        const auto s = shortest(x);
+        assert(strtof(s.c_str(), nullptr) == x);
+        char tmp[32];
+        assert(s.size() <= (size_t)snprintf(tmp, sizeof(tmp), "%.9g", x));
+    }
+
+    assert(fixed(1.23456f, 2) == "1.23");
+    assert(fixed(-1.005f, 3) == "-1.005");
+    assert(fixed(2.5f, 4) == "2.5");
+    assert(fixed(2.999f, 2) == "3");
+    assert(fixed(0.001f, 2) == "0");
+    assert(fixed(-0.001f, 2) == "0");
+    assert(fixed(0.05f, 2) == "0.05");
+    assert(fixed(12.5f, 0) == "13");
+    assert(fixed(100, 9) == "100");
+    assert(fixed(1e20f, 2) == "1e20");
+    assert(fixed(NAN, 2) == "nan");
+    assert(round_to_decimals(1.23456f, 2) == 1.23f);
+    assert(round_to_decimals(-0.05f, 1) == -0.1f);
+    assert(round_to_decimals(1e20f, 2) == 1e20f);
+#endif
+}
@@ -0,0 +1,227 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#include "include/geometry.h"
+#include <algorithm>
+
+using namespace pentrek;
+
+// If the derivative at t is (nearly) zero, e.g. at the end of a curve whose
+// control point is coincident with it, fall back on the chord(s) so we still
+// return a meaningful direction.
+static Point safe_tangent(Point tan, Point fallback0, Point fallback1) {
+    if (tan.isNearlyZero()) {
+        tan = fallback0;
+        if (tan.isNearlyZero()) {
+            tan = fallback1;
+        }
+    }
+    return tan.normalize();
+}
+
+/*
+ *  Wang's formula: a degree-n bezier is within tolerance of its chords if
+ *  it is divided into
+ *
+ *      sqrt(n*(n-1)/8 * max|P[i] - 2P[i+1] + P[i+2]| / tolerance)
+ *
+ *  uniform (in t) segments.
+ */
+
+// We work with the squared length, so this returns ceil(sqrt(sqrt(value)))
+static int wang_segments(float scale, float secondDiffLengthSquared, float invTolerance) {
+    const float n = std::sqrt(std::sqrt(scale * scale * secondDiffLengthSquared) * invTolerance);
+    // written this way so NaN (e.g. an infinite point) also gets pinned
+    if (!(n < kMaxCurveSegments)) {
+        return kMaxCurveSegments;
+    }
+    const int ni = (int)n;
+    return std::max(1, ni + (ni < n));  // ceil
+}
+
+int pentrek::count_quad_segments(Point a, Point b, Point c, float invTolerance) {
+    // 2*1/8
+    return wang_segments(0.25f, (a - twice(b) + c).lengthSquared(), invTolerance);
+}
+
+int pentrek::count_cubic_segments(Point a, Point b, Point c, Point d, float invTolerance) {
+    // 3*2/8
+    const float lenSq = std::max((a - twice(b) + c).lengthSquared(),
+                                 (b - twice(c) + d).lengthSquared());
+    return wang_segments(0.75f, lenSq, invTolerance);
+}
+
+std::pair<Point, Point> pentrek::line_postan(const Point pts[], float t) {
+    return {
+        lerp_unbounded(pts[0], pts[1], t),
+        (pts[1] - pts[0]).normalize(),
+    };
+}
+
+std::pair<Point, Point> pentrek::quad_postan(const Point pts[], float t) {
+    const auto qc = QuadCoeff::Compute(pts);
+    const Point tan = twice(qc.A * t) + qc.B;
+    const Point chord = pts[2] - pts[0];
+    return {
+        qc.eval(t),
+        safe_tangent(tan, chord, chord),
+    };
+}
+
+std::pair<Point, Point> pentrek::cubic_postan(const Point pts[], float t) {
+    const auto cc = CubicCoeff::Compute(pts);
+    const Point chord = t < 0.5f ? pts[2] - pts[0] : pts[3] - pts[1];
+    return {
+        cc.eval(t),
+        safe_tangent(cc.evalTan(t), chord, pts[3] - pts[0]),
+    };
+}
+
+void pentrek::line_chop(const Point src[2], float t, Point dst[3]) {
+    dst[0] = src[0];
+    dst[1] = lerp_unbounded(src[0], src[1], t);
+    dst[2] = src[1];
+}
+
+void pentrek::quad_chop(const Point src[3], float t, Point dst[5]) {
+    const Point ab = lerp_unbounded(src[0], src[1], t);
+    const Point bc = lerp_unbounded(src[1], src[2], t);
+
+    dst[0] = src[0];
+    dst[1] = ab;
+    dst[2] = lerp_unbounded(ab, bc, t);
+    dst[3] = bc;
+    dst[4] = src[2];
+}
+
+void pentrek::cubic_chop(const Point src[4], float t, Point dst[7]) {
+    const Point ab = lerp_unbounded(src[0], src[1], t);
+    const Point bc = lerp_unbounded(src[1], src[2], t);
+    const Point cd = lerp_unbounded(src[2], src[3], t);
+    const Point abc = lerp_unbounded(ab, bc, t);
+    const Point bcd = lerp_unbounded(bc, cd, t);
+
+    dst[0] = src[0];
+    dst[1] = ab;
+    dst[2] = abc;
+    dst[3] = lerp_unbounded(abc, bcd, t);
+    dst[4] = bcd;
+    dst[5] = cd;
+    dst[6] = src[3];
+}
+
+void pentrek::line_extract(const Point src[2], float t0, float t1, Point dst[2]) {
+    assert(t0 <= t1);
+    dst[0] = lerp_unbounded(src[0], src[1], t0);
+    dst[1] = lerp_unbounded(src[0], src[1], t1);
+}
+
+// For the curves, we first chop at t1 (keeping the front), and then chop
+// that piece at t0 (rescaled to its new range), keeping the back.
+
+void pentrek::quad_extract(const Point src[3], float t0, float t1, Point dst[3]) {
+    assert(t0 <= t1);
+    Point tmp[5];
+    if (t1 < 1) {
+        quad_chop(src, t1, tmp);
+    } else {
+        std::copy(src, src + 3, tmp);
+    }
+    if (t0 > 0) {
+        Point tmp2[5];
+        quad_chop(tmp, t1 > 0 ? t0 / t1 : 0, tmp2);
+        std::copy(tmp2 + 2, tmp2 + 5, dst);
+    } else {
+        std::copy(tmp, tmp + 3, dst);
+    }
+}
+
+void pentrek::cubic_extract(const Point src[4], float t0, float t1, Point dst[4]) {
+    assert(t0 <= t1);
+    Point tmp[7];
+    if (t1 < 1) {
+        cubic_chop(src, t1, tmp);
+    } else {
+        std::copy(src, src + 4, tmp);
+    }
+    if (t0 > 0) {
+        Point tmp2[7];
+        cubic_chop(tmp, t1 > 0 ? t0 / t1 : 0, tmp2);
+        std::copy(tmp2 + 3, tmp2 + 7, dst);
+    } else {
+        std::copy(tmp, tmp + 4, dst);
+    }
+}
+
+// Merge the X and Y roots (each already sorted), dropping the endpoints and dups.
+static int merge_extrema(const float tx[], int nx, const float ty[], int ny, float dst[]) {
+    float* end = std::merge(tx, tx + nx, ty, ty + ny, dst);
+    end = std::unique(dst, end);
+    end = std::remove_if(dst, end, [](float t) { return t <= 0 || t >= 1; });
+    return castTo<int>(end - dst);
+}
+
+// Our derivative is 2At + B, so the extrema (in each axis) are where At + B/2 == 0
+
+int pentrek::quad_extrema(const Point src[3], float t[2]) {
+    const auto qc = QuadCoeff::Compute(src);
+    float tx[2], ty[2];
+    const int nx = quadratic_unit_roots(0, qc.A.x, 0.5f * qc.B.x, tx);
+    const int ny = quadratic_unit_roots(0, qc.A.y, 0.5f * qc.B.y, ty);
+    return merge_extrema(tx, nx, ty, ny, t);
+}
+
+// Our derivative is 3At^2 + 2Bt + C
+
+int pentrek::cubic_extrema(const Point src[4], float t[4]) {
+    const auto cc = CubicCoeff::Compute(src);
+    float tx[2], ty[2];
+    const int nx = quadratic_unit_roots(3 * cc.A.x, 2 * cc.B.x, cc.C.x, tx);
+    const int ny = quadratic_unit_roots(3 * cc.A.y, 2 * cc.B.y, cc.C.y, ty);
+    return merge_extrema(tx, nx, ty, ny, t);
+}
+
+void pentrek::pin_monotonic(Point pts[], int degree) {
+    for (int axis = 0; axis < 2; ++axis) {
+        auto c = [&](int i) -> float& { return axis ? pts[i].y : pts[i].x; };
+        const float a = c(0),
+                    b = c(degree);
+        if (degree == 2 || a == b) {
+            for (int i = 1; i < degree; ++i) {
+                c(i) = pin_float(c(i), std::min(a, b), std::max(a, b));
+            }
+        } else if (degree == 3) {
+            if ((c(1) - a) * (b - a) < 0) {
+                c(1) = a;
+            }
+            if ((b - c(2)) * (b - a) < 0) {
+                c(2) = b;
+            }
+        }
+    }
+}
+
+Rect pentrek::quad_tight_bounds(const Point src[3]) {
+    float t[2];
+    const int count = quad_extrema(src, t);
+
+    const auto qc = QuadCoeff::Compute(src);
+    Point storage[4] = {src[0], src[2]};
+    for (int i = 0; i < count; ++i) {
+        storage[2 + i] = qc.eval(t[i]);
+    }
+    return Rect::Bounds({storage, (size_t)(2 + count)});
+}
+
+Rect pentrek::cubic_tight_bounds(const Point src[4]) {
+    float t[4];
+    const int count = cubic_extrema(src, t);
+
+    const auto cc = CubicCoeff::Compute(src);
+    Point storage[6] = {src[0], src[3]};
+    for (int i = 0; i < count; ++i) {
+        storage[2 + i] = cc.eval(t[i]);
+    }
+    return Rect::Bounds({storage, (size_t)(2 + count)});
+}
@@ -1,15 +1,12 @@
 
 
 #include "include/matrix.h"
+#include "include/point_kernels.h"
 
 using namespace pentrek;
 
 constexpr Matrix gIdentity;
 
-bool Matrix::isIdentity() const {
-    return *this == gIdentity;
-}
-
 const Matrix& Matrix::I() { return gIdentity; }
 
 Point Point::makeLength(float newLength) const {
@@ -24,7 +21,7 @@ Point Point::makeLength(float newLength) const {
 Matrix Matrix::Rotate(float radians) {
     const float c = std::cos(radians);
     const float s = std::sin(radians);
-    return {c, s, -s, c, 0, 0};
+    return Matrix(c, s, -s, c, 0, 0);
 }
 
 static double dcross(double a, double b, double c, double d) {
@@ -96,38 +93,28 @@ Matrix Matrix::Fit(const Rect& src, const Rect& dst, FitStyle fit) {
 
 void Matrix::map(Span<Point> dst, Span<const Point> src) const {
     assert(dst.size() >= src.size());
-    for (size_t i = 0; i < src.size(); ++i) {
-        dst[i] = *this * src[i];
+    if (src.empty()) {
+        return;
+    }
+    if (this->isIdentity()) {
+        if (dst.data() != src.data()) {
+            std::copy(src.begin(), src.end(), dst.begin());
+        }
+    } else if (this->isScaleTranslate()) {
+        PointKernels::Get().m_scaleTrans(dst.data(), src.data(), src.size(),
+                                         m[0], m[3], m[4], m[5]);
+    } else {
+        PointKernels::Get().m_affine(dst.data(), src.data(), src.size(), *this);
     }
 }
 
 ///////////////
 
-static inline float fast_min(float a, float b) {
-    return fminf(a, b);
-}
-static inline float fast_max(float a, float b) {
-    return fmaxf(a, b);
-}
-
 Rect Rect::Bounds(Span<const Point> pts) {
     if (pts.empty()) {
         return pentrek::Rect::Empty();
     }
-    
-    float l = pts[0].x,
-          t = pts[0].y,
-          r = l,
-          b = t;
-
-    for (size_t i = 1; i < pts.size(); ++i) {
-        auto p = pts[i];
-        l = fast_min(l, p.x);
-        t = fast_min(t, p.y);
-        r = fast_max(r, p.x);
-        b = fast_max(b, p.y);
-    }
-    return pentrek::Rect{l, t, r, b};
+    return PointKernels::Get().m_bounds(pts.data(), pts.size());
 }
 
 void Rect::toQuad(Point p[4]) const {
@@ -0,0 +1,659 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#include "include/measure.h"
+#include "include/cache.h"
+#include "include/geometry.h"
+
+using namespace pentrek;
+
+using Rec = ContourMeasure::Rec;
+
+// Don't subdivide forever (e.g. for huge coordinates and a tiny tolerance)
+static bool tspan_big_enough(float tspan) {
+    return tspan > 1.0f / 1024;
+}
+
+static bool exceeds_tol(Point p, float tol) {
+    return std::max(std::abs(p.x), std::abs(p.y)) > tol;
+}
+
+// Compare the midpoint of the curve with the midpoint of its chord
+static bool quad_too_curvy(const Point pts[3], float tol) {
+    // (a + 2b + c)/4 - (a + c)/2
+    return exceeds_tol((twice(pts[1]) - pts[0] - pts[2]) * 0.25f, tol);
+}
+
+// Compare the inner control points with the chord at 1/3 and 2/3
+static bool cubic_too_curvy(const Point pts[4], float tol) {
+    constexpr float third = 1.0f / 3;
+    return exceeds_tol(pts[1] - lerp(pts[0], pts[3], third), tol)
+        || exceeds_tol(pts[2] - lerp(pts[0], pts[3], 1 - third), tol);
+}
+
+static float add_chord(Point a, Point b, float total, unsigned index, unsigned count,
+                       float endT, std::vector<Rec>* recs) {
+    const float prev = total;
+    total += (b - a).length();
+    if (total > prev) {     // skip zero-length pieces
+        recs->push_back({index, count, total, endT});
+    }
+    return total;
+}
+
+static float quad_segs(const Point pts[3], float total, float minT, float maxT,
+                       unsigned index, float tol, std::vector<Rec>* recs) {
+    if (tspan_big_enough(maxT - minT) && quad_too_curvy(pts, tol)) {
+        Point tmp[5];
+        quad_chop(pts, 0.5f, tmp);
+        const float midT = (minT + maxT) * 0.5f;
+        total = quad_segs(tmp + 0, total, minT, midT, index, tol, recs);
+        total = quad_segs(tmp + 2, total, midT, maxT, index, tol, recs);
+        return total;
+    }
+    return add_chord(pts[0], pts[2], total, index, 2, maxT, recs);
+}
+
+static float cubic_segs(const Point pts[4], float total, float minT, float maxT,
+                        unsigned index, float tol, std::vector<Rec>* recs) {
+    if (tspan_big_enough(maxT - minT) && cubic_too_curvy(pts, tol)) {
+        Point tmp[7];
+        cubic_chop(pts, 0.5f, tmp);
+        const float midT = (minT + maxT) * 0.5f;
+        total = cubic_segs(tmp + 0, total, minT, midT, index, tol, recs);
+        total = cubic_segs(tmp + 3, total, midT, maxT, index, tol, recs);
+        return total;
+    }
+    return add_chord(pts[0], pts[3], total, index, 3, maxT, recs);
+}
+
+// Zero-length segments are skipped, judged by their points rather than by
+// whether total grew: a real segment can be shorter than total's precision,
+// and the next one still has to start from its end. (It just gets no Rec.)
+
+float ContourMeasure::add_line(Point a, float total) {
+    if (a == m_pts.back()) {
+        return total;
+    }
+    const auto index = castTo<unsigned>(m_pts.size() - 1);
+    total = add_chord(m_pts.back(), a, total, index, 1, 1, &m_recs);
+    m_pts.push_back(a);
+    return total;
+}
+
+float ContourMeasure::add_quad(const Point pts[], float total, float tol) {
+    assert(pts[0] == m_pts.back());
+    if (pts[1] == pts[0] && pts[2] == pts[0]) {
+        return total;
+    }
+    const auto index = castTo<unsigned>(m_pts.size() - 1);
+    total = quad_segs(pts, total, 0, 1, index, tol, &m_recs);
+    m_pts.push_back(pts[1]);
+    m_pts.push_back(pts[2]);
+    return total;
+}
+
+float ContourMeasure::add_cubic(const Point pts[], float total, float tol) {
+    assert(pts[0] == m_pts.back());
+    if (pts[1] == pts[0] && pts[2] == pts[0] && pts[3] == pts[0]) {
+        return total;
+    }
+    const auto index = castTo<unsigned>(m_pts.size() - 1);
+    total = cubic_segs(pts, total, 0, 1, index, tol, &m_recs);
+    m_pts.push_back(pts[1]);
+    m_pts.push_back(pts[2]);
+    m_pts.push_back(pts[3]);
+    return total;
+}
+
+ContourMeasure::ContourMeasure(Span<const Point> pts, Span<const PathVerb> vbs, float tol) {
+    assert(tol > 0);
+    assert(vbs.size() > 0 && vbs[0] == PathVerb::move);
+
+    m_pts.reserve(pts.size() + 1);
+    m_pts.push_back(pts[0]);
+
+    const Point* p = pts.data() + 1;
+    float total = 0;
+    for (size_t i = 1; i < vbs.size(); ++i) {
+        switch (vbs[i]) {
+            case PathVerb::move:
+                assert(false);  // we only measure a single contour
+                break;
+            case PathVerb::line:
+                total = this->add_line(p[0], total);
+                p += 1;
+                break;
+            case PathVerb::quad:
+                total = this->add_quad(p - 1, total, tol);
+                p += 2;
+                break;
+            case PathVerb::cubic:
+                total = this->add_cubic(p - 1, total, tol);
+                p += 3;
+                break;
+            case PathVerb::close:
+                total = this->add_line(m_pts[0], total);
+                m_isClosed = true;
+                break;
+        }
+    }
+    assert(p == pts.data() + pts.size());
+
+    this->validate();
+}
+
+#ifdef DEBUG
+void ContourMeasure::validate() const {
+    float prevLength = 0;
+    for (const auto& r : m_recs) {
+        assert(r.m_pointCount >= 1 && r.m_pointCount <= 3);
+        assert((size_t)r.m_pointIndex + r.m_pointCount < m_pts.size());
+        assert(r.m_length > prevLength);
+        assert(r.m_tValue > 0 && r.m_tValue <= 1);
+        prevLength = r.m_length;
+    }
+}
+#endif
+
+size_t ContourMeasure::findRec(float distance) const {
+    auto iter = std::lower_bound(m_recs.begin(), m_recs.end(), distance,
+                                 [](const Rec& r, float d) {
+        return r.m_length < d;
+    });
+    const size_t index = iter - m_recs.begin();
+    return std::min(index, m_recs.size() - 1);
+}
+
+float ContourMeasure::recT(size_t index, float distance) const {
+    const Rec& rec = m_recs[index];
+
+    float prevLength = 0, prevT = 0;
+    if (index > 0) {
+        const Rec& prev = m_recs[index - 1];
+        prevLength = prev.m_length;
+        if (prev.m_pointIndex == rec.m_pointIndex) {
+            prevT = prev.m_tValue;  // same curve
+        }
+    }
+    assert(rec.m_length > prevLength);
+
+    const float u = (distance - prevLength) / (rec.m_length - prevLength);
+    return lerp(prevT, rec.m_tValue, pin_to_unit(u));
+}
+
+static std::pair<Point, Point> curve_postan(const Point pts[], unsigned count, float t) {
+    switch (count) {
+        case 1: return line_postan(pts, t);
+        case 2: return quad_postan(pts, t);
+        case 3: return cubic_postan(pts, t);
+    }
+    assert(false);
+    return {{0, 0}, {1, 0}};
+}
+
+std::pair<Point, Point> ContourMeasure::getPosTan(float distance) const {
+    distance = this->pin_distance(distance);
+    const size_t index = this->findRec(distance);
+    return curve_postan(this->recPts(index), m_recs[index].m_pointCount,
+                        this->recT(index, distance));
+}
+
+std::pair<Point, Point> ContourMeasure::getPosTanExtend(float distance) const {
+    const float len = this->length();
+    if (distance < 0) {
+        auto [pos, tan] = this->getPosTan(0);
+        return {pos + tan * distance, tan};
+    }
+    if (distance > len) {
+        auto [pos, tan] = this->getPosTan(len);
+        return {pos + tan * (distance - len), tan};
+    }
+    return this->getPosTan(distance);
+}
+
+Matrix ContourMeasure::getMatrix(float distance) const {
+    auto [pos, tan] = this->getPosTan(distance);
+    return Matrix(tan, tan.cw(), pos);
+}
+
+namespace {
+
+// Every segment (line, quad, cubic) in cubic form, so that a run of t values
+// on the same segment can be evaluated with the same branch-free loop.
+struct SegCoeff {
+    Point A, B, C, D;   // At^3 + Bt^2 + Ct + D
+
+    static SegCoeff Make(const Point pts[], unsigned count) {
+        switch (count) {
+            case 1: return {{0, 0}, {0, 0}, pts[1] - pts[0], pts[0]};
+            case 2: {
+                auto qc = QuadCoeff::Compute(pts);
+                return {{0, 0}, qc.A, qc.B, qc.C};
+            }
+            default: {
+                auto cc = CubicCoeff::Compute(pts);
+                return {cc.A, cc.B, cc.C, cc.D};
+            }
+        }
+    }
+
+    void eval(const float ts[], Point pos[], Point tan[], size_t n) const {
+        const Point A3 = 3 * A, B2 = twice(B);
+        for (size_t i = 0; i < n; ++i) {
+            const float t = ts[i];
+            pos[i] = ((A*t + B)*t + C)*t + D;
+            tan[i] = (A3*t + B2)*t + C;
+        }
+    }
+};
+
+} // namespace
+
+// Returns the index of the first rec (starting at 'start') whose length is >= d
+// (or the last rec). Since our distances are sorted, the answer is usually close
+// by, so we look in increasingly large steps, and then binary search that range.
+static size_t gallop_forward(const std::vector<Rec>& recs, size_t start, float d) {
+    const size_t n = recs.size();
+    size_t lo = start,
+           step = 1;
+    while (lo + step < n && recs[lo + step - 1].m_length < d) {
+        lo += step;
+        step *= 2;
+    }
+    const size_t hi = std::min(lo + step, n);
+    auto iter = std::lower_bound(recs.begin() + lo, recs.begin() + hi, d,
+                                 [](const Rec& r, float d) {
+        return r.m_length < d;
+    });
+    return std::min<size_t>(iter - recs.begin(), n - 1);
+}
+
+/*
+ *  Calls proc(index, pos, tan) for each distance, in order of increasing distance.
+ *
+ *  We walk the recs once (rather than a full search per distance), and batch up
+ *  runs of t values that land on the same segment, evaluating them together.
+ */
+template <typename Proc>
+static void sweep_postan(const ContourMeasure& cm, Span<const float> distances, Proc proc) {
+    const size_t N = distances.size();
+    const auto& recs = cm.m_recs;
+
+    // if we need to sort, we sort {distance, index} pairs
+    std::vector<std::pair<float, uint32_t>> order;
+    const bool isSorted = std::is_sorted(distances.begin(), distances.end());
+    if (!isSorted) {
+        order.resize(N);
+        for (size_t i = 0; i < N; ++i) {
+            order[i] = {distances[i], castTo<uint32_t>(i)};
+        }
+        std::sort(order.begin(), order.end());
+    }
+
+    constexpr size_t kMaxRun = 64;
+    float    ts[kMaxRun];
+    uint32_t ids[kMaxRun];
+    Point    pos[kMaxRun],
+             tan[kMaxRun];
+    size_t   n = 0;
+
+    size_t recIndex = 0;
+    size_t runRec = 0;   // a rec on the current segment
+    SegCoeff coeff;
+
+    auto flush = [&]() {
+        coeff.eval(ts, pos, tan, n);
+        for (size_t i = 0; i < n; ++i) {
+            const float len = tan[i].length();
+            if (len > 1.0f / 32678) {
+                tan[i] = tan[i] * (1 / len);
+            } else {
+                // degenerate derivative, let the scalar version pick a direction
+                tan[i] = curve_postan(cm.recPts(runRec), recs[runRec].m_pointCount, ts[i]).second;
+            }
+            proc(ids[i], pos[i], tan[i]);
+        }
+        n = 0;
+    };
+
+    for (size_t k = 0; k < N; ++k) {
+        const uint32_t i = isSorted ? castTo<uint32_t>(k) : order[k].second;
+        const float d = cm.pin_distance(distances[i]);
+        if (recs[recIndex].m_length < d) {
+            recIndex = gallop_forward(recs, recIndex + 1, d);
+        }
+
+        if (n == 0 || recs[recIndex].m_pointIndex != recs[runRec].m_pointIndex) {
+            if (n > 0) {
+                flush();
+            }
+            runRec = recIndex;
+            coeff = SegCoeff::Make(cm.recPts(runRec), recs[runRec].m_pointCount);
+        } else if (n == kMaxRun) {
+            flush();
+        }
+        ts[n] = cm.recT(recIndex, d);
+        ids[n] = i;
+        n += 1;
+    }
+    if (n > 0) {
+        flush();
+    }
+}
+
+void ContourMeasure::getPosTan(Span<const float> distances,
+                               Span<Point> pos, Span<Point> tan) const {
+    assert(pos.empty() || pos.size() == distances.size());
+    assert(tan.empty() || tan.size() == distances.size());
+
+    Point* p = pos.data();
+    Point* t = tan.data();
+    sweep_postan(*this, distances, [p, t](uint32_t i, Point ps, Point tn) {
+        if (p) {
+            p[i] = ps;
+        }
+        if (t) {
+            t[i] = tn;
+        }
+    });
+}
+
+void ContourMeasure::getMatrix(Span<const float> distances, Span<Matrix> dst) const {
+    assert(dst.size() == distances.size());
+
+    Matrix* m = dst.data();
+    sweep_postan(*this, distances, [m](uint32_t i, Point pos, Point tan) {
+        m[i] = Matrix(tan, tan.cw(), pos);
+    });
+}
+
+static void extract_segment(const Point pts[], unsigned count, float t0, float t1,
+                            bool doMove, PathSync* sink) {
+    Point tmp[4];
+    switch (count) {
+        case 1: line_extract(pts, t0, t1, tmp); break;
+        case 2: quad_extract(pts, t0, t1, tmp); break;
+        case 3: cubic_extract(pts, t0, t1, tmp); break;
+        default: assert(false); return;
+    }
+    if (doMove) {
+        sink->move(tmp[0]);
+    }
+    switch (count) {
+        case 1: sink->line(tmp[1]); break;
+        case 2: sink->quad(tmp[1], tmp[2]); break;
+        case 3: sink->cubic(tmp[1], tmp[2], tmp[3]); break;
+    }
+}
+
+void ContourMeasure::getSegment(float start, float end, bool doMove, PathSync* sink) const {
+    start = this->pin_distance(start);
+    end = this->pin_distance(end);
+    if (start > end) {
+        return;
+    }
+
+    const size_t i0 = this->findRec(start);
+    const size_t i1 = this->findRec(end);
+    const float t0 = this->recT(i0, start);
+    const float t1 = this->recT(i1, end);
+    const auto& r0 = m_recs[i0];
+    const auto& r1 = m_recs[i1];
+
+    if (r0.m_pointIndex == r1.m_pointIndex) {
+        extract_segment(this->recPts(i0), r0.m_pointCount, t0, t1, doMove, sink);
+        return;
+    }
+
+    extract_segment(this->recPts(i0), r0.m_pointCount, t0, 1, doMove, sink);
+
+    // emit the whole curves that lie between the first and last
+    unsigned prevIndex = r0.m_pointIndex;
+    for (size_t i = i0 + 1; i < i1; ++i) {
+        const auto& r = m_recs[i];
+        if (r.m_pointIndex != prevIndex && r.m_pointIndex != r1.m_pointIndex) {
+            extract_segment(this->recPts(i), r.m_pointCount, 0, 1, false, sink);
+            prevIndex = r.m_pointIndex;
+        }
+    }
+
+    extract_segment(this->recPts(i1), r1.m_pointCount, 0, t1, false, sink);
+}
+
+rcp<ContourMeasure> ContourMeasure::Make(Span<const Point> pts, Span<const PathVerb> vbs,
+                                         float tol) {
+    // only measure the first contour
+    auto [npts, nvbs] = count_contour_pts_vbs(pts, vbs);
+    if (nvbs < 2) {
+        return nullptr;
+    }
+
+    auto cm = make_rcp<ContourMeasure>(pts.subspan(0, npts), vbs.subspan(0, nvbs), tol);
+    if (cm->m_recs.empty()) {
+        return nullptr;
+    }
+    return cm;
+}
+
+rcp<ContourMeasure> ContourMeasure::Make(const Path& path, float tol) {
+    return Make(path.points(), path.verbs(), tol);
+}
+
+//////////////////////////////////
+
+rcp<ContourMeasure> ContourMeasureIter::tryNext() {
+    auto [npts, nvbs] = count_contour_pts_vbs(m_pts, m_vbs);
+    assert(nvbs > 0);
+
+    auto cm = ContourMeasure::Make(m_pts.subspan(0, npts), m_vbs.subspan(0, nvbs), m_tol);
+
+    m_pts = m_pts.subspan(npts, m_pts.size() - npts);
+    m_vbs = m_vbs.subspan(nvbs, m_vbs.size() - nvbs);
+    return cm;
+}
+
+rcp<ContourMeasure> ContourMeasureIter::next() {
+    while (!m_vbs.empty()) {
+        if (auto cm = this->tryNext()) {
+            return cm;
+        }
+    }
+    return nullptr;
+}
+
+//////////////////////////////////
+
+PathMeasure::PathMeasure(const Path& path, float tol) {
+    ContourMeasureIter iter(path, tol);
+    while (auto cm = iter.next()) {
+        m_length += cm->length();
+        m_contours.push_back(std::move(cm));
+    }
+}
+
+namespace {
+
+struct MeasureKey {
+    UniqueID    m_pathID;
+    float       m_tol;
+
+    bool operator==(const MeasureKey& o) const {
+        return m_pathID == o.m_pathID && m_tol == o.m_tol;
+    }
+};
+struct MeasureKeyHash {
+    size_t operator()(const MeasureKey& k) const {
+        return (size_t)LRUCacheBase::HashMix(k.m_pathID, LRUCacheBase::FloatBits(k.m_tol));
+    }
+};
+using MeasureCache = LRUCache<MeasureKey, rcp<PathMeasure>, MeasureKeyHash>;
+
+MeasureCache* global_measure_cache() {
+    // Enough for every path in a typical scene, so animating (e.g. a dash or
+    // trim effect on each of them) never has to measure a path twice.
+    static MeasureCache* gCache = new MeasureCache(1024);
+    return gCache;
+}
+
+} // namespace
+
+rcp<PathMeasure> PathMeasure::Make(const Path& path, float tol) {
+    return global_measure_cache()->findOrMake({path.uniqueID(), tol}, [&]() {
+        return make_rcp<PathMeasure>(path, tol);
+    });
+}
+
+void PathMeasure::PurgeCache() {
+    global_measure_cache()->purgeAll();
+}
+
+//////////////////////////////////
+
+#include "include/path_builder.h"
+
+void ContourMeasure::Tests() {
+#ifdef DEBUG
+    auto eq = [](Point a, Point b, float tol = 1.0f / 1024) {
+        return nearly_eq(a.x, b.x, tol) && nearly_eq(a.y, b.y, tol);
+    };
+
+    {
+        const Point pts[] = {{0, 0}, {10, 0}};
+        auto cm = Make(pts, {PathVerb::move, PathVerb::line});
+        assert(cm && cm->length() == 10 && !cm->isClosed());
+
+        auto [pos, tan] = cm->getPosTan(4);
+        assert(eq(pos, {4, 0}) && eq(tan, {1, 0}));
+        std::tie(pos, tan) = cm->getPosTan(-1);
+        assert(eq(pos, {0, 0}));
+        std::tie(pos, tan) = cm->getPosTanExtend(12);
+        assert(eq(pos, {12, 0}));
+
+        const auto mx = cm->getMatrix(5);
+        assert(eq(mx * Point{0, 0}, {5, 0}));
+        assert(eq(mx * Point{0, 1}, {5, 1}));
+    }
+
+    // zero-length contours are skipped
+    {
+        PathBuilder b;
+        b.move({1, 1}); b.line({1, 1});
+        b.addRect({0, 0, 10, 20});
+        b.move({5, 5});
+        auto path = b.detach();
+
+        ContourMeasureIter iter(path);
+        auto cm = iter.next();
+        assert(cm && cm->isClosed());
+        assert(cm->length() == 60);
+        assert(!iter.next());
+    }
+
+    // curves are flattened to within tolerance
+    {
+        const float r = 100;
+        auto path = Path::Circle({0, 0}, r);
+        for (float tol : {1.0f, 0.25f, 0.01f}) {
+            auto cm = Make(*path, tol);
+            const float expected = 2 * 3.14159265f * r;
+            assert(std::abs(cm->length() - expected) < expected * 0.01f);
+
+            // every point we find should be on the circle
+            for (float d = 0; d <= cm->length(); d += 7) {
+                auto [pos, tan] = cm->getPosTan(d);
+                assert(nearly_eq(pos.length(), r, 0.1f));
+                assert(nearly_zero(pos.dot(tan) / r, 0.01f));
+            }
+        }
+    }
+
+    // getSegment
+    {
+        PathBuilder b;
+        b.move({0, 0});
+        b.line({10, 0});
+        b.quad({20, 0}, {20, 10});
+        b.line({20, 20});
+        auto cm = Make(*b.detach());
+
+        PathBuilder seg;
+        cm->getSegment(5, 8, true, &seg);
+        assert(seg.m_verbs.size() == 2);
+        assert(eq(seg.m_points[0], {5, 0}) && eq(seg.m_points[1], {8, 0}));
+
+        seg = PathBuilder();
+        cm->getSegment(5, cm->length() - 5, true, &seg);
+        const PathVerb expected[] = {
+            PathVerb::move, PathVerb::line, PathVerb::quad, PathVerb::line,
+        };
+        assert(Span<const PathVerb>(seg.m_verbs) == Span<const PathVerb>(expected));
+        assert(eq(seg.m_points.front(), {5, 0}));
+        assert(eq(seg.m_points.back(), {20, 15}));
+
+        seg = PathBuilder();
+        cm->getSegment(8, 5, true, &seg);
+        assert(seg.empty());
+    }
+
+    // batch queries match the single queries
+    {
+        PathBuilder b;
+        b.move({0, 0});
+        b.line({10, 0});
+        b.quad({20, 0}, {20, 10});
+        b.cubic({20, 30}, {0, 30}, {0, 0});
+        b.close();
+        auto cm = Make(*b.detach(), 0.1f);
+
+        std::vector<float> dist;
+        for (float d = -5; d < cm->length() + 5; d += 0.75f) {
+            dist.push_back(d);
+        }
+        // unsorted as well as sorted
+        std::vector<float> shuffled(dist.rbegin(), dist.rend());
+        for (const auto& ds : {dist, shuffled}) {
+            const size_t N = ds.size();
+            std::vector<Point> pos(N), tan(N);
+            std::vector<Matrix> mx(N);
+            cm->getPosTan(ds, pos, tan);
+            cm->getMatrix(ds, mx);
+            for (size_t i = 0; i < N; ++i) {
+                auto [p, t] = cm->getPosTan(ds[i]);
+                assert(eq(p, pos[i], 1.0f / 256) && eq(t, tan[i], 1.0f / 256));
+                assert(eq(mx[i] * Point{0, 1}, p + t.cw(), 1.0f / 256));
+            }
+            cm->getPosTan(ds, pos, {});     // just positions
+        }
+    }
+
+    // the cache returns the same measure for the same path + tolerance
+    {
+        auto path = Path::Oval({0, 0, 40, 20});
+        auto m0 = PathMeasure::Make(path);
+        auto m1 = PathMeasure::Make(path);
+        auto m2 = PathMeasure::Make(path, 0.5f);
+        assert(m0.get() == m1.get());
+        assert(m0.get() != m2.get());
+        assert(m0->contours().size() == 1);
+        assert(m0->length() == m0->contours()[0]->length());
+        PathMeasure::PurgeCache();
+    }
+
+    // a segment too short to change the running total still moves the pen
+    {
+        PathBuilder builder;
+        builder.move({0, 0});
+        for (int i = 1; i <= 20000; ++i) {
+            builder.line({(i & 1) * 10.0f, 0});     // back and forth
+        }
+        const Point end = builder.m_points.back();
+        builder.line(end + Point{0.004f, 0});
+        builder.quad(end + Point{10, 10}, end + Point{20, 0});
+        auto cm = ContourMeasure::Make(*builder.detach());
+        auto [p, t] = cm->getPosTan(cm->length());
+        assert(eq(p, end + Point{20, 0}, 1.0f / 64));
+    }
+#endif
+}
@@ -0,0 +1,228 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#include "include/mikemull.h"
+
+using namespace pentrek;
+
+CtrlPoint MikeMull::ctrlPoint(Point prev, Point curr, Point next) const {
+    const Point across = next - prev;
+    const float length = across.length() * m_tanScale;
+    float prevLength = length * 0.5f,
+          nextLength = prevLength;
+
+    if (!m_useC2) {
+        // split it in proportion to the sides (unless we are an end)
+        const float a = (curr - prev).length(),
+                    b = (next - curr).length();
+        if (a > 0 && b > 0) {
+            prevLength = length * a / (a + b);
+            nextLength = length * b / (a + b);
+        }
+    }
+
+    const Point dir = across.normalize();
+    return {
+        curr - dir * std::min(prevLength, m_maxTanLength),
+        curr,
+        curr + dir * std::min(nextLength, m_maxTanLength),
+    };
+}
+
+std::vector<CtrlPoint> MikeMull::ctrlPoints(Span<const Point> pts) const {
+    const size_t n = pts.size();
+    std::vector<CtrlPoint> ctrls(n);
+    for (size_t i = 0; i < n; ++i) {
+        Point prev = pts[i], next = pts[i];
+        if (i > 0) {
+            prev = pts[i - 1];
+        } else if (m_isClosed) {
+            prev = pts[n - 1];
+        }
+        if (i + 1 < n) {
+            next = pts[i + 1];
+        } else if (m_isClosed) {
+            next = pts[0];
+        }
+        ctrls[i] = this->ctrlPoint(prev, pts[i], next);
+    }
+    return ctrls;
+}
+
+rcp<Path> MikeMull::path(Span<const Point> pts) const {
+    const auto ctrls = this->ctrlPoints(pts);
+    return path_from_ctrlpoints(ctrls, m_isClosed);
+}
+
+rcp<Path> pentrek::path_from_ctrlpoints(Span<const CtrlPoint> ctrls, bool doClose) {
+    PathBuilder builder;
+    path_add_ctrlpoints(&builder, ctrls, doClose);
+    return builder.detach();
+}
+
+//////////////////////////////////
+
+MikeMullSpline::MikeMullSpline(const MikeMull& params, Span<const Point> pts)
+    : m_params(params)
+{
+    this->setPoints(pts);
+}
+
+void MikeMullSpline::setPoints(Span<const Point> pts) {
+    m_points.assign(pts.begin(), pts.end());
+    m_ctrls = m_params.ctrlPoints(m_points);
+    m_builder.m_points.clear();
+    m_builder.m_verbs.clear();
+    path_add_ctrlpoints(&m_builder, m_ctrls, m_params.m_isClosed);
+}
+
+// Same as MikeMull::ctrlPoints(), for just one point
+CtrlPoint MikeMullSpline::computeCtrl(size_t i) const {
+    const size_t n = m_points.size();
+    const bool closed = m_params.m_isClosed;
+    const Point curr = m_points[i];
+    const Point prev = i > 0 ? m_points[i - 1] : (closed ? m_points[n - 1] : curr);
+    const Point next = i + 1 < n ? m_points[i + 1] : (closed ? m_points[0] : curr);
+    return m_params.ctrlPoint(prev, curr, next);
+}
+
+// Writes m_ctrls[i] into the path's points (see path_add_ctrlpoints for the layout).
+// Each write goes through [], so only the points we touch are checked against
+// what a path() snapshot can see.
+void MikeMullSpline::patch(size_t i) {
+    const size_t n = m_ctrls.size();
+    const bool wraps = m_params.m_isClosed && n > 1;
+    const CtrlPoint& c = m_ctrls[i];
+    auto& pts = m_builder.m_points;
+
+    pts[3*i] = c.curr;
+    if (i > 0) {
+        pts[3*i - 1] = c.prev;
+    } else if (wraps) {
+        pts[3*n - 1] = c.prev;
+        pts[3*n] = c.curr;
+    }
+    if (i + 1 < n || wraps) {
+        pts[3*i + 1] = c.next;
+    }
+}
+
+void MikeMullSpline::setPoint(size_t index, Point p) {
+    const size_t n = m_points.size();
+    assert(index < n);
+    m_points[index] = p;
+
+    // index and its neighbors (which may wrap around, or not exist)
+    for (int delta = -1; delta <= 1; ++delta) {
+        size_t i = index + delta;
+        if (delta < 0 && index == 0) {
+            if (!m_params.m_isClosed) {
+                continue;
+            }
+            i = n - 1;
+        } else if (i == n) {
+            if (!m_params.m_isClosed) {
+                continue;
+            }
+            i = 0;
+        }
+        m_ctrls[i] = this->computeCtrl(i);
+        this->patch(i);
+    }
+}
+
+//////////////////////////////////
+
+#include "include/random.h"
+
+void MikeMullSpline::Tests() {
+#ifdef DEBUG
+    auto same = [](const Path& a, const Path& b) {
+        return a.verbs().size() == b.verbs().size() &&
+               a.points().size() == b.points().size() &&
+               std::equal(a.verbs().begin(), a.verbs().end(), b.verbs().begin()) &&
+               std::memcmp(a.points().data(), b.points().data(), a.points().size_bytes()) == 0;
+    };
+
+    // 4 points on a circle make (nearly) a circle
+    {
+        const Point pts[] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+        MikeMull mm;
+        mm.m_isClosed = true;
+        const auto path = mm.path(pts);
+        assert(path->verbs().size() == 6);     // move, 4 cubics, close
+        path->visit([](const Point*) {}, [](const Point*) {}, [](const Point*) {},
+                    [](const Point* p) {
+                        const Point mid = CubicCoeff::Compute(p - 1).eval(0.5f);
+                        assert(nearly_eq(mid.length(), 1, 1.0f / 1024));
+                    },
+                    [](Point, Point) {});
+    }
+
+    // an open curve starts and ends at its points, heading toward its neighbors
+    {
+        const Point pts[] = {{0, 0}, {10, 0}, {10, 10}};
+        MikeMull mm;
+        mm.m_useC2 = false;
+        mm.m_maxTanLength = 2;
+        const auto ctrls = mm.ctrlPoints(pts);
+        assert(ctrls.size() == 3);
+        assert(ctrls[0].curr == pts[0] && ctrls[2].curr == pts[2]);
+        assert(ctrls[0].next.y == 0 && ctrls[0].next.x > 0);
+        assert(ctrls[2].prev.x == 10 && ctrls[2].prev.y < 10);
+        for (const auto& c : ctrls) {
+            assert((c.next - c.curr).length() <= 2 + 1.0f / 1024);
+            assert((c.curr - c.prev).length() <= 2 + 1.0f / 1024);
+        }
+        assert(mm.path(pts)->verbs().size() == 3);
+        assert(mm.path({})->verbs().size() == 0);
+        assert(mm.path({pts[0]})->verbs().size() == 1);
+    }
+
+    // editing points one at a time gives the same path as building from scratch
+    Random rand;
+    for (bool closed : {false, true}) {
+        for (bool c2 : {false, true}) {
+            for (size_t n : {(size_t)1, (size_t)2, (size_t)3, (size_t)50}) {
+                MikeMull mm;
+                mm.m_isClosed = closed;
+                mm.m_useC2 = c2;
+                mm.m_maxTanLength = 30;
+
+                std::vector<Point> pts(n);
+                for (auto& p : pts) {
+                    p = {rand.nextSF() * 100, rand.nextSF() * 100};
+                }
+                MikeMullSpline spline(mm, pts);
+                assert(same(*spline.path(), *mm.path(pts)));
+
+                for (int i = 0; i < 100; ++i) {
+                    const size_t index = rand.nextU() % n;
+                    pts[index] = {rand.nextSF() * 100, rand.nextSF() * 100};
+                    spline.setPoint(index, pts[index]);
+                }
+                assert(same(*spline.path(), *mm.path(pts)));
+
+                // Editing doesn't copy the points once the last path() is gone.
+                // While one is held, the first edit copies them (leaving that
+                // path as it was), but the edits after it don't.
+                const Point* addr = spline.builder().m_points.data();
+                spline.setPoint(0, pts[0]);
+                assert(spline.builder().m_points.data() == addr);
+                const auto held = spline.path();
+                spline.setPoint(0, pts[0] + Vector{1, 1});
+                addr = spline.builder().m_points.data();
+                assert(addr != held->points().data());
+                assert(held->points()[0] == pts[0]);
+                spline.setPoint(0, pts[0]);
+                assert(spline.builder().m_points.data() == addr);
+
+                const auto ctrls = mm.ctrlPoints(pts);
+                assert(std::memcmp(ctrls.data(), spline.ctrlPoints().data(),
+                                   n * sizeof(CtrlPoint)) == 0);
+            }
+        }
+    }
+#endif
+}
@@ -0,0 +1,422 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#include "include/morph.h"
+#include "include/curve_kernels.h"
+#include "include/path_builder.h"
+#include <algorithm>
+
+using namespace pentrek;
+
+namespace {
+
+// A contour as a run of cubics: 3n+1 points for n cubics. If it is closed, the
+// last point is the same as the first.
+struct Contour {
+    std::vector<Point> m_pts;
+    bool  m_closed = false;
+    float m_area = 0;           // signed (so its sign is the direction)
+    Point m_center = {0, 0};    // the centroid of its area (or of its points)
+
+    size_t count() const { return (m_pts.size() - 1) / 3; }
+
+    void reverse() {
+        std::reverse(m_pts.begin(), m_pts.end());
+        m_area = -m_area;
+    }
+};
+
+} // namespace
+
+static std::vector<Contour> cubic_contours(const Path& path) {
+    std::vector<Contour> contours;
+    Point start = {0, 0};
+
+    auto add = [&](Point p1, Point p2, Point p3) {
+        if (contours.back().m_closed) {
+            // it goes on without a move, so from the start of the last one
+            contours.push_back({{start}});
+        }
+        auto& pts = contours.back().m_pts;
+        pts.push_back(p1);
+        pts.push_back(p2);
+        pts.push_back(p3);
+    };
+    auto add_line = [&](Point p) {
+        const Point p0 = contours.back().m_closed ? start : contours.back().m_pts.back();
+        add(lerp(p0, p, 1/3.0f), lerp(p0, p, 2/3.0f), p);
+    };
+
+    path.visit([&](const Point* p) {
+                   start = p[0];
+                   contours.push_back({{start}});
+               },
+               [&](const Point* p) { add_line(p[0]); },
+               [&](const Point* p) {
+                   const Point p0 = contours.back().m_closed ? start : contours.back().m_pts.back();
+                   add(lerp(p0, p[0], 2/3.0f), lerp(p[1], p[0], 2/3.0f), p[1]);
+               },
+               [&](const Point* p) { add(p[0], p[1], p[2]); },
+               [&](Point, Point first) {
+                   if (!contours.back().m_closed) {
+                       if (contours.back().m_pts.back() != first) {
+                           add_line(first);
+                       }
+                       contours.back().m_closed = true;
+                   }
+               });
+
+    // a move on its own (or a move and a close) has nothing to morph
+    contours.erase(std::remove_if(contours.begin(), contours.end(),
+                                  [](const Contour& c) { return c.count() == 0; }),
+                   contours.end());
+    return contours;
+}
+
+// Measures a polygon through points along the cubics (4 per cubic, which is
+// plenty for pairing contours up).
+static void compute_area_center(Contour* c) {
+    std::vector<Point> poly;
+    for (size_t i = 0; i < c->count(); ++i) {
+        const auto cc = CubicCoeff::Compute(&c->m_pts[i * 3]);
+        for (int k = 0; k < 4; ++k) {
+            poly.push_back(cc.eval(k * 0.25f));
+        }
+    }
+
+    double area = 0, cx = 0, cy = 0, mx = 0, my = 0;
+    for (size_t i = 0; i < poly.size(); ++i) {
+        const Point p = poly[i],
+                    q = poly[(i + 1) % poly.size()];
+        const double cross = (double)p.x * q.y - (double)q.x * p.y;
+        area += cross;
+        cx += (p.x + q.x) * cross;
+        cy += (p.y + q.y) * cross;
+        mx += p.x;
+        my += p.y;
+    }
+    c->m_area = (float)(area * 0.5);
+
+    const Rect r = Rect::Bounds(poly);
+    if (std::abs(area) > 1e-6 * (r.width() * r.width() + r.height() * r.height())) {
+        c->m_center = {(float)(cx / (3 * area)), (float)(cy / (3 * area))};
+    } else {
+        // no area to speak of (e.g. a line), so just average the points
+        c->m_center = {(float)(mx / poly.size()), (float)(my / poly.size())};
+    }
+}
+
+// Splits c's cubics until it has count of them. Each split goes to whichever
+// cubic (counting the pieces it is already split into) is longest, and each
+// cubic is then chopped at evenly spaced t values.
+static void split_to(Contour* c, size_t count) {
+    const size_t n = c->count();
+    if (n >= count) {
+        return;
+    }
+    const Point* pts = c->m_pts.data();
+
+    std::vector<float> lengths(n);
+    std::vector<size_t> pieces(n, 1);
+    for (size_t i = 0; i < n; ++i) {
+        const Point* p = &pts[i * 3];
+        // halfway between the chord and the hull, which is close enough here
+        lengths[i] = ((p[3] - p[0]).length() +
+                      (p[1] - p[0]).length() + (p[2] - p[1]).length() + (p[3] - p[2]).length()) * 0.5f;
+    }
+    for (size_t extra = count - n; extra > 0; --extra) {
+        size_t best = 0;
+        for (size_t i = 1; i < n; ++i) {
+            if (lengths[i] * pieces[best] > lengths[best] * pieces[i]) {
+                best = i;
+            }
+        }
+        pieces[best] += 1;
+    }
+
+    const auto& kernels = CurveKernels::Get();
+    std::vector<Point> dst = {pts[0]};
+    std::vector<float> ts;
+    std::vector<Point> chopped;
+    for (size_t i = 0; i < n; ++i) {
+        const size_t k = pieces[i];
+        ts.resize(k - 1);
+        for (size_t j = 1; j < k; ++j) {
+            ts[j - 1] = (float)j / k;
+        }
+        chopped.resize(3 * k + 1);
+        kernels.m_cubicChop(chopped.data(), &pts[i * 3], ts.data(), k - 1);
+        chopped.back() = pts[i * 3 + 3];    // so it ends exactly where it did
+        dst.insert(dst.end(), chopped.begin() + 1, chopped.end());
+    }
+    c->m_pts = std::move(dst);
+    assert(c->count() == count);
+}
+
+// The sum of the squared distances between corresponding points (relative to
+// their centers), with b's points starting at offset.
+static float travel(const Contour& a, const Contour& b, size_t offset, size_t n) {
+    float sum = 0;
+    for (size_t k = 0; k < n; ++k) {
+        const Point da = a.m_pts[k] - a.m_center,
+                    db = b.m_pts[(k + offset) % n] - b.m_center;
+        sum += (da - db).lengthSquared();
+    }
+    return sum;
+}
+
+// Rotates (closed) or reverses (open) b so that its points travel the least to a's
+static void align_start(const Contour& a, Contour* b) {
+    assert(a.m_pts.size() == b->m_pts.size());
+    const size_t n = a.m_pts.size();
+
+    if (a.m_closed && b->m_closed) {
+        // the last point is the first again, so there are n - 1 to rotate through
+        size_t best = 0;
+        float bestTravel = travel(a, *b, 0, n - 1);
+        for (size_t offset = 3; offset < n - 1; offset += 3) {
+            const float t = travel(a, *b, offset, n - 1);
+            if (t < bestTravel) {
+                bestTravel = t;
+                best = offset;
+            }
+        }
+        if (best) {
+            auto& pts = b->m_pts;
+            pts.pop_back();
+            std::rotate(pts.begin(), pts.begin() + best, pts.end());
+            pts.push_back(pts[0]);
+        }
+    } else if (!a.m_closed && !b->m_closed) {
+        const float forward = travel(a, *b, 0, n);
+        b->reverse();
+        if (travel(a, *b, 0, n) >= forward) {
+            b->reverse();
+        }
+    }
+}
+
+// Pairs up a's and b's contours, cheapest first (by how far apart their centers
+// are, and how different their areas, each relative to the shapes' size).
+// Returns the pairs in a's order, then any of b's left over. -1 means no partner.
+static std::vector<std::pair<int, int>> pair_contours(const std::vector<Contour>& a,
+                                                      const std::vector<Contour>& b,
+                                                      const Rect& bounds) {
+    const float diagonal = std::max(std::sqrt(bounds.width() * bounds.width() +
+                                              bounds.height() * bounds.height()), 1e-6f);
+    float maxArea = 1e-6f;
+    for (const auto* list : {&a, &b}) {
+        for (const auto& c : *list) {
+            maxArea = std::max(maxArea, std::abs(c.m_area));
+        }
+    }
+
+    struct Candidate {
+        float cost;
+        int   ia, ib;
+    };
+    std::vector<Candidate> candidates;
+    for (size_t i = 0; i < a.size(); ++i) {
+        for (size_t j = 0; j < b.size(); ++j) {
+            const float cost = (a[i].m_center - b[j].m_center).length() / diagonal +
+                               std::abs(std::abs(a[i].m_area) - std::abs(b[j].m_area)) / maxArea;
+            candidates.push_back({cost, (int)i, (int)j});
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Candidate& x, const Candidate& y) { return x.cost < y.cost; });
+
+    std::vector<int> partnerOfA(a.size(), -1);
+    std::vector<bool> bTaken(b.size(), false);
+    for (const auto& c : candidates) {
+        if (partnerOfA[c.ia] < 0 && !bTaken[c.ib]) {
+            partnerOfA[c.ia] = c.ib;
+            bTaken[c.ib] = true;
+        }
+    }
+
+    std::vector<std::pair<int, int>> pairs;
+    for (size_t i = 0; i < a.size(); ++i) {
+        pairs.push_back({(int)i, partnerOfA[i]});
+    }
+    for (size_t j = 0; j < b.size(); ++j) {
+        if (!bTaken[j]) {
+            pairs.push_back({-1, (int)j});
+        }
+    }
+    return pairs;
+}
+
+// A stand-in for a contour with no partner: all of its points at c's center
+static Contour point_contour(const Contour& c) {
+    Contour dst;
+    dst.m_pts.assign(c.m_pts.size(), c.m_center);
+    dst.m_closed = c.m_closed;
+    dst.m_center = c.m_center;
+    return dst;
+}
+
+static void add_contour(PathBuilder* dst, const Contour& c, bool close) {
+    dst->incReserve(c.m_pts.size(), c.count() + 2);
+    dst->move(c.m_pts[0]);
+    for (size_t i = 0; i < c.count(); ++i) {
+        dst->cubic(&c.m_pts[i * 3 + 1]);
+    }
+    if (close) {
+        dst->close();
+    }
+}
+
+MorphPair::MorphPair(const Path& a, const Path& b) {
+    auto contoursA = cubic_contours(a);
+    auto contoursB = cubic_contours(b);
+    for (auto* list : {&contoursA, &contoursB}) {
+        for (auto& c : *list) {
+            compute_area_center(&c);
+        }
+    }
+
+    PathBuilder builderA, builderB;
+    builderA.m_fillType = a.fillType();
+    builderB.m_fillType = b.fillType();
+
+    const Rect bounds = a.bounds().join(b.bounds());
+    for (auto [ia, ib] : pair_contours(contoursA, contoursB, bounds)) {
+        Contour ca = ia >= 0 ? contoursA[ia] : point_contour(contoursB[ib]);
+        Contour cb = ib >= 0 ? contoursB[ib] : point_contour(ca);
+
+        if (ia >= 0 && ib >= 0) {
+            if (ca.m_closed && cb.m_closed && ca.m_area * cb.m_area < 0) {
+                cb.reverse();
+            }
+            const size_t count = std::max(ca.count(), cb.count());
+            split_to(&ca, count);
+            split_to(&cb, count);
+            align_start(ca, &cb);
+        }
+        if (ia < 0) {
+            // now that cb is settled, its stand-in needs the same number of points
+            ca = point_contour(cb);
+        }
+
+        // If only one is closed, its closing segment is already a cubic, so it
+        // still looks the same without the close.
+        const bool close = ca.m_closed && cb.m_closed;
+        add_contour(&builderA, ca, close);
+        add_contour(&builderB, cb, close);
+    }
+
+    m_a = builderA.detach();
+    m_b = builderB.detach();
+    assert(m_a->verbs() == m_b->verbs());
+    assert(m_a->points().size() == m_b->points().size());
+}
+
+//////////////////////////////////
+
+void MorphPair::Tests() {
+#ifdef DEBUG
+    auto nearly_eq_pts = [](Span<const Point> a, Span<const Point> b, float tol) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); ++i) {
+            if ((a[i] - b[i]).length() > tol) {
+                return false;
+            }
+        }
+        return true;
+    };
+    // the same shape (checked by what contains() says over a grid)
+    auto same_fill = [](const Path& a, const Path& b) {
+        const Rect r = a.bounds().join(b.bounds());
+        for (int y = 0; y < 32; ++y) {
+            for (int x = 0; x < 32; ++x) {
+                const Point p = {r.left + r.width() * (x + 0.5f) / 32,
+                                 r.top + r.height() * (y + 0.5f) / 32};
+                if (a.contains(p) != b.contains(p)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+
+    // a triangle (lines) into a circle (cubics)
+    {
+        const Point tri[] = {{0, 0}, {100, 0}, {50, 80}};
+        const auto a = Path::Poly(tri, true);
+        const auto b = Path::Circle({50, 40}, 30);
+        MorphPair morph(*a, *b);
+        assert(morph.a()->verbs().size() == 1 + 4 + 1);
+        assert(same_fill(*a, *morph.a()));
+        assert(same_fill(*b, *morph.b()));
+        assert(*morph.lerp(0) == *morph.a());
+        assert(nearly_eq_pts(morph.lerp(1)->points(), morph.b()->points(), 1e-4f));
+
+        // reusing the last frame's storage
+        auto frame = morph.lerp(0.25f);
+        const Path* addr = frame.get();
+        frame = morph.lerp(std::move(frame), 0.5f);
+        assert(frame.get() == addr);
+    }
+
+    // the same square, but starting at a different corner: the start is
+    // rotated to match, so nothing moves
+    {
+        const Point sq[] = {{0, 0}, {10, 0}, {10, 10}, {0, 10}};
+        const Point rot[] = {sq[2], sq[3], sq[0], sq[1]};
+        MorphPair morph(*Path::Poly(sq, true), *Path::Poly(rot, true));
+        assert(nearly_eq_pts(morph.a()->points(), morph.b()->points(), 1e-4f));
+    }
+
+    // the same circle, going the other way: b is reversed (rather than the
+    // halfway frame collapsing through its center)
+    {
+        const auto a = Path::Circle({0, 0}, 10, PathDirection::cw);
+        const auto b = Path::Circle({0, 0}, 10, PathDirection::ccw);
+        MorphPair morph(*a, *b);
+        assert(morph.lerp(0.5f)->bounds() == a->bounds());
+    }
+
+    // contours are paired by position and size, and one left over grows from a point
+    {
+        PathBuilder builder;
+        builder.addCircle({0, 0}, 10);
+        builder.addCircle({100, 0}, 50);
+        const auto a = builder.detach();
+        const auto b = Path::Circle({110, 0}, 45);
+        MorphPair morph(*a, *b);
+
+        const auto pa = morph.a()->points();
+        const auto pb = morph.b()->points();
+        assert(pa.size() == 2 * 13);
+        // a's first contour (the small circle) has no partner, so it shrinks to its center
+        for (size_t i = 0; i < 13; ++i) {
+            assert((pb[i] - Point{0, 0}).length() < 1e-3f);
+        }
+        // the big one becomes b's circle
+        assert(same_fill(*b, *Path::Make(pb.subspan(13, 13), morph.b()->verbs().subspan(0, 6))));
+    }
+
+    // open contours, and empty paths
+    {
+        PathBuilder builder;
+        builder.addLine({0, 0}, {10, 0});
+        const auto a = builder.detach();
+        builder.addLine({10, 5}, {0, 5});
+        builder.quad({-5, 10}, {0, 15});
+        const auto b = builder.detach();
+        MorphPair morph(*a, *b);
+        assert(morph.a()->verbs().size() == 3);
+        // b was reversed, so its end at {0, 15} lines up with a's start
+        assert(morph.b()->points()[0] == Point({0, 15}));
+
+        MorphPair empty(*Path::Empty(), *Path::Empty());
+        assert(empty.a()->empty() && empty.b()->empty());
+        MorphPair grow(*Path::Empty(), *b);
+        assert(grow.a()->points().size() == grow.b()->points().size());
+    }
+#endif
+}
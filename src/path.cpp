@@ -2,12 +2,18 @@
  *  Copyright Pentrek Inc, 2022
  */
 
+#include "include/float_format.h"
 #include "include/geometry.h"
 #include "include/path_builder.h"
+#include "include/path_interner.h"
+#include "include/point_kernels.h"
 // for utils
 #include "include/data.h"
 #include "include/writer.h"
+#include <atomic>
+#include <new>
 #include <stdio.h>
+#include <string>
 
 namespace pentrek {
 
@@ -58,85 +64,450 @@ Path::Iter::Rec Path::Iter::next() {
 
 //////////////////////////////////////////
 
-Path::Path(Span<const Point> pts, Span<const PathVerb> vbs,
-           PathFillType ft, const pentrek::Rect* bounds)
-    : m_points(pts.begin(), pts.end())
-    , m_verbs( vbs.begin(), vbs.end())
-    , m_bounds(bounds ? *bounds : Rect::Bounds(m_points))
+Path::Path(size_t pointCount, size_t verbCount, PathFillType ft)
+    : m_pointCount(castTo<uint32_t>(pointCount))
+    , m_verbCount(castTo<uint32_t>(verbCount))
     , m_fillType(ft)
+    , m_builderStorage(false)
+    , m_storage(nullptr)
+    , m_lazyFlags(0)
+    , m_hitIndex(nullptr)
 {
+    // our storage follows us (Point is 4-byte aligned, and so are we)
+    static_assert(sizeof(Path) % alignof(Point) == 0, "");
+    m_points = reinterpret_cast<const Point*>(this + 1);
+    m_verbs  = reinterpret_cast<const PathVerb*>(m_points + pointCount);
+}
+
+#ifdef DEBUG
+// So Tests() can check which operations allocate
+static std::atomic<int> gPathAllocCount{0};
+#endif
+
+rcp<Path> Path::Alloc(size_t pointCount, size_t verbCount, PathFillType ft) {
+    DEBUG_CODE(gPathAllocCount += 1;)
+    const size_t size = sizeof(Path) + pointCount * sizeof(Point) + verbCount * sizeof(PathVerb);
+    void* storage = ::operator new(size);
+    return rcp<Path>(new (storage) Path(pointCount, verbCount, ft));
+}
+
+rcp<Path> Path::Make(Span<const Point> pts, Span<const PathVerb> vbs,
+                     PathFillType ft, const pentrek::Rect* bounds) {
 #ifdef DEBUG
     size_t n = count_points(vbs);
     assert(pts.size() == n);
     // todo: check for legal verb sequence
-    
+
     if (bounds) {
-        auto r = Rect::Bounds(m_points);
-        assert(r == m_bounds);
+        auto r = Rect::Bounds(pts);
+        assert(r == *bounds);
     }
 #endif
+
+    auto path = Alloc(pts.size(), vbs.size(), ft);
+    std::copy(pts.begin(), pts.end(), path->writablePoints());
+    std::copy(vbs.begin(), vbs.end(), path->writableVerbs());
+    if (bounds) {
+        path->setBounds(*bounds);
+    }
+    return path;
 }
 
-Path::Path(std::vector<Point>&& pts, std::vector<PathVerb>&& vbs,
-           PathFillType ft, const pentrek::Rect* bounds)
-    : m_points(std::move(pts))
-    , m_verbs( std::move(vbs))
-    , m_bounds(bounds ? *bounds : Rect::Bounds(m_points))
-    , m_fillType(ft)
-{
+rcp<Path> Path::Wrap(rcp<Data> storage, Span<const Point> pts, Span<const PathVerb> vbs,
+                     PathFillType ft, const pentrek::Rect* bounds) {
 #ifdef DEBUG
-    size_t n = count_points(vbs);
-    assert(pts.size() == n);
-    // todo: check for legal verb sequence
-    
+    assert(pts.size() == count_points(vbs));
+    const auto* begin = (const uint8_t*)storage->data();
+    const auto* end = begin + storage->size();
+    assert(pts.empty() || ((const uint8_t*)pts.data() >= begin &&
+                           (const uint8_t*)(pts.data() + pts.size()) <= end));
+    assert(vbs.empty() || ((const uint8_t*)vbs.data() >= begin &&
+                           (const uint8_t*)(vbs.data() + vbs.size()) <= end));
+#endif
+
+    auto path = Alloc(0, 0, ft);
+    path->m_points = pts.data();
+    path->m_verbs = vbs.data();
+    path->m_pointCount = castTo<uint32_t>(pts.size());
+    path->m_verbCount = castTo<uint32_t>(vbs.size());
+    path->m_storage = storage.release();
     if (bounds) {
-        auto r = Rect::Bounds(m_points);
-        assert(r == m_bounds);
+        path->setBounds(*bounds);
     }
-#endif
+    return path;
+}
+
+rcp<Path> Path::WrapBuilderStorage(rcp<Data> storage, Span<const Point> pts,
+                                   Span<const PathVerb> vbs, PathFillType ft) {
+    auto path = Wrap(std::move(storage), pts, vbs, ft);
+    path->m_builderStorage = true;
+    return path;
+}
+
+bool Path::ownsStorage() const {
+    return m_storage == nullptr || (m_builderStorage && m_storage->unique());
+}
+
+Path::~Path() {
+    DeleteHitIndex(m_hitIndex.load(std::memory_order_relaxed));
+    safe_unref(m_storage);
+}
+
+void Path::invalidateCaches() {
+    assert(this->unique());
+    m_lazyFlags.store(0, std::memory_order_relaxed);
+    DeleteHitIndex(m_hitIndex.exchange(nullptr, std::memory_order_relaxed));
+}
+
+void Path::setBounds(const pentrek::Rect& r) {
+    m_bounds = r;
+    m_lazyFlags.fetch_or(kBoundsValid, std::memory_order_release);
+}
+
+void Path::computeBounds() const {
+    m_bounds = Rect::Bounds(this->points());
+    m_lazyFlags.fetch_or(kBoundsValid, std::memory_order_release);
+}
+
+static bool contains_inclusive(const Rect& r, Point p) {
+    return r.left <= p.x && p.x <= r.right && r.top <= p.y && p.y <= r.bottom;
+}
+
+void Path::computeTightBounds() const {
+    // Start with the points that are on the curve (which the tight bounds must
+    // include), and then only look at the curves whose control points are
+    // outside of those bounds.
+
+    auto r = pentrek::Rect::Empty();
+    bool first = true;
+    auto add = [&](Point p) {
+        const pentrek::Rect pr = {p.x, p.y, p.x, p.y};
+        r = first ? pr : r.join(pr);
+        first = false;
+    };
+    auto noop = [](Point, Point) {};
+
+    this->visit([&](const Point* p) { add(p[0]); },
+                [&](const Point* p) { add(p[0]); },
+                [&](const Point* p) { add(p[1]); },
+                [&](const Point* p) { add(p[2]); },
+                noop);
+
+    const pentrek::Rect onCurve = r;
+    this->visit([](const Point*) {},
+                [](const Point*) {},
+                [&](const Point* p) {
+                    if (!contains_inclusive(onCurve, p[0])) {
+                        r = r.join(quad_tight_bounds(p - 1));
+                    }
+                },
+                [&](const Point* p) {
+                    if (!contains_inclusive(onCurve, p[0]) || !contains_inclusive(onCurve, p[1])) {
+                        r = r.join(cubic_tight_bounds(p - 1));
+                    }
+                },
+                noop);
+
+    m_tightBounds = r;
+    m_lazyFlags.fetch_or(kTightBoundsValid, std::memory_order_release);
+}
+
+// -0 and 0 are equal, so they must hash the same
+static uint32_t canonical_bits(float x) {
+    x += 0.0f;
+    uint32_t bits;
+    memcpy(&bits, &x, 4);
+    return bits;
+}
+
+static inline uint64_t hash_step(uint64_t h, uint64_t word) {
+    h = (h ^ word) * 0x9E3779B97F4A7C15ull;
+    return h ^ (h >> 29);
+}
+
+void Path::computeContentHash() const {
+    uint64_t h = hash_step((uint64_t)m_fillType, ((uint64_t)m_pointCount << 32) | m_verbCount);
+    for (auto p : this->points()) {
+        h = hash_step(h, ((uint64_t)canonical_bits(p.x) << 32) | canonical_bits(p.y));
+    }
+
+    const uint8_t* vbs = reinterpret_cast<const uint8_t*>(m_verbs);
+    size_t n = m_verbCount;
+    for (; n >= 8; n -= 8, vbs += 8) {
+        uint64_t word;
+        memcpy(&word, vbs, 8);
+        h = hash_step(h, word);
+    }
+    uint64_t word = 0;
+    memcpy(&word, vbs, n);
+    h = hash_step(h, word);
+
+    // final avalanche (from murmur3)
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+
+    m_contentHash = h;
+    m_lazyFlags.fetch_or(kContentHashValid, std::memory_order_release);
+}
+
+// These are twice the signed area between a segment and the origin (so summing
+// them around a contour, relative to its start, gives twice its area).
+
+static double cross(Point a, Point b) {
+    return (double)a.x * b.y - (double)a.y * b.x;
+}
+
+static double twice_quad_area(Point a, Point b, Point c) {
+    return (2 * cross(a, b) + 2 * cross(b, c) + cross(a, c)) / 3;
+}
+
+static double twice_cubic_area(Point a, Point b, Point c, Point d) {
+    return (6 * cross(a, b) + 3 * cross(a, c) + cross(a, d) +
+            3 * cross(b, c) + 3 * cross(b, d) + 6 * cross(c, d)) / 10;
+}
+
+// v is a closed polygon, with no point repeated (not even the last as the first).
+static bool is_convex(const std::vector<Point>& v, double area) {
+    const size_t n = v.size();
+    if (n < 3 || area == 0) {
+        return false;
+    }
+    double turning = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const Point e0 = v[i] - v[(i + n - 1) % n],
+                    e1 = v[(i + 1) % n] - v[i];
+        const double c = cross(e0, e1),
+                     d = (double)e0.x * e1.x + (double)e0.y * e1.y;
+        if (c * area < 0 || (c == 0 && d < 0)) {
+            return false;   // it turns the other way, or doubles back
+        }
+        turning += std::atan2(c, d);
+    }
+    // once around is 2pi (a star that goes around twice would be 4pi)
+    constexpr double kPI = 3.14159265358979;
+    return std::abs(turning) < 3 * kPI;
+}
+
+static bool is_rect(const std::vector<Point>& v) {
+    if (v.size() != 4) {
+        return false;
+    }
+    // the edges must alternate between horizontal and vertical
+    const bool firstIsHorizontal = v[0].y == v[1].y;
+    for (size_t i = 0; i < 4; ++i) {
+        const Point e = v[(i + 1) % 4] - v[i];
+        const bool horizontal = (i & 1) ? !firstIsHorizontal : firstIsHorizontal;
+        if (horizontal ? (e.y != 0 || e.x == 0) : (e.x != 0 || e.y == 0)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// pts are a move and 4 cubics: are they what oval_points would make?
+static bool is_oval(Span<const Point> pts, PathDirection dir) {
+    assert(pts.size() == 13);
+    const auto r = Rect::Bounds(pts);
+    Point expected[13];
+    oval_points(r, dir, expected);
+    const float tol = (r.width() + r.height()) * 1e-5f;
+    for (size_t i = 0; i < 13; ++i) {
+        if (std::abs(pts[i].x - expected[i].x) > tol || std::abs(pts[i].y - expected[i].y) > tol) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Path::computeInfo() const {
+    PathInfo info = {0, 0, PathInfo::Kind::general, false, true};
+
+    double area = 0;    // twice the area
+    size_t segments = 0,
+           cubics = 0,
+           moves = 0;
+    bool inContour = false,
+         closed = false;
+    Point start = {0, 0};
+    const Point* movePt = nullptr;
+    const Point* contourBegin = nullptr;    // (of the last contour with segments)
+    const Point* contourEnd = nullptr;
+
+    auto segment = [&](const Point* p, int n) {
+        if (!inContour) {
+            inContour = true;
+            info.m_contourCount += 1;
+            contourBegin = movePt;
+        }
+        segments += 1;
+        contourEnd = p + n;
+    };
+    this->visit([&](const Point* p) {
+                    movePt = p;
+                    start = p[0];
+                    moves += 1;
+                    inContour = false;
+                },
+                [&](const Point* p) {
+                    segment(p, 1);
+                    area += cross(p[-1] - start, p[0] - start);
+                },
+                [&](const Point* p) {
+                    segment(p, 2);
+                    info.m_allLines = false;
+                    area += twice_quad_area(p[-1] - start, p[0] - start, p[1] - start);
+                },
+                [&](const Point* p) {
+                    segment(p, 3);
+                    info.m_allLines = false;
+                    cubics += 1;
+                    area += twice_cubic_area(p[-1] - start, p[0] - start,
+                                             p[1] - start, p[2] - start);
+                },
+                [&](Point, Point) { closed = closed || inContour; });
+    info.m_area = (float)(area * 0.5);
+
+    if (segments == 0) {
+        info.m_kind = PathInfo::Kind::empty;
+        info.m_allLines = true;
+    } else if (info.m_contourCount == 1) {
+        const Span<const Point> pts = {contourBegin, (size_t)(contourEnd - contourBegin)};
+
+        // the polygon of its points (and control points), without repeats
+        std::vector<Point> poly;
+        for (Point p : pts) {
+            if (poly.empty() || poly.back() != p) {
+                poly.push_back(p);
+            }
+        }
+        if (poly.size() > 1 && poly.back() == poly.front()) {
+            poly.pop_back();
+        }
+        info.m_isConvex = is_convex(poly, area);
+
+        // the rect and oval kinds promise that bounds() is the shape's, so a
+        // stray move (whose point is in the bounds) rules them out
+        const bool oneMove = moves == 1;
+
+        if (info.m_allLines) {
+            if (segments == 1) {
+                info.m_kind = PathInfo::Kind::line;
+            } else if (oneMove && closed && area != 0 && is_rect(poly)) {
+                info.m_kind = PathInfo::Kind::rect;
+            } else {
+                info.m_kind = PathInfo::Kind::polygon;
+            }
+        } else if (oneMove && closed && segments == 4 && cubics == 4 && area != 0 &&
+                   is_oval(pts, info.direction())) {
+            info.m_kind = PathInfo::Kind::oval;
+        }
+    }
+
+    m_info = info;
+    m_lazyFlags.fetch_or(kInfoValid, std::memory_order_release);
+}
+
+void Path::setInfo(const PathInfo& info) {
+    m_info = info;
+    m_lazyFlags.fetch_or(kInfoValid, std::memory_order_release);
 }
 
 bool Path::operator==(const Path& o) const {
-    return this->fillType() == o.fillType()
-        && this->bounds() == o.bounds()
-        && this->points() == o.points()
+    if (this == &o) {
+        return true;
+    }
+    if (m_fillType != o.m_fillType
+            || m_pointCount != o.m_pointCount
+            || m_verbCount != o.m_verbCount) {
+        return false;
+    }
+    // If we've both already computed our hashes, we can quickly see if we differ.
+    // (the bounds are computed from the points, so we needn't compare them)
+    const auto both = m_lazyFlags.load(std::memory_order_acquire)
+                    & o.m_lazyFlags.load(std::memory_order_acquire);
+    if ((both & kContentHashValid) && m_contentHash != o.m_contentHash) {
+        return false;
+    }
+    return this->points() == o.points()
         && this->verbs() == o.verbs();
 }
 
 std::vector<Point> Path::copyPoints() const {
-    return std::vector<Point>(m_points.begin(), m_points.end());
+    auto pts = this->points();
+    return std::vector<Point>(pts.begin(), pts.end());
 }
 
 std::vector<PathVerb> Path::copyVerbs() const {
-    return std::vector<PathVerb>(m_verbs.begin(), m_verbs.end());
+    auto vbs = this->verbs();
+    return std::vector<PathVerb>(vbs.begin(), vbs.end());
 }
 
 rcp<Path> Path::transform(const Matrix& mx) const {
-    auto pts = this->copyPoints();
-    auto vbs = this->copyVerbs();
-    if (!mx.isIdentity()) {
-        mx.map(pts);
+    auto path = Alloc(m_pointCount, m_verbCount, m_fillType);
+    mx.map({path->writablePoints(), m_pointCount}, this->points());
+    std::copy(m_verbs, m_verbs + m_verbCount, path->writableVerbs());
+    return path;
+}
+
+rcp<Path> Path::Transform(rcp<Path>&& src, const Matrix& mx) {
+    rcp<Path> path = std::move(src);
+    if (mx.isIdentity()) {
+        return path;
+    }
+    if (!path->unique() || !path->ownsStorage()) {
+        return path->transform(mx);
     }
-    return make_rcp<Path>(std::move(pts), std::move(vbs), this->fillType());
+
+    mx.map({path->writablePoints(), path->m_pointCount});
+    path->invalidateCaches();
+    path->newUniqueID();
+    return path;
 }
 
 //////////////////////////////////////////
 
 rcp<Path> Path::Empty() {
-    static auto gIdentity = rcp<Path>(new Path);
-    return gIdentity;
+    static auto gEmpty = Alloc(0, 0, kDefFillType);
+    return gEmpty;
 }
 
+// Rect and Oval are common, so we build them directly (w/o a PathBuilder)
+
 rcp<Path> Path::Rect(const pentrek::Rect& r, PathDirection dir) {
-    PathBuilder p;
-    p.addRect(r, dir);
-    return p.detach();
+    Point pts[4];
+    rect_points(r, dir, pts);
+    constexpr PathVerb vbs[] = {
+        PathVerb::move, PathVerb::line, PathVerb::line, PathVerb::line, PathVerb::close,
+    };
+    auto path = Make(pts, vbs, kDefFillType);
+    if (r.width() > 0 && r.height() > 0) {
+        const float area = r.width() * r.height();
+        path->setInfo({dir == PathDirection::cw ? area : -area, 1, PathInfo::Kind::rect, true, true});
+    }
+    return path;
 }
 
 rcp<Path> Path::Oval(const pentrek::Rect& r, PathDirection dir) {
-    PathBuilder p;
-    p.addOval(r, dir);
-    return p.detach();
+    Point pts[13];
+    oval_points(r, dir, pts);
+    constexpr PathVerb vbs[] = {
+        PathVerb::move,
+        PathVerb::cubic, PathVerb::cubic, PathVerb::cubic, PathVerb::cubic,
+        PathVerb::close,
+    };
+    auto path = Make(pts, vbs, kDefFillType);
+    if (r.width() > 0 && r.height() > 0) {
+        double area = 0;
+        for (int i = 0; i < 12; i += 3) {
+            area += twice_cubic_area(pts[i] - pts[0], pts[i+1] - pts[0],
+                                     pts[i+2] - pts[0], pts[i+3] - pts[0]);
+        }
+        path->setInfo({(float)(area * 0.5), 1, PathInfo::Kind::oval, true, false});
+    }
+    return path;
 }
 
 rcp<Path> Path::Circle(Point center, float radius, PathDirection dir) {
@@ -151,30 +522,59 @@ rcp<Path> Path::Poly(Span<const Point> pts, bool doClose) {
     return p.detach();
 }
 
+// Can dst's storage be overwritten with a lerp of src (and no one else see it)?
+static bool can_reuse_for(const Path* dst, const Path& src) {
+    return dst
+        && dst->unique()
+        && dst->ownsStorage()
+        && dst->fillType() == src.fillType()
+        && dst->points().size() == src.points().size()
+        && dst->verbs().size() == src.verbs().size();
+}
+
 rcp<Path> Path::Lerp(const Path* a, const Path* b, float t) {
-    assert(a->m_points.size() == b->m_points.size());
-    assert(a->m_verbs.size() == b->m_verbs.size());
-    const size_t n = a->m_points.size();
+    return Lerp(nullptr, *a, *b, t);
+}
+
+rcp<Path> Path::Lerp(rcp<Path>&& dst, const Path& a, const Path& b, float t) {
+    assert(a.m_pointCount == b.m_pointCount);
+    assert(a.m_verbCount == b.m_verbCount);
+    const size_t n = a.m_pointCount;
+
+    rcp<Path> path = std::move(dst);
+    if (can_reuse_for(path.get(), a)) {
+        path->invalidateCaches();
+        path->newUniqueID();
+    } else {
+        path = Alloc(n, a.m_verbCount, a.fillType());
+    }
 
     // If a and b have different verbs, we don't really notice,
     // we just copy over the verbs from a
 
-    std::vector<Point> pts(a->m_points.size());
-    std::vector<PathVerb> vbs = a->m_verbs;
+    if (path->m_verbs != a.m_verbs) {
+        std::copy(a.m_verbs, a.m_verbs + a.m_verbCount, path->writableVerbs());
+    }
+    if (n > 0) {
+        PointKernels::Get().m_lerp(path->writablePoints(), a.m_points, b.m_points, n, t);
+    }
+    return path;
+}
 
-    if (false) {
-        for (size_t i = 0; i < n; ++i) {
-            pts[i] = lerp_unbounded(a->m_points[i], b->m_points[i], t);
-        }
-    } else {
-        const Point* pa = a->m_points.data();
-        const Point* pb = b->m_points.data();
-        Point* pc = pts.data();
-        for (size_t i = 0; i < n; ++i) {
-            pc[i] = lerp_unbounded(pa[i], pb[i], t);
-        }
+void Path::Lerp(Span<rcp<Path>> dst, Span<const Path* const> a,
+                Span<const Path* const> b, float t) {
+    assert(dst.size() == a.size());
+    assert(dst.size() == b.size());
+    for (size_t i = 0; i < dst.size(); ++i) {
+        dst[i] = Lerp(std::move(dst[i]), *a[i], *b[i], t);
+    }
+}
+
+void Path::Lerp(Span<rcp<Path>> dst, const Path& a, const Path& b, Span<const float> t) {
+    assert(dst.size() == t.size());
+    for (size_t i = 0; i < dst.size(); ++i) {
+        dst[i] = Lerp(std::move(dst[i]), a, b, t[i]);
     }
-    return make_rcp<Path>(std::move(pts), std::move(vbs), a->fillType());
 }
 
 // Utilities
@@ -198,34 +598,6 @@ void Path::dump() const {
     }
 }
 
-void Path::writeSVGString(Writer* w) const {
-    Iter iter(*this);
-    while (const auto r = iter.next()) {
-        switch (r.vrb) {
-            case PathVerb::move: w->writef("M%g,%g", r.pts[0].x, r.pts[0].y); break;
-            case PathVerb::line: w->writef("L%g,%g", r.pts[1].x, r.pts[1].y); break;
-            case PathVerb::quad:
-                w->writef("Q%g,%g %g,%g",
-                          r.pts[1].x, r.pts[1].y,
-                          r.pts[2].x, r.pts[2].y);
-                break;
-            case PathVerb::cubic:
-                w->writef("C%g,%g %g,%g %g,%g",
-                          r.pts[1].x, r.pts[1].y,
-                          r.pts[2].x, r.pts[2].y,
-                          r.pts[3].x, r.pts[3].y);
-                break;
-            case PathVerb::close: w->write("Z"); break;
-        }
-    }
-}
-
-rcp<Data> Path::asSVGData() const {
-    MemoryWriter w;
-    this->writeSVGString(&w);
-    return w.detach();
-}
-
 
 std::pair<int, int> count_contour_pts_vbs(Span<const Point> pts, Span<const PathVerb> vbs) {
     if (vbs.size() == 0) {
@@ -267,7 +639,68 @@ void Path::Tests() {
     assert(*p0 == *p1);
     
     assert(p0->bounds() == r);
-    
+
+    // snapshots share the builder's storage, and are not disturbed by what it does next
+    {
+        PathBuilder pb;
+        pb.incReserve(100, 100);
+        pb.move({0, 0});
+        pb.line({1, 1});
+        const auto s0 = pb.snapshot();
+        pb.line({2, 2});
+        const auto s1 = pb.snapshot();
+        assert(s1->points().data() == s0->points().data());
+        assert(s0->points().size() == 2 && s1->points().size() == 3);
+        assert(!s1->ownsStorage());
+
+        // reading, and adding (or changing) what the snapshots can't see, stays put
+        const Point more[] = {{3, 3}, {4, 4}};
+        pb.addPath(Path::Poly(more, false), Matrix::Trans(1, 0));
+        float sum = 0;
+        for (Point p : pb.m_points) {
+            sum += p.x;
+        }
+        assert(sum == 12 && Rect::Bounds(pb.m_points).right == 5);
+        pb.m_points[4] = {5, 5};
+        assert(std::as_const(pb).m_points.data() == s1->points().data());
+
+        pb.m_points[0] = {9, 9};    // s0 and s1 can see this one, so pb moves
+        assert(pb.m_points.data() != s1->points().data());
+        assert(s0->points()[0] == Point({0, 0}) && s1->points()[0] == Point({0, 0}));
+
+        const auto s2 = pb.snapshot();
+        pb.m_points.clear();
+        pb.m_verbs.clear();
+        pb.move({5, 5});
+        assert(s2->points()[0] == Point({9, 9}) && s2->points().size() == 5);
+
+        // growing moves pb too, while the snapshots keep the old storage
+        for (int i = 0; i < 200; ++i) {
+            pb.line({(float)i, 0});
+        }
+        assert(s2->points().back() == Point({5, 5}));
+
+        // with no snapshots of its block, the builder copies into a path of
+        // its own (one allocation), and keeps its storage for reuse
+        const Point* addr = pb.m_points.data();
+        const size_t capacity = pb.m_points.capacity();
+        auto d = pb.detach();
+        assert(d->points().data() != addr);
+        assert(pb.empty() && pb.m_points.capacity() == capacity);
+        assert(d->ownsStorage());
+        const Path* dAddr = d.get();
+        d = Path::Transform(std::move(d), Matrix::Trans(1, 0));
+        assert(d.get() == dAddr && d->points()[0] == Point({6, 5}));
+
+        // ... but if a snapshot is sharing it, the path takes the block instead
+        pb.move({1, 2});
+        pb.line({3, 4});
+        const auto s3 = pb.snapshot();
+        d = pb.detach();
+        assert(d->points().data() == s3->points().data());
+        assert(pb.empty() && pb.m_points.capacity() == 0);
+    }
+
     {
         constexpr int N = 9;
         Point p[N];
@@ -320,6 +753,343 @@ void Path::Tests() {
         r = iter.next(); assert(!r);
         r = iter.next(); assert(!r);
     }
+
+    // transforming in place vs. copying
+    {
+        const auto mx = Matrix::Trans(10, 20);
+        auto src = Path::Rect({0, 0, 4, 4});
+        const auto expected = src->transform(mx);
+
+        auto shared = src;
+        auto copy = mx * std::move(shared);
+        assert(copy.get() != src.get());
+        assert(*copy == *expected);
+        assert(src->bounds() == Rect::LTRB(0, 0, 4, 4));
+
+        const Path* ptr = src.get();
+        const auto id = src->uniqueID();
+        auto inplace = mx * std::move(src);
+        assert(inplace.get() == ptr);
+        assert(inplace->uniqueID() != id);
+        assert(*inplace == *expected);
+
+        // views map the points on demand
+        TransformedPathView view(copy, Matrix::Scale(2, 2));
+        PathBuilder pb;
+        pb.addPath(view);
+        assert(pb.bounds() == Rect::LTRB(20, 40, 28, 48));
+        assert(*pb.detach() == *view.copyPath());
+    }
+
+    // tight bounds
+    {
+        PathBuilder pb;
+        pb.move(0, 0);
+        pb.quad({10, 20}, {20, 0});
+        auto quad = pb.detach();
+        assert(quad->bounds() == Rect::LTRB(0, 0, 20, 20));
+        assert(quad->tightBounds() == Rect::LTRB(0, 0, 20, 10));
+
+        pb.move(0, 0);
+        pb.cubic({0, 30}, {30, 30}, {30, 0});
+        pb.move(-5, 0);
+        pb.line(0, 5);
+        auto cubic = pb.detach();
+        assert(cubic->bounds() == Rect::LTRB(-5, 0, 30, 30));
+        assert(cubic->tightBounds() == Rect::LTRB(-5, 0, 30, 22.5f));
+
+        // the control points of a circle are on its bounds
+        auto circle = Path::Circle({0, 0}, 10);
+        assert(circle->tightBounds() == circle->bounds());
+
+        assert(Path::Empty()->tightBounds() == Rect::Empty());
+
+        // changing a path in place recomputes its bounds
+        auto moved = Path::Transform(std::move(quad), Matrix::Trans(1, 2));
+        assert(moved->bounds() == Rect::LTRB(1, 2, 21, 22));
+        assert(moved->tightBounds() == Rect::LTRB(1, 2, 21, 12));
+    }
+
+    // hit testing
+    {
+        auto rect = Path::Rect({0, 0, 10, 10});
+        assert(rect->contains({5, 5}));
+        assert(!rect->contains({15, 5}));
+        assert(!rect->hitTest({12, 5}, 1));
+        assert(rect->hitTest({12, 5}, 2.5f));
+        assert(rect->hitTest(IRect{2, 2, 4, 4}));
+        assert(rect->hitTest(IRect{-5, -5, 20, 20}));
+        assert(!rect->hitTest(IRect{11, 0, 20, 10}));
+
+        auto circle = Path::Circle({0, 0}, 10);
+        assert(circle->contains({0, 0}));
+        assert(circle->contains({7, 7}));       // 9.9 from the center
+        assert(!circle->contains({7.2f, 7.2f}));  // 10.2 from the center
+
+        // a monotonic cubic with a control point past its end point in X,
+        // which crosses y = 100 at x = 70.37
+        PathBuilder sb;
+        sb.move({0, 0});
+        sb.cubic({120, 100}, {60, 200}, {100, 300});
+        auto s = sb.detach();
+        assert(s->contains({66, 100}) && !s->contains({74, 100}));
+
+        // a donut, with the hole's direction determining the winding fill
+        for (auto dir : {PathDirection::ccw, PathDirection::cw}) {
+            for (auto ft : {PathFillType::winding, PathFillType::evenodd}) {
+                PathBuilder pb;
+                pb.m_fillType = ft;
+                pb.addCircle({0, 0}, 10);
+                pb.addCircle({0, 0}, 5, dir);
+                auto donut = pb.detach();
+                const bool inHole = ft == PathFillType::winding && dir == PathDirection::ccw;
+                assert(donut->contains({0, 0}) == inHole);
+                assert(donut->hitTest(IRect{-2, -2, 2, 2}) == inHole);
+                assert(donut->contains({0, 7}));
+                assert(donut->hitTest(IRect{4, 0, 6, 1}));      // straddles the hole's edge
+            }
+        }
+
+        // enough circles to build the band index, which should match the distances
+        PathBuilder pb;
+        Point centers[8];
+        for (int i = 0; i < 8; ++i) {
+            centers[i] = {i * 25.0f, (i & 1) * 30.0f};
+            pb.addCircle(centers[i], 10);
+        }
+        auto circles = pb.detach();
+        for (float y = -15; y <= 45; y += 1.25f) {
+            for (float x = -15; x <= 195; x += 1.25f) {
+                float d = 1e9f;
+                for (auto c : centers) {
+                    d = std::min(d, (Point{x, y} - c).length());
+                }
+                if (std::abs(d - 10) > 0.05f) {
+                    assert(circles->contains({x, y}) == (d < 10));
+                }
+            }
+        }
+    }
+
+    // content hashing and interning
+    {
+        auto a = Path::Rect({0, 0, 10, 10});
+        auto b = Path::Rect({0, 0, 10, 10});
+        auto c = Path::Rect({0, 0, 10, 11});
+        assert(a->uniqueID() != b->uniqueID());
+        assert(a->contentHash() == b->contentHash());
+        assert(a->contentHash() != c->contentHash());
+        assert(*a == *b);
+        assert(*a != *c);
+
+        const Point p0[] = {{0, 0}, {1, 1}};
+        const Point p1[] = {{-0.0f, 0}, {1, 1}};
+        const PathVerb vbs[] = {PathVerb::move, PathVerb::line};
+        assert(Path::Make(p0, vbs)->contentHash() == Path::Make(p1, vbs)->contentHash());
+        assert(Path::Make(p0, vbs)->contentHash() !=
+               Path::Make(p0, vbs, PathFillType::evenodd)->contentHash());
+
+        PathInterner interner;
+        auto ia = interner.intern(a);
+        auto ib = interner.intern(b);
+        auto ic = interner.intern(c);
+        assert(ia.get() == a.get());
+        assert(ib.get() == a.get());
+        assert(ic.get() == c.get());
+        assert(interner.count() == 2);
+
+        ic = nullptr;
+        c = nullptr;
+        interner.purgeUnused();     // only the interner was holding c
+        assert(interner.count() == 1);
+    }
+
+    // morphing into reused storage
+    {
+        auto a = Path::Rect({0, 0, 10, 10});
+        auto b = Path::Rect({10, 20, 30, 40});
+        const auto mid = Path::Lerp(a.get(), b.get(), 0.5f);
+        assert(mid->bounds() == Rect::LTRB(5, 10, 20, 25));
+
+        // warm up: the first call allocates, the rest must not
+        rcp<Path> frame = Path::Lerp(nullptr, *a, *b, 0);
+        PathBuilder builder;
+        builder.setLerp(*a, *b, 0);
+        rcp<Path> batch[3];
+        const float ts[] = {0, 0.5f, 1};
+        Path::Lerp(batch, *a, *b, ts);
+
+        const int allocs = gPathAllocCount;
+        const Path* frameAddr = frame.get();
+        const Point* builderAddr = builder.m_points.data();
+        const Path* batchAddr = batch[1].get();
+        for (int i = 0; i <= 10; ++i) {
+            const float t = i / 10.0f;
+            const auto id = frame->uniqueID();
+            frame = Path::Lerp(std::move(frame), *a, *b, t);
+            assert(frame->uniqueID() != id);
+            builder.setLerp(*a, *b, t);
+            Path::Lerp(batch, *a, *b, ts);
+        }
+        assert(gPathAllocCount == allocs);
+        assert(frame.get() == frameAddr);
+        assert(builder.m_points.data() == builderAddr);
+        assert(batch[1].get() == batchAddr);
+        assert(*frame == *b);
+        assert(*batch[1] == *mid);
+
+        // shared results are not overwritten
+        auto shared = frame;
+        frame = Path::Lerp(std::move(frame), *a, *b, 0.5f);
+        assert(frame.get() != shared.get());
+        assert(*shared == *b);
+        assert(*frame == *mid);
+        assert(gPathAllocCount == allocs + 1);
+
+        // N pairs, one t
+        const Path* as[] = {a.get(), b.get()};
+        const Path* bs[] = {b.get(), a.get()};
+        rcp<Path> pairs[2];
+        Path::Lerp(pairs, as, bs, 0.5f);
+        assert(*pairs[0] == *mid);
+        assert(*pairs[1] == *mid);
+    }
+
+    // SVG
+    {
+        PathBuilder b;
+        b.move(1, 2);
+        b.line(3.5f, -4);
+        b.quad(0.1f, 0, 10, 20);
+        b.cubic(1, 1, 2, 2, 3, 3);
+        b.close();
+        b.move(100, 100);
+        b.line(101, 100);
+        const auto p = b.detach();
+        auto svg = [](const Path& path, const SVGPathOptions& opts) {
+            auto data = path.asSVGData(opts);
+            return std::string((const char*)data->data(), data->size());
+        };
+
+        SVGPathOptions opts;
+        assert(svg(*p, opts) == "M1,2L3.5,-4Q0.1,0 10,20C1,1 2,2 3,3ZM100,100L101,100");
+        opts.m_decimals = 0;
+        assert(svg(*p, opts) == "M1,2L4,-4Q0,0 10,20C1,1 2,2 3,3ZM100,100L101,100");
+        opts = {};
+        opts.m_relative = true;
+        assert(svg(*p, opts) == "m1,2l2.5,-6q-3.4,4 6.5,24c-9,-19 -8,-18 -7,-17zm99,98l1,0");
+        assert(svg(*Path::Empty(), opts).empty());
+
+        // relative deltas are from the rounded positions, so they don't drift
+        b.move(0, 0);
+        for (int i = 1; i <= 3; ++i) {
+            b.line(i * 0.4f, 0);
+        }
+        opts.m_decimals = 0;
+        assert(svg(*b.detach(), opts) == "m0,0l0,0l1,0l0,0");
+
+        // longer than the emitter's buffer
+        std::string expected;
+        char num[kMaxFloatChars];
+        b.move(0, 0);
+        expected += "M0,0";
+        for (int i = 1; i < 2000; ++i) {
+            const float x = i / 3.0f;
+            b.line(x, -x);
+            expected += "L";
+            expected.append(num, float_to_chars(x, num));
+            expected += ",";
+            expected.append(num, float_to_chars(-x, num));
+        }
+        assert(svg(*b.detach(), {}) == expected);
+    }
+
+    // info
+    {
+        using Kind = PathInfo::Kind;
+        // the same points and verbs, but a new path (so its info is computed)
+        auto copy = [](const Path& p) { return Make(p.points(), p.verbs(), p.fillType()); };
+        auto same = [](const PathInfo& a, const PathInfo& b) {
+            return a.m_kind == b.m_kind && a.m_isConvex == b.m_isConvex &&
+                   a.m_allLines == b.m_allLines && a.m_contourCount == b.m_contourCount &&
+                   nearly_eq(a.m_area, b.m_area, std::abs(a.m_area) * 1e-5f);
+        };
+
+        assert(Path::Empty()->info().m_kind == Kind::empty);
+        PathBuilder b;
+        b.move(1, 2);
+        assert(b.detach()->info().m_kind == Kind::empty);
+        b.addLine({0, 0}, {3, 4});
+        assert(b.detach()->info().m_kind == Kind::line);
+
+        // what Rect and Oval know matches what we work out
+        for (auto dir : {PathDirection::cw, PathDirection::ccw}) {
+            const auto r = Path::Rect({1, 2, 11, 7}, dir);
+            const auto& info = r->info();
+            assert(info.m_kind == Kind::rect && info.direction() == dir && info.m_area == (dir == PathDirection::cw ? 50 : -50));
+            assert(same(info, copy(*r)->info()));
+
+            const auto c = Path::Circle({10, 10}, 10, dir);
+            assert(c->info().m_kind == Kind::oval && c->info().direction() == dir);
+            assert(nearly_eq(std::abs(c->info().m_area), 3.14159265f * 100, 0.1f));
+            assert(same(c->info(), copy(*c)->info()));
+
+            b.addRect({0, 0, 5, 5}, dir);
+            assert(b.detach()->info().m_kind == Kind::rect);
+        }
+        // a stray move is in the bounds, so the path isn't just the rect
+        b.addRect({10, 10, 20, 20});
+        b.move({100, 100});
+        const auto stray = b.detach();
+        assert(stray->info().m_kind == Kind::polygon);
+        assert(!stray->contains({50, 50}) && stray->contains({15, 15}));
+        b.move({100, 100});
+        b.addRect({10, 10, 20, 20});
+        assert(b.detach()->info().m_kind == Kind::polygon);
+        assert(Path::Rect({0, 0, 0, 5})->info().m_kind == Kind::polygon);
+
+        // a rotated rect is just a (convex) polygon
+        const auto diamond = Path::Rect({0, 0, 10, 10})->transform(Matrix::Rotate(0.5f));
+        assert(diamond->info().m_kind == Kind::polygon && diamond->info().m_isConvex);
+        assert(nearly_eq(diamond->info().m_area, -100, 1e-3f));
+
+        // concave, and self-intersecting (which turns one way, but goes around twice)
+        const Point arrow[] = {{0, 0}, {10, 5}, {0, 10}, {3, 5}};
+        assert(!Path::Poly(arrow, true)->info().m_isConvex);
+        Point star[5];
+        for (int i = 0; i < 5; ++i) {
+            const float angle = i * 2 * (2 * 3.14159265f / 5);
+            star[i] = {std::cos(angle), std::sin(angle)};
+        }
+        assert(!Path::Poly(star, true)->info().m_isConvex);
+
+        // curves, and more than one contour
+        b.move(0, 0);
+        b.quad({10, 10}, {20, 0});
+        b.close();
+        const auto quad = b.detach();
+        assert(quad->info().m_kind == Kind::general && !quad->info().m_allLines);
+        assert(nearly_eq(std::abs(quad->info().m_area), 20 * 5 * 2 / 3.0f, 1e-3f));
+        b.addRect({0, 0, 1, 1});
+        b.addRect({2, 0, 3, 1});
+        const auto two = b.detach();
+        assert(two->info().m_kind == Kind::general && two->info().m_contourCount == 2);
+        assert(!two->info().m_isConvex && two->info().m_allLines);
+
+        // the fast paths in contains() agree with counting the winding (which is
+        // what a rect gets if it has another contour off to the side)
+        const Point tri[] = {{0, 0}, {10, 0}, {0, 10}};
+        for (const auto& shape : {Path::Rect({0, 0, 10, 10}), Path::Poly(tri, true)}) {
+            b.addPath(*shape, Matrix::I());
+            b.addRect({100, 100, 101, 101});
+            const auto slow = b.detach();
+            for (float y = -1; y <= 11; y += 0.5f) {
+                for (float x = -1; x <= 11; x += 0.5f) {
+                    assert(shape->contains({x, y}) == slow->contains({x, y}));
+                }
+            }
+        }
+    }
 #endif
 }
 
@@ -4,6 +4,7 @@
 
 #include "include/geometry.h"
 #include "include/path_builder.h"
+#include "include/point_kernels.h"
 
 namespace pentrek {
 
@@ -49,6 +50,10 @@ static bool ready_for_segment(Span<const PathVerb> vbs) {
     return vbs.back() != PathVerb::close;
 }
 
+bool PathBuilder::readyForSegment() const {
+    return ready_for_segment(m_verbs);
+}
+
 #endif
 
 PathBuilder::PathBuilder(const Path& src, const Matrix& mx) {
@@ -60,55 +65,20 @@ void PathBuilder::incReserve(size_t ptsDelta, size_t vbsDelta) {
      m_verbs.reserve( m_verbs.size() + vbsDelta);
 }
 
-void PathBuilder::move(Point p) {
-    m_verbs.push_back(PathVerb::move);
-    m_points.push_back(p);
-}
-void PathBuilder::line(Point p) {
-    assert(ready_for_segment(m_verbs));
-    
-    m_verbs.push_back(PathVerb::line);
-    m_points.push_back(p);
-}
-void PathBuilder::quad(Point p1, Point p2) {
-    assert(ready_for_segment(m_verbs));
-    
-    m_verbs.push_back(PathVerb::quad);
-    m_points.push_back(p1);
-    m_points.push_back(p2);
-}
-void PathBuilder::cubic(Point p1, Point p2, Point p3) {
-    assert(ready_for_segment(m_verbs));
-    
-    m_verbs.push_back(PathVerb::cubic);
-    m_points.push_back(p1);
-    m_points.push_back(p2);
-    m_points.push_back(p3);
-}
-void PathBuilder::close() {
-    assert(ready_for_segment(m_verbs));
-    
-    m_verbs.push_back(PathVerb::close);
-}
-
-void PathBuilder::addRect(const pentrek::Rect& r, PathDirection dir) {
-    m_points.reserve(m_points.size() + 4);
-    m_verbs.reserve(m_verbs.size() + 1 + 3 + 1);    // M 3*L X
-    
-    this->move({r.left, r.top});
+void rect_points(const Rect& r, PathDirection dir, Point dst[4]) {
+    dst[0] = {r.left, r.top};
     if (dir == PathDirection::cw) {
-        this->line({r.right, r.top});
-        this->line({r.right, r.bottom});
-        this->line({r.left, r.bottom});
+        dst[1] = {r.right, r.top};
+        dst[2] = {r.right, r.bottom};
+        dst[3] = {r.left, r.bottom};
     } else {
-        this->line({r.left, r.bottom});
-        this->line({r.right, r.bottom});
-        this->line({r.right, r.top});
+        dst[1] = {r.left, r.bottom};
+        dst[2] = {r.right, r.bottom};
+        dst[3] = {r.right, r.top};
     }
-    this->close();
 }
 
-void PathBuilder::addOval(const pentrek::Rect& r, PathDirection dir) {
+void oval_points(const Rect& r, PathDirection dir, Point dst[13]) {
     constexpr float C = kBezierCircleCoeff;
     
     // precompute clockwise unit circle, starting and ending at {1, 0}
@@ -123,19 +93,42 @@ void PathBuilder::addOval(const pentrek::Rect& r, PathDirection dir) {
     const auto mx = Matrix::Trans(r.center())
     * Matrix::Scale(r.width() * 0.5f, r.height() * 0.5f);
     
-    m_points.reserve(m_points.size() + 1 + 4*3);    // M 4*C
-    m_verbs.reserve(m_verbs.size() + 1 + 4 + 1);    // M 4*C X
-    
-    this->move(mx * Point{1, 0});
     if (dir == PathDirection::cw) {
-        for (int i = 1; i <= 12; i += 3) {
-            this->cubic(mx * unit[i+0], mx * unit[i+1], mx * unit[i+2]);
+        for (int i = 0; i <= 12; ++i) {
+            dst[i] = mx * unit[i];
         }
     } else {
-        for (int i = 11; i >= 0; i -= 3) {
-            this->cubic(mx * unit[i-0], mx * unit[i-1], mx * unit[i-2]);
+        for (int i = 0; i <= 12; ++i) {
+            dst[i] = mx * unit[12 - i];
         }
     }
+}
+
+void PathBuilder::addRect(const pentrek::Rect& r, PathDirection dir) {
+    Point pts[4];
+    rect_points(r, dir, pts);
+
+    m_points.reserve(m_points.size() + 4);
+    m_verbs.reserve(m_verbs.size() + 1 + 3 + 1);    // M 3*L X
+    
+    this->move(pts[0]);
+    this->line(pts[1]);
+    this->line(pts[2]);
+    this->line(pts[3]);
+    this->close();
+}
+
+void PathBuilder::addOval(const pentrek::Rect& r, PathDirection dir) {
+    Point pts[13];
+    oval_points(r, dir, pts);
+
+    m_points.reserve(m_points.size() + 1 + 4*3);    // M 4*C
+    m_verbs.reserve(m_verbs.size() + 1 + 4 + 1);    // M 4*C X
+    
+    this->move(pts[0]);
+    for (int i = 1; i <= 12; i += 3) {
+        this->cubic(pts[i], pts[i+1], pts[i+2]);
+    }
     this->close();
 }
 
@@ -158,6 +151,29 @@ void PathBuilder::addPoly(Span<const Point> pts, bool doClose) {
     }
 }
 
+// Point layout (which MikeMullSpline relies on): the move is ctrls[0].curr, and then
+// segment i's cubic is {ctrls[i].next, ctrls[i+1].prev, ctrls[i+1].curr} (wrapping
+// around to ctrls[0] for the closing segment).
+void path_add_ctrlpoints(PathBuilder* dst, Span<const CtrlPoint> ctrls, bool doClose) {
+    const size_t n = ctrls.size();
+    if (n == 0) {
+        return;
+    }
+    const size_t segments = n - 1 + (doClose && n > 1);
+    dst->incReserve(1 + 3 * segments, 1 + segments + doClose);
+
+    dst->move(ctrls[0].curr);
+    for (size_t i = 1; i < n; ++i) {
+        dst->cubic(ctrls[i - 1].next, ctrls[i].prev, ctrls[i].curr);
+    }
+    if (doClose) {
+        if (n > 1) {
+            dst->cubic(ctrls[n - 1].next, ctrls[0].prev, ctrls[0].curr);
+        }
+        dst->close();
+    }
+}
+
 void PathBuilder::addPath(Span<const Point> pts, Span<const PathVerb> vbs, const Matrix& mx) {
     assert(valid_verbs(vbs, m_verbs.size() == 0));
     assert(count_points(vbs) == pts.size());
@@ -167,7 +183,7 @@ void PathBuilder::addPath(Span<const Point> pts, Span<const PathVerb> vbs, const
     m_points.insert(m_points.end(), pts.begin(), pts.end());
 
     if (mx != Matrix::I()) {
-        mx.map({&m_points[offset], m_points.size() - offset});
+        mx.map(m_points.writable(offset, m_points.size() - offset));
     }
 }
 
@@ -176,18 +192,106 @@ void PathBuilder::addPath(const Path& src, const Matrix& mx) {
 }
 
 void PathBuilder::transformInPlace(const Matrix& mx) {
-    for (auto& pt : m_points) {
-        pt = mx * pt;
+    mx.map(m_points);
+}
+
+void PathBuilder::setLerp(const Path& a, const Path& b, float t) {
+    const auto pa = a.points();
+    const auto pb = b.points();
+    assert(pa.size() == pb.size());
+    assert(a.verbs().size() == b.verbs().size());
+
+    m_verbs.assign(a.verbs().begin(), a.verbs().end());
+    m_points.resize(pa.size());
+    if (pa.size() > 0) {
+        PointKernels::Get().m_lerp(m_points.data(), pa.data(), pb.data(), pa.size(), t);
     }
+    m_fillType = a.fillType();
 }
 
-rcp<Path> PathBuilder::snapshot() {
-    return make_rcp<Path>(m_points, m_verbs, m_fillType);
+void PathBuilder::reallocate(size_t pointCapacity, size_t verbCapacity) {
+    assert(pointCapacity >= m_points.size() && verbCapacity >= m_verbs.size());
+
+    auto block = Data::Uninitialized(pointCapacity * sizeof(Point) + verbCapacity * sizeof(PathVerb));
+    auto pts = (Point*)block->writable_data();
+    auto vbs = (PathVerb*)(pts + pointCapacity);
+    std::copy(m_points.m_data, m_points.m_data + m_points.size(), pts);
+    std::copy(m_verbs.m_data, m_verbs.m_data + m_verbs.size(), vbs);
+
+    m_block = std::move(block);
+    m_points.m_data = pts;
+    m_points.m_capacity = pointCapacity;
+    m_points.m_frozen = 0;
+    m_verbs.m_data = vbs;
+    m_verbs.m_capacity = verbCapacity;
+    m_verbs.m_frozen = 0;
+}
+
+void PathBuilder::unshare() {
+    if (m_block->unique()) {
+        // the snapshots have all gone away
+        m_points.m_frozen = m_verbs.m_frozen = 0;
+    } else {
+        this->reallocate(m_points.capacity(), m_verbs.capacity());
+    }
+}
+
+PathBuilder::PathBuilder(const PathBuilder& src) : m_fillType(src.m_fillType) {
+    if (!src.empty()) {
+        this->reallocate(src.m_points.size(), src.m_verbs.size());
+    }
+    m_points.insert(m_points.end(), src.m_points.begin(), src.m_points.end());
+    m_verbs.insert(m_verbs.end(), src.m_verbs.begin(), src.m_verbs.end());
 }
 
+PathBuilder::PathBuilder(PathBuilder&& src) {
+    *this = std::move(src);
+}
+
+PathBuilder& PathBuilder::operator=(const PathBuilder& src) {
+    if (this != &src) {
+        m_points.clear();
+        m_verbs.clear();
+        m_points.insert(m_points.end(), src.m_points.begin(), src.m_points.end());
+        m_verbs.insert(m_verbs.end(), src.m_verbs.begin(), src.m_verbs.end());
+        m_fillType = src.m_fillType;
+    }
+    return *this;
+}
 
+PathBuilder& PathBuilder::operator=(PathBuilder&& src) {
+    if (this != &src) {
+        m_block = std::move(src.m_block);
+        m_points.take(&src.m_points);
+        m_verbs.take(&src.m_verbs);
+        m_fillType = src.m_fillType;
+    }
+    return *this;
+}
+
+rcp<Path> PathBuilder::snapshot() {
+    if (m_verbs.empty()) {
+        return Path::Make({}, {}, m_fillType);
+    }
+    m_points.m_frozen = m_points.size();
+    m_verbs.m_frozen = m_verbs.size();
+    return Path::WrapBuilderStorage(m_block, {m_points.m_data, m_points.size()},
+                                    {m_verbs.m_data, m_verbs.size()}, m_fillType);
+}
+
+// Normally we copy into a path of its own (a single allocation), and keep our
+// block for whatever we build next. But if snapshots are sharing the block,
+// we'd have to leave it to them anyway, so the path just joins them.
 rcp<Path> PathBuilder::detach() {
-    auto path = make_rcp<Path>(std::move(m_points), std::move(m_verbs), m_fillType);
+    if (m_block && !m_block->unique()) {
+        auto path = this->snapshot();
+        const auto fillType = m_fillType;
+        *this = PathBuilder();
+        m_fillType = fillType;
+        return path;
+    }
+    auto path = Path::Make({m_points.m_data, m_points.size()},
+                           {m_verbs.m_data, m_verbs.size()}, m_fillType);
     m_points.clear();
     m_verbs.clear();
     return path;
@@ -0,0 +1,322 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#include "include/path_effect.h"
+#include "include/path_builder.h"
+#include <cmath>
+#include <vector>
+
+using namespace pentrek;
+
+// A contour that would get more dashes than this is left whole instead
+constexpr double kMaxDashes = 1000000;
+
+namespace {
+
+class DashEffect : public PathEffect {
+    std::vector<float>  m_intervals;    // even count: on, off, on, off, ...
+    std::vector<double> m_prefix;       // where each interval starts in the pattern
+    double m_sum;                       // the pattern's length
+    size_t m_startIndex;                // the interval each contour starts in
+    float  m_startRemaining;            // ... and how much of it is left
+
+public:
+    DashEffect(Span<const float> intervals, float phase) {
+        m_intervals.assign(intervals.begin(), intervals.end());
+        if (m_intervals.size() & 1) {
+            m_intervals.insert(m_intervals.end(), intervals.begin(), intervals.end());
+        }
+
+        double sum = 0;
+        for (auto x : m_intervals) {
+            m_prefix.push_back(sum);
+            sum += x;
+        }
+        m_sum = sum;
+        phase = std::fmod(phase, (float)sum);
+        if (phase < 0) {
+            phase += (float)sum;
+        }
+
+        size_t i = 0;
+        while (phase >= m_intervals[i] && i + 1 < m_intervals.size()) {
+            phase -= m_intervals[i];
+            i += 1;
+        }
+        m_startIndex = i;
+        m_startRemaining = std::max(0.0f, m_intervals[i] - phase);
+    }
+
+    void apply(const PathMeasure& meas, PathSync* sink) const override {
+        for (const auto& cm : meas.contours()) {
+            this->dashContour(*cm, sink);
+        }
+    }
+
+private:
+    void dashContour(const ContourMeasure& cm, PathSync* sink) const {
+        const float length = cm.length();
+        const size_t n = m_intervals.size();
+
+        if (length / m_sum * (n / 2) > kMaxDashes) {
+            // (too many to be worth drawing one at a time)
+            cm.getSegment(0, length, true, sink);
+            if (cm.isClosed()) {
+                sink->close();
+            }
+            return;
+        }
+
+        // If a closed contour is on at both its start and end, those two dashes
+        // are really one, so we hold the first one back and append it to the last.
+        const bool joinEnds = cm.isClosed() && (m_startIndex & 1) == 0;
+        float firstEnd = -1;
+        bool lastReachedEnd = false;
+
+        // Each interval starts at origin + k * m_sum + m_prefix[i] (in double,
+        // since adding up the intervals in float stops advancing once they are
+        // under half an ulp of the distance so far).
+        const double origin = m_startRemaining -
+                              (m_prefix[m_startIndex] + m_intervals[m_startIndex]);
+        size_t i = m_startIndex, k = 0;
+        double d = origin + m_prefix[i];
+        while (d < length) {
+            if ((i & 1) == 0) {
+                const double next = d + m_intervals[i];
+                const float start = (float)std::max(d, 0.0),
+                            end = (float)std::min(next, (double)length);
+                if (k == 0 && i == m_startIndex && joinEnds) {
+                    firstEnd = end;
+                } else {
+                    cm.getSegment(start, end, true, sink);
+                    lastReachedEnd = next >= length;
+                }
+            }
+            if (++i == n) {
+                i = 0;
+                k += 1;
+            }
+            d = origin + k * m_sum + m_prefix[i];
+        }
+
+        if (firstEnd >= 0) {
+            cm.getSegment(0, firstEnd, !lastReachedEnd, sink);
+        }
+    }
+};
+
+class TrimEffect : public PathEffect {
+    float m_start, m_span;   // fractions of the length, m_start is in [0...1)
+
+public:
+    TrimEffect(float start, float end, float offset) {
+        m_span = pin_float(end - start, 0, 1);
+        start += offset;
+        m_start = start - std::floor(start);
+    }
+
+    void apply(const PathMeasure& meas, PathSync* sink) const override {
+        const float length = meas.length();
+        if (m_span <= 0 || length <= 0) {
+            return;
+        }
+
+        const auto contours = meas.contours();
+        if (m_span >= 1) {
+            for (const auto& cm : contours) {
+                cm->getSegment(0, cm->length(), true, sink);
+                if (cm->isClosed()) {
+                    sink->close();
+                }
+            }
+            return;
+        }
+
+        const float start = m_start * length,
+                    end = (m_start + m_span) * length;
+        if (end <= length) {
+            trim(contours, start, end, sink);
+        } else if (contours.size() == 1 && contours[0]->isClosed()) {
+            // wrapping around a single closed contour, so the two parts are one
+            const auto& cm = contours[0];
+            cm->getSegment(start, length, true, sink);
+            cm->getSegment(0, end - length, false, sink);
+        } else {
+            trim(contours, start, length, sink);
+            trim(contours, 0, end - length, sink);
+        }
+    }
+
+private:
+    // Emits [start...end] (distances along all of the contours)
+    static void trim(Span<const rcp<ContourMeasure>> contours, float start, float end,
+                     PathSync* sink) {
+        float base = 0;
+        for (const auto& cm : contours) {
+            const float length = cm->length();
+            if (start < base + length && end > base) {
+                cm->getSegment(start - base, end - base, true, sink);
+            }
+            base += length;
+            if (base > end) {
+                break;
+            }
+        }
+    }
+};
+
+} // namespace
+
+rcp<PathEffect> PathEffect::Dash(Span<const float> intervals, float phase) {
+    float sum = 0;
+    for (auto x : intervals) {
+        if (!(x >= 0)) {
+            return nullptr;
+        }
+        sum += x;
+    }
+    if (!(sum > 0) || !std::isfinite(sum) || !std::isfinite(phase)) {
+        return nullptr;
+    }
+    return make_rcp<DashEffect>(intervals, phase);
+}
+
+rcp<PathEffect> PathEffect::Trim(float start, float end, float offset) {
+    return make_rcp<TrimEffect>(start, end, offset);
+}
+
+rcp<Path> PathEffect::apply(const Path& path) const {
+    PathBuilder builder;
+    this->apply(path, &builder);
+    return builder.detach();
+}
+
+//////////////////////////////////
+
+void PathEffect::Tests() {
+#ifdef DEBUG
+    auto eq = [](Point a, Point b) {
+        return nearly_eq(a.x, b.x, 1.0f / 1024) && nearly_eq(a.y, b.y, 1.0f / 1024);
+    };
+    auto dash_count = [](const Path& path) {
+        int n = 0;
+        for (auto v : path.verbs()) {
+            n += v == PathVerb::move;
+        }
+        return n;
+    };
+
+    const Point line[] = {{0, 0}, {100, 0}};
+    const auto path = Path::Poly(line, false);
+
+    // invalid intervals
+    const float negative[] = {10, -1};
+    const float zeros[] = {0, 0};
+    assert(!Dash(negative, 0));
+    assert(!Dash(zeros, 0));
+    assert(!Dash({}, 0));
+
+    const float intervals[] = {10, 5};
+    auto dashed = Dash(intervals, 0)->apply(*path);
+    assert(dash_count(*dashed) == 7);   // 0-10, 15-25, ... 90-100
+    assert(eq(dashed->points()[0], line[0]));
+    assert(eq(dashed->points()[1], {10, 0}));
+    assert(eq(dashed->points()[2], {15, 0}));
+    assert(eq(dashed->points().back(), line[1]));
+
+    // the phase shifts the pattern, and wraps (in either direction)
+    dashed = Dash(intervals, 3)->apply(*path);
+    assert(eq(dashed->points()[1], {7, 0}));
+    assert(eq(dashed->points()[2], {12, 0}));
+    assert(*dashed == *Dash(intervals, 3 + 15 * 4)->apply(*path));
+    assert(*dashed == *Dash(intervals, 3 - 15 * 4)->apply(*path));
+    dashed = Dash(intervals, 12)->apply(*path);     // starts off
+    assert(eq(dashed->points()[0], {3, 0}));
+
+    // an odd number of intervals is repeated
+    const float odd[] = {10};
+    dashed = Dash(odd, 0)->apply(*path);
+    assert(dash_count(*dashed) == 5);
+
+    // dashes far along are where they should be
+    const Point longer[] = {{0, 0}, {5000, 0}};
+    const float small[] = {0.1f, 0.1f};
+    dashed = Dash(small, 0)->apply(*Path::Poly(longer, false));
+    assert(dash_count(*dashed) == 25000);
+    assert(eq(dashed->points()[dashed->points().size() - 2], {4999.8f, 0}));
+
+    // intervals that are tiny next to the length would make too many dashes
+    // (and, added up in float, never get to the end), so it is left whole
+    const Point huge[] = {{0, 0}, {1e6f, 0}};
+    const float tiny[] = {1e-3f, 1e-3f};
+    dashed = Dash(tiny, 0)->apply(*Path::Poly(huge, false));
+    assert(dash_count(*dashed) == 1);
+    assert(eq(dashed->points()[0], huge[0]) && eq(dashed->points().back(), huge[1]));
+
+    // a closed contour joins its first and last dashes
+    const auto square = Path::Rect({0, 0, 10, 10});
+    const float sq[] = {5, 2.5f};   // 40 / 7.5 = 5.33 dashes
+    dashed = Dash(sq, 0)->apply(*square);
+    assert(dash_count(*dashed) == 5);
+    const float even[] = {5, 5};
+    dashed = Dash(even, 0)->apply(*square);
+    assert(dash_count(*dashed) == 4);
+    assert(eq(dashed->points()[0], {0, 10}));    // the first dash comes last
+    assert(eq(dashed->points().back(), {0, 5}));
+    dashed = Dash(even, 2.5f)->apply(*square);
+    assert(dash_count(*dashed) == 4);
+    assert(eq(dashed->points()[0], {0, 7.5f}));
+    assert(eq(dashed->points().back(), {0, 2.5f}));     // and continues the last
+
+    // trim
+    auto trimmed = Trim(0.25f, 0.5f)->apply(*path);
+    assert(dash_count(*trimmed) == 1);
+    assert(eq(trimmed->points()[0], {25, 0}));
+    assert(eq(trimmed->points().back(), {50, 0}));
+
+    assert(Trim(0.5f, 0.5f)->apply(*path)->empty());
+    assert(Trim(0.75f, 0.25f)->apply(*path)->empty());
+
+    // offset wraps around the end
+    trimmed = Trim(0.25f, 0.5f, 0.6f)->apply(*path);
+    assert(dash_count(*trimmed) == 2);
+    assert(eq(trimmed->points()[0], {85, 0}));
+    assert(eq(trimmed->points().back(), {10, 0}));
+
+    // ... and joins up, if it is a single closed contour
+    trimmed = Trim(0, 0.5f, 0.875f)->apply(*square);
+    assert(dash_count(*trimmed) == 1);
+    assert(eq(trimmed->points()[0], {5, 0}));
+    assert(eq(trimmed->points().back(), {5, 10}));
+
+    // the whole thing
+    trimmed = Trim(0, 1, 0.3f)->apply(*square);
+    assert(trimmed->verbs().back() == PathVerb::close);
+
+    // trim spans all of the contours
+    PathBuilder b;
+    b.addLine({0, 0}, {10, 0});
+    b.addLine({0, 10}, {30, 10});
+    const auto two = b.detach();
+    trimmed = Trim(0.125f, 0.5f)->apply(*two);   // 5...20
+    assert(dash_count(*trimmed) == 2);
+    assert(eq(trimmed->points()[0], {5, 0}));
+    assert(eq(trimmed->points().back(), {10, 10}));
+
+    // a caller can hold onto the measure
+    const auto meas = PathMeasure::Make(two);
+    b = PathBuilder();
+    Trim(0.125f, 0.5f)->apply(*meas, &b);
+    assert(*b.detach() == *trimmed);
+
+    // ending right where a contour does doesn't start the next one
+    b.addLine({0, 0}, {10, 0});
+    b.addLine({0, 10}, {10, 10});
+    trimmed = Trim(0, 0.5f)->apply(*b.detach());
+    assert(trimmed->verbs().size() == 2);
+    assert(eq(trimmed->points().back(), {10, 0}));
+
+    PathMeasure::PurgeCache();
+#endif
+}
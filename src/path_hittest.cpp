@@ -0,0 +1,435 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#include "include/path.h"
+#include "include/geometry.h"
+#include "include/math.h"
+
+using namespace pentrek;
+
+/*
+ *  Hit testing works on the path's edges, chopped at their extrema so that each
+ *  piece is monotonic in both X and Y. Each piece then crosses any horizontal
+ *  (or vertical) line at most once, which makes the winding count (and the
+ *  rect intersection test) a single root-solve per piece.
+ *
+ *  Small paths generate these pieces on the fly for each query. Large paths
+ *  (e.g. glyphs with hundreds of curves) build them once, and bucket them into
+ *  horizontal bands, so a query only looks at the pieces that span its Y.
+ */
+
+static bool contains_inclusive(const Rect& r, Point p) {
+    return r.left <= p.x && p.x <= r.right && r.top <= p.y && p.y <= r.bottom;
+}
+
+static bool overlaps_inclusive(const Rect& a, const Rect& b) {
+    return a.left <= b.right && b.left <= a.right && a.top <= b.bottom && b.top <= a.bottom;
+}
+
+static float coord(Point p, int axis) { return axis ? p.y : p.x; }
+
+namespace {
+
+struct MonoEdge {
+    Point   m_pts[4];
+    Rect    m_bounds;   // of the end points, which is tight since we're monotonic
+    uint8_t m_degree;   // 1, 2, 3 : line, quad, cubic
+    int8_t  m_winding;  // +1 if Y increases, -1 if it decreases, 0 if horizontal
+
+    MonoEdge(const Point pts[], int degree) : m_degree(castTo<uint8_t>(degree)) {
+        std::copy(pts, pts + degree + 1, m_pts);
+        const Point a = pts[0],
+                    b = pts[degree];
+        m_bounds = Rect::Bounds(a, b);
+        m_winding = a.y < b.y ? 1 : (a.y > b.y ? -1 : 0);
+        pin_monotonic(m_pts, degree);
+    }
+
+    Point last() const { return m_pts[m_degree]; }
+
+    Point eval(float t) const {
+        switch (m_degree) {
+            case 1: return lerp(m_pts[0], m_pts[1], t);
+            case 2: return QuadCoeff::Compute(m_pts).eval(t);
+            default: return CubicCoeff::Compute(m_pts).eval(t);
+        }
+    }
+
+    // Returns t where our coordinate in axis (0 or 1) equals value, which
+    // must be between our end points.
+    float solve(int axis, float value) const {
+        const float a = coord(m_pts[0], axis),
+                    b = coord(m_pts[1], axis);
+        float roots[3];
+        int count = 0;
+        switch (m_degree) {
+            case 1:
+                roots[0] = (value - a) / (b - a);
+                count = float_is_unit(roots[0]) ? 1 : 0;
+                break;
+            case 2: {
+                const float c = coord(m_pts[2], axis);
+                count = quadratic_unit_roots(a - 2*b + c, 2*(b - a), a - value, roots);
+            } break;
+            default: {
+                const float c = coord(m_pts[2], axis),
+                            d = coord(m_pts[3], axis);
+                count = cubic_unit_roots(d - 3*c + 3*b - a, 3*(c - 2*b + a), 3*(b - a),
+                                         a - value, roots);
+            } break;
+        }
+        if (count > 0) {
+            return roots[0];
+        }
+        // Since we're monotonic, the root must exist, so we were just
+        // (numerically) too close to one of our ends.
+        return std::abs(value - a) < std::abs(value - coord(this->last(), axis)) ? 0 : 1;
+    }
+
+    // Returns our contribution to the winding of a horizontal ray from p to +infinity.
+    // We include our top, but not our bottom, so a ray through the point
+    // where two edges meet only counts one of them.
+    int winding(Point p) const {
+        if (m_winding == 0 || p.y < m_bounds.top || p.y >= m_bounds.bottom) {
+            return 0;
+        }
+        if (p.x >= m_bounds.right) {
+            return 0;
+        }
+        if (p.x < m_bounds.left) {
+            return m_winding;
+        }
+        return this->eval(this->solve(1, p.y)).x > p.x ? m_winding : 0;
+    }
+
+    bool intersects(const Rect& r) const {
+        if (!overlaps_inclusive(m_bounds, r)) {
+            return false;
+        }
+        if (contains_inclusive(r, m_pts[0]) || contains_inclusive(r, this->last())) {
+            return true;
+        }
+        // Both of our ends are outside, so we must cross one of r's sides.
+        for (float x : {r.left, r.right}) {
+            if (m_bounds.left <= x && x <= m_bounds.right && m_bounds.left < m_bounds.right) {
+                const float y = this->eval(this->solve(0, x)).y;
+                if (r.top <= y && y <= r.bottom) {
+                    return true;
+                }
+            }
+        }
+        for (float y : {r.top, r.bottom}) {
+            if (m_bounds.top <= y && y <= m_bounds.bottom && m_bounds.top < m_bounds.bottom) {
+                const float x = this->eval(this->solve(1, y)).x;
+                if (r.left <= x && x <= r.right) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+};
+
+template <int N, typename Extract, typename Proc>
+void chop_monotonic(const Point src[], const float t[], int count, Extract extract, Proc& proc) {
+    float prevT = 0;
+    Point tmp[N];
+    for (int i = 0; i <= count; ++i) {
+        const float nextT = i < count ? t[i] : 1;
+        extract(src, prevT, nextT, tmp);
+        proc(MonoEdge(tmp, N - 1));
+        prevT = nextT;
+    }
+}
+
+// Returns true if none of the points' Y values are in [top...bottom]
+static bool outside_y(const Point pts[], int count, float top, float bottom) {
+    bool above = true,
+         below = true;
+    for (int i = 0; i < count; ++i) {
+        above = above && pts[i].y < top;
+        below = below && pts[i].y > bottom;
+    }
+    return above || below;
+}
+
+// Calls proc with each of the monotonic pieces of the path's edges, including
+// the implied line that closes each contour (since we're testing its fill).
+// Edges that are entirely above top or below bottom are skipped (without chopping).
+template <typename Proc> void visit_mono_edges(const Path& path, float top, float bottom, Proc proc) {
+    const Point* p = path.points().data();
+    Point start = {0, 0},
+          last = {0, 0};
+
+    auto closeContour = [&]() {
+        const Point pts[] = {last, start};
+        if (last != start && !outside_y(pts, 2, top, bottom)) {
+            proc(MonoEdge(pts, 1));
+        }
+        last = start;
+    };
+
+    for (auto v : path.verbs()) {
+        switch (v) {
+            case PathVerb::move:
+                closeContour();
+                start = last = *p++;
+                break;
+            case PathVerb::line: {
+                const Point pts[] = {last, p[0]};
+                if (!outside_y(pts, 2, top, bottom)) {
+                    proc(MonoEdge(pts, 1));
+                }
+                last = p[0];
+                p += 1;
+            } break;
+            case PathVerb::quad: {
+                const Point pts[] = {last, p[0], p[1]};
+                if (!outside_y(pts, 3, top, bottom)) {
+                    float t[2];
+                    const int n = quad_extrema(pts, t);
+                    chop_monotonic<3>(pts, t, n, quad_extract, proc);
+                }
+                last = p[1];
+                p += 2;
+            } break;
+            case PathVerb::cubic: {
+                const Point pts[] = {last, p[0], p[1], p[2]};
+                if (!outside_y(pts, 4, top, bottom)) {
+                    float t[4];
+                    const int n = cubic_extrema(pts, t);
+                    chop_monotonic<4>(pts, t, n, cubic_extract, proc);
+                }
+                last = p[2];
+                p += 3;
+            } break;
+            case PathVerb::close:
+                closeContour();
+                break;
+        }
+    }
+    closeContour();
+}
+
+bool is_inside(int winding, PathFillType ft) {
+    return ft == PathFillType::evenodd ? (winding & 1) != 0 : winding != 0;
+}
+
+} // namespace
+
+class pentrek::PathHitIndex {
+    std::vector<MonoEdge> m_edges;
+    std::vector<uint32_t> m_bandStart;  // bandCount + 1 offsets into m_bandEdges
+    std::vector<uint32_t> m_bandEdges;  // indices into m_edges
+    float m_top = 0,
+          m_bandScale = 0;              // band = (y - m_top) * m_bandScale
+
+    static constexpr float kBandsPerEdge = 2;
+    static constexpr size_t kMaxBands = 1024;
+
+    size_t bandCount() const { return m_bandStart.size() - 1; }
+
+    size_t band(float y) const {
+        const float b = (y - m_top) * m_bandScale;
+        return b <= 0 ? 0 : std::min((size_t)b, this->bandCount() - 1);
+    }
+
+public:
+    PathHitIndex(const Path& path) {
+        const Rect bounds = path.bounds();
+        visit_mono_edges(path, bounds.top, bounds.bottom, [this](const MonoEdge& e) {
+            m_edges.push_back(e);
+        });
+
+        // Size the bands so that a typical edge spans a couple of them: smaller
+        // bands would mostly repeat the same edges, larger ones add edges that
+        // a query (likely) doesn't touch.
+        float edgeHeights = 0;
+        for (const auto& e : m_edges) {
+            edgeHeights += e.m_bounds.height();
+        }
+        const float avgEdgeHeight = m_edges.size() > 0 ? edgeHeights / m_edges.size() : 0;
+        size_t bandCount = 1;
+        if (avgEdgeHeight > 0) {
+            const float bands = kBandsPerEdge * bounds.height() / avgEdgeHeight;
+            bandCount = (size_t)pin_float(bands, 1, (float)std::min(kMaxBands, m_edges.size()));
+        }
+        m_top = bounds.top;
+        m_bandScale = bounds.height() > 0 ? bandCount / bounds.height() : 0;
+
+        // count how many edges are in each band, then turn that into offsets
+        m_bandStart.assign(bandCount + 1, 0);
+        for (const auto& e : m_edges) {
+            for (size_t b = this->band(e.m_bounds.top); b <= this->band(e.m_bounds.bottom); ++b) {
+                m_bandStart[b + 1] += 1;
+            }
+        }
+        for (size_t b = 0; b < bandCount; ++b) {
+            m_bandStart[b + 1] += m_bandStart[b];
+        }
+
+        m_bandEdges.resize(m_bandStart.back());
+        std::vector<uint32_t> fill(m_bandStart.begin(), m_bandStart.end() - 1);
+        for (size_t i = 0; i < m_edges.size(); ++i) {
+            const auto& e = m_edges[i];
+            for (size_t b = this->band(e.m_bounds.top); b <= this->band(e.m_bounds.bottom); ++b) {
+                m_bandEdges[fill[b]++] = castTo<uint32_t>(i);
+            }
+        }
+    }
+
+    // Calls proc with each edge in the bands that span [top...bottom], until
+    // proc returns true. An edge in several of those bands is only seen in the
+    // first of them.
+    template <typename F> bool any(float top, float bottom, F proc) const {
+        const size_t first = this->band(top),
+                     last  = this->band(bottom);
+        for (size_t b = first; b <= last; ++b) {
+            for (uint32_t i = m_bandStart[b]; i < m_bandStart[b + 1]; ++i) {
+                const auto& e = m_edges[m_bandEdges[i]];
+                if (b > first && this->band(e.m_bounds.top) < b) {
+                    continue;   // already seen
+                }
+                if (proc(e)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    int winding(Point p) const {
+        int w = 0;
+        if (!m_bandEdges.empty()) {
+            this->any(p.y, p.y, [&](const MonoEdge& e) {
+                w += e.winding(p);
+                return false;
+            });
+        }
+        return w;
+    }
+
+    bool intersects(const Rect& r) const {
+        return !m_bandEdges.empty() && this->any(r.top, r.bottom, [&](const MonoEdge& e) {
+            return e.intersects(r);
+        });
+    }
+};
+
+// Below this, it's faster to just walk the path for each query
+static constexpr size_t kMinVerbsForIndex = 16;
+
+// Above this, the hit index (which only looks at nearby edges) is faster than
+// checking every edge's half-plane.
+static constexpr size_t kMaxConvexFastPathPoints = 32;
+
+void Path::DeleteHitIndex(const PathHitIndex* index) {
+    delete index;
+}
+
+const PathHitIndex* Path::hitIndex() const {
+    auto index = m_hitIndex.load(std::memory_order_acquire);
+    if (!index && m_verbCount >= kMinVerbsForIndex) {
+        auto fresh = new PathHitIndex(*this);
+        if (m_hitIndex.compare_exchange_strong(index, fresh, std::memory_order_acq_rel)) {
+            index = fresh;
+        } else {
+            delete fresh;   // another thread beat us to it (index now holds theirs)
+        }
+    }
+    return index;
+}
+
+// For a convex polygon: inside if p is inside every edge's half-plane, and outside
+// if it is outside any of them. Returns -1 if p is too close to an edge to say
+// (so the caller falls back to counting the winding, which treats points on
+// the edges consistently with neighboring paths).
+static int convex_polygon_contains(Span<const Point> pts, float area, Point p, float tolerance) {
+    const size_t n = pts.size();
+    const float sign = area > 0 ? 1 : -1;
+    int result = 1;
+    for (size_t i = 0; i < n; ++i) {
+        const Point a = pts[i],
+                    b = pts[i + 1 < n ? i + 1 : 0];
+        const Point e = b - a;
+        const float lenSq = e.lengthSquared();
+        if (lenSq == 0) {
+            continue;
+        }
+        const float c = Point::Cross(e, p - a) * sign;
+        // c is the distance from the edge, times the edge's length
+        if (c * c <= tolerance * tolerance * lenSq) {
+            result = -1;
+        } else if (c < 0) {
+            return 0;
+        }
+    }
+    return result;
+}
+
+bool Path::contains(Point p) const {
+    const auto& bounds = this->bounds();
+    if (!contains_inclusive(bounds, p)) {
+        return false;
+    }
+
+    const auto& info = this->info();
+    if (info.m_kind == PathInfo::Kind::rect) {
+        // the same as the winding count (below) gives: left and top edges in,
+        // right and bottom edges out
+        return bounds.left <= p.x && p.x < bounds.right && bounds.top <= p.y && p.y < bounds.bottom;
+    }
+    // (convex means one contour, but there could be a stray move as well)
+    if (info.m_isConvex && info.m_allLines && m_pointCount <= kMaxConvexFastPathPoints &&
+        std::count(m_verbs, m_verbs + m_verbCount, PathVerb::move) == 1) {
+        const float tolerance = (bounds.width() + bounds.height()) * 1e-5f;
+        const int inside = convex_polygon_contains(this->points(), info.m_area, p, tolerance);
+        if (inside >= 0) {
+            return inside != 0;
+        }
+    }
+
+    int w = 0;
+    if (auto index = this->hitIndex()) {
+        w = index->winding(p);
+    } else {
+        visit_mono_edges(*this, p.y, p.y, [&](const MonoEdge& e) {
+            w += e.winding(p);
+        });
+    }
+    return is_inside(w, m_fillType);
+}
+
+bool Path::hitTestRect(const pentrek::Rect& r) const {
+    if (!overlaps_inclusive(this->bounds(), r)) {
+        return false;
+    }
+    if (this->info().m_kind == PathInfo::Kind::rect) {
+        return true;    // we are our bounds
+    }
+    // If none of our edges cross r, then it is either all inside or all outside
+    if (this->contains(r.center())) {
+        return true;
+    }
+
+    if (auto index = this->hitIndex()) {
+        return index->intersects(r);
+    }
+    bool hit = false;
+    visit_mono_edges(*this, r.top, r.bottom, [&](const MonoEdge& e) {
+        hit = hit || e.intersects(r);
+    });
+    return hit;
+}
+
+bool Path::hitTest(Point p, float radius) const {
+    if (radius > 0) {
+        return this->hitTestRect({p.x - radius, p.y - radius, p.x + radius, p.y + radius});
+    }
+    return this->contains(p);
+}
+
+bool Path::hitTest(const IRect& r) const {
+    return this->hitTestRect({(float)r.left, (float)r.top, (float)r.right, (float)r.bottom});
+}
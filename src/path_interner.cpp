@@ -0,0 +1,55 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#include "include/path_interner.h"
+
+using namespace pentrek;
+
+rcp<Path> PathInterner::intern(rcp<Path> path) {
+    const uint64_t hash = path->contentHash();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto range = m_paths.equal_range(hash);
+    for (auto iter = range.first; iter != range.second; ++iter) {
+        if (*iter->second == *path) {
+            return iter->second;
+        }
+    }
+
+    if (m_paths.size() >= m_purgeAt) {
+        this->purgeUnusedLocked();
+        // wait until we've (at least) doubled again before purging again
+        m_purgeAt = std::max(kMinPurgeCount, m_paths.size() * 2);
+    }
+    m_paths.emplace(hash, path);
+    return path;
+}
+
+size_t PathInterner::count() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_paths.size();
+}
+
+void PathInterner::purgeUnused() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    this->purgeUnusedLocked();
+}
+
+// If we're the only owner, no one else can be (since the only way to get
+// a ref to one of our paths is through intern(), which takes the mutex).
+void PathInterner::purgeUnusedLocked() {
+    for (auto iter = m_paths.begin(); iter != m_paths.end();) {
+        if (iter->second->unique()) {
+            iter = m_paths.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+}
+
+PathInterner& PathInterner::Global() {
+    static PathInterner* gInterner = new PathInterner;
+    return *gInterner;
+}
@@ -0,0 +1,1283 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#include "include/path_ops.h"
+#include "include/path_builder.h"
+#include "include/flatten.h"
+#include "include/geometry.h"
+#include "include/math.h"
+#include "include/random.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using namespace pentrek;
+
+/*
+ *  The ops run in a few passes, all on edges that are monotonic in X and Y:
+ *
+ *  1. Both paths are chopped into monotonic edges, each remembering which
+ *     operand it came from (its winding contribution to that operand) and
+ *     which range of its original curve it covers.
+ *  2. A sweep (sorted by left edge) finds the pairs of edges whose bounds
+ *     overlap, and each pair is intersected: lines analytically, curves by
+ *     subdividing until they are flat and then intersecting their chords.
+ *  3. Edges are split at the intersections, and their end points are merged
+ *     into shared vertices (anything within eps is the same vertex).
+ *  4. Coincident edges are merged into one, summing their windings.
+ *  5. The faces that the edges enclose are traced, and each face's winding
+ *     (of each operand) is found by casting a ray from its longest edge. An
+ *     edge is on the boundary of the result if the faces on its two sides
+ *     differ, facing so that the inside is on its left.
+ *  6. The surviving edges are linked into contours, and pieces of the same
+ *     original curve (or collinear lines) are joined back together.
+ *
+ *  Limitations: curves that partially overlap (rather than cross, or being
+ *  identical after splitting) are not merged, so e.g. the union of a circle
+ *  with an abutting copy of one of its arcs may keep a sliver.
+ */
+
+namespace {
+
+// All of the (X, Y) tolerances are relative to the size of the inputs
+constexpr float kRelativeEpsilon = 1.0f / 65536;
+constexpr int kMaxSubdivideDepth = 20;
+constexpr size_t kMaxBands = 256;
+
+float coord(Point p, int axis) { return axis ? p.y : p.x; }
+
+Point eval_curve(const Point pts[], int count, float t) {
+    switch (count) {
+        case 1: return lerp_unbounded(pts[0], pts[1], t);
+        case 2: return QuadCoeff::Compute(pts).eval(t);
+        default: return CubicCoeff::Compute(pts).eval(t);
+    }
+}
+
+void extract_curve(const Point src[], int count, float t0, float t1, Point dst[]) {
+    switch (count) {
+        case 1: line_extract(src, t0, t1, dst); break;
+        case 2: quad_extract(src, t0, t1, dst); break;
+        default: cubic_extract(src, t0, t1, dst); break;
+    }
+}
+
+// dst must hold 2*count + 1 points: the halves are dst[0..count] and dst[count..2*count]
+void chop_curve_half(const Point src[], int count, Point dst[]) {
+    switch (count) {
+        case 1: line_chop(src, 0.5f, dst); break;
+        case 2: quad_chop(src, 0.5f, dst); break;
+        default: cubic_chop(src, 0.5f, dst); break;
+    }
+}
+
+// Returns t where the (monotonic) curve's coordinate in axis (0 or 1) equals
+// value, which must be between its end points.
+float solve_mono(const Point pts[], int count, int axis, float value) {
+    const float a = coord(pts[0], axis),
+                b = coord(pts[1], axis);
+    float roots[3];
+    int n = 0;
+    switch (count) {
+        case 1:
+            roots[0] = (value - a) / (b - a);
+            n = float_is_unit(roots[0]) ? 1 : 0;
+            break;
+        case 2: {
+            const float c = coord(pts[2], axis);
+            n = quadratic_unit_roots(a - 2*b + c, 2*(b - a), a - value, roots);
+        } break;
+        default: {
+            const float c = coord(pts[2], axis),
+                        d = coord(pts[3], axis);
+            n = cubic_unit_roots(d - 3*c + 3*b - a, 3*(c - 2*b + a), 3*(b - a), a - value, roots);
+        } break;
+    }
+    if (n > 0) {
+        return roots[0];
+    }
+    // Since we're monotonic, the root must exist, so we were just
+    // (numerically) too close to one of our ends.
+    return std::abs(value - a) < std::abs(value - coord(pts[count], axis)) ? 0 : 1;
+}
+
+// Returns t for the point on the (monotonic) curve nearest p, which is near the curve
+float solve_mono(const Point pts[], int count, Point p) {
+    const Point d = pts[count] - pts[0];
+    const int axis = std::abs(d.y) > std::abs(d.x) ? 1 : 0;
+    return solve_mono(pts, count, axis, coord(p, axis));
+}
+
+// The curves from the input paths, which the edges refer back to, so that the
+// pieces which survive can be rejoined into the original curves.
+struct Curve {
+    Point m_pts[4];
+    int   m_count;      // 1, 2, 3 : line, quad, cubic
+};
+
+struct Edge {
+    Point m_pts[4];
+    int   m_count;      // 1, 2, 3 : line, quad, cubic
+    int   m_wind[2];    // winding contribution to each operand (in the direction of the edge)
+    int   m_curve;      // index into the curves, and the range of it we cover
+    float m_T0, m_T1;   // (reversed if m_T0 > m_T1)
+    int   m_v0 = -1,
+          m_v1 = -1;    // indices of our end points in the merged vertices
+    bool  m_dead = false;
+
+    Point start() const { return m_pts[0]; }
+    Point end() const { return m_pts[m_count]; }
+    Point eval(float t) const { return eval_curve(m_pts, m_count, t); }
+
+    // We're monotonic, so our end points are our bounds
+    Rect bounds() const { return Rect::Bounds(this->start(), this->end()); }
+
+    // The directions we leave our start, and arrive at our end
+    Point startDir() const {
+        for (int i = 1; i <= m_count; ++i) {
+            if (m_pts[i] != m_pts[0]) {
+                return m_pts[i] - m_pts[0];
+            }
+        }
+        return {0, 0};
+    }
+    Point endDir() const {
+        for (int i = m_count - 1; i >= 0; --i) {
+            if (m_pts[i] != m_pts[m_count]) {
+                return m_pts[m_count] - m_pts[i];
+            }
+        }
+        return {0, 0};
+    }
+
+    void reverse() {
+        std::reverse(m_pts, m_pts + m_count + 1);
+        std::swap(m_T0, m_T1);
+        std::swap(m_v0, m_v1);
+        m_wind[0] = -m_wind[0];
+        m_wind[1] = -m_wind[1];
+    }
+
+    float solve(int axis, float value) const { return solve_mono(m_pts, m_count, axis, value); }
+
+    // Returns our contribution to the winding (of operand k) of a ray from p
+    // to +infinity, crossing the edges whose range in axis contains p (so
+    // axis 1 is a horizontal ray). Like Path::contains, we include our low
+    // end but not our high end, so a ray through a vertex counts once.
+    int winding(int axis, Point p, int k) const {
+        const float a = coord(this->start(), axis),
+                    b = coord(this->end(), axis),
+                    v = coord(p, axis);
+        if (a == b || v < std::min(a, b) || v >= std::max(a, b)) {
+            return 0;
+        }
+        const int other = 1 - axis;
+        const float o0 = coord(this->start(), other),
+                    o1 = coord(this->end(), other),
+                    po = coord(p, other);
+        if (po >= std::max(o0, o1)) {
+            return 0;
+        }
+        if (po >= std::min(o0, o1) && coord(this->eval(this->solve(axis, v)), other) <= po) {
+            return 0;
+        }
+        // a +X ray counts edges going down (+Y) as +1, so that the inside
+        // of the edge is on its left (cw) side; a +Y ray counts edges going left.
+        const int dir = axis == 1 ? (b > a ? 1 : -1) : (b < a ? 1 : -1);
+        return dir * m_wind[k];
+    }
+};
+
+bool is_flat(const Point pts[], int count, float eps) {
+    const Point chord = pts[count] - pts[0];
+    const float len = chord.length();
+    for (int i = 1; i < count; ++i) {
+        const Point v = pts[i] - pts[0];
+        const float dist = len > 0 ? std::abs(Point::Cross(chord, v)) / len : v.length();
+        if (dist > eps) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool overlaps(const Rect& a, const Rect& b, float eps) {
+    return a.left <= b.right + eps && b.left <= a.right + eps &&
+           a.top <= b.bottom + eps && b.top <= a.bottom + eps;
+}
+
+// A (s, u) pair of parameters on two edges where they meet
+using TPair = std::pair<float, float>;
+
+// Returns the number of intersections written to out (at most 4, if the lines are collinear)
+int intersect_lines(Point a0, Point a1, Point b0, Point b1, float eps, TPair out[4]) {
+    const Point da = a1 - a0,
+                db = b1 - b0;
+    const float la = da.length(),
+                lb = db.length();
+    if (la == 0 || lb == 0) {
+        return 0;
+    }
+
+    const float denom = Point::Cross(da, db);
+    if (std::abs(denom) <= 1.0e-6f * la * lb) {
+        // parallel: we only care if they are collinear, in which case each
+        // end point that lies on the other line is an intersection.
+        if (std::abs(Point::Cross(da, b0 - a0)) > eps * la ||
+            std::abs(Point::Cross(da, b1 - a0)) > eps * la) {
+            return 0;
+        }
+        const float sl = eps / la,
+                    ul = eps / lb;
+        int n = 0;
+        for (int i = 0; i < 2; ++i) {
+            const float s = Point::Dot(i ? b1 - a0 : b0 - a0, da) / (la * la);
+            if (s >= -sl && s <= 1 + sl) {
+                out[n++] = {pin_to_unit(s), (float)i};
+            }
+            const float u = Point::Dot(i ? a1 - b0 : a0 - b0, db) / (lb * lb);
+            if (u >= -ul && u <= 1 + ul) {
+                out[n++] = {(float)i, pin_to_unit(u)};
+            }
+        }
+        return n;
+    }
+
+    const Point w = b0 - a0;
+    const float s = Point::Cross(w, db) / denom,
+                u = Point::Cross(w, da) / denom;
+    const float sl = eps / la,
+                ul = eps / lb;
+    if (s >= -sl && s <= 1 + sl && u >= -ul && u <= 1 + ul) {
+        out[0] = {pin_to_unit(s), pin_to_unit(u)};
+        return 1;
+    }
+    return 0;
+}
+
+// Subdivides whichever curve isn't flat (or is larger) until both are flat,
+// then intersects their chords. The results are mapped back into [a0..a1] and [b0..b1].
+void intersect_curves(const Point a[], int na, float a0, float a1,
+                      const Point b[], int nb, float b0, float b1,
+                      float eps, int depth, std::vector<TPair>* out) {
+    const Rect ra = Rect::Bounds(a[0], a[na]),
+               rb = Rect::Bounds(b[0], b[nb]);
+    if (!overlaps(ra, rb, eps)) {
+        return;
+    }
+
+    const bool flatA = is_flat(a, na, eps),
+               flatB = is_flat(b, nb, eps);
+    if ((flatA && flatB) || depth >= kMaxSubdivideDepth) {
+        TPair local[4];
+        const int n = intersect_lines(a[0], a[na], b[0], b[nb], eps, local);
+        for (int i = 0; i < n; ++i) {
+            auto [s, u] = local[i];
+            // Where the chords meet is close to the curves, but t along a chord
+            // can be far from t along its curve (e.g. a flat quad whose control
+            // point is near one end), so we solve for the curves' t there.
+            if (na > 1) {
+                s = solve_mono(a, na, lerp(a[0], a[na], s));
+            }
+            if (nb > 1) {
+                u = solve_mono(b, nb, lerp(b[0], b[nb], u));
+            }
+            out->push_back({a0 + s * (a1 - a0), b0 + u * (b1 - b0)});
+        }
+        return;
+    }
+
+    Point tmp[7];
+    const bool splitA = !flatA && (flatB || ra.width() + ra.height() >= rb.width() + rb.height());
+    if (splitA) {
+        chop_curve_half(a, na, tmp);
+        const float am = (a0 + a1) * 0.5f;
+        intersect_curves(tmp, na, a0, am, b, nb, b0, b1, eps, depth + 1, out);
+        intersect_curves(tmp + na, na, am, a1, b, nb, b0, b1, eps, depth + 1, out);
+    } else {
+        chop_curve_half(b, nb, tmp);
+        const float bm = (b0 + b1) * 0.5f;
+        intersect_curves(a, na, a0, a1, tmp, nb, b0, bm, eps, depth + 1, out);
+        intersect_curves(a, na, a0, a1, tmp + nb, nb, bm, b1, eps, depth + 1, out);
+    }
+}
+
+bool same_edge(const Edge& a, const Edge& b) {
+    if (a.m_count != b.m_count) {
+        return false;
+    }
+    const int n = a.m_count;
+    bool forward = true,
+         backward = true;
+    for (int i = 0; i <= n; ++i) {
+        forward = forward && a.m_pts[i] == b.m_pts[i];
+        backward = backward && a.m_pts[i] == b.m_pts[n - i];
+    }
+    return forward || backward;
+}
+
+// The path fill types, plus positive (for SimplifyPositive)
+enum class FillRule : uint8_t {
+    winding, evenodd, positive,
+};
+
+FillRule fill_rule(const Path& path) {
+    return path.fillType() == PathFillType::evenodd ? FillRule::evenodd : FillRule::winding;
+}
+
+bool is_inside(int winding, FillRule rule) {
+    switch (rule) {
+        case FillRule::winding:  return winding != 0;
+        case FillRule::evenodd:  return (winding & 1) != 0;
+        case FillRule::positive: return winding > 0;
+    }
+    return false;
+}
+
+bool op_result(PathOp op, bool a, bool b) {
+    switch (op) {
+        case PathOp::kUnion:      return a || b;
+        case PathOp::kIntersect:  return a && b;
+        case PathOp::kDifference: return a && !b;
+        case PathOp::kXor:        return a != b;
+    }
+    return false;
+}
+
+// Merges points that are within eps of each other, using a hash grid so each
+// lookup only has to look at its neighboring cells.
+class VertexMap {
+    std::unordered_map<uint64_t, std::vector<int>> m_grid;
+    std::vector<Point> m_verts;
+    float m_invCell;
+    float m_eps;
+
+    static uint64_t Key(int64_t x, int64_t y) {
+        return (uint64_t)(uint32_t)x << 32 | (uint32_t)y;
+    }
+
+public:
+    VertexMap(float eps, size_t reserve) : m_invCell(1 / (2 * eps)), m_eps(eps) {
+        m_grid.reserve(reserve);
+        m_verts.reserve(reserve);
+    }
+
+    const Point& operator[](int index) const { return m_verts[index]; }
+
+    int findOrAdd(Point p) {
+        const int64_t cx = (int64_t)std::floor(p.x * m_invCell),
+                      cy = (int64_t)std::floor(p.y * m_invCell);
+        for (int64_t y = cy - 1; y <= cy + 1; ++y) {
+            for (int64_t x = cx - 1; x <= cx + 1; ++x) {
+                auto iter = m_grid.find(Key(x, y));
+                if (iter == m_grid.end()) {
+                    continue;
+                }
+                for (int index : iter->second) {
+                    if ((m_verts[index] - p).length() <= m_eps) {
+                        return index;
+                    }
+                }
+            }
+        }
+        const int index = castTo<int>(m_verts.size());
+        m_verts.push_back(p);
+        m_grid[Key(cx, cy)].push_back(index);
+        return index;
+    }
+};
+
+// Buckets the live edges by their range in one axis, for the winding queries
+class Bands {
+    std::vector<uint32_t> m_start;  // bandCount + 1 offsets into m_edges
+    std::vector<uint32_t> m_edges;
+    float m_min = 0,
+          m_scale = 0;
+    int   m_axis;
+
+    size_t band(float v) const {
+        const float b = (v - m_min) * m_scale;
+        return b <= 0 ? 0 : std::min((size_t)b, m_start.size() - 2);
+    }
+
+public:
+    Bands(const std::vector<Edge>& edges, int axis) : m_axis(axis) {
+        float lo = std::numeric_limits<float>::infinity(),
+              hi = -lo;
+        size_t live = 0;
+        for (const auto& e : edges) {
+            if (!e.m_dead) {
+                lo = std::min({lo, coord(e.start(), axis), coord(e.end(), axis)});
+                hi = std::max({hi, coord(e.start(), axis), coord(e.end(), axis)});
+                live += 1;
+            }
+        }
+        const size_t count = std::max<size_t>(1, std::min(kMaxBands, live / 4));
+        if (live > 0 && hi > lo) {
+            m_min = lo;
+            m_scale = count / (hi - lo);
+        }
+
+        std::vector<std::pair<size_t, size_t>> ranges(edges.size());
+        m_start.assign(count + 1, 0);
+        for (size_t i = 0; i < edges.size(); ++i) {
+            if (!edges[i].m_dead) {
+                const float a = coord(edges[i].start(), axis),
+                            b = coord(edges[i].end(), axis);
+                ranges[i] = {this->band(std::min(a, b)), this->band(std::max(a, b))};
+                for (size_t j = ranges[i].first; j <= ranges[i].second; ++j) {
+                    m_start[j + 1] += 1;
+                }
+            }
+        }
+        for (size_t j = 0; j < count; ++j) {
+            m_start[j + 1] += m_start[j];
+        }
+        m_edges.resize(m_start[count]);
+        std::vector<uint32_t> fill(m_start.begin(), m_start.end() - 1);
+        for (size_t i = 0; i < edges.size(); ++i) {
+            if (!edges[i].m_dead) {
+                for (size_t j = ranges[i].first; j <= ranges[i].second; ++j) {
+                    m_edges[fill[j]++] = castTo<uint32_t>(i);
+                }
+            }
+        }
+    }
+
+    Span<const uint32_t> lookup(Point p) const {
+        const size_t b = this->band(coord(p, m_axis));
+        return {m_edges.data() + m_start[b], m_start[b + 1] - m_start[b]};
+    }
+};
+
+class OpBuilder {
+    std::vector<Curve> m_curves;
+    std::vector<Edge>  m_edges;
+    FillRule           m_fill[2];
+    float              m_eps = 0;
+
+public:
+    OpBuilder(const Path& a, FillRule ruleA, const Path& b, FillRule ruleB) {
+        m_fill[0] = ruleA;
+        m_fill[1] = ruleB;
+
+        const Rect bounds = a.bounds().join(b.bounds());
+        const float size = std::max({std::abs(bounds.left), std::abs(bounds.top),
+                                     std::abs(bounds.right), std::abs(bounds.bottom),
+                                     bounds.width(), bounds.height()});
+        m_eps = std::max(size * kRelativeEpsilon, std::numeric_limits<float>::min());
+
+        this->addEdges(a, 0);
+        this->addEdges(b, 1);
+    }
+
+    rcp<Path> run(PathOp op) {
+        this->split();
+        this->mergeCoincident();
+        this->classify(op);
+        return this->link();
+    }
+
+private:
+    void addCurve(const Point pts[], int count, int operand) {
+        bool degenerate = true;
+        for (int i = 1; i <= count; ++i) {
+            degenerate = degenerate && pts[i] == pts[0];
+        }
+        if (degenerate) {
+            return;
+        }
+
+        Curve c;
+        std::copy(pts, pts + count + 1, c.m_pts);
+        c.m_count = count;
+        const int curveIndex = castTo<int>(m_curves.size());
+        m_curves.push_back(c);
+
+        float t[5];
+        int n = 0;
+        switch (count) {
+            case 2: n = quad_extrema(pts, t); break;
+            case 3: n = cubic_extrema(pts, t); break;
+            default: break;
+        }
+        t[n] = 1;
+
+        float prevT = 0;
+        for (int i = 0; i <= n; ++i) {
+            Edge e;
+            extract_curve(pts, count, prevT, t[i], e.m_pts);
+            e.m_count = count;
+            e.m_wind[operand] = 1;
+            e.m_wind[1 - operand] = 0;
+            e.m_curve = curveIndex;
+            e.m_T0 = prevT;
+            e.m_T1 = t[i];
+            prevT = t[i];
+
+            if (e.start() == e.end()) {
+                continue;   // monotonic, so this must be (nearly) a point
+            }
+            pin_monotonic(e.m_pts, count);
+            m_edges.push_back(e);
+        }
+    }
+
+    // Includes the implied line that closes each contour, since we're operating on the fill
+    void addEdges(const Path& path, int operand) {
+        const Point* p = path.points().data();
+        Point start = {0, 0},
+              last = {0, 0};
+
+        auto closeContour = [&]() {
+            const Point pts[] = {last, start};
+            this->addCurve(pts, 1, operand);
+            last = start;
+        };
+
+        for (auto v : path.verbs()) {
+            switch (v) {
+                case PathVerb::move:
+                    closeContour();
+                    start = last = *p++;
+                    break;
+                case PathVerb::line: {
+                    const Point pts[] = {last, p[0]};
+                    this->addCurve(pts, 1, operand);
+                    last = p[0];
+                    p += 1;
+                } break;
+                case PathVerb::quad: {
+                    const Point pts[] = {last, p[0], p[1]};
+                    this->addCurve(pts, 2, operand);
+                    last = p[1];
+                    p += 2;
+                } break;
+                case PathVerb::cubic: {
+                    const Point pts[] = {last, p[0], p[1], p[2]};
+                    this->addCurve(pts, 3, operand);
+                    last = p[2];
+                    p += 3;
+                } break;
+                case PathVerb::close:
+                    closeContour();
+                    break;
+            }
+        }
+        closeContour();
+    }
+
+    // Finds the intersections between all of the edges, and splits them there
+    void split() {
+        struct Hit {
+            int   m_edge;
+            float m_t;
+            Point m_p;
+            int   m_vert;
+
+            bool operator<(const Hit& o) const {
+                return m_edge < o.m_edge || (m_edge == o.m_edge && m_t < o.m_t);
+            }
+        };
+        std::vector<Hit> hits;
+        std::vector<Rect> bounds(m_edges.size());
+        std::vector<int> order(m_edges.size());
+        for (size_t i = 0; i < m_edges.size(); ++i) {
+            bounds[i] = m_edges[i].bounds();
+            order[i] = castTo<int>(i);
+        }
+        std::sort(order.begin(), order.end(), [&](int a, int b) {
+            return bounds[a].left < bounds[b].left;
+        });
+
+        // Returns 0 or 1 if p is (within eps of) that end of the edge, else -1
+        auto whichEnd = [this](const Edge& e, Point p) {
+            return (p - e.start()).length() <= m_eps ? 0 :
+                   (p - e.end()).length() <= m_eps ? 1 : -1;
+        };
+
+        std::vector<int> active;
+        std::vector<TPair> pairs;
+        for (int i : order) {
+            const float left = bounds[i].left - m_eps;
+            active.erase(std::remove_if(active.begin(), active.end(), [&](int j) {
+                return bounds[j].right < left;
+            }), active.end());
+
+            const Edge& ei = m_edges[i];
+            for (int j : active) {
+                const Edge& ej = m_edges[j];
+                if (!overlaps(bounds[i], bounds[j], m_eps) || same_edge(ei, ej)) {
+                    continue;
+                }
+                pairs.clear();
+                if (ei.m_count == 1 && ej.m_count == 1) {
+                    TPair lineHits[4];
+                    const int n = intersect_lines(ei.start(), ei.end(), ej.start(), ej.end(),
+                                                  m_eps, lineHits);
+                    pairs.assign(lineHits, lineHits + n);
+                } else {
+                    intersect_curves(ei.m_pts, ei.m_count, 0, 1, ej.m_pts, ej.m_count, 0, 1,
+                                     m_eps, 0, &pairs);
+                }
+                for (auto [s, u] : pairs) {
+                    const Point pi = ei.eval(s),
+                                pj = ej.eval(u);
+                    const int endI = whichEnd(ei, pi),
+                              endJ = whichEnd(ej, pj);
+                    // If either is at an existing end point, that is where they meet
+                    Point p = (pi + pj) * 0.5f;
+                    if (endI >= 0) {
+                        p = endI ? ei.end() : ei.start();
+                    } else if (endJ >= 0) {
+                        p = endJ ? ej.end() : ej.start();
+                    }
+                    if (endI < 0) {
+                        hits.push_back({i, s, p, -1});
+                    }
+                    if (endJ < 0) {
+                        hits.push_back({j, u, p, -1});
+                    }
+                }
+            }
+            active.push_back(i);
+        }
+
+        // Each hit becomes a vertex once, and is shared by both of its edges,
+        // so that where several crossings fall within eps of each other, the
+        // edges agree on which vertex they meet at. (Snapping each edge's hits
+        // to its previous one instead can join a crossing to different
+        // vertices on its two edges, and the edges then cross between them.)
+        VertexMap verts(m_eps, m_edges.size() + hits.size());
+        for (const Edge& e : m_edges) {
+            verts.findOrAdd(e.start());
+            verts.findOrAdd(e.end());
+        }
+        for (Hit& h : hits) {
+            h.m_vert = verts.findOrAdd(h.m_p);
+        }
+
+        std::vector<Edge> pieces;
+        pieces.reserve(m_edges.size() * 2);
+
+        auto addPiece = [&](const Edge& e, float s0, int v0, float s1, int v1) {
+            if (v0 == v1) {
+                return;
+            }
+            Edge piece = e;
+            extract_curve(e.m_pts, e.m_count, s0, s1, piece.m_pts);
+            piece.m_T0 = e.m_T0 + s0 * (e.m_T1 - e.m_T0);
+            piece.m_T1 = e.m_T0 + s1 * (e.m_T1 - e.m_T0);
+            piece.m_v0 = v0;
+            piece.m_v1 = v1;
+            piece.m_pts[0] = verts[piece.m_v0];
+            piece.m_pts[piece.m_count] = verts[piece.m_v1];
+            pin_monotonic(piece.m_pts, piece.m_count);
+            // Moving the end points of a piece only a few eps long swamps its
+            // control points, so its tangents (which order the edges around a
+            // vertex) are noise. Its chord is the better guide.
+            const Point chord = piece.end() - piece.start();
+            if (chord.length() <= 16 * m_eps) {
+                for (int k = 1; k < piece.m_count; ++k) {
+                    piece.m_pts[k] = piece.start() + chord * ((float)k / piece.m_count);
+                }
+            }
+            pieces.push_back(piece);
+        };
+
+        std::sort(hits.begin(), hits.end());
+        auto hit = hits.begin();
+        for (size_t i = 0; i < m_edges.size(); ++i) {
+            const Edge& e = m_edges[i];
+            const int endV = verts.findOrAdd(e.end());
+            float prevT = 0;
+            int prevV = verts.findOrAdd(e.start());
+            for (; hit != hits.end() && hit->m_edge == (int)i; ++hit) {
+                if (hit->m_vert == prevV || hit->m_vert == endV) {
+                    continue;
+                }
+                addPiece(e, prevT, prevV, hit->m_t, hit->m_vert);
+                prevT = hit->m_t;
+                prevV = hit->m_vert;
+            }
+            addPiece(e, prevT, prevV, 1, endV);
+        }
+        m_edges.swap(pieces);
+    }
+
+    // Returns true if a and b (which share their end points) follow the same path.
+    // Their parameterizations may differ (e.g. flat quads with different control
+    // points), so we compare them where they cross the same line, rather than
+    // at the same t.
+    bool coincident(const Edge& a, const Edge& b) const {
+        const Point d = a.end() - a.start();
+        const int axis = std::abs(d.y) > std::abs(d.x) ? 1 : 0;
+        for (float t : {0.25f, 0.5f, 0.75f}) {
+            const Point p = a.eval(t),
+                        q = b.eval(b.solve(axis, coord(p, axis)));
+            if ((p - q).length() > 2 * m_eps) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Edges that connect the same two vertices, and follow the same path, are
+    // merged into one with their combined winding.
+    void mergeCoincident() {
+        std::unordered_map<uint64_t, std::vector<int>> byEnds;
+        for (size_t i = 0; i < m_edges.size(); ++i) {
+            Edge& e = m_edges[i];
+            const uint64_t key = (uint64_t)std::min(e.m_v0, e.m_v1) << 32 |
+                                 (uint32_t)std::max(e.m_v0, e.m_v1);
+            auto& bucket = byEnds[key];
+            for (int j : bucket) {
+                Edge& other = m_edges[j];
+                const bool reversed = other.m_v0 != e.m_v0;
+                if (this->coincident(e, other)) {
+                    const int sign = reversed ? -1 : 1;
+                    other.m_wind[0] += sign * e.m_wind[0];
+                    other.m_wind[1] += sign * e.m_wind[1];
+                    e.m_dead = true;
+                    break;
+                }
+            }
+            if (!e.m_dead) {
+                bucket.push_back(castTo<int>(i));
+            }
+        }
+        for (auto& e : m_edges) {
+            if (e.m_wind[0] == 0 && e.m_wind[1] == 0) {
+                e.m_dead = true;
+            }
+        }
+    }
+
+    // Returns the winding (of each operand) on our left (cw) side, by casting
+    // a ray across the edge from its midpoint.
+    void leftWinding(size_t i, const Bands bands[2], int winding[2]) const {
+        const Edge& e = m_edges[i];
+        const Point p = e.eval(0.5f);
+        const Point tan = e.m_count == 1 ? e.end() - e.start()
+                                         : eval_curve(e.m_pts, e.m_count, 0.5f + 1.0f/1024) -
+                                           eval_curve(e.m_pts, e.m_count, 0.5f - 1.0f/1024);
+        // cast the ray across the edge, rather than along it
+        const int axis = std::abs(tan.y) >= std::abs(tan.x) ? 1 : 0;
+
+        int far[2] = {0, 0};
+        for (uint32_t j : bands[axis].lookup(p)) {
+            if (j != i) {
+                far[0] += m_edges[j].winding(axis, p, 0);
+                far[1] += m_edges[j].winding(axis, p, 1);
+            }
+        }
+        // Our left side is on the far side of the ray if we go up (axis 1) or
+        // right (axis 0), else it's the side the ray starts on, which differs
+        // from the far side by our own winding.
+        const bool leftIsFar = axis == 1 ? tan.y < 0 : tan.x > 0;
+        for (int k = 0; k < 2; ++k) {
+            winding[k] = leftIsFar ? far[k] : far[k] + e.m_wind[k];
+        }
+    }
+
+    // A half edge is an edge in one direction or the other: 2*index (forward)
+    // or 2*index + 1 (reversed). It bounds the face on its left (cw) side.
+    int halfEnd(int h) const { return h & 1 ? m_edges[h >> 1].m_v0 : m_edges[h >> 1].m_v1; }
+    Point halfStartDir(int h) const {
+        return h & 1 ? -m_edges[h >> 1].endDir() : m_edges[h >> 1].startDir();
+    }
+
+    // Returns, for each half edge h, the one that continues h's face: the
+    // sharpest left turn where h ends (like link() takes), or back along h if
+    // there is no other.
+    //
+    // Rather than comparing turns from each h (which wrap unpredictably at
+    // +-pi when an edge leaves along h's twin), we sort each vertex's half
+    // edges around it once; the next one is then the twin's neighbor, so
+    // every face we trace closes on itself.
+    std::vector<int> faceSuccessors() const {
+        std::vector<std::vector<int>> outgoing;
+        for (size_t i = 0; i < m_edges.size(); ++i) {
+            const Edge& e = m_edges[i];
+            if (!e.m_dead) {
+                outgoing.resize(std::max(outgoing.size(), (size_t)std::max(e.m_v0, e.m_v1) + 1));
+                outgoing[e.m_v0].push_back(castTo<int>(2*i));
+                outgoing[e.m_v1].push_back(castTo<int>(2*i + 1));
+            }
+        }
+
+        constexpr float kPI = 3.14159265f;
+        constexpr float kSameAngle = 1.0f/1024;
+        auto angleOf = [](Point v) { return std::atan2(v.y, v.x); };
+
+        std::vector<int> next(2 * m_edges.size(), -1);
+        std::vector<int> slot(2 * m_edges.size(), -1);
+        struct Spoke {
+            int   m_half;
+            float m_angle, m_bend;
+        };
+        std::vector<Spoke> spokes;
+        for (auto& around : outgoing) {
+            spokes.clear();
+            for (int h : around) {
+                const Edge& e = m_edges[h >> 1];
+                const Point dir = this->halfStartDir(h);
+                spokes.push_back({h, angleOf(dir), 0});
+                // Edges leaving in the same direction (e.g. tangent curves)
+                // are told apart by the direction to their midpoints.
+                const Point mid = e.eval(0.5f) - (h & 1 ? e.end() : e.start());
+                spokes.back().m_bend = std::atan2(Point::Cross(dir, mid), Point::Dot(dir, mid));
+            }
+            std::sort(spokes.begin(), spokes.end(), [](const Spoke& a, const Spoke& b) {
+                return a.m_angle < b.m_angle;
+            });
+            // Start after the widest gap, so no run of (nearly) equal angles
+            // straddles the wrap at +-pi, then order each run by bend.
+            const size_t n = spokes.size();
+            size_t first = 0;
+            float widest = -1;
+            for (size_t k = 0; k < n; ++k) {
+                const float gap = k + 1 < n ? spokes[k + 1].m_angle - spokes[k].m_angle
+                                            : spokes[0].m_angle + 2 * kPI - spokes[k].m_angle;
+                if (gap > widest) {
+                    widest = gap;
+                    first = (k + 1) % n;
+                }
+            }
+            std::rotate(spokes.begin(), spokes.begin() + first, spokes.end());
+            for (size_t k = 1; k < n; ++k) {
+                if (spokes[k].m_angle < spokes[k - 1].m_angle) {
+                    spokes[k].m_angle += 2 * kPI;
+                }
+            }
+            for (size_t start = 0, end; start < n; start = end) {
+                for (end = start + 1; end < n &&
+                     spokes[end].m_angle - spokes[end - 1].m_angle < kSameAngle; ++end) {}
+                std::sort(spokes.begin() + start, spokes.begin() + end,
+                          [](const Spoke& a, const Spoke& b) { return a.m_bend < b.m_bend; });
+            }
+            for (size_t k = 0; k < n; ++k) {
+                around[k] = spokes[k].m_half;
+                slot[around[k]] = castTo<int>(k);
+            }
+        }
+
+        // The sharpest left (cw) turn from h leaves just before h's twin, in
+        // order of increasing angle.
+        for (size_t h = 0; h < next.size(); ++h) {
+            if (!m_edges[h >> 1].m_dead) {
+                const auto& around = outgoing[this->halfEnd(castTo<int>(h))];
+                const size_t n = around.size();
+                next[h] = around[(slot[h ^ 1] + n - 1) % n];
+            }
+        }
+        return next;
+    }
+
+    // Keeps the edges that separate inside from outside (of the result), and
+    // orients them so that the inside is on their left (cw) side.
+    //
+    // Rather than casting a ray from each edge, we trace the faces that the
+    // edges enclose, and cast one from each face's longest edge. An edge is on
+    // the boundary if the faces on its two sides differ, which is then
+    // consistent where edges meet, even where crossings fall so close together
+    // that a ray from a short edge between them would be at the mercy of
+    // rounding, and so every contour in the result closes.
+    void classify(PathOp op) {
+        const Bands bands[2] = {Bands(m_edges, 0), Bands(m_edges, 1)};
+
+        const std::vector<int> next = this->faceSuccessors();
+
+        std::vector<int> faceOf(2 * m_edges.size(), -1);
+        std::vector<char> faceIn;
+        for (size_t h = 0; h < faceOf.size(); ++h) {
+            if (m_edges[h >> 1].m_dead || faceOf[h] >= 0) {
+                continue;
+            }
+            const int face = castTo<int>(faceIn.size());
+            int longest = castTo<int>(h);
+            float longestLen = 0;
+            for (int cur = castTo<int>(h); faceOf[cur] < 0; cur = next[cur]) {
+                faceOf[cur] = face;
+                const Edge& e = m_edges[cur >> 1];
+                const float len = (e.end() - e.start()).length();
+                if (len > longestLen) {
+                    longest = cur;
+                    longestLen = len;
+                }
+            }
+
+            int winding[2];
+            this->leftWinding(longest >> 1, bands, winding);
+            if (longest & 1) {
+                // we're on the right side of the edge
+                winding[0] -= m_edges[longest >> 1].m_wind[0];
+                winding[1] -= m_edges[longest >> 1].m_wind[1];
+            }
+            faceIn.push_back(op_result(op, is_inside(winding[0], m_fill[0]),
+                                           is_inside(winding[1], m_fill[1])));
+        }
+
+        for (size_t i = 0; i < m_edges.size(); ++i) {
+            Edge& e = m_edges[i];
+            if (e.m_dead) {
+                continue;
+            }
+            const bool leftIn = faceIn[faceOf[2*i]],
+                       rightIn = faceIn[faceOf[2*i + 1]];
+            if (leftIn == rightIn) {
+                e.m_dead = true;
+            } else if (!leftIn) {
+                e.reverse();
+            }
+        }
+    }
+
+    bool canMerge(const Edge& a, const Edge& b) const {
+        if (a.m_count == 1 && b.m_count == 1) {
+            const Point chord = b.end() - a.start();
+            const float len = chord.length();
+            return len > 0 && Point::Dot(a.end() - a.start(), b.end() - b.start()) > 0 &&
+                   std::abs(Point::Cross(chord, a.end() - a.start())) <= 0.5f * m_eps * len;
+        }
+        return a.m_curve == b.m_curve && a.m_T1 == b.m_T0 &&
+               (a.m_T1 > a.m_T0) == (b.m_T1 > b.m_T0);
+    }
+
+    rcp<Path> link() {
+        std::vector<std::vector<int>> outgoing;
+        for (size_t i = 0; i < m_edges.size(); ++i) {
+            const Edge& e = m_edges[i];
+            if (!e.m_dead) {
+                if ((size_t)e.m_v0 >= outgoing.size()) {
+                    outgoing.resize(e.m_v0 + 1);
+                }
+                outgoing[e.m_v0].push_back(castTo<int>(i));
+            }
+        }
+
+        PathBuilder builder;
+        std::vector<char> used(m_edges.size(), 0);
+        std::vector<int> loop;
+        for (size_t first = 0; first < m_edges.size(); ++first) {
+            if (m_edges[first].m_dead || used[first]) {
+                continue;
+            }
+            loop.clear();
+            const int startV = m_edges[first].m_v0;
+            int cur = castTo<int>(first);
+            while (true) {
+                used[cur] = 1;
+                loop.push_back(cur);
+                const int v = m_edges[cur].m_v1;
+                if (v == startV) {
+                    break;
+                }
+                // Where several edges leave a vertex, take the sharpest left turn,
+                // which keeps regions that just touch here in separate contours.
+                const Point in = m_edges[cur].endDir();
+                int best = -1;
+                float bestAngle = 0;
+                if ((size_t)v < outgoing.size()) {
+                    for (int cand : outgoing[v]) {
+                        if (used[cand]) {
+                            continue;
+                        }
+                        const Point out = m_edges[cand].startDir();
+                        const float angle = std::atan2(Point::Dot(out, in.cw()), Point::Dot(out, in));
+                        if (best < 0 || angle > bestAngle) {
+                            best = cand;
+                            bestAngle = angle;
+                        }
+                    }
+                }
+                if (best < 0) {
+                    break;  // shouldn't happen, but if it does we close what we have
+                }
+                cur = best;
+            }
+            this->emitLoop(loop, &builder);
+        }
+        return builder.detach();
+    }
+
+    void emitLoop(const std::vector<int>& loop, PathBuilder* builder) const {
+        const size_t n = loop.size();
+        // start at an edge that can't be merged with the one before it
+        size_t start = 0;
+        for (size_t i = 0; i < n; ++i) {
+            if (!this->canMerge(m_edges[loop[(i + n - 1) % n]], m_edges[loop[i]])) {
+                start = i;
+                break;
+            }
+        }
+
+        builder->move(m_edges[loop[start]].start());
+        size_t i = 0;
+        while (i < n) {
+            const Edge& first = m_edges[loop[(start + i) % n]];
+            size_t j = i + 1;
+            while (j < n && this->canMerge(m_edges[loop[(start + j - 1) % n]],
+                                           m_edges[loop[(start + j) % n]])) {
+                j += 1;
+            }
+            const Edge& last = m_edges[loop[(start + j - 1) % n]];
+
+            if (first.m_count == 1) {
+                builder->line(last.end());
+            } else {
+                const Curve& c = m_curves[first.m_curve];
+                const float t0 = first.m_T0,
+                            t1 = last.m_T1;
+                Point pts[4];
+                extract_curve(c.m_pts, c.m_count, std::min(t0, t1), std::max(t0, t1), pts);
+                if (t0 > t1) {
+                    std::reverse(pts, pts + c.m_count + 1);
+                }
+                pts[c.m_count] = last.end();
+                if (c.m_count == 2) {
+                    builder->quad(pts[1], pts[2]);
+                } else {
+                    builder->cubic(pts[1], pts[2], pts[3]);
+                }
+            }
+            i = j;
+        }
+        builder->close();
+    }
+};
+
+} // namespace
+
+rcp<Path> PathOps::Op(const Path& a, const Path& b, PathOp op) {
+    return OpBuilder(a, fill_rule(a), b, fill_rule(b)).run(op);
+}
+
+rcp<Path> PathOps::Simplify(const Path& path) {
+    return Op(path, *Path::Empty(), PathOp::kUnion);
+}
+
+rcp<Path> PathOps::SimplifyPositive(const Path& path) {
+    return OpBuilder(path, FillRule::positive, *Path::Empty(), FillRule::winding)
+           .run(PathOp::kUnion);
+}
+
+//////////////////////////////////
+
+rcp<Path> SimplifyCache::simplify(const Path& path) {
+    auto matches = [&](const Entry& entry) { return *entry.m_source == path; };
+    auto make = [&]() {
+        return Entry{rcp<const Path>(safe_ref(&path)), PathOps::Simplify(path)};
+    };
+    return m_cache.findOrMake(path.contentHash(), matches, make).m_result;
+}
+
+SimplifyCache& SimplifyCache::Global() {
+    static SimplifyCache* gCache = new SimplifyCache;
+    return *gCache;
+}
+
+//////////////////////////////////
+
+void PathOps::Tests() {
+#ifdef DEBUG
+    auto count_verbs = [](const Path& path, PathVerb verb) {
+        int n = 0;
+        for (auto v : path.verbs()) {
+            n += v == verb;
+        }
+        return n;
+    };
+    auto as_evenodd = [](const Path& path) {
+        return Path::Make(path.points(), path.verbs(), PathFillType::evenodd);
+    };
+    // The result's contours don't overlap, and face the same way, so it
+    // fills the same with either fill type.
+    auto same_both_fills = [&](const Path& path) {
+        const auto eo = as_evenodd(path);
+        const Rect r = path.bounds();
+        for (int y = 0; y < 16; ++y) {
+            for (int x = 0; x < 16; ++x) {
+                const Point p = {r.left + r.width() * (x + 0.37f) / 16,
+                                 r.top + r.height() * (y + 0.61f) / 16};
+                if (path.contains(p) != eo->contains(p)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+
+    const Rect ra = {0, 0, 10, 10},
+               rb = {5, 5, 15, 15};
+    const auto a = Path::Rect(ra),
+               b = Path::Rect(rb, PathDirection::cw);
+
+    auto r = Op(*a, *b, PathOp::kUnion);
+    assert(count_verbs(*r, PathVerb::move) == 1);
+    assert(count_verbs(*r, PathVerb::line) == 8);
+    assert(r->contains({2, 2}) && r->contains({7, 7}) && r->contains({12, 12}));
+    assert(!r->contains({12, 2}) && !r->contains({2, 12}));
+    assert(same_both_fills(*r));
+
+    r = Op(*a, *b, PathOp::kIntersect);
+    assert(count_verbs(*r, PathVerb::line) == 4);
+    const Rect intersection = {5, 5, 10, 10};
+    assert(r->bounds() == intersection);
+    assert(r->contains({7, 7}) && !r->contains({2, 2}) && !r->contains({12, 12}));
+
+    r = Op(*a, *b, PathOp::kDifference);
+    assert(count_verbs(*r, PathVerb::line) == 6);
+    assert(r->contains({2, 2}) && !r->contains({7, 7}) && !r->contains({12, 12}));
+
+    r = Op(*a, *b, PathOp::kXor);
+    assert(count_verbs(*r, PathVerb::move) == 2);
+    assert(r->contains({2, 2}) && r->contains({12, 12}) && !r->contains({7, 7}));
+    assert(same_both_fills(*r));
+
+    // disjoint, and identical
+    const Rect far = {20, 0, 30, 10};
+    r = Op(*a, *Path::Rect(far), PathOp::kUnion);
+    assert(count_verbs(*r, PathVerb::move) == 2);
+    assert(Op(*a, *Path::Rect(far), PathOp::kIntersect)->empty());
+    r = Op(*a, *a, PathOp::kUnion);
+    assert(count_verbs(*r, PathVerb::line) == 4);
+    assert(r->bounds() == ra);
+    assert(Op(*a, *a, PathOp::kDifference)->empty());
+
+    // abutting squares lose their shared edge, and the collinear sides are joined
+    const Rect right = {10, 0, 20, 10},
+               both = {0, 0, 20, 10};
+    r = Op(*a, *Path::Rect(right), PathOp::kUnion);
+    assert(count_verbs(*r, PathVerb::move) == 1);
+    assert(count_verbs(*r, PathVerb::line) == 4);
+    assert(r->bounds() == both);
+
+    // a self-intersecting bow tie becomes two triangles
+    const Point bowtie[] = {{0, 0}, {10, 10}, {10, 0}, {0, 10}};
+    r = Simplify(*Path::Poly(bowtie, true));
+    assert(count_verbs(*r, PathVerb::move) == 2);
+    assert(r->contains({1, 5}) && r->contains({9, 5}) && !r->contains({5, 1}));
+    assert(same_both_fills(*r));
+
+    // overlapping circles in one path (like a variable glyph's contours), keeping their curves
+    PathBuilder builder;
+    builder.addCircle({0, 0}, 10);
+    builder.addCircle({12, 0}, 10);
+    const auto circles = builder.detach();
+    r = Simplify(*circles);
+    assert(count_verbs(*r, PathVerb::move) == 1);
+    assert(count_verbs(*r, PathVerb::line) == 0);
+    assert(count_verbs(*r, PathVerb::cubic) > 0);
+    assert(count_verbs(*r, PathVerb::cubic) <= count_verbs(*circles, PathVerb::cubic) + 2);
+    assert(r->contains({6, 0}) && r->contains({-8, 0}) && r->contains({20, 0}));
+    assert(same_both_fills(*r));
+
+    // ... but with evenodd, the overlap is a hole, leaving two crescents
+    r = Simplify(*as_evenodd(*circles));
+    assert(count_verbs(*r, PathVerb::move) == 2);
+    assert(!r->contains({6, 0}) && r->contains({-8, 0}) && r->contains({20, 0}));
+    assert(same_both_fills(*r));
+
+    // a hole (reversed contour) under winding stays a hole
+    builder.addRect({0, 0, 30, 30});
+    builder.addRect({10, 10, 20, 20}, PathDirection::cw);
+    r = Simplify(*builder.detach());
+    assert(count_verbs(*r, PathVerb::move) == 2);
+    assert(r->contains({5, 5}) && !r->contains({15, 15}));
+    assert(same_both_fills(*r));
+
+    // only positive (cw) windings count: a ccw contour erases what it overlaps,
+    // and adds nothing where it is alone
+    builder.addRect({0, 0, 20, 20}, PathDirection::cw);
+    builder.addRect({10, 10, 30, 30}, PathDirection::ccw);
+    r = SimplifyPositive(*builder.detach());
+    assert(count_verbs(*r, PathVerb::line) == 6);
+    assert(r->contains({5, 5}) && !r->contains({15, 15}) && !r->contains({25, 25}));
+    assert(same_both_fills(*r));
+    assert(SimplifyPositive(*Path::Circle({0, 0}, 10, PathDirection::ccw))->empty());
+
+    // ops agree with the operands' own contains(), away from the edges
+    const auto c0 = Path::Circle({10, 10}, 8),
+               c1 = Path::Oval({6, 4, 22, 13}, PathDirection::cw);
+    for (auto op : {PathOp::kUnion, PathOp::kIntersect, PathOp::kDifference, PathOp::kXor}) {
+        r = Op(*c0, *c1, op);
+        int mismatches = 0;
+        for (int y = 0; y < 24; ++y) {
+            for (int x = 0; x < 24; ++x) {
+                const Point p = {x + 0.5f, y + 0.5f};
+                mismatches += r->contains(p) != op_result(op, c0->contains(p), c1->contains(p));
+            }
+        }
+        assert(mismatches <= 4);   // points that are within a hair of an edge
+        assert(same_both_fills(*r));
+    }
+
+    // Simplify agrees with the source's own contains() on random self-crossing
+    // curves, away from the edges (where rounding may legitimately differ)
+    auto distance = [](const Polylines& lines, Point p) {
+        float best = std::numeric_limits<float>::infinity();
+        for (size_t c = 0; c < lines.count(); ++c) {
+            const auto pts = lines.points(c);
+            Point prev = pts.back();
+            for (Point pt : pts) {
+                const Point ab = pt - prev;
+                const float len2 = ab.dot(ab),
+                            t = len2 > 0 ? pin_float((p - prev).dot(ab) / len2, 0, 1) : 0;
+                best = std::min(best, (prev + ab * t - p).length());
+                prev = pt;
+            }
+        }
+        return best;
+    };
+    Random rand(2022);
+    Polylines lines;
+    for (int n = 0; n < 60; ++n) {
+        auto random_point = [&]() { return Point{rand.nextF(0, 100), rand.nextF(0, 100)}; };
+        builder.move(random_point());
+        for (int i = 0; i < 3 + n % 8; ++i) {
+            const Point p0 = random_point(),
+                        p1 = random_point(),
+                        p2 = random_point();
+            switch (rand.nextU() % 3) {
+                case 0:  builder.line(p0); break;
+                case 1:  builder.quad(p0, p1); break;
+                default: builder.cubic(p0, p1, p2); break;
+            }
+        }
+        builder.close();
+        auto src = builder.detach();
+        if (n & 1) {
+            src = as_evenodd(*src);
+        }
+        r = Simplify(*src);
+        assert(same_both_fills(*r));
+
+        lines.reset();
+        flatten(*src, 0.01f, &lines);
+        for (int y = 0; y < 25; ++y) {
+            for (int x = 0; x < 25; ++x) {
+                const Point p = {x * 4 + rand.nextF(0, 4), y * 4 + rand.nextF(0, 4)};
+                if (distance(lines, p) > 0.5f) {
+                    assert(r->contains(p) == src->contains(p));
+                }
+            }
+        }
+    }
+
+    // the cache matches on contents, not on the path object
+    SimplifyCache cache(4);
+    const auto first = cache.simplify(*circles);
+    const auto copy = Path::Make(circles->points(), circles->verbs());
+    assert(cache.simplify(*copy).get() == first.get());
+    assert(cache.count() == 1);
+    for (int i = 0; i < 8; ++i) {
+        cache.simplify(*Path::Circle({(float)i, 0}, 5));
+    }
+    assert(cache.count() <= 4);
+    cache.purgeAll();
+    assert(cache.count() == 0);
+#endif
+}
@@ -0,0 +1,195 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#include "include/path_segments.h"
+#include "include/path_builder.h"
+
+using namespace pentrek;
+
+namespace {
+
+// Where to write each batch's next segment
+struct Cursor {
+    float*    m_x[4];
+    float*    m_y[4];
+    uint32_t* m_index;
+    size_t    m_count;
+
+    template <int N> void add(const Point pts[N], uint32_t index) {
+        const size_t i = m_count++;
+        for (int k = 0; k < N; ++k) {
+            m_x[k][i] = pts[k].x;
+            m_y[k][i] = pts[k].y;
+        }
+        m_index[i] = index;
+    }
+};
+
+} // namespace
+
+void PathSegments::reset(const Path& path) {
+    // Count first, so each batch is sized once. A close may not add a line,
+    // so the lines can end up with a little more room than they need.
+    size_t counts[3] = {0, 0, 0};
+    for (auto v : path.verbs()) {
+        switch (v) {
+            case PathVerb::move:  break;
+            case PathVerb::line:
+            case PathVerb::close: counts[0] += 1; break;
+            case PathVerb::quad:  counts[1] += 1; break;
+            case PathVerb::cubic: counts[2] += 1; break;
+        }
+    }
+
+    Cursor cursors[3];
+    for (int b = 0; b < 3; ++b) {
+        auto& batch = m_batches[b];
+        const size_t stride = counts[b];
+        batch.m_coords.resize(2 * (b + 2) * stride);
+        batch.m_index.resize(stride);
+        batch.m_stride = stride;
+
+        auto& c = cursors[b];
+        for (int k = 0; k < b + 2; ++k) {
+            c.m_x[k] = batch.m_coords.data() + (2*k) * stride;
+            c.m_y[k] = batch.m_coords.data() + (2*k + 1) * stride;
+        }
+        c.m_index = batch.m_index.data();
+        c.m_count = 0;
+    }
+
+    m_contours.clear();
+    uint32_t seg = 0, contourStart = 0;
+    auto endContour = [&](bool closed) {
+        if (seg > contourStart) {
+            m_contours.push_back({seg, closed});
+            contourStart = seg;
+        }
+    };
+
+    Point start = {0, 0}, prev = {0, 0};
+    const Point* p = path.points().data();
+    for (auto v : path.verbs()) {
+        switch (v) {
+            case PathVerb::move:
+                endContour(false);
+                start = prev = p[0];
+                p += 1;
+                break;
+            case PathVerb::line: {
+                const Point pts[] = {prev, p[0]};
+                cursors[0].add<2>(pts, seg++);
+                prev = p[0];
+                p += 1;
+            } break;
+            case PathVerb::quad: {
+                const Point pts[] = {prev, p[0], p[1]};
+                cursors[1].add<3>(pts, seg++);
+                prev = p[1];
+                p += 2;
+            } break;
+            case PathVerb::cubic: {
+                const Point pts[] = {prev, p[0], p[1], p[2]};
+                cursors[2].add<4>(pts, seg++);
+                prev = p[2];
+                p += 3;
+            } break;
+            case PathVerb::close:
+                if (prev != start) {
+                    const Point pts[] = {prev, start};
+                    cursors[0].add<2>(pts, seg++);
+                }
+                endContour(true);
+                prev = start;
+                break;
+        }
+    }
+    endContour(false);
+
+    for (int b = 0; b < 3; ++b) {
+        m_batches[b].m_count = cursors[b].m_count;
+    }
+    m_count = seg;
+}
+
+//////////////////////////////////
+
+void PathSegments::Tests() {
+#ifdef DEBUG
+    PathBuilder b;
+    b.move(0, 0);
+    b.line(10, 0);
+    b.quad(20, 0, 20, 10);
+    b.cubic(20, 20, 10, 30, 0, 30);
+    b.close();              // adds a line back to {0, 0}
+    b.move(100, 100);       // no segments, so not a contour
+    b.move(50, 50);
+    b.line(60, 60);
+    b.line(50, 50);
+    b.close();              // already at the start, so no line
+    b.move(-1, -1);
+    b.quad(-2, -2, -3, -1);
+    const auto path = b.detach();
+
+    PathSegments segs;
+    segs.reset(*path);
+    assert(segs.count() == 7);
+    assert(segs.lines().count() == 4);
+    assert(segs.quads().count() == 2);
+    assert(segs.cubics().count() == 1);
+
+    const auto contours = segs.contours();
+    assert(contours.size() == 3);
+    assert(contours[0].m_end == 4 && contours[0].m_closed);
+    assert(contours[1].m_end == 6 && contours[1].m_closed);
+    assert(contours[2].m_end == 7 && !contours[2].m_closed);
+
+    // in path order: line quad cubic line | line line | quad
+    const auto& lines = segs.lines();
+    const uint32_t lineIndex[] = {0, 3, 4, 5};
+    for (size_t i = 0; i < 4; ++i) {
+        assert(lines.index()[i] == lineIndex[i]);
+    }
+    const Point p0 = {0, 30}, p1 = {0, 0};
+    assert(lines.point(0, 1) == p0 && lines.point(1, 1) == p1);
+    assert(lines.x(1)[0] == 10 && lines.y(1)[0] == 0);
+
+    const auto& quads = segs.quads();
+    assert(quads.index()[0] == 1 && quads.index()[1] == 6);
+    const Point q0 = {10, 0}, q1 = {20, 0}, q2 = {20, 10};
+    assert(quads.point(0, 0) == q0 && quads.point(1, 0) == q1 && quads.point(2, 0) == q2);
+    assert(quads.x(0)[1] == -1 && quads.y(2)[1] == -1);
+
+    const auto& cubics = segs.cubics();
+    assert(cubics.index()[0] == 2);
+    assert(cubics.point(0, 0) == q2);
+    assert(cubics.x(3)[0] == 0 && cubics.y(3)[0] == 30);
+
+    // the same segments as visiting the path
+    size_t seen = 0;
+    Point prev = {0, 0};
+    path->visit([&](const Point* p) { prev = p[0]; },
+                [&](const Point* p) { prev = p[0]; seen += 1; },
+                [&](const Point* p) { prev = p[1]; seen += 1; },
+                [&](const Point* p) {
+                    assert(cubics.point(1, 0) == p[0]);
+                    assert(cubics.point(2, 0) == p[1]);
+                    prev = p[2];
+                    seen += 1;
+                },
+                [&](Point, Point) {});
+    assert(seen == 6);     // visit() has no line for a close
+
+    // resetting with a smaller path reuses the storage
+    const float* storage = cubics.x(0).data();
+    segs.reset(*Path::Rect({0, 0, 10, 10}));
+    assert(segs.count() == 4 && segs.lines().count() == 4);
+    assert(segs.cubics().count() == 0 && segs.contours().size() == 1);
+    segs.reset(*path);
+    assert(segs.cubics().x(0).data() == storage);
+
+    segs.reset(*Path::Empty());
+    assert(segs.count() == 0 && segs.contours().size() == 0);
+#endif
+}
@@ -0,0 +1,693 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#include "include/path_svg.h"
+#include "include/float_format.h"
+#include "include/path_builder.h"
+#include "include/writer.h"
+#include <cstdlib>
+#include <cstring>
+
+using namespace pentrek;
+
+namespace {
+
+/*
+ *  Formats straight into a local buffer, handing it to the writer whenever it
+ *  might not hold the next verb (and at the end). Writer::writef costs a
+ *  vsnprintf and a virtual write per verb, which is what this replaces.
+ */
+class SVGEmitter {
+    Writer*     m_writer;
+    const int   m_decimals;
+    const bool  m_relative;
+
+    // Where a reader of what we've written will be, which relative deltas are from
+    Point       m_current = {0, 0};
+    Point       m_contourStart = {0, 0};
+
+    size_t      m_used = 0;
+    char        m_buffer[4096];
+
+    // the most one verb can write: a letter and 3 points
+    static constexpr size_t kMaxVerbChars = 1 + 3 * (2 * kMaxFloatChars + 2);
+
+public:
+    SVGEmitter(Writer* w, const SVGPathOptions& opts)
+        : m_writer(w)
+        , m_decimals(opts.m_decimals)
+        , m_relative(opts.m_relative)
+    {}
+
+    ~SVGEmitter() { this->flush(); }
+
+    void flush() {
+        if (m_used) {
+            m_writer->write({m_buffer, m_used});
+            m_used = 0;
+        }
+    }
+
+    void verb(char cmd, const Point pts[], int count) {
+        if (m_used + kMaxVerbChars > sizeof(m_buffer)) {
+            this->flush();
+        }
+        const Point base = m_relative ? m_current : Point{0, 0};
+        m_buffer[m_used++] = m_relative ? (char)(cmd - 'A' + 'a') : cmd;
+
+        Point last = {0, 0};
+        for (int i = 0; i < count; ++i) {
+            if (i > 0) {
+                m_buffer[m_used++] = ' ';
+            }
+            last.x = this->number(pts[i].x - base.x);
+            m_buffer[m_used++] = ',';
+            last.y = this->number(pts[i].y - base.y);
+        }
+        m_current = base + last;
+        if (cmd == 'M') {
+            m_contourStart = m_current;
+        }
+    }
+
+    void close() {
+        if (m_used + 1 > sizeof(m_buffer)) {
+            this->flush();
+        }
+        m_buffer[m_used++] = m_relative ? 'z' : 'Z';
+        m_current = m_contourStart;
+    }
+
+private:
+    // Writes the value, and returns what a reader will read back
+    float number(float v) {
+        char* dst = m_buffer + m_used;
+        if (m_decimals < 0) {
+            m_used += float_to_chars(v, dst);
+            return v;
+        }
+        m_used += float_to_chars_fixed(v, m_decimals, dst);
+        return round_to_decimals(v, m_decimals);
+    }
+};
+
+} // namespace
+
+void Path::writeSVGString(Writer* w, const SVGPathOptions& opts) const {
+    SVGEmitter svg(w, opts);
+    this->visit([&](const Point* p) { svg.verb('M', p, 1); },
+                [&](const Point* p) { svg.verb('L', p, 1); },
+                [&](const Point* p) { svg.verb('Q', p, 2); },
+                [&](const Point* p) { svg.verb('C', p, 3); },
+                [&](Point, Point) { svg.close(); });
+}
+
+rcp<Data> Path::asSVGData(const SVGPathOptions& opts) const {
+    MemoryWriter w;
+    this->writeSVGString(&w, opts);
+    return w.detach();
+}
+
+//////////////////////////////////
+
+namespace {
+
+inline bool is_separator(char c) {
+    return c == ' ' || c == ',' || c == '\n' || c == '\r' || c == '\t' || c == '\f';
+}
+
+inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+// Returns the number of numbers each command takes, or -1 if c is not a command
+int args_for_command(char c) {
+    switch (c | 0x20) {     // lower case
+        case 'z': return 0;
+        case 'h': case 'v': return 1;
+        case 'm': case 'l': case 't': return 2;
+        case 's': case 'q': return 4;
+        case 'c': return 6;
+        case 'a': return 7;
+    }
+    return -1;
+}
+
+// Returns the end of the number starting at p, or p if there isn't one. If
+// mayContinue, a number cut off by end (e.g. "-" or "1e") returns end.
+const char* scan_number(const char* p, const char* end, bool mayContinue) {
+    const char* start = p;
+    if (p < end && (*p == '-' || *p == '+')) {
+        p += 1;
+    }
+    const char* digits = p;
+    while (p < end && is_digit(*p)) {
+        p += 1;
+    }
+    if (p < end && *p == '.') {
+        p += 1;
+        while (p < end && is_digit(*p)) {
+            p += 1;
+        }
+    }
+    if (p - digits == 0 || (p - digits == 1 && *digits == '.')) {
+        return p == end && mayContinue ? end : start;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* e = p + 1;
+        if (e < end && (*e == '-' || *e == '+')) {
+            e += 1;
+        }
+        if (e < end && is_digit(*e)) {
+            while (e < end && is_digit(*e)) {
+                e += 1;
+            }
+            p = e;
+        } else if (e == end && mayContinue) {
+            p = end;
+        }
+    }
+    return p;
+}
+
+const float gPow10f[] = {
+    1, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f,
+};
+
+const double gPow10d[] = {
+    1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/*
+ *  Parses a number that scan_number() found. Most numbers have few enough
+ *  digits to be computed exactly with one multiply or divide (Clinger's fast
+ *  path), first in float and then in double. The rest go to strtof.
+ */
+bool parse_number(const char* p, const char* end, float* value) {
+    const char* start = p;
+    const bool negative = *p == '-';
+    if (*p == '-' || *p == '+') {
+        p += 1;
+    }
+
+    constexpr uint64_t kMaxMantissa = (uint64_t(1) << 53);
+    uint64_t mantissa = 0;
+    int exp10 = 0;
+    bool exact = true;
+    for (; p < end && is_digit(*p); ++p) {
+        if (mantissa < kMaxMantissa / 10) {
+            mantissa = mantissa * 10 + (*p - '0');
+        } else {
+            exp10 += 1;
+            exact &= *p == '0';
+        }
+    }
+    if (p < end && *p == '.') {
+        for (p += 1; p < end && is_digit(*p); ++p) {
+            if (mantissa < kMaxMantissa / 10) {
+                mantissa = mantissa * 10 + (*p - '0');
+                exp10 -= 1;
+            } else {
+                exact &= *p == '0';
+            }
+        }
+    }
+    if (p < end) {
+        assert(*p == 'e' || *p == 'E');
+        p += 1;
+        const bool negExp = *p == '-';
+        if (*p == '-' || *p == '+') {
+            p += 1;
+        }
+        int e = 0;
+        for (; p < end; ++p) {
+            e = std::min(e * 10 + (*p - '0'), 100000);
+        }
+        exp10 += negExp ? -e : e;
+    }
+
+    if (exact && mantissa < (1u << 24) && std::abs(exp10) <= 10) {
+        // both operands are exact floats, so the result is correctly rounded
+        const float m = (float)mantissa;
+        const float v = exp10 >= 0 ? m * gPow10f[exp10] : m / gPow10f[-exp10];
+        *value = negative ? -v : v;
+        return true;
+    }
+    if (exact && std::abs(exp10) <= 22) {
+        const double m = (double)mantissa;
+        const double d = exp10 >= 0 ? m * gPow10d[exp10] : m / gPow10d[-exp10];
+        // Rounding d to a float could round the exact value twice. That only
+        // matters if d is halfway between two floats (or a denormal float).
+        uint64_t bits;
+        memcpy(&bits, &d, 8);
+        const uint64_t halfway = uint64_t(1) << 28;
+        if ((bits & (2 * halfway - 1)) != halfway && d >= 1.17549435e-38) {
+            *value = (float)(negative ? -d : d);
+            return true;
+        }
+    }
+
+    char buffer[SVGPathParser::kMaxNumberChars + 1];
+    const size_t n = end - start;
+    if (n > SVGPathParser::kMaxNumberChars) {
+        return false;
+    }
+    memcpy(buffer, start, n);
+    buffer[n] = 0;
+    *value = strtof(buffer, nullptr);
+    return true;
+}
+
+constexpr float kPI = 3.14159265f;
+
+/*
+ *  Appends the SVG elliptical arc from p0 to p1 as cubics, one per quarter turn
+ *  (or less). This follows the SVG spec's conversion from endpoint to center
+ *  parameterization (SVG 1.1, appendix F.6).
+ */
+void arc_to(PathSync* dst, Point p0, float rx, float ry, float degrees,
+            bool largeArc, bool sweep, Point p1) {
+    if (p0 == p1) {
+        return;
+    }
+    rx = std::abs(rx);
+    ry = std::abs(ry);
+    if (rx == 0 || ry == 0) {
+        dst->line(p1);
+        return;
+    }
+
+    const float angle = degrees * (kPI / 180),
+                cosA = std::cos(angle),
+                sinA = std::sin(angle);
+
+    // the chord's half-vector, in the ellipse's (unrotated) frame
+    const Point h = (p0 - p1) * 0.5f,
+                hp = {cosA * h.x + sinA * h.y, cosA * h.y - sinA * h.x};
+
+    // radii too small to span the chord are scaled up until they just do
+    const float lambda = (hp.x * hp.x) / (rx * rx) + (hp.y * hp.y) / (ry * ry);
+    if (lambda > 1) {
+        const float s = std::sqrt(lambda);
+        rx *= s;
+        ry *= s;
+    }
+
+    // the center, in that frame
+    const float rx2 = rx * rx, ry2 = ry * ry,
+                num = rx2 * ry2 - rx2 * hp.y * hp.y - ry2 * hp.x * hp.x,
+                den = rx2 * hp.y * hp.y + ry2 * hp.x * hp.x;
+    float coef = den > 0 ? std::sqrt(std::max(num / den, 0.0f)) : 0;
+    if (largeArc == sweep) {
+        coef = -coef;
+    }
+    const Point cp = {coef * rx * hp.y / ry, -coef * ry * hp.x / rx};
+
+    // the start and end, on the unit circle
+    const Point u = {(hp.x - cp.x) / rx, (hp.y - cp.y) / ry},
+                v = {(-hp.x - cp.x) / rx, (-hp.y - cp.y) / ry};
+    const float start = std::atan2(u.y, u.x);
+    float sweepAngle = std::atan2(Point::Cross(u, v), Point::Dot(u, v));
+    if (!sweep && sweepAngle > 0) {
+        sweepAngle -= 2 * kPI;
+    } else if (sweep && sweepAngle < 0) {
+        sweepAngle += 2 * kPI;
+    }
+
+    // maps the unit circle onto the ellipse
+    const Point center = {cosA * cp.x - sinA * cp.y + (p0.x + p1.x) * 0.5f,
+                          sinA * cp.x + cosA * cp.y + (p0.y + p1.y) * 0.5f};
+    const auto mx = Matrix::Trans(center) * Matrix::Rotate(angle) * Matrix::Scale(rx, ry);
+
+    // a little slop, so a half-turn that rounded up is still 2 pieces
+    const int n = std::max((int)std::ceil(std::abs(sweepAngle) / (kPI / 2) - 0.001f), 1);
+    const float step = sweepAngle / n,
+                k = 4.0f / 3 * std::tan(step / 4);
+    Point from = {std::cos(start), std::sin(start)};
+    for (int i = 1; i <= n; ++i) {
+        const float a = start + step * i;
+        const Point to = {std::cos(a), std::sin(a)};
+        dst->cubic(mx * (from + from.cw() * k),
+                   mx * (to - to.cw() * k),
+                   i == n ? p1 : mx * to);
+        from = to;
+    }
+}
+
+} // namespace
+
+bool SVGPathParser::command(char c) {
+    if (m_needsArgs || m_argCount > 0) {
+        return false;   // the previous command is missing numbers
+    }
+    const char upper = c & ~0x20;
+    if (m_cmd == 0 && upper != 'M') {
+        return false;   // must start with a move
+    }
+    m_cmd = upper;
+    m_relative = c != upper;
+    if (upper == 'Z') {
+        if (!m_needsMove) {
+            m_dst->close();
+            m_needsMove = true;
+        }
+        m_current = m_start;
+        m_prevCmd = 'Z';
+    } else {
+        m_needsArgs = true;
+    }
+    return true;
+}
+
+void SVGPathParser::segment() {
+    const float* a = m_args;
+    const Point base = m_relative ? m_current : Point{0, 0};
+    auto pt = [&](int i) { return Point{a[i], a[i + 1]} + base; };
+
+    if (m_cmd == 'M') {
+        m_current = m_start = pt(0);
+        m_dst->move(m_current);
+        m_needsMove = false;
+        m_prevCmd = 'M';
+        m_cmd = 'L';    // any more pairs are lines
+        return;
+    }
+    if (m_needsMove) {
+        m_dst->move(m_current);
+        m_needsMove = false;
+    }
+
+    Point p;
+    switch (m_cmd) {
+        case 'L':
+            p = pt(0);
+            m_dst->line(p);
+            break;
+        case 'H':
+            p = {a[0] + base.x, m_current.y};
+            m_dst->line(p);
+            break;
+        case 'V':
+            p = {m_current.x, a[0] + base.y};
+            m_dst->line(p);
+            break;
+        case 'C':
+            m_lastCtrl = pt(2);
+            p = pt(4);
+            m_dst->cubic(pt(0), m_lastCtrl, p);
+            break;
+        case 'S': {
+            const bool smooth = m_prevCmd == 'C' || m_prevCmd == 'S';
+            const Point c1 = smooth ? m_current * 2 - m_lastCtrl : m_current;
+            m_lastCtrl = pt(0);
+            p = pt(2);
+            m_dst->cubic(c1, m_lastCtrl, p);
+        } break;
+        case 'Q':
+            m_lastCtrl = pt(0);
+            p = pt(2);
+            m_dst->quad(m_lastCtrl, p);
+            break;
+        case 'T': {
+            const bool smooth = m_prevCmd == 'Q' || m_prevCmd == 'T';
+            m_lastCtrl = smooth ? m_current * 2 - m_lastCtrl : m_current;
+            p = pt(0);
+            m_dst->quad(m_lastCtrl, p);
+        } break;
+        case 'A':
+            p = pt(5);
+            arc_to(m_dst, m_current, a[0], a[1], a[2], a[3] != 0, a[4] != 0, p);
+            break;
+        default:
+            assert(false);
+            return;
+    }
+    m_current = p;
+    m_prevCmd = m_cmd;
+}
+
+// Returns where parsing stopped (only short of end if !final and a number might
+// continue in the next piece), or nullptr on an error.
+const char* SVGPathParser::parse(const char* p, const char* end, bool final) {
+    for (;;) {
+        while (p < end && is_separator(*p)) {
+            p += 1;
+        }
+        if (p == end) {
+            return p;
+        }
+
+        const char c = *p;
+        if (args_for_command(c) >= 0) {
+            if (!this->command(c)) {
+                return nullptr;
+            }
+            p += 1;
+            continue;
+        }
+        if (m_cmd == 0 || m_cmd == 'Z') {
+            return nullptr;     // numbers need a command
+        }
+
+        float value;
+        if (m_cmd == 'A' && (m_argCount == 3 || m_argCount == 4)) {
+            // flags are a single digit, and need not be separated (e.g. "1020,0")
+            if (c != '0' && c != '1') {
+                return nullptr;
+            }
+            value = (float)(c - '0');
+            p += 1;
+        } else {
+            const char* next = scan_number(p, end, !final);
+            if (next == p) {
+                return nullptr;
+            }
+            if (next == end && !final) {
+                return p;
+            }
+            if (!parse_number(p, next, &value)) {
+                return nullptr;
+            }
+            p = next;
+        }
+
+        m_args[m_argCount++] = value;
+        if (m_argCount == args_for_command(m_cmd)) {
+            this->segment();
+            m_argCount = 0;
+            m_needsArgs = false;
+        }
+    }
+}
+
+bool SVGPathParser::write(Span<const char> src) {
+    if (m_error) {
+        return false;
+    }
+    const char* p = src.data();
+    const char* end = p + src.size();
+
+    if (m_carryLen > 0) {
+        // finish the number that the previous piece ended in
+        const size_t n = std::min(src.size(), sizeof(m_carry) - m_carryLen),
+                     len = m_carryLen + n;
+        memcpy(m_carry + m_carryLen, p, n);
+        const char* stop = this->parse(m_carry, m_carry + len, false);
+        if (!stop) {
+            return this->fail();
+        }
+        const size_t used = stop - m_carry;
+        if (used < m_carryLen) {
+            // still not finished
+            if (n < src.size()) {
+                return this->fail();
+            }
+            m_carryLen = len;
+            return true;
+        }
+        p += used - m_carryLen;
+        m_carryLen = 0;
+    }
+
+    const char* stop = this->parse(p, end, false);
+    if (!stop) {
+        return this->fail();
+    }
+    const size_t rest = end - stop;
+    if (rest >= sizeof(m_carry)) {
+        return this->fail();    // too long for a number
+    }
+    memcpy(m_carry, stop, rest);
+    m_carryLen = rest;
+    return true;
+}
+
+bool SVGPathParser::finish() {
+    if (m_error) {
+        return false;
+    }
+    if (m_carryLen > 0) {
+        if (!this->parse(m_carry, m_carry + m_carryLen, true)) {
+            return this->fail();
+        }
+        m_carryLen = 0;
+    }
+    if (m_needsArgs || m_argCount > 0) {
+        return this->fail();
+    }
+    return true;
+}
+
+bool SVGPathParser::Parse(Span<const char> src, PathSync* dst) {
+    SVGPathParser parser(dst);
+    if (parser.parse(src.data(), src.data() + src.size(), true) == nullptr) {
+        return false;
+    }
+    return parser.finish();
+}
+
+rcp<Path> SVGPathParser::MakePath(Span<const char> src, PathFillType ft) {
+    PathBuilder builder;
+    builder.m_fillType = ft;
+    return Parse(src, &builder) ? builder.detach() : nullptr;
+}
+
+//////////////////////////////////
+
+void SVGPathParser::Tests() {
+#ifdef DEBUG
+    auto parse = [](const char str[]) { return MakePath({str, strlen(str)}); };
+    auto same = [](const Path& a, const Path& b, float tol) {
+        if (a.verbs().size() != b.verbs().size() || a.points().size() != b.points().size() ||
+            !std::equal(a.verbs().begin(), a.verbs().end(), b.verbs().begin())) {
+            return false;
+        }
+        for (size_t i = 0; i < a.points().size(); ++i) {
+            const Point d = a.points()[i] - b.points()[i];
+            if (std::abs(d.x) > tol || std::abs(d.y) > tol) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    PathBuilder b;
+    b.move(10, 10);
+    b.line(15, 10);
+    b.line(15, 15);
+    b.line(0, 15);
+    b.line(0, 0);
+    b.close();
+    b.move(10, 10);         // drawing after Z starts at the contour's start
+    b.line(20, 20);
+    const auto lines = b.detach();
+    assert(*parse("M10 10 h5 v5 H0 V0 z l10,10") == *lines);
+    assert(*parse(" M 10,10\n H 15 V 15\tL 0 15 0 0 Z Z L20 20 ") == *lines);
+
+    // compact numbers
+    b.move(1, -2.5f);
+    b.line(0.5f, 0.25f);
+    b.line(30, 0.4f);
+    const auto compact = b.detach();
+    assert(*parse("M1-2.5.5.25L3e1,4E-1") == *compact);
+    assert(*parse("m1-2.5l-.5 2.75 29.5.15") == *parse("M1-2.5L.5.25 30 .4"));
+
+    // smooth curves reflect the previous control point
+    b.move(0, 0);
+    b.cubic(0, 10, 10, 10, 10, 0);
+    b.cubic(10, -10, 20, -10, 20, 0);
+    b.cubic(20, 10, 30, 10, 30, 0);
+    b.quad(35, -10, 40, 0);
+    b.quad(45, 10, 50, 0);
+    const auto smooth = b.detach();
+    assert(*parse("M0 0C0 10 10 10 10 0S20-10 20 0S30 10 30 0Q35-10 40 0T50 0") == *smooth);
+    // with nothing to reflect, the first control point is the current point
+    assert(*parse("M0 0L10 0S20-10 20 0") == *parse("M0 0L10 0C10 0 20-10 20 0"));
+    assert(*parse("M0 0C0 10 10 10 10 0s10-10 10 0") == *parse("M0 0C0 10 10 10 10 0 10-10 20-10 20 0"));
+    assert(*parse("M0 0Q5-10 10 0t10 0") == *parse("M0 0Q5-10 10 0Q15 10 20 0"));
+    assert(*parse("M0 0T10 0") == *parse("M0 0Q0 0 10 0"));
+
+    // arcs become cubics on the ellipse, ending exactly at the end point
+    {
+        auto arc = parse("M0,0 A10,10 0 0,1 20,0");
+        assert(arc->verbs().size() == 3);   // a half-turn is 2 cubics
+        const Point end = {20, 0};
+        assert(arc->points().back() == end);
+        for (auto p : arc->points()) {
+            // the cubics' on-curve points are on the circle, and this sweep is y < 0
+            assert(p.y <= 0.001f);
+        }
+        const Point mid = arc->points()[3];
+        assert(nearly_eq(mid.x, 10, 0.001f) && nearly_eq(mid.y, -10, 0.001f));
+
+        // the other sweep, and the flags written without separators
+        arc = parse("M0,0 a10 10 0 0020,0");
+        assert(nearly_eq(arc->points()[3].y, 10, 0.001f));
+        // radii too small are scaled up, so this is the same half-turn
+        assert(same(*arc, *parse("M0,0 A1 1 0 0 0 20 0"), 0.001f));
+        // a large arc on a circle too big for a half-turn
+        arc = parse("M0,0 A20,20 0 1,1 20,0");
+        assert(arc->verbs().size() == 5 && arc->points().back() == end);
+        // rotated ellipse: the mid point is along the rotated minor axis
+        arc = parse("M0,0 A20,10 90 0,1 0,40");
+        const Point end2 = {0, 40};
+        assert(arc->points().back() == end2);
+        assert(nearly_eq(arc->points()[3].x, 10, 0.01f) && nearly_eq(arc->points()[3].y, 20, 0.01f));
+        // degenerate arcs
+        assert(*parse("M0,0 A0,10 0 0,1 20,0") == *parse("M0,0 L20,0"));
+        assert(*parse("M5,5 A10,10 0 0,1 5,5") == *parse("M5,5"));
+    }
+
+    // invalid data
+    for (const char* str : {"L1 2", "M1", "M1 2 L", "M1 2 L3", "M1 2 x", "1 2", "M1 2 Z 3 4",
+                            "M 1 2 A 1 1 0 2 0 3 3", "M1 2 L3 4e", "M1 2 L3 -", "M1 2 L--3 4",
+                            "M1 2 L 3 . 4"}) {
+        assert(!parse(str));
+    }
+    assert(*parse("") == *Path::Empty());
+
+    // round-trips what we write
+    {
+        b.move(1, 2);
+        b.line(3.5f, -4);
+        b.quad(0.1f, 1.0f / 3, 10, 20);
+        b.cubic(1e-7f, 1, 2000, 2, 3, -123.456f);
+        b.close();
+        b.move(100, 100);
+        b.line(101, 100);
+        const auto path = b.detach();
+        SVGPathOptions opts;
+        for (bool relative : {false, true}) {
+            opts.m_relative = relative;
+            auto data = path->asSVGData(opts);
+            auto p = MakePath(data->cspan());
+            assert(p && same(*p, *path, relative ? 1e-4f : 0));
+        }
+        auto data = path->asSVGData();
+        auto again = MakePath(data->cspan())->asSVGData();
+        assert(again->size() == data->size() && !memcmp(again->data(), data->data(), data->size()));
+    }
+
+    // pieces may end anywhere, even inside numbers
+    {
+        const char str[] = "M10-2.5e1 c1.25,2 3E+1-4.5 5 6 s7 8 9 10 a5,4 30 1020 -5 Z"
+                           "m1 1 q2 2 3 3 t4 4 h-.5 v1e-2 L 12345.678 -0.000123z";
+        const auto whole = parse(str);
+        assert(whole);
+        for (size_t step = 1; step <= 7; ++step) {
+            SVGPathParser parser(&b);
+            for (size_t i = 0; i < sizeof(str) - 1; i += step) {
+                assert(parser.write({str + i, std::min(step, sizeof(str) - 1 - i)}));
+            }
+            assert(parser.finish());
+            assert(*b.detach() == *whole);
+        }
+
+        // an unfinished command is caught at the end
+        SVGPathParser parser(&b);
+        assert(parser.write({"M1 2 L3", 7}));
+        assert(!parser.finish());
+        b.detach();
+    }
+#endif
+}
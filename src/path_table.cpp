@@ -0,0 +1,298 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#include "include/path_table.h"
+#include "include/path_builder.h"
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace pentrek;
+
+struct PathTable::Header {
+    uint32_t m_magic;
+    uint16_t m_version;
+    uint8_t  m_encoding;
+    uint8_t  m_reserved;
+    uint32_t m_count;       // number of entries (paths)
+    uint32_t m_size;        // of the whole encoding, so we can detect truncation
+};
+
+struct PathTable::Entry {
+    uint32_t m_pointOffset; // from the start of the encoding
+    uint32_t m_verbOffset;
+    uint32_t m_pointCount;
+    uint32_t m_verbCount;
+    Rect     m_bounds;      // of the points, which kQuant16 is relative to
+    uint8_t  m_fillType;
+    uint8_t  m_reserved[3];
+};
+
+namespace {
+
+constexpr uint32_t kMagic = 'P' | 'T' << 8 | 'K' << 16 | 'P' << 24;
+constexpr uint16_t kVersion = 1;
+
+// Each path's points start on this boundary (which suits both encodings)
+constexpr size_t kAlign = 4;
+
+constexpr float kQuantMax = 65535;
+
+const uint8_t gPtsPerVerb[] = {
+    1, 1, 2, 3, 0,  // move, line, quad, cubic, close
+};
+
+size_t align_up(size_t n) { return (n + kAlign - 1) & ~(kAlign - 1); }
+
+size_t point_size(PathEncoding enc) {
+    return enc == PathEncoding::kFloat32 ? sizeof(Point) : 2 * sizeof(uint16_t);
+}
+
+bool valid_verbs(Span<const PathVerb> vbs, size_t pointCount) {
+    if (vbs.size() > 0 && vbs[0] != PathVerb::move) {
+        return false;
+    }
+    size_t n = 0;
+    for (auto v : vbs) {
+        if ((unsigned)v >= sizeof(gPtsPerVerb)) {
+            return false;
+        }
+        n += gPtsPerVerb[(unsigned)v];
+    }
+    return n == pointCount;
+}
+
+void quantize(Span<const Point> src, const Rect& bounds, uint16_t dst[]) {
+    const float sx = bounds.width() > 0 ? kQuantMax / bounds.width() : 0,
+                sy = bounds.height() > 0 ? kQuantMax / bounds.height() : 0;
+    // the values are pinned to be non-negative, so adding 0.5 and truncating rounds them
+    for (auto p : src) {
+        *dst++ = (uint16_t)(pin_float((p.x - bounds.left) * sx, 0, kQuantMax) + 0.5f);
+        *dst++ = (uint16_t)(pin_float((p.y - bounds.top) * sy, 0, kQuantMax) + 0.5f);
+    }
+}
+
+void dequantize(const uint16_t src[], const Rect& bounds, Span<Point> dst) {
+    const float sx = bounds.width() / kQuantMax,
+                sy = bounds.height() / kQuantMax;
+    for (auto& p : dst) {
+        p = {bounds.left + src[0] * sx, bounds.top + src[1] * sy};
+        src += 2;
+    }
+}
+
+} // namespace
+
+rcp<Data> PathTable::Encode(Span<const Path* const> paths, PathEncoding enc) {
+    const size_t ptSize = point_size(enc);
+    size_t size = sizeof(Header) + paths.size() * sizeof(Entry);
+    for (const Path* path : paths) {
+        size = align_up(size);
+        size += path->points().size() * ptSize + path->verbs().size();
+    }
+    if (size > UINT32_MAX) {
+        return nullptr;     // our offsets are 32 bits
+    }
+
+    auto data = Data::Uninitialized(size);
+    auto* base = (uint8_t*)data->writable_data();
+    memset(base, 0, size);  // so the padding is deterministic
+
+    const Header header = {
+        kMagic, kVersion, (uint8_t)enc, 0, castTo<uint32_t>(paths.size()), (uint32_t)size,
+    };
+    memcpy(base, &header, sizeof(header));
+
+    auto* entries = (Entry*)(base + sizeof(Header));
+    size_t offset = sizeof(Header) + paths.size() * sizeof(Entry);
+    for (size_t i = 0; i < paths.size(); ++i) {
+        const Path& path = *paths[i];
+        const auto pts = path.points();
+        const auto vbs = path.verbs();
+
+        offset = align_up(offset);
+        Entry& e = entries[i];
+        e.m_pointOffset = (uint32_t)offset;
+        e.m_verbOffset = (uint32_t)(offset + pts.size() * ptSize);
+        e.m_pointCount = (uint32_t)pts.size();
+        e.m_verbCount = (uint32_t)vbs.size();
+        e.m_bounds = path.bounds();
+        e.m_fillType = (uint8_t)path.fillType();
+
+        if (enc == PathEncoding::kFloat32) {
+            memcpy(base + e.m_pointOffset, pts.data(), pts.size() * sizeof(Point));
+        } else {
+            quantize(pts, e.m_bounds, (uint16_t*)(base + e.m_pointOffset));
+        }
+        memcpy(base + e.m_verbOffset, vbs.data(), vbs.size());
+        offset = e.m_verbOffset + vbs.size();
+    }
+    assert(offset == size);
+    return data;
+}
+
+PathTable::PathTable(rcp<Data> data, const Entry* entries, size_t count, PathEncoding enc)
+    : m_data(std::move(data))
+    , m_entries(entries)
+    , m_count(count)
+    , m_encoding(enc)
+{
+    static_assert(sizeof(Header) == 16, "");
+    static_assert(sizeof(Entry) == 36, "");
+}
+
+rcp<PathTable> PathTable::Make(rcp<Data> data) {
+    if (!data || data->size() < sizeof(Header)) {
+        return nullptr;
+    }
+    // We read the encoding in place, so it must be aligned. Mapped files and
+    // our own allocations are, but if this isn't (e.g. it is part of a larger
+    // buffer), we make an aligned copy.
+    if ((uintptr_t)data->data() % alignof(Entry)) {
+        data = Data::Copy(data->bspan());
+    }
+
+    const auto* base = (const uint8_t*)data->data();
+    Header header;
+    memcpy(&header, base, sizeof(header));
+    if (header.m_magic != kMagic || header.m_version != kVersion ||
+        header.m_encoding > (uint8_t)PathEncoding::kQuant16 || header.m_size > data->size()) {
+        return nullptr;
+    }
+
+    const auto enc = (PathEncoding)header.m_encoding;
+    const uint64_t size = header.m_size,
+                   dirEnd = sizeof(Header) + (uint64_t)header.m_count * sizeof(Entry),
+                   ptSize = point_size(enc);
+    if (dirEnd > size) {
+        return nullptr;
+    }
+
+    const auto* entries = (const Entry*)(base + sizeof(Header));
+    for (uint32_t i = 0; i < header.m_count; ++i) {
+        const Entry& e = entries[i];
+        if (e.m_fillType > (uint8_t)PathFillType::evenodd ||
+            e.m_pointOffset % kAlign != 0 ||
+            e.m_pointOffset < dirEnd || e.m_verbOffset < dirEnd ||
+            e.m_pointOffset + e.m_pointCount * ptSize > size ||
+            (uint64_t)e.m_verbOffset + e.m_verbCount > size) {
+            return nullptr;
+        }
+    }
+    return rcp<PathTable>(new PathTable(std::move(data), entries, header.m_count, enc));
+}
+
+rcp<Path> PathTable::Decode(rcp<Data> data) {
+    auto table = Make(std::move(data));
+    return table && table->count() > 0 ? table->at(0) : nullptr;
+}
+
+rcp<Path> PathTable::at(size_t index) const {
+    assert(index < m_count);
+    const Entry& e = m_entries[index];
+    const auto* base = (const uint8_t*)m_data->data();
+
+    const Span<const PathVerb> vbs = {(const PathVerb*)(base + e.m_verbOffset), e.m_verbCount};
+    if (!valid_verbs(vbs, e.m_pointCount)) {
+        return nullptr;
+    }
+    const auto ft = (PathFillType)e.m_fillType;
+
+    if (m_encoding == PathEncoding::kFloat32) {
+        const Span<const Point> pts = {(const Point*)(base + e.m_pointOffset), e.m_pointCount};
+        return Path::Wrap(m_data, pts, vbs, ft, &e.m_bounds);
+    }
+
+    std::vector<Point> pts(e.m_pointCount);
+    dequantize((const uint16_t*)(base + e.m_pointOffset), e.m_bounds, pts);
+    return Path::Make(pts, vbs, ft);
+}
+
+//////////////////////////////////
+
+void PathTable::Tests() {
+#ifdef DEBUG
+    PathBuilder b;
+    b.move(1, 2);
+    b.quad(10, 20, 30, -5);
+    b.cubic(0, 0, 100, 50, 7.25f, 3.5f);
+    b.close();
+    b.addCircle({-40, 10}, 12);
+    const auto curvy = b.detach();
+
+    const Rect r = {0, 0, 10, 20};
+    const auto evenodd = Path::Make(curvy->points(), curvy->verbs(), PathFillType::evenodd);
+    const auto rect = Path::Rect(r);
+    const Path* paths[] = {curvy.get(), Path::Empty().get(), rect.get(), evenodd.get()};
+
+    // float32 round-trips exactly, and the paths point into the data
+    auto data = Encode(paths);
+    auto table = Make(data);
+    assert(table && table->count() == 4);
+    assert(table->encoding() == PathEncoding::kFloat32);
+    const auto* begin = (const uint8_t*)data->data();
+    for (size_t i = 0; i < 4; ++i) {
+        auto p = table->at(i);
+        assert(*p == *paths[i]);
+        assert(p->bounds() == paths[i]->bounds());
+        const auto* pts = (const uint8_t*)p->points().data();
+        assert(p->empty() || (pts >= begin && pts < begin + data->size()));
+    }
+    assert(*Decode(Encode(*rect)) == *rect);
+
+    // wrapped paths keep the data alive, and are never changed in place
+    auto wrapped = table->at(2);
+    table = nullptr;
+    data = nullptr;
+    wrapped = Path::Transform(std::move(wrapped), Matrix::Trans(5, 5));
+    assert(wrapped->bounds() == r.offset(5, 5));
+    table = Make(Encode(paths));
+    assert(*table->at(2) == *rect);
+
+    // quant16 is smaller, and within its tolerance
+    auto qdata = Encode(paths, PathEncoding::kQuant16);
+    auto qtable = Make(qdata);
+    assert(qtable && qtable->encoding() == PathEncoding::kQuant16);
+    assert(qdata->size() < Encode(paths)->size());
+    for (size_t i = 0; i < 4; ++i) {
+        auto p = qtable->at(i);
+        assert(p->fillType() == paths[i]->fillType());
+        assert(p->verbs().size() == paths[i]->verbs().size());
+        const Rect bounds = paths[i]->bounds();
+        const float tol = std::max(bounds.width(), bounds.height()) / 131070 * 1.01f;
+        for (size_t j = 0; j < p->points().size(); ++j) {
+            const Point d = p->points()[j] - paths[i]->points()[j];
+            assert(std::abs(d.x) <= tol && std::abs(d.y) <= tol);
+        }
+    }
+    assert(*qtable->at(2) == *rect);    // integers survive exactly
+
+    // not aligned: we make a copy
+    data = Encode(paths);
+    std::vector<uint8_t> storage(data->size() + 1);
+    memcpy(storage.data() + 1, data->data(), data->size());
+    table = Make(Data::Unmanaged({storage.data() + 1, data->size()}));
+    assert(table && *table->at(0) == *curvy);
+
+    // invalid encodings
+    assert(!Make(nullptr));
+    assert(!Make(Data::Empty()));
+    assert(!Make(Data::Copy({data->bspan().data(), data->size() - 1})));   // truncated
+    auto bad = Data::Copy(data->bspan());
+    ((uint8_t*)bad->writable_data())[0] ^= 1;
+    assert(!Make(bad));
+
+    // bad verbs are caught when that path is asked for
+    bad = Data::Copy(data->bspan());
+    auto* entries = (Entry*)((uint8_t*)bad->writable_data() + sizeof(Header));
+    ((uint8_t*)bad->writable_data())[entries[2].m_verbOffset + 1] = 9;
+    table = Make(bad);
+    assert(table && table->at(0) && !table->at(2));
+    entries[3].m_pointCount += 1;
+    assert(!table->at(3));
+    entries[3].m_verbOffset = (uint32_t)bad->size();
+    entries[3].m_verbCount = 1;
+    assert(!Make(bad));
+#endif
+}
@@ -0,0 +1,504 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#include "include/point_kernels.h"
+#include "include/math.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+    #include <immintrin.h>
+    #define PENTREK_KERNELS_SSE2
+    #if defined(__GNUC__) || defined(__clang__)
+        #define PENTREK_KERNELS_AVX2
+    #endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #include <arm_neon.h>
+    #define PENTREK_KERNELS_NEON
+#elif defined(__wasm_simd128__)
+    #include <wasm_simd128.h>
+    #define PENTREK_KERNELS_WASM
+#endif
+
+using namespace pentrek;
+
+/*
+ *  The SIMD versions all work on interleaved points: one 128bit register holds
+ *  2 points (x0 y0 x1 y1), so a scale+translate is just a multiply-add with
+ *  (sx sy sx sy) and (tx ty tx ty). For a general affine we also need the
+ *  swizzled register (y0 x0 y1 x1):
+ *
+ *      x' = a*x + c*y + e
+ *      y' = d*y + b*x + f
+ *
+ *  The leftover point (if n is odd) is handled by the scalar code.
+ */
+
+namespace scalar {
+
+static void scale_trans(Point dst[], const Point src[], size_t n,
+                        float sx, float sy, float tx, float ty) {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = {src[i].x * sx + tx, src[i].y * sy + ty};
+    }
+}
+
+static void affine(Point dst[], const Point src[], size_t n, const Matrix& mx) {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = mx * src[i];
+    }
+}
+
+static Rect bounds(const Point src[], size_t n) {
+    assert(n > 0);
+    float l = src[0].x,
+          t = src[0].y,
+          r = l,
+          b = t;
+
+    for (size_t i = 1; i < n; ++i) {
+        const auto p = src[i];
+        l = std::min(l, p.x);
+        t = std::min(t, p.y);
+        r = std::max(r, p.x);
+        b = std::max(b, p.y);
+    }
+    return {l, t, r, b};
+}
+
+static void lerp(Point dst[], const Point a[], const Point b[], size_t n, float t) {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = lerp_unbounded(a[i], b[i], t);
+    }
+}
+
+} // namespace scalar
+
+static const PointKernels gScalarKernels = {
+    "scalar",
+    scalar::scale_trans,
+    scalar::affine,
+    scalar::bounds,
+    scalar::lerp,
+};
+
+static Rect join_bounds(const float mins[4], const float maxs[4]) {
+    return {
+        std::min(mins[0], mins[2]), std::min(mins[1], mins[3]),
+        std::max(maxs[0], maxs[2]), std::max(maxs[1], maxs[3]),
+    };
+}
+
+#ifdef PENTREK_KERNELS_SSE2
+
+namespace sse2 {
+
+static void scale_trans(Point dst[], const Point src[], size_t n,
+                        float sx, float sy, float tx, float ty) {
+    const __m128 scale = _mm_setr_ps(sx, sy, sx, sy);
+    const __m128 trans = _mm_setr_ps(tx, ty, tx, ty);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128 v = _mm_loadu_ps(&src[i].x);
+        _mm_storeu_ps(&dst[i].x, _mm_add_ps(_mm_mul_ps(v, scale), trans));
+    }
+    scalar::scale_trans(dst + i, src + i, n - i, sx, sy, tx, ty);
+}
+
+static void affine(Point dst[], const Point src[], size_t n, const Matrix& mx) {
+    const __m128 ad = _mm_setr_ps(mx[0], mx[3], mx[0], mx[3]);
+    const __m128 cb = _mm_setr_ps(mx[2], mx[1], mx[2], mx[1]);
+    const __m128 ef = _mm_setr_ps(mx[4], mx[5], mx[4], mx[5]);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128 v = _mm_loadu_ps(&src[i].x);
+        __m128 s = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+        v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(v, ad), _mm_mul_ps(s, cb)), ef);
+        _mm_storeu_ps(&dst[i].x, v);
+    }
+    scalar::affine(dst + i, src + i, n - i, mx);
+}
+
+static Rect bounds(const Point src[], size_t n) {
+    assert(n > 0);
+    if (n < 2) {
+        return scalar::bounds(src, n);
+    }
+    __m128 mn = _mm_loadu_ps(&src[0].x),
+           mx = mn;
+    size_t i = 2;
+    for (; i + 2 <= n; i += 2) {
+        __m128 v = _mm_loadu_ps(&src[i].x);
+        mn = _mm_min_ps(mn, v);
+        mx = _mm_max_ps(mx, v);
+    }
+    float mins[4], maxs[4];
+    _mm_storeu_ps(mins, mn);
+    _mm_storeu_ps(maxs, mx);
+    Rect r = join_bounds(mins, maxs);
+    if (i < n) {
+        r = r.join(scalar::bounds(src + i, n - i));
+    }
+    return r;
+}
+
+static void lerp(Point dst[], const Point a[], const Point b[], size_t n, float t) {
+    const __m128 vt = _mm_set1_ps(t);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128 va = _mm_loadu_ps(&a[i].x);
+        __m128 vb = _mm_loadu_ps(&b[i].x);
+        _mm_storeu_ps(&dst[i].x, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), vt)));
+    }
+    scalar::lerp(dst + i, a + i, b + i, n - i, t);
+}
+
+} // namespace sse2
+
+static const PointKernels gSSE2Kernels = {
+    "sse2",
+    sse2::scale_trans,
+    sse2::affine,
+    sse2::bounds,
+    sse2::lerp,
+};
+
+#endif
+
+#ifdef PENTREK_KERNELS_AVX2
+
+// These are compiled for AVX2 regardless of our build flags, and are only
+// called if the CPU reports that it supports AVX2. Each register holds 4 points.
+// We deliberately don't use FMA, so all of the sets return the same results.
+//
+// The leftovers are handed to the SSE2 versions, which are not VEX encoded, so
+// we must clear the upper halves of the registers first (or pay for the
+// AVX-SSE transition on every call).
+
+#define AVX2_FUNC   __attribute__((target("avx2")))
+
+namespace avx2 {
+
+AVX2_FUNC static void scale_trans(Point dst[], const Point src[], size_t n,
+                                  float sx, float sy, float tx, float ty) {
+    const __m256 scale = _mm256_setr_ps(sx, sy, sx, sy, sx, sy, sx, sy);
+    const __m256 trans = _mm256_setr_ps(tx, ty, tx, ty, tx, ty, tx, ty);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256 v = _mm256_loadu_ps(&src[i].x);
+        _mm256_storeu_ps(&dst[i].x, _mm256_add_ps(_mm256_mul_ps(v, scale), trans));
+    }
+    _mm256_zeroupper();
+    sse2::scale_trans(dst + i, src + i, n - i, sx, sy, tx, ty);
+}
+
+AVX2_FUNC static void affine(Point dst[], const Point src[], size_t n, const Matrix& m) {
+    const float a = m[0], b = m[1], c = m[2], d = m[3], e = m[4], f = m[5];
+    const __m256 ad = _mm256_setr_ps(a, d, a, d, a, d, a, d);
+    const __m256 cb = _mm256_setr_ps(c, b, c, b, c, b, c, b);
+    const __m256 ef = _mm256_setr_ps(e, f, e, f, e, f, e, f);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256 v = _mm256_loadu_ps(&src[i].x);
+        __m256 s = _mm256_permute_ps(v, _MM_SHUFFLE(2, 3, 0, 1));
+        v = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(v, ad), _mm256_mul_ps(s, cb)), ef);
+        _mm256_storeu_ps(&dst[i].x, v);
+    }
+    _mm256_zeroupper();
+    sse2::affine(dst + i, src + i, n - i, m);
+}
+
+AVX2_FUNC static Rect bounds(const Point src[], size_t n) {
+    assert(n > 0);
+    if (n < 4) {
+        return sse2::bounds(src, n);
+    }
+    __m256 mn = _mm256_loadu_ps(&src[0].x),
+           mx = mn;
+    size_t i = 4;
+    for (; i + 4 <= n; i += 4) {
+        __m256 v = _mm256_loadu_ps(&src[i].x);
+        mn = _mm256_min_ps(mn, v);
+        mx = _mm256_max_ps(mx, v);
+    }
+    __m128 mn4 = _mm_min_ps(_mm256_castps256_ps128(mn), _mm256_extractf128_ps(mn, 1));
+    __m128 mx4 = _mm_max_ps(_mm256_castps256_ps128(mx), _mm256_extractf128_ps(mx, 1));
+    float mins[4], maxs[4];
+    _mm_storeu_ps(mins, mn4);
+    _mm_storeu_ps(maxs, mx4);
+    Rect r = join_bounds(mins, maxs);
+    if (i < n) {
+        _mm256_zeroupper();
+        r = r.join(sse2::bounds(src + i, n - i));
+    }
+    return r;
+}
+
+AVX2_FUNC static void lerp(Point dst[], const Point a[], const Point b[], size_t n, float t) {
+    const __m256 vt = _mm256_set1_ps(t);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256 va = _mm256_loadu_ps(&a[i].x);
+        __m256 vb = _mm256_loadu_ps(&b[i].x);
+        _mm256_storeu_ps(&dst[i].x, _mm256_add_ps(va, _mm256_mul_ps(_mm256_sub_ps(vb, va), vt)));
+    }
+    _mm256_zeroupper();
+    sse2::lerp(dst + i, a + i, b + i, n - i, t);
+}
+
+} // namespace avx2
+
+static const PointKernels gAVX2Kernels = {
+    "avx2",
+    avx2::scale_trans,
+    avx2::affine,
+    avx2::bounds,
+    avx2::lerp,
+};
+
+static bool cpu_has_avx2() {
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif
+
+#ifdef PENTREK_KERNELS_NEON
+
+namespace neon {
+
+static void scale_trans(Point dst[], const Point src[], size_t n,
+                        float sx, float sy, float tx, float ty) {
+    const float32x4_t scale = {sx, sy, sx, sy};
+    const float32x4_t trans = {tx, ty, tx, ty};
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        float32x4_t v = vld1q_f32(&src[i].x);
+        vst1q_f32(&dst[i].x, vmlaq_f32(trans, v, scale));
+    }
+    scalar::scale_trans(dst + i, src + i, n - i, sx, sy, tx, ty);
+}
+
+static void affine(Point dst[], const Point src[], size_t n, const Matrix& mx) {
+    const float32x4_t ad = {mx[0], mx[3], mx[0], mx[3]};
+    const float32x4_t cb = {mx[2], mx[1], mx[2], mx[1]};
+    const float32x4_t ef = {mx[4], mx[5], mx[4], mx[5]};
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        float32x4_t v = vld1q_f32(&src[i].x);
+        float32x4_t s = vrev64q_f32(v);
+        vst1q_f32(&dst[i].x, vmlaq_f32(vmlaq_f32(ef, s, cb), v, ad));
+    }
+    scalar::affine(dst + i, src + i, n - i, mx);
+}
+
+static Rect bounds(const Point src[], size_t n) {
+    assert(n > 0);
+    if (n < 2) {
+        return scalar::bounds(src, n);
+    }
+    float32x4_t mn = vld1q_f32(&src[0].x),
+                mx = mn;
+    size_t i = 2;
+    for (; i + 2 <= n; i += 2) {
+        float32x4_t v = vld1q_f32(&src[i].x);
+        mn = vminq_f32(mn, v);
+        mx = vmaxq_f32(mx, v);
+    }
+    float mins[4], maxs[4];
+    vst1q_f32(mins, mn);
+    vst1q_f32(maxs, mx);
+    Rect r = join_bounds(mins, maxs);
+    if (i < n) {
+        r = r.join(scalar::bounds(src + i, n - i));
+    }
+    return r;
+}
+
+static void lerp(Point dst[], const Point a[], const Point b[], size_t n, float t) {
+    const float32x4_t vt = vdupq_n_f32(t);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        float32x4_t va = vld1q_f32(&a[i].x);
+        float32x4_t vb = vld1q_f32(&b[i].x);
+        vst1q_f32(&dst[i].x, vmlaq_f32(va, vsubq_f32(vb, va), vt));
+    }
+    scalar::lerp(dst + i, a + i, b + i, n - i, t);
+}
+
+} // namespace neon
+
+static const PointKernels gNEONKernels = {
+    "neon",
+    neon::scale_trans,
+    neon::affine,
+    neon::bounds,
+    neon::lerp,
+};
+
+#endif
+
+#ifdef PENTREK_KERNELS_WASM
+
+namespace wasm {
+
+static void scale_trans(Point dst[], const Point src[], size_t n,
+                        float sx, float sy, float tx, float ty) {
+    const v128_t scale = wasm_f32x4_make(sx, sy, sx, sy);
+    const v128_t trans = wasm_f32x4_make(tx, ty, tx, ty);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        v128_t v = wasm_v128_load(&src[i].x);
+        wasm_v128_store(&dst[i].x, wasm_f32x4_add(wasm_f32x4_mul(v, scale), trans));
+    }
+    scalar::scale_trans(dst + i, src + i, n - i, sx, sy, tx, ty);
+}
+
+static void affine(Point dst[], const Point src[], size_t n, const Matrix& mx) {
+    const v128_t ad = wasm_f32x4_make(mx[0], mx[3], mx[0], mx[3]);
+    const v128_t cb = wasm_f32x4_make(mx[2], mx[1], mx[2], mx[1]);
+    const v128_t ef = wasm_f32x4_make(mx[4], mx[5], mx[4], mx[5]);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        v128_t v = wasm_v128_load(&src[i].x);
+        v128_t s = wasm_i32x4_shuffle(v, v, 1, 0, 3, 2);
+        v = wasm_f32x4_add(wasm_f32x4_add(wasm_f32x4_mul(v, ad), wasm_f32x4_mul(s, cb)), ef);
+        wasm_v128_store(&dst[i].x, v);
+    }
+    scalar::affine(dst + i, src + i, n - i, mx);
+}
+
+static Rect bounds(const Point src[], size_t n) {
+    assert(n > 0);
+    if (n < 2) {
+        return scalar::bounds(src, n);
+    }
+    v128_t mn = wasm_v128_load(&src[0].x),
+           mx = mn;
+    size_t i = 2;
+    for (; i + 2 <= n; i += 2) {
+        v128_t v = wasm_v128_load(&src[i].x);
+        mn = wasm_f32x4_pmin(mn, v);
+        mx = wasm_f32x4_pmax(mx, v);
+    }
+    float mins[4], maxs[4];
+    wasm_v128_store(mins, mn);
+    wasm_v128_store(maxs, mx);
+    Rect r = join_bounds(mins, maxs);
+    if (i < n) {
+        r = r.join(scalar::bounds(src + i, n - i));
+    }
+    return r;
+}
+
+static void lerp(Point dst[], const Point a[], const Point b[], size_t n, float t) {
+    const v128_t vt = wasm_f32x4_splat(t);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        v128_t va = wasm_v128_load(&a[i].x);
+        v128_t vb = wasm_v128_load(&b[i].x);
+        wasm_v128_store(&dst[i].x, wasm_f32x4_add(va, wasm_f32x4_mul(wasm_f32x4_sub(vb, va), vt)));
+    }
+    scalar::lerp(dst + i, a + i, b + i, n - i, t);
+}
+
+} // namespace wasm
+
+static const PointKernels gWASMKernels = {
+    "wasm-simd128",
+    wasm::scale_trans,
+    wasm::affine,
+    wasm::bounds,
+    wasm::lerp,
+};
+
+#endif
+
+std::vector<const PointKernels*> PointKernels::Available() {
+    std::vector<const PointKernels*> all = { &gScalarKernels };
+#ifdef PENTREK_KERNELS_SSE2
+    all.push_back(&gSSE2Kernels);
+#endif
+#ifdef PENTREK_KERNELS_AVX2
+    if (cpu_has_avx2()) {
+        all.push_back(&gAVX2Kernels);
+    }
+#endif
+#ifdef PENTREK_KERNELS_NEON
+    all.push_back(&gNEONKernels);
+#endif
+#ifdef PENTREK_KERNELS_WASM
+    all.push_back(&gWASMKernels);
+#endif
+    return all;
+}
+
+const PointKernels& PointKernels::Scalar() { return gScalarKernels; }
+
+const PointKernels& PointKernels::Get() {
+    // the last one is the best
+    static const PointKernels* gBest = Available().back();
+    return *gBest;
+}
+
+//////////////////////////////////////
+
+#include "include/random.h"
+
+void PointKernels::Tests() {
+#ifdef DEBUG
+    auto eq = [](Point a, Point b) {
+        return nearly_eq(a.x, b.x, 1.0f / 4096) && nearly_eq(a.y, b.y, 1.0f / 4096);
+    };
+
+    Random rand;
+    constexpr size_t N = 37;    // odd, so we exercise the leftovers
+    Point a[N], b[N];
+    for (size_t i = 0; i < N; ++i) {
+        a[i] = {rand.nextSF() * 100, rand.nextSF() * 100};
+        b[i] = {rand.nextSF() * 100, rand.nextSF() * 100};
+    }
+    const Matrix mx(1.5f, 0.25f, -0.75f, 2, 10, -20);
+
+    const auto& s = Scalar();
+    for (auto k : Available()) {
+        for (size_t n : {(size_t)1, (size_t)2, (size_t)3, (size_t)5, N}) {
+            Point expected[N], actual[N];
+
+            s.m_affine(expected, a, n, mx);
+            k->m_affine(actual, a, n, mx);
+            for (size_t i = 0; i < n; ++i) {
+                assert(eq(expected[i], actual[i]));
+            }
+
+            s.m_scaleTrans(expected, a, n, 2, 3, 4, 5);
+            k->m_scaleTrans(actual, a, n, 2, 3, 4, 5);
+            for (size_t i = 0; i < n; ++i) {
+                assert(eq(expected[i], actual[i]));
+            }
+
+            s.m_lerp(expected, a, b, n, 0.3f);
+            k->m_lerp(actual, a, b, n, 0.3f);
+            for (size_t i = 0; i < n; ++i) {
+                assert(eq(expected[i], actual[i]));
+            }
+
+            assert(s.m_bounds(a, n) == k->m_bounds(a, n));
+
+            // in place
+            std::copy(a, a + n, actual);
+            k->m_affine(actual, actual, n, mx);
+            s.m_affine(expected, a, n, mx);
+            for (size_t i = 0; i < n; ++i) {
+                assert(eq(expected[i], actual[i]));
+            }
+        }
+    }
+
+    assert(Matrix().isIdentity());
+    assert(Matrix::Trans(1, 2).type() == Matrix::kTranslate);
+    assert(Matrix::Scale(1, 2).type() == Matrix::kScale);
+    assert(Matrix::Rotate(1).type() & Matrix::kAffine);
+    assert((Matrix::Trans(1, 2) * Matrix::Scale(3, 4)).isScaleTranslate());
+    assert(!(Matrix::Trans(1, 2) * Matrix::Scale(3, 4)).isTranslate());
+    assert((Matrix::Trans(1, 2) * Matrix::Trans(-1, -2)).isIdentity());
+#endif
+}
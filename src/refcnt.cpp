@@ -16,6 +16,10 @@ static uint32_t next_unique_id() {
 
 UniqueIDRefCnt::UniqueIDRefCnt() : m_uniqueID(next_unique_id()) {}
 
+void UniqueIDRefCnt::newUniqueID() {
+    m_uniqueID = next_unique_id();
+}
+
 namespace {
 
 class Foo : public RefCnt {
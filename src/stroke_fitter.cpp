@@ -0,0 +1,408 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#include "include/stroke_fitter.h"
+#include "include/geometry.h"
+
+using namespace pentrek;
+
+// Below this many samples we wait for more before fitting, and at this many
+// we commit, even if it all still fits one cubic (so each fit is bounded).
+constexpr size_t kMinFitSamples = 7;
+constexpr size_t kMaxFitSamples = 65;
+
+static float dist_to_segment_squared(Point p, Point a, Point b) {
+    const Point ab = b - a;
+    const float lenSq = ab.lengthSquared();
+    const float t = lenSq > 0 ? pin_to_unit(Point::Dot(p - a, ab) / lenSq) : 0;
+    return (a + ab * t - p).lengthSquared();
+}
+
+// Appends (in order) the indices of the points between first and last that
+// Ramer-Douglas-Peucker keeps.
+static void rdp(const Point pts[], size_t first, size_t last, float tolSq,
+                std::vector<size_t>* dst) {
+    float maxDist = tolSq;
+    size_t index = 0;
+    for (size_t i = first + 1; i < last; ++i) {
+        const float d = dist_to_segment_squared(pts[i], pts[first], pts[last]);
+        if (d > maxDist) {
+            maxDist = d;
+            index = i;
+        }
+    }
+    if (index) {
+        rdp(pts, first, index, tolSq, dst);
+        dst->push_back(index);
+        rdp(pts, index, last, tolSq, dst);
+    }
+}
+
+/*
+ *  Schneider, "An Algorithm for Automatically Fitting Digitized Curves",
+ *  Graphics Gems (1990).
+ *
+ *  Fits a cubic to d[first...last], starting in the direction t1 and ending in
+ *  the direction -t2, with the interior points' t values taken from their
+ *  distance along the polyline, by least squares. If that is not within
+ *  tolerance, it improves the t values (with Newton's method) and tries again,
+ *  and then splits at the worst point and fits each side.
+ */
+
+struct FitCubic {
+    Point  pts[4];
+    size_t last;    // the index of the sample it ends at
+};
+
+static void generate_bezier(const Point d[], size_t n, const float u[], Point t1, Point t2,
+                            Point bez[4]) {
+    const Point p0 = d[0], p3 = d[n - 1];
+
+    float c00 = 0, c01 = 0, c11 = 0, x0 = 0, x1 = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const float t = u[i], mt = 1 - t;
+        const float b0 = mt*mt*mt, b1 = 3*t*mt*mt, b2 = 3*t*t*mt, b3 = t*t*t;
+        const Point a0 = t1 * b1,
+                    a1 = t2 * b2;
+        c00 += Point::Dot(a0, a0);
+        c01 += Point::Dot(a0, a1);
+        c11 += Point::Dot(a1, a1);
+        const Point tmp = d[i] - (p0 * (b0 + b1) + p3 * (b2 + b3));
+        x0 += Point::Dot(a0, tmp);
+        x1 += Point::Dot(a1, tmp);
+    }
+
+    const float det = c00 * c11 - c01 * c01;
+    float alpha0 = det != 0 ? (x0 * c11 - x1 * c01) / det : 0,
+          alpha1 = det != 0 ? (c00 * x1 - c01 * x0) / det : 0;
+
+    // If the handles come out (nearly) zero or negative, or so long that the
+    // cubic could loop between samples, fall back on the usual thirds.
+    const float segLength = (p3 - p0).length();
+    if (!(alpha0 > segLength * 1e-6f && alpha1 > segLength * 1e-6f &&
+          alpha0 < segLength && alpha1 < segLength)) {
+        alpha0 = alpha1 = segLength / 3;
+    }
+    bez[0] = p0;
+    bez[1] = p0 + t1 * alpha0;
+    bez[2] = p3 + t2 * alpha1;
+    bez[3] = p3;
+}
+
+// Returns the largest distance (squared) from a sample to its point on the cubic,
+// and sets split to its index.
+static float max_error(const Point d[], size_t n, const float u[], const Point bez[4],
+                       size_t* split) {
+    const auto cc = CubicCoeff::Compute(bez);
+    float maxDist = 0;
+    *split = n / 2;
+    for (size_t i = 1; i + 1 < n; ++i) {
+        const float dist = (cc.eval(u[i]) - d[i]).lengthSquared();
+        if (dist > maxDist) {
+            maxDist = dist;
+            *split = i;
+        }
+    }
+    return maxDist;
+}
+
+// One Newton step (for each sample) toward the t of its nearest point on the cubic
+static void reparameterize(const Point d[], size_t n, float u[], const Point bez[4]) {
+    const auto cc = CubicCoeff::Compute(bez);
+    for (size_t i = 1; i + 1 < n; ++i) {
+        const float t = u[i];
+        const Point diff = cc.eval(t) - d[i],
+                    d1 = cc.evalTan(t),
+                    d2 = 6*cc.A*t + 2*cc.B;
+        const float denom = Point::Dot(d1, d1) + Point::Dot(diff, d2);
+        if (denom != 0) {
+            u[i] = pin_to_unit(t - Point::Dot(diff, d1) / denom);
+        }
+    }
+}
+
+static void fit_cubic(const Point d[], size_t first, size_t last, Point t1, Point t2,
+                      float tolSq, std::vector<FitCubic>* dst) {
+    const size_t n = last - first + 1;
+    d += first;
+
+    if (n == 2) {
+        const float dist = (d[1] - d[0]).length() / 3;
+        dst->push_back({{d[0], d[0] + t1 * dist, d[1] + t2 * dist, d[1]}, last});
+        return;
+    }
+
+    float u[kMaxFitSamples + 1];
+    assert(n <= ArrayCount(u));
+    u[0] = 0;
+    for (size_t i = 1; i < n; ++i) {
+        u[i] = u[i - 1] + (d[i] - d[i - 1]).length();
+    }
+    for (size_t i = 1; i < n; ++i) {
+        u[i] /= u[n - 1];
+    }
+
+    Point bez[4];
+    generate_bezier(d, n, u, t1, t2, bez);
+    size_t split;
+    float error = max_error(d, n, u, bez, &split);
+    if (error > tolSq && error < tolSq * 16) {
+        // close enough that better t values may be all we need
+        for (int i = 0; i < 4 && error > tolSq; ++i) {
+            reparameterize(d, n, u, bez);
+            generate_bezier(d, n, u, t1, t2, bez);
+            error = max_error(d, n, u, bez, &split);
+        }
+    }
+    if (error <= tolSq) {
+        dst->push_back({{bez[0], bez[1], bez[2], bez[3]}, last});
+        return;
+    }
+
+    const Point center = (d[split - 1] - d[split + 1]).normalize();
+    fit_cubic(d - first, first, first + split, t1, center, tolSq, dst);
+    fit_cubic(d - first, first + split, last, -center, t2, tolSq, dst);
+}
+
+//////////////////////////////////
+
+void StrokeFitter::begin(Point p) {
+    m_anchor = p;
+    m_window.clear();
+    m_samples.clear();
+    m_samples.push_back(p);
+    m_startTan = {0, 0};
+    m_edges[0] = m_edges[1] = {{0, 0}, 0};
+    m_dst->move(p);
+}
+
+void StrokeFitter::add(Point p) {
+    if (p == (m_window.empty() ? m_anchor : m_window.back())) {
+        return;
+    }
+    m_window.push_back(p);
+
+    const float tolSq = m_opts.m_tolerance * m_opts.m_tolerance;
+    const size_t n = m_window.size();
+    size_t i = 0;
+    while (i + 1 < n && dist_to_segment_squared(m_window[i], m_anchor, p) <= tolSq) {
+        i += 1;
+    }
+    if (i + 1 == n) {
+        // they all still fit the line from the anchor
+        if (n >= (size_t)m_opts.m_window) {
+            this->addVertex(p);
+            m_anchor = p;
+            m_window.clear();
+        }
+        return;
+    }
+
+    // Run RDP over the anchor and window, and commit its vertices. The points
+    // after the last one (which fit the line from it to p) stay in the window.
+    m_window.insert(m_window.begin(), m_anchor);
+    std::vector<size_t> indices;
+    rdp(m_window.data(), 0, n, tolSq, &indices);
+    assert(indices.size() > 0);
+    for (size_t index : indices) {
+        this->addVertex(m_window[index]);
+    }
+    m_anchor = m_window[indices.back()];
+    m_window.erase(m_window.begin(), m_window.begin() + indices.back() + 1);
+}
+
+void StrokeFitter::addVertex(Point v) {
+    const Point last = m_samples.back();
+    const Edge out = {(v - last).normalize(), (v - last).length()};
+
+    // A corner can fall between two vertices (when no input point is right on
+    // it), leaving a short edge across it with a smaller turn at each end. So if
+    // the last edge is much shorter than the ones on either side, we also check
+    // the turn from the one before it.
+    const float cosCorner = std::cos(m_opts.m_cornerAngle);
+    const Edge& in = m_edges[1];
+    const Edge& before = m_edges[0];
+    if ((in.m_length > 0 && Point::Dot(in.m_dir, out.m_dir) < cosCorner) ||
+        (before.m_length > in.m_length * 2 && out.m_length > in.m_length * 2 &&
+         Point::Dot(before.m_dir, out.m_dir) < cosCorner)) {
+        this->fit(true);    // everything up to the corner
+    }
+    m_edges[0] = m_edges[1];
+    m_edges[1] = out;
+    m_samples.push_back((last + v) * 0.5f);
+    m_samples.push_back(v);
+
+    if (m_samples.size() >= kMinFitSamples) {
+        this->fit(false);
+    }
+}
+
+// Fits the samples, and commits all of the cubics except the last (unless final,
+// or there are too many samples to wait for another).
+void StrokeFitter::fit(bool final) {
+    const size_t n = m_samples.size();
+    if (n < 2) {
+        return;
+    }
+    const Point* d = m_samples.data();
+    const Point t1 = m_startTan == Point{0, 0} ? (d[1] - d[0]).normalize() : m_startTan;
+    const Point t2 = (d[n - 2] - d[n - 1]).normalize();
+    const float tolSq = m_opts.m_fitTolerance * m_opts.m_fitTolerance;
+
+    std::vector<FitCubic> cubics;
+    fit_cubic(d, 0, n - 1, t1, t2, tolSq, &cubics);
+
+    size_t commit = cubics.size() - 1;
+    if (final || (commit == 0 && n >= kMaxFitSamples)) {
+        commit = cubics.size();
+    }
+    if (commit == 0) {
+        return;
+    }
+    for (size_t i = 0; i < commit; ++i) {
+        m_dst->cubic(cubics[i].pts[1], cubics[i].pts[2], cubics[i].pts[3]);
+    }
+
+    const FitCubic& c = cubics[commit - 1];
+    m_samples.erase(m_samples.begin(), m_samples.begin() + c.last);
+    if (final) {
+        m_startTan = {0, 0};
+        m_edges[0] = m_edges[1] = {{0, 0}, 0};
+    } else {
+        // so the next cubic joins this one smoothly
+        m_startTan = (c.pts[3] - c.pts[2]).normalize();
+    }
+}
+
+void StrokeFitter::finish() {
+    if (!m_window.empty()) {
+        this->addVertex(m_window.back());
+        m_window.clear();
+    }
+    this->fit(true);
+}
+
+void StrokeFitter::addTail(PathSync* sink) const {
+    for (size_t i = 1; i < m_samples.size(); ++i) {
+        sink->line(m_samples[i]);
+    }
+    if (!m_window.empty()) {
+        sink->line(m_window.back());
+    }
+}
+
+//////////////////////////////////
+
+#include "include/flatten.h"
+#include "include/path_builder.h"
+
+void StrokeFitter::Tests() {
+#ifdef DEBUG
+    // the distance from p to the nearest of the polylines
+    auto distance = [](const Polylines& lines, Point p) {
+        float best = std::numeric_limits<float>::infinity();
+        for (size_t c = 0; c < lines.count(); ++c) {
+            const auto pts = lines.points(c);
+            for (size_t i = 1; i < pts.size(); ++i) {
+                best = std::min(best, dist_to_segment_squared(p, pts[i - 1], pts[i]));
+            }
+        }
+        return std::sqrt(best);
+    };
+
+    // a straight stroke becomes a single segment
+    {
+        PathBuilder builder;
+        StrokeFitter fitter(&builder);
+        fitter.begin({0, 0});
+        for (int i = 1; i <= 1000; ++i) {
+            fitter.add({i * 0.5f, i * 0.25f});
+        }
+        fitter.finish();
+        const auto path = builder.detach();
+        assert(path->verbs().size() == 2);
+        const Point end = {500, 250};
+        assert(path->points().back() == end);
+    }
+
+    // a click without a drag is just the move
+    {
+        PathBuilder builder;
+        StrokeFitter fitter(&builder);
+        fitter.begin({5, 5});
+        fitter.add({5, 5});
+        fitter.finish();
+        assert(builder.detach()->verbs().size() == 1);
+    }
+
+    // Curvy strokes, at mouse resolution (whole pixels): far fewer points, and
+    // all of the input stays close to the result, throughout the stroke.
+    const StrokeFitter::Options opts;
+    const float maxDistance = opts.m_tolerance + opts.m_fitTolerance + 0.25f;
+    for (int shape = 0; shape < 3; ++shape) {
+        std::vector<Point> input;
+        for (int i = 0; i <= 2000; ++i) {
+            const float t = i / 2000.0f;
+            Point p;
+            switch (shape) {
+                case 0: p = {300 + 200 * std::cos(t * 6.2831853f), 300 + 200 * std::sin(t * 6.2831853f)}; break;
+                case 1: p = {t * 1500, 200 + 80 * std::sin(t * 25)}; break;
+                default: p = {std::abs(t - 0.5f) * 800, t * 600}; break;    // a corner
+            }
+            input.push_back({std::round(p.x), std::round(p.y)});
+        }
+
+        PathBuilder builder;
+        StrokeFitter fitter(&builder);
+        fitter.begin(input[0]);
+        for (size_t i = 1; i < input.size(); ++i) {
+            fitter.add(input[i]);
+            if (i % 500 == 0) {
+                // what's committed, plus the tail, covers the input so far
+                PathBuilder live = builder;
+                fitter.addTail(&live);
+                assert(live.m_points.back() == input[i]);
+                Polylines lines;
+                flatten(*live.detach(), 0.05f, &lines);
+                for (size_t j = 0; j <= i; j += 7) {
+                    assert(distance(lines, input[j]) <= maxDistance);
+                }
+            }
+        }
+        fitter.finish();
+        const auto path = builder.detach();
+        assert(path->points().back() == input.back());
+        assert(path->points().size() * 8 < input.size());
+
+        Polylines lines;
+        flatten(*path, 0.05f, &lines);
+        for (const auto& p : input) {
+            assert(distance(lines, p) <= maxDistance);
+        }
+    }
+
+    // a corner that falls between input points (so no vertex is on it)
+    {
+        std::vector<Point> input;
+        for (int i = 0; i <= 125; ++i) {
+            const float t = i / 125.0f;
+            input.push_back({std::round(std::abs(t - 0.5f) * 800), std::round(t * 600)});
+        }
+        PathBuilder builder;
+        StrokeFitter fitter(&builder);
+        fitter.begin(input[0]);
+        for (size_t i = 1; i < input.size(); ++i) {
+            fitter.add(input[i]);
+        }
+        fitter.finish();
+        Polylines lines;
+        flatten(*builder.detach(), 0.05f, &lines);
+        for (const auto& p : input) {
+            assert(distance(lines, p) <= maxDistance);
+        }
+        const Point corner = {0, 300};
+        assert(distance(lines, corner) <= 4);
+    }
+#endif
+}
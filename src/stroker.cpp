@@ -0,0 +1,1228 @@
+/*
+ *  Copyright Pentrek Inc, 2022
+ */
+
+#include "include/stroker.h"
+#include "include/flatten.h"
+#include "include/geometry.h"
+#include "include/path_builder.h"
+#include "include/path_ops.h"
+
+using namespace pentrek;
+
+// A curve's offset that still isn't within tolerance after this many halvings
+// is accepted as is.
+constexpr int kMaxSubdivide = 8;
+
+// How finely a curve is sampled when looking for the cusps of its offset
+constexpr int kCuspSamples = 16;
+
+// How many places (evenly spaced inside it) each fitted piece of an offset is
+// checked against the real offset
+constexpr int kFitSamples = 7;
+
+namespace {
+
+// Appends straight to a PathBuilder's arrays (rather than through PathSync),
+// since the stroker writes several segments per source segment.
+struct Side {
+    PathBuilder* m_path;
+
+    void line(Point p) {
+        m_path->m_verbs.push_back(PathVerb::line);
+        m_path->m_points.push_back(p);
+    }
+    void cubic(Point p1, Point p2, Point p3) {
+        m_path->m_verbs.push_back(PathVerb::cubic);
+        m_path->m_points.insert(m_path->m_points.end(), {p1, p2, p3});
+    }
+};
+
+} // namespace
+
+// Appends a (single cubic) circular arc around center, from center + from to
+// center + to. from and to must have the same length, and the arc is the short
+// way around (best kept within 90 degrees).
+static void arc_to(Side* dst, Point center, Vector from, Vector to) {
+    const float rr = from.lengthSquared();
+    const float cosA = from.dot(to) / rr,
+                sinA = from.cross(to) / rr;
+    // tan(A/4), from tan(A/2) = sin / (1 + cos)
+    const float tan2 = sinA / (1 + cosA);
+    const float k = 4.0f / 3 * tan2 / (1 + std::sqrt(1 + tan2 * tan2));
+    dst->cubic(center + from + from.cw() * k,
+               center + to - to.cw() * k,
+               center + to);
+}
+
+// Appends the segments of src (after its move) to path, in reverse order
+static void append_reversed(Side* path, const PathBuilder& src) {
+    const Point* pts = src.m_points.data();
+    size_t i = src.m_points.size() - 1;
+    for (size_t v = src.m_verbs.size() - 1; v > 0; --v) {
+        switch (src.m_verbs[v]) {
+            case PathVerb::line:
+                path->line(pts[i - 1]);
+                i -= 1;
+                break;
+            case PathVerb::cubic:
+                path->cubic(pts[i - 1], pts[i - 2], pts[i - 3]);
+                i -= 3;
+                break;
+            default:
+                assert(false);  // we only write lines and cubics
+                break;
+        }
+    }
+    assert(i == 0);
+}
+
+namespace {
+
+// A point on a curve's offset, and the offset's derivative there
+struct OffsetPt {
+    Point  pos;
+    Vector deriv;
+};
+
+/*
+ *  For a curve P with unit tangent T, normal N = T.cw() and curvature k, the
+ *  offset is O = P + rN, whose derivative is O' = P'(1 - rk).
+ */
+static OffsetPt offset_at(const CubicCoeff& cc, float t, float r, Vector chord) {
+    const Point p = cc.eval(t);
+    const Vector d1 = cc.evalTan(t);
+    const Vector d2 = 6 * cc.A * t + twice(cc.B);
+    if (d1.isNearlyZero()) {
+        // a cusp (or a control point on an end): d2 gives the direction
+        const Vector tan = (d2.isNearlyZero() ? chord : d2).normalize();
+        return {p + tan.cw() * r, {0, 0}};
+    }
+    const float len = d1.length();
+    const float k = d1.cross(d2) / (len * len * len);
+    return {p + (d1 / len).cw() * r, d1 * (1 - r * k)};
+}
+
+// What goes on the outside of a turn (the inside just pivots)
+struct JoinStyle {
+    StrokeJoin m_join;
+    float      m_miterLimit;
+    float      m_radius;        // how far the sides are from the pivot
+    float      m_tolerance;
+};
+
+} // namespace
+
+// Appends the join on the outside of a turn (from unit tangent t0 to t1) around
+// pivot, from pivot + n0 to pivot + n1.
+static void outer_join(Side* dst, const JoinStyle& style, Point pivot, Vector n0, Vector n1,
+                       Vector t0, Vector t1) {
+    const float dot = t0.dot(t1);
+    switch (style.m_join) {
+        case StrokeJoin::miter: {
+            // The miter's length (relative to the radius) is 1/cos(turn/2),
+            // and cos^2(turn/2) = (1 + dot)/2
+            const float cos2 = (1 + dot) * 0.5f;
+            if (cos2 * style.m_miterLimit * style.m_miterLimit >= 1) {
+                dst->line(pivot + (n0 + n1) / (1 + dot));
+            }
+        } break;
+        case StrokeJoin::round: {
+            // if the arc's sagitta is within tolerance, the bevel is close enough
+            const float cos2 = std::max(0.0f, (1 + dot) * 0.5f);
+            const float sagitta = style.m_radius * (1 - std::sqrt(cos2));
+            if (sagitta > style.m_tolerance) {
+                if (dot < 0) {
+                    // more than 90 degrees, so split at the outermost point
+                    const Vector mid = (t0 - t1).makeLength(style.m_radius);
+                    arc_to(dst, pivot, n0, mid);
+                    arc_to(dst, pivot, mid, n1);
+                } else {
+                    arc_to(dst, pivot, n0, n1);
+                }
+                return;
+            }
+        } break;
+        case StrokeJoin::bevel:
+            break;
+    }
+    dst->line(pivot + n1);
+}
+
+// Approximates the offset between t0 and t1 with the cubic that matches its
+// ends and derivatives there, splitting it until that is within tolerance.
+//
+// Where the curve turns sharply within a piece too small to matter (at or near
+// a cusp of the curve itself), its offset swings around the piece faster than
+// halving catches up with. That piece is stroked as a round join instead, as
+// the stroker would if it were a corner: the outside of the turn gets an arc
+// around it, and the inside pivots on it.
+static void fit_offset(Side* dst, const CubicCoeff& cc, Vector chord, float r, float tolerance,
+                       float t0, const OffsetPt& o0, float t1, const OffsetPt& o1, int depth) {
+    const float h3 = (t1 - t0) * (1.0f / 3);
+    const Point c[] = {o0.pos, o0.pos + o0.deriv * h3, o1.pos - o1.deriv * h3, o1.pos};
+
+    if (depth < kMaxSubdivide) {
+        // Errors can cancel at any one place (e.g. symmetric ones, at the
+        // midpoint), and the fit can bulge between a couple, so check along it
+        const auto approx = CubicCoeff::Compute(c);
+        const float tolSq = tolerance * tolerance;
+        bool fits = true;
+        for (int i = 1; i <= kFitSamples; ++i) {
+            const float s = (float)i / (kFitSamples + 1);
+            const Point p = offset_at(cc, t0 + (t1 - t0) * s, r, chord).pos;
+            if ((approx.eval(s) - p).lengthSquared() > tolSq) {
+                fits = false;
+                break;
+            }
+        }
+        if (!fits) {
+            const float tm = (t0 + t1) * 0.5f;
+            const Point p0 = cc.eval(t0),
+                        pm = cc.eval(tm),
+                        p1 = cc.eval(t1);
+            if ((p0 - pm).lengthSquared() <= tolSq && (p1 - pm).lengthSquared() <= tolSq) {
+                // o = p + r * tan.cw()
+                const Vector tan0 = ((o0.pos - p0) / r).ccw(),
+                             tan1 = ((o1.pos - p1) / r).ccw();
+                // as StrokeContext::join picks its outer side (the left is +r)
+                if ((tan0.cross(tan1) > 0) == (r < 0)) {
+                    outer_join(dst, {StrokeJoin::round, 1, std::abs(r), tolerance},
+                               pm, o0.pos - pm, o1.pos - pm, tan0, tan1);
+                } else {
+                    dst->line(pm);
+                    dst->line(o1.pos);
+                }
+                return;
+            }
+            const OffsetPt om = offset_at(cc, tm, r, chord);
+            fit_offset(dst, cc, chord, r, tolerance, t0, o0, tm, om, depth + 1);
+            fit_offset(dst, cc, chord, r, tolerance, tm, om, t1, o1, depth + 1);
+            return;
+        }
+    }
+    dst->cubic(c[1], c[2], c[3]);
+}
+
+/*
+ *  The offset's derivative, P'(1 - rk), reverses where the curve's radius of
+ *  curvature passes r, giving the offset a cusp. Since k = P' x P'' / |P'|^3,
+ *  that is where r(P' x P'') - |P'|^3 changes sign. Writes the t of each one
+ *  (in increasing order) to ts, and returns how many there are.
+ */
+static int find_offset_cusps(const CubicCoeff& cc, float r, float ts[kCuspSamples]) {
+    // is r(P' x P'') > |P'|^3 (compared as squares, to skip the sqrt)
+    auto reversed = [&](float t) {
+        const Vector d1 = cc.evalTan(t);
+        const Vector d2 = 6 * cc.A * t + twice(cc.B);
+        const float rk = r * d1.cross(d2),
+                    len2 = d1.lengthSquared();
+        return rk > 0 && rk * rk > len2 * len2 * len2;
+    };
+
+    int n = 0;
+    float prevT = 0;
+    bool prevRev = reversed(0);
+    for (int i = 1; i <= kCuspSamples; ++i) {
+        const float t = (float)i / kCuspSamples;
+        const bool rev = reversed(t);
+        if (rev != prevRev) {
+            float lo = prevT, hi = t;
+            for (int j = 0; j < 16; ++j) {
+                const float mid = (lo + hi) * 0.5f;
+                (reversed(mid) == prevRev ? lo : hi) = mid;
+            }
+            // one right at an end doesn't need a piece of its own
+            const float root = (lo + hi) * 0.5f;
+            if (root > 1.0f / 1024 && root < 1 - 1.0f / 1024) {
+                ts[n++] = root;
+            }
+        }
+        prevT = t;
+        prevRev = rev;
+    }
+    return n;
+}
+
+// Appends the offset (by r) of the cubic c, whose unit tangents at its ends are
+// t0 and t1. If splitAtCusps, it is made of pieces that each end at a cusp (if
+// there are any), so that the offset's loops are clean.
+static void offset_cubic(Side* dst, const Point c[4], Vector t0, Vector t1,
+                         float r, float tolerance, bool splitAtCusps) {
+    const auto cc = CubicCoeff::Compute(c);
+    const Vector chord = c[3] - c[0];
+
+    float ts[kCuspSamples + 1];
+    const int n = splitAtCusps ? find_offset_cusps(cc, r, ts) : 0;
+    ts[n] = 1;
+
+    OffsetPt o0 = offset_at(cc, 0, r, chord);
+    // use the same ends as the joins (and caps) will
+    o0.pos = c[0] + t0.cw() * r;
+    float prevT = 0;
+    for (int i = 0; i <= n; ++i) {
+        OffsetPt o1 = offset_at(cc, ts[i], r, chord);
+        if (i == n) {
+            o1.pos = c[3] + t1.cw() * r;
+        }
+        fit_offset(dst, cc, chord, r, tolerance, prevT, o0, ts[i], o1, 0);
+        o0 = o1;
+        prevT = ts[i];
+    }
+}
+
+namespace {
+
+class StrokeContext {
+public:
+    StrokeContext(const StrokeParams& params, float tolerance, PathBuilder* dst)
+        : m_dst(dst)
+        , m_radius(params.m_width * 0.5f)
+        , m_tolerance(tolerance)
+        , m_miterLimit(params.m_miterLimit)
+        , m_join(params.m_join)
+        , m_cap(params.m_cap)
+    {}
+
+    // The result gets both sides, and the right side is also built separately
+    void reserve(size_t ptsPerSide, size_t vbsPerSide) {
+        m_dst->incReserve(ptsPerSide * 2 + 16, vbsPerSide * 2 + 16);
+        m_rightPath.incReserve(ptsPerSide + 8, vbsPerSide + 8);
+    }
+
+    void moveTo(Point p) {
+        m_firstPt = m_prevPt = p;
+        m_hasSegment = m_hasVerb = false;
+    }
+    void lineTo(Point);
+    void cubicTo(const Point[4]);
+    void quadTo(const Point q[3]) {
+        constexpr float k = 2.0f / 3;
+        const Point c[] = {q[0], q[0] + (q[1] - q[0]) * k, q[2] + (q[1] - q[2]) * k, q[2]};
+        this->cubicTo(c);
+    }
+    void endContour(bool doClose);
+
+private:
+    PathBuilder* m_dst;         // the result, and the left side of the current contour
+    PathBuilder  m_rightPath;   // the right side, appended in reverse when the contour ends
+    Side         m_left{m_dst};
+    Side         m_right{&m_rightPath};
+
+    const float      m_radius;
+    const float      m_tolerance;
+    const float      m_miterLimit;
+    const StrokeJoin m_join;
+    const StrokeCap  m_cap;
+
+    Point  m_firstPt, m_prevPt;
+    Vector m_firstTan, m_prevTan;   // unit tangents
+    bool   m_hasSegment = false;    // we have started the sides
+    bool   m_hasVerb = false;       // (possibly zero-length) segments after the move
+
+    Vector normal(Vector tan) const { return tan.cw() * m_radius; }
+
+    void beginSegment(Vector tan);
+    void join(Point pivot, Vector t0, Vector t1);
+    void cap(Point, Vector tan);
+};
+
+} // namespace
+
+void StrokeContext::beginSegment(Vector tan) {
+    const Vector n = this->normal(tan);
+    if (!m_hasSegment) {
+        m_dst->move(m_prevPt + n);
+        m_rightPath.m_points.clear();
+        m_rightPath.m_verbs.clear();
+        m_rightPath.move(m_prevPt - n);
+        m_firstTan = tan;
+        m_hasSegment = true;
+    } else {
+        this->join(m_prevPt, m_prevTan, tan);
+    }
+}
+
+void StrokeContext::lineTo(Point p) {
+    m_hasVerb = true;
+    if (p == m_prevPt) {
+        return;
+    }
+    const Vector tan = (p - m_prevPt).normalize();
+    this->beginSegment(tan);
+
+    const Vector n = this->normal(tan);
+    m_left.line(p + n);
+    m_right.line(p - n);
+    m_prevPt = p;
+    m_prevTan = tan;
+}
+
+void StrokeContext::cubicTo(const Point c[4]) {
+    m_hasVerb = true;
+    if (c[1] == c[0] && c[2] == c[0] && c[3] == c[0]) {
+        return;
+    }
+    const Vector t0 = cubic_postan(c, 0).second,
+                 t1 = cubic_postan(c, 1).second;
+    this->beginSegment(t0);
+
+    // Inside a tight curve, the offset has cusps, and no single cubic can
+    // follow it through one, so each side is split there.
+    offset_cubic(&m_left, c, t0, t1, m_radius, m_tolerance, true);
+    offset_cubic(&m_right, c, t0, t1, -m_radius, m_tolerance, true);
+    m_prevPt = c[3];
+    m_prevTan = t1;
+}
+
+// The sides of the incoming segment are at pivot +/- normal(t0), and we
+// connect them to the outgoing segment's, at pivot +/- normal(t1).
+void StrokeContext::join(Point pivot, Vector t0, Vector t1) {
+    const Vector n0 = this->normal(t0),
+                 n1 = this->normal(t1);
+    const float cross = t0.cross(t1),
+                dot = t0.dot(t1);
+
+    if (dot > 0 && std::abs(cross) * m_radius <= m_tolerance) {
+        // Nearly straight on: the sides just continue, and are off by at most
+        // the distance between pivot + normal(t0) and pivot + normal(t1).
+        return;
+    }
+
+    // Turning toward the left (positive cross) puts the left side on the inside.
+    // The inside just pivots (which is covered by both segments), the outside
+    // gets the actual join.
+    Side* outer = &m_left;
+    Side* inner = &m_right;
+    float sign = 1;
+    if (cross > 0) {
+        std::swap(outer, inner);
+        sign = -1;
+    }
+    inner->line(pivot);
+    inner->line(pivot - n1 * sign);
+    outer_join(outer, {m_join, m_miterLimit, m_radius, m_tolerance},
+               pivot, n0 * sign, n1 * sign, t0, t1);
+}
+
+// Appends the cap around p, heading in tan, from the left side to the right
+void StrokeContext::cap(Point p, Vector tan) {
+    const Vector n = this->normal(tan),
+                 ahead = tan * m_radius;
+    switch (m_cap) {
+        case StrokeCap::butt:
+            break;
+        case StrokeCap::round:
+            arc_to(&m_left, p, n, ahead);
+            arc_to(&m_left, p, ahead, -n);
+            return;
+        case StrokeCap::square:
+            m_left.line(p + n + ahead);
+            m_left.line(p - n + ahead);
+            break;
+    }
+    m_left.line(p - n);
+}
+
+void StrokeContext::endContour(bool doClose) {
+    if (!m_hasSegment) {
+        // zero-length, but round and square caps still draw a dot
+        if (m_hasVerb) {
+            const float r = m_radius;
+            const Point p = m_firstPt;
+            switch (m_cap) {
+                case StrokeCap::butt: break;
+                case StrokeCap::round: m_dst->addCircle(p, r); break;
+                case StrokeCap::square: m_dst->addRect({p.x - r, p.y - r, p.x + r, p.y + r}); break;
+            }
+        }
+        m_hasVerb = false;
+        return;
+    }
+
+    if (doClose) {
+        this->lineTo(m_firstPt);
+        this->join(m_firstPt, m_prevTan, m_firstTan);
+        m_dst->close();
+        // the right side is its own contour, going the other way
+        m_dst->move(m_rightPath.m_points.back());
+        append_reversed(&m_left, m_rightPath);
+        m_dst->close();
+    } else {
+        this->cap(m_prevPt, m_prevTan);
+        append_reversed(&m_left, m_rightPath);
+        this->cap(m_firstPt, -m_firstTan);
+        m_dst->close();
+    }
+    m_hasSegment = m_hasVerb = false;
+}
+
+//////////////////////////////////////
+
+Stroker::Stroker(const StrokeParams& params, float tolerance)
+    : m_params(params)
+    , m_tolerance(tolerance)
+{
+    assert(params.m_width > 0);
+    assert(params.m_miterLimit >= 1);
+    assert(tolerance > 0);
+}
+
+rcp<Path> Stroker::stroke(const Path& path) const {
+    PathBuilder builder;
+    StrokeContext ctx(m_params, m_tolerance, &builder);
+    // each side gets (at least) a copy of the points
+    ctx.reserve(path.points().size(), path.verbs().size());
+
+    Point prev = {0, 0};
+    bool inContour = false;
+    const Point* p = path.points().data();
+    for (auto v : path.verbs()) {
+        switch (v) {
+            case PathVerb::move:
+                if (inContour) {
+                    ctx.endContour(false);
+                }
+                ctx.moveTo(p[0]);
+                inContour = true;
+                prev = p[0];
+                p += 1;
+                break;
+            case PathVerb::line:
+                ctx.lineTo(p[0]);
+                prev = p[0];
+                p += 1;
+                break;
+            case PathVerb::quad: {
+                const Point q[] = {prev, p[0], p[1]};
+                ctx.quadTo(q);
+                prev = p[1];
+                p += 2;
+            } break;
+            case PathVerb::cubic: {
+                const Point c[] = {prev, p[0], p[1], p[2]};
+                ctx.cubicTo(c);
+                prev = p[2];
+                p += 3;
+            } break;
+            case PathVerb::close:
+                ctx.endContour(true);
+                inContour = false;
+                break;
+        }
+    }
+    if (inContour) {
+        ctx.endContour(false);
+    }
+    return builder.detach();
+}
+
+rcp<Path> Stroker::strokePoly(Span<const Point> pts, bool doClose) const {
+    if (pts.size() == 0) {
+        return Path::Empty();
+    }
+    PathBuilder builder;
+    StrokeContext ctx(m_params, m_tolerance, &builder);
+    // each point gets a line, and (typically) two more for its join
+    ctx.reserve(pts.size() * 3, pts.size() * 3);
+
+    ctx.moveTo(pts[0]);
+    for (size_t i = 1; i < pts.size(); ++i) {
+        ctx.lineTo(pts[i]);
+    }
+    ctx.endContour(doClose);
+    return builder.detach();
+}
+
+//////////////////////////////////////
+
+namespace {
+
+/*
+ *  Offsets each contour (closed, as for filling) by r along the normal
+ *  tan.cw(), so a positive r moves a cw contour inward. The inside of each
+ *  turn pivots around the vertex, as the stroker's does, which leaves loops
+ *  that go backwards (for SimplifyPositive to remove).
+ *
+ *  If reverse, each contour's offset is reversed, so a ccw contour (offset by
+ *  -r) still gives a cw offset.
+ */
+class OffsetContext {
+public:
+    OffsetContext(float r, const JoinStyle& style, bool reverse, PathBuilder* dst)
+        : m_dst(dst)
+        , m_side{reverse ? &m_contour : dst}
+        , m_r(r)
+        , m_style(style)
+        , m_reverse(reverse)
+    {}
+
+    void moveTo(Point p) {
+        this->close();
+        m_firstPt = m_prevPt = p;
+    }
+    void lineTo(Point);
+    void cubicTo(const Point[4]);
+    void quadTo(const Point q[3]) {
+        constexpr float k = 2.0f / 3;
+        const Point c[] = {q[0], q[0] + (q[1] - q[0]) * k, q[2] + (q[1] - q[2]) * k, q[2]};
+        this->cubicTo(c);
+    }
+    void close();
+
+private:
+    PathBuilder* m_dst;
+    PathBuilder  m_contour;     // the current contour, if we're reversing them
+    Side         m_side;
+
+    const float     m_r;
+    const JoinStyle m_style;
+    const bool      m_reverse;
+
+    Point  m_firstPt = {0, 0},
+           m_prevPt = {0, 0};
+    Vector m_firstTan, m_prevTan;   // unit tangents
+    bool   m_hasSegment = false;
+
+    Vector normal(Vector tan) const { return tan.cw() * m_r; }
+
+    void beginSegment(Vector tan);
+    void join(Point pivot, Vector t0, Vector t1);
+};
+
+} // namespace
+
+void OffsetContext::beginSegment(Vector tan) {
+    if (!m_hasSegment) {
+        if (m_reverse) {
+            m_contour.m_points.clear();
+            m_contour.m_verbs.clear();
+        }
+        (m_reverse ? &m_contour : m_dst)->move(m_prevPt + this->normal(tan));
+        m_firstTan = tan;
+        m_hasSegment = true;
+    } else {
+        this->join(m_prevPt, m_prevTan, tan);
+    }
+}
+
+void OffsetContext::lineTo(Point p) {
+    if (p == m_prevPt) {
+        return;
+    }
+    const Vector tan = (p - m_prevPt).normalize();
+    this->beginSegment(tan);
+    m_side.line(p + this->normal(tan));
+    m_prevPt = p;
+    m_prevTan = tan;
+}
+
+void OffsetContext::cubicTo(const Point c[4]) {
+    if (c[1] == c[0] && c[2] == c[0] && c[3] == c[0]) {
+        return;
+    }
+    const Vector t0 = cubic_postan(c, 0).second,
+                 t1 = cubic_postan(c, 1).second;
+    this->beginSegment(t0);
+    offset_cubic(&m_side, c, t0, t1, m_r, m_style.m_tolerance, true);
+    m_prevPt = c[3];
+    m_prevTan = t1;
+}
+
+void OffsetContext::join(Point pivot, Vector t0, Vector t1) {
+    const float cross = t0.cross(t1),
+                dot = t0.dot(t1);
+    if (dot > 0 && std::abs(cross) * m_style.m_radius <= m_style.m_tolerance) {
+        return;     // nearly straight on (see StrokeContext::join)
+    }
+    const Vector n1 = this->normal(t1);
+    if (cross * m_r > 0) {
+        // we're on the inside of the turn
+        m_side.line(pivot);
+        m_side.line(pivot + n1);
+    } else {
+        outer_join(&m_side, m_style, pivot, this->normal(t0), n1, t0, t1);
+    }
+}
+
+void OffsetContext::close() {
+    if (!m_hasSegment) {
+        return;
+    }
+    this->lineTo(m_firstPt);
+    this->join(m_firstPt, m_prevTan, m_firstTan);
+    if (m_reverse) {
+        m_dst->move(m_contour.m_points.back());
+        Side dst{m_dst};
+        append_reversed(&dst, m_contour);
+    }
+    m_dst->close();
+    m_hasSegment = false;
+}
+
+static float dist_to_segment_squared(Point p, Point a, Point b) {
+    const Vector ab = b - a;
+    const float len2 = ab.lengthSquared();
+    const float t = len2 > 0 ? pin_float((p - a).dot(ab) / len2, 0, 1) : 0;
+    return (a + ab * t - p).lengthSquared();
+}
+
+// Returns true if p is within dist of one of the (closed) polylines
+static bool is_within(const Polylines& polys, Span<const Rect> bounds, Point p, float dist) {
+    const float distSq = dist * dist;
+    for (size_t i = 0; i < polys.count(); ++i) {
+        const Rect& r = bounds[i];
+        if (p.x < r.left - dist || p.x > r.right + dist ||
+            p.y < r.top - dist || p.y > r.bottom + dist) {
+            continue;
+        }
+        const auto pts = polys.points(i);
+        Point prev = pts.back();
+        for (Point pt : pts) {
+            if (dist_to_segment_squared(p, prev, pt) < distSq) {
+                return true;
+            }
+            prev = pt;
+        }
+    }
+    return false;
+}
+
+/*
+ *  Where the offset turns inside out, making a whole loop that goes backwards
+ *  (e.g. insetting a circle by more than its radius gives a smaller circle
+ *  going the same way), the winding can't tell it from the real thing, but
+ *  the distance can: it is closer to src than the offset's distance. So we
+ *  drop the contours whose segments are mostly that close, or on the wrong
+ *  side of src (outside it for an inset, inside it for an outset), as are the
+ *  little loops left where the offset of a sharp spike folds over itself.
+ *
+ *  (A loop like that which overlaps the real offset is merged into it by
+ *  SimplifyPositive, so it survives. This only happens with tight curves,
+ *  whose backwards loops nearly always go the other way.)
+ */
+static rcp<Path> drop_inverted(rcp<Path> offset, const Path& src, float distance,
+                               float tolerance) {
+    // The polylines are within tolerance of src, as the offset is of the real one
+    const float minDist = std::abs(distance) - 3 * tolerance;
+    if (minDist <= 0 || offset->empty()) {
+        return offset;
+    }
+    Polylines polys;
+    flatten(src, tolerance, &polys);
+    std::vector<Rect> bounds(polys.count());
+    for (size_t i = 0; i < polys.count(); ++i) {
+        bounds[i] = Rect::Bounds(polys.points(i));
+    }
+
+    const bool inward = distance < 0;
+    auto misplaced = [&](Point p) {
+        return is_within(polys, bounds, p, minDist) || src.contains(p) != inward;
+    };
+
+    // for each contour, how many of its segments (judged by their middles) are misplaced
+    std::vector<int> close, segments;
+    offset->visit([&](const Point*) {
+                      close.push_back(0);
+                      segments.push_back(0);
+                  },
+                  [&](const Point* p) {
+                      segments.back() += 1;
+                      close.back() += misplaced((p[-1] + p[0]) * 0.5f);
+                  },
+                  [&](const Point* p) {
+                      segments.back() += 1;
+                      const Point mid = (p[-1] + twice(p[0]) + p[1]) * 0.25f;
+                      close.back() += misplaced(mid);
+                  },
+                  [&](const Point* p) {
+                      segments.back() += 1;
+                      const Point mid = (p[-1] + (p[0] + p[1]) * 3 + p[2]) * 0.125f;
+                      close.back() += misplaced(mid);
+                  },
+                  [&](Point, Point) {});
+
+    bool dropAny = false;
+    for (size_t i = 0; i < close.size(); ++i) {
+        dropAny = dropAny || close[i] * 2 > segments[i];
+    }
+    if (!dropAny) {
+        return offset;
+    }
+
+    PathBuilder builder;
+    const Point* pts = offset->points().data();
+    const auto vbs = offset->verbs();
+    int contour = -1;
+    bool keep = false;
+    for (auto v : vbs) {
+        const int n = points_for_verb(v);
+        if (v == PathVerb::move) {
+            contour += 1;
+            keep = close[contour] * 2 <= segments[contour];
+        }
+        if (keep) {
+            builder.m_verbs.push_back(v);
+            builder.m_points.insert(builder.m_points.end(), pts, pts + n);
+        }
+        pts += n;
+    }
+    return builder.detach();
+}
+
+Offsetter::Offsetter(StrokeJoin join, float miterLimit, float tolerance)
+    : m_join(join)
+    , m_miterLimit(miterLimit)
+    , m_tolerance(tolerance)
+{
+    assert(miterLimit >= 1);
+    assert(tolerance > 0);
+}
+
+rcp<Path> Offsetter::offset(const Path& path, float distance) const {
+    const PathInfo& info = path.info();
+    if (info.m_kind == PathInfo::Kind::empty) {
+        return Path::Empty();
+    }
+    if (distance == 0) {
+        return Path::Make(path.points(), path.verbs(), path.fillType());
+    }
+
+    // We want each contour to have the inside on its cw side, and not to
+    // overlap the others, which is what Simplify returns. A convex path
+    // already is one such contour (if it goes the other way, we reverse it).
+    rcp<Path> simplified;
+    const Path* src = &path;
+    bool reverse = false;
+    if (info.m_isConvex) {
+        reverse = info.direction() == PathDirection::ccw;
+    } else {
+        simplified = PathOps::Simplify(path);
+        src = simplified.get();
+    }
+
+    PathBuilder builder;
+    builder.incReserve(src->points().size() * 2, src->verbs().size() * 2);
+    OffsetContext ctx(reverse ? distance : -distance,
+                      {m_join, m_miterLimit, std::abs(distance), m_tolerance},
+                      reverse, &builder);
+
+    Point prev = {0, 0};
+    const Point* p = src->points().data();
+    for (auto v : src->verbs()) {
+        switch (v) {
+            case PathVerb::move:
+                ctx.moveTo(p[0]);
+                prev = p[0];
+                p += 1;
+                break;
+            case PathVerb::line:
+                ctx.lineTo(p[0]);
+                prev = p[0];
+                p += 1;
+                break;
+            case PathVerb::quad: {
+                const Point q[] = {prev, p[0], p[1]};
+                ctx.quadTo(q);
+                prev = p[1];
+                p += 2;
+            } break;
+            case PathVerb::cubic: {
+                const Point c[] = {prev, p[0], p[1], p[2]};
+                ctx.cubicTo(c);
+                prev = p[2];
+                p += 3;
+            } break;
+            case PathVerb::close:
+                ctx.close();
+                break;
+        }
+    }
+    ctx.close();
+    auto raw = builder.detach();
+
+    if (info.m_isConvex && distance > 0) {
+        return raw;     // every turn is outward, so nothing overlaps
+    }
+    return drop_inverted(PathOps::SimplifyPositive(*raw), *src, distance, m_tolerance);
+}
+
+//////////////////////////////////////
+
+size_t StrokeCache::KeyHash::operator()(const Key& k) const {
+    uint64_t h = k.m_pathID;
+    for (uint32_t word : {LRUCacheBase::FloatBits(k.m_tolerance),
+                          LRUCacheBase::FloatBits(k.m_params.m_width),
+                          LRUCacheBase::FloatBits(k.m_params.m_miterLimit),
+                          (uint32_t)k.m_params.m_join << 8 | (uint32_t)k.m_params.m_cap}) {
+        h = LRUCacheBase::HashMix(h, word);
+    }
+    return (size_t)h;
+}
+
+rcp<Path> StrokeCache::stroke(const Path& path, const StrokeParams& params, float tolerance) {
+    return m_cache.findOrMake({path.uniqueID(), tolerance, params}, [&]() {
+        return Stroker(params, tolerance).stroke(path);
+    });
+}
+
+StrokeCache& StrokeCache::Global() {
+    static StrokeCache* gCache = new StrokeCache;
+    return *gCache;
+}
+
+//////////////////////////////////////
+
+size_t OffsetCache::KeyHash::operator()(const Key& k) const {
+    uint64_t h = k.m_pathID;
+    for (uint32_t word : {LRUCacheBase::FloatBits(k.m_tolerance),
+                          LRUCacheBase::FloatBits(k.m_miterLimit),
+                          (uint32_t)k.m_join}) {
+        h = LRUCacheBase::HashMix(h, word);
+    }
+    return (size_t)h;
+}
+
+rcp<Path> OffsetCache::offset(const Path& path, float distance, StrokeJoin join,
+                              float miterLimit, float tolerance) {
+    const float slop = tolerance * 0.5f;
+    auto matches = [&](const Entry& entry) {
+        return std::abs(entry.m_distance - distance) <= slop;
+    };
+    auto make = [&]() {
+        return Entry{distance, Offsetter(join, miterLimit, tolerance - slop).offset(path, distance)};
+    };
+    return m_cache.findOrMake({path.uniqueID(), tolerance, miterLimit, join}, matches, make).m_offset;
+}
+
+OffsetCache& OffsetCache::Global() {
+    static OffsetCache* gCache = new OffsetCache;
+    return *gCache;
+}
+
+//////////////////////////////////////
+
+void Stroker::Tests() {
+#ifdef DEBUG
+    const Point line[] = {{0, 0}, {10, 0}};
+    StrokeParams params;
+    params.m_width = 2;
+
+    const Rect butt = {0, -1, 10, 1},
+               square = {-1, -1, 11, 1};
+
+    auto path = Stroker(params).strokePoly(line, false);
+    assert(path->fillType() == PathFillType::winding);
+    assert(path->bounds() == butt);
+    assert(path->contains({5, 0.5f}));
+    assert(!path->contains({5, 1.5f}));
+    assert(!path->contains({-0.5f, 0}));
+
+    params.m_cap = StrokeCap::square;
+    path = Stroker(params).strokePoly(line, false);
+    assert(path->bounds() == square);
+    assert(path->contains({-0.9f, 0.9f}));
+
+    params.m_cap = StrokeCap::round;
+    path = Stroker(params).strokePoly(line, false);
+    assert(path->contains({-0.9f, 0}));
+    assert(path->contains({10.9f, 0}));
+    assert(!path->contains({-0.8f, 0.8f}));
+    assert(nearly_eq(path->tightBounds().left, -1, 1.0f / 1024));
+
+    // a polyline strokes the same as the equivalent path
+    assert(*path == *Stroker(params).stroke(*Path::Poly(line, false)));
+
+    // joins, in both directions
+    params.m_cap = StrokeCap::butt;
+    for (auto dir : {PathDirection::cw, PathDirection::ccw}) {
+        auto rect = Path::Rect({0, 0, 10, 10}, dir);
+
+        params.m_join = StrokeJoin::miter;
+        path = Stroker(params).stroke(*rect);
+        assert(path->contains({-0.9f, -0.9f}));
+        assert(path->contains({10.9f, 10.9f}));
+        assert(!path->contains({5, 5}));    // the stroke has a hole
+        assert(!path->contains({-1.1f, 5}));
+
+        params.m_join = StrokeJoin::bevel;
+        path = Stroker(params).stroke(*rect);
+        assert(path->contains({-0.4f, -0.4f}));
+        assert(!path->contains({-0.9f, -0.9f}));
+        assert(!path->contains({5, 5}));
+
+        params.m_join = StrokeJoin::round;
+        path = Stroker(params).stroke(*rect);
+        assert(path->contains({-0.6f, -0.6f}));
+        assert(!path->contains({-0.8f, -0.8f}));
+        assert(!path->contains({5, 5}));
+    }
+
+    // a sharp turn exceeds the miter limit, so it is beveled
+    const Point spike[] = {{0, 0}, {100, 5}, {0, 10}};
+    params.m_join = StrokeJoin::miter;
+    params.m_miterLimit = 100;
+    path = Stroker(params).strokePoly(spike, false);
+    assert(path->bounds().right > 110);
+    params.m_miterLimit = 10;
+    path = Stroker(params).strokePoly(spike, false);
+    assert(path->bounds().right < 102);
+
+    // curves are offset within tolerance
+    params = StrokeParams();
+    params.m_width = 10;
+    path = Stroker(params).stroke(*Path::Circle({0, 0}, 50));
+    for (int i = 0; i < 64; ++i) {
+        const float angle = i * 0.1f;
+        const Vector v = {std::cos(angle), std::sin(angle)};
+        assert(path->contains(v * 50));
+        assert(path->contains(v * 54.5f));
+        assert(path->contains(v * 45.5f));
+        assert(!path->contains(v * 55.5f));
+        assert(!path->contains(v * 44.5f));
+        assert(!path->contains(v * 20));
+    }
+
+    const Point curve[] = {{0, 0}, {100, -60}, {100, 160}, {200, 100}};
+    PathBuilder builder;
+    builder.move(curve[0]);
+    builder.cubic(curve[1], curve[2], curve[3]);
+    path = Stroker(params).stroke(*builder.detach());
+    for (int i = 1; i < 32; ++i) {
+        const auto [p, tan] = cubic_postan(curve, i / 32.0f);
+        const Vector n = tan.cw();
+        assert(path->contains(p));
+        assert(path->contains(p + n * 4.5f));
+        assert(path->contains(p - n * 4.5f));
+        assert(!path->contains(p + n * 5.5f));
+        assert(!path->contains(p - n * 5.5f));
+    }
+
+    // With round joins and caps, the stroke is exactly the points within half
+    // its width of the curves. We check that, except within tolerance of the
+    // edge, through tight turns (where the offset has cusps) and cusps of the
+    // curve itself.
+    auto covers = [](const Path& src, float width, float tolerance) {
+        StrokeParams params;
+        params.m_width = width;
+        params.m_join = StrokeJoin::round;
+        params.m_cap = StrokeCap::round;
+        const auto result = Stroker(params, tolerance).stroke(src);
+        Polylines polys;
+        flatten(src, 1.0f / 64, &polys);
+        const float r = width * 0.5f,
+                    margin = tolerance + 1.0f / 16;
+        const Rect bounds = src.bounds().inset(-r - 2, -r - 2);
+        for (int y = 0; y < 64; ++y) {
+            for (int x = 0; x < 64; ++x) {
+                const Point p = {bounds.left + bounds.width() * (x + 0.37f) / 64,
+                                 bounds.top + bounds.height() * (y + 0.61f) / 64};
+                float distSq = std::numeric_limits<float>::infinity();
+                for (size_t i = 0; i < polys.count(); ++i) {
+                    const auto pts = polys.points(i);
+                    for (size_t j = 1; j < pts.size(); ++j) {
+                        distSq = std::min(distSq, dist_to_segment_squared(p, pts[j - 1], pts[j]));
+                    }
+                }
+                const float dist = std::sqrt(distSq);
+                if (std::abs(dist - r) > margin && result->contains(p) != (dist < r)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+
+    builder.move({45, 26});     // nearly a cusp
+    builder.cubic({67, 16}, {35, 4}, {79, 42});
+    assert(covers(*builder.detach(), 16, 0.25f));
+    builder.move({0, 0});       // a cusp, at (50, 75)
+    builder.cubic({100, 100}, {0, 100}, {100, 0});
+    assert(covers(*builder.detach(), 30, 0.25f));
+    builder.move({89, 26});     // turning most of the way around, in a point
+    builder.quad({56, 47}, {71, 16});
+    builder.quad({62, 73}, {46, 61});
+    builder.line({91, 38});
+    builder.cubic({39, 77}, {79, 68}, {51, 65});
+    assert(covers(*builder.detach(), 16, 0.25f));
+
+    // a zero-length segment only draws with round or square caps
+    const Point dot[] = {{5, 5}, {5, 5}};
+    params.m_cap = StrokeCap::butt;
+    assert(Stroker(params).strokePoly(dot, false)->empty());
+    params.m_cap = StrokeCap::round;
+    assert(Stroker(params).strokePoly(dot, false)->contains({5, 9}));
+    params.m_cap = StrokeCap::square;
+    assert(Stroker(params).strokePoly(dot, false)->contains({9, 9}));
+
+    // the cache returns the same result for the same path and parameters
+    StrokeCache cache(4);
+    auto src = Path::Poly(spike, false);
+    auto s0 = cache.stroke(*src, params);
+    assert(cache.stroke(*src, params).get() == s0.get());
+    params.m_width = 3;
+    assert(cache.stroke(*src, params).get() != s0.get());
+    assert(cache.count() == 2);
+    for (int i = 0; i < 10; ++i) {
+        cache.stroke(*Path::Poly(spike, false), params);
+    }
+    assert(cache.count() <= 4);
+    cache.purgeAll();
+    assert(cache.count() == 0);
+#endif
+}
+
+void Offsetter::Tests() {
+#ifdef DEBUG
+    // With round joins, the offset is exactly the points whose signed distance
+    // (positive inside) from the edges of the area the path fills is more than
+    // -distance. We check that, except within margin of the edge. (The edges of
+    // a self-intersecting path's area are Simplify's, not the path's own.)
+    auto matches = [](const Path& src, float distance, const Path& result) {
+        Polylines polys;
+        flatten(*PathOps::Simplify(src), 1.0f / 64, &polys);
+        const float margin = 0.75f;
+        const float pad = std::abs(distance) + 2;
+        const Rect r = src.bounds().inset(-pad, -pad);
+        for (int y = 0; y < 48; ++y) {
+            for (int x = 0; x < 48; ++x) {
+                const Point p = {r.left + r.width() * (x + 0.37f) / 48,
+                                 r.top + r.height() * (y + 0.61f) / 48};
+                float distSq = std::numeric_limits<float>::infinity();
+                for (size_t i = 0; i < polys.count(); ++i) {
+                    const auto pts = polys.points(i);
+                    Point prev = pts.back();
+                    for (Point pt : pts) {
+                        distSq = std::min(distSq, dist_to_segment_squared(p, prev, pt));
+                        prev = pt;
+                    }
+                }
+                const float signedDist = src.contains(p) ? std::sqrt(distSq) : -std::sqrt(distSq);
+                if (std::abs(signedDist + distance) > margin &&
+                        result.contains(p) != (signedDist + distance > 0)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+
+    const Rect square = {0, 0, 10, 10};
+    const auto rect = Path::Rect(square);
+    Offsetter miter(StrokeJoin::miter),
+              bevel(StrokeJoin::bevel),
+              round(StrokeJoin::round);
+
+    auto result = miter.offset(*rect, 5);
+    assert(result->bounds() == square.inset(-5, -5));
+    assert(result->contains({-4.9f, -4.9f}));
+    result = bevel.offset(*rect, 5);
+    assert(result->contains({-2, -2}) && !result->contains({-4, -4}));
+    assert(matches(*rect, 5, *round.offset(*rect, 5)));
+
+    // the inside of a corner is cut off, whatever the join
+    for (const auto& offsetter : {miter, bevel, round}) {
+        result = offsetter.offset(*rect, -3);
+        assert(result->info().m_kind == PathInfo::Kind::rect);
+        assert(result->bounds() == square.inset(3, 3));
+        assert(offsetter.offset(*rect, -6)->empty());
+    }
+
+    // curves, in either direction, in and out (and then too far in)
+    for (auto dir : {PathDirection::cw, PathDirection::ccw}) {
+        const auto circle = Path::Circle({0, 0}, 50, dir);
+        for (float d : {10.0f, -10.0f, -49.0f}) {
+            assert(matches(*circle, d, *round.offset(*circle, d)));
+        }
+        assert(round.offset(*circle, -60)->empty());
+    }
+
+    // concave, with the hole going either way, and self-intersecting
+    const Point ell[] = {{0, 0}, {30, 0}, {30, 10}, {10, 10}, {10, 30}, {0, 30}};
+    const auto lpath = Path::Poly(ell, true);
+    for (float d : {4.0f, -3.0f}) {
+        assert(matches(*lpath, d, *round.offset(*lpath, d)));
+    }
+    for (auto dir : {PathDirection::cw, PathDirection::ccw}) {
+        PathBuilder builder;
+        builder.addRect({0, 0, 40, 40}, PathDirection::cw);
+        builder.addRect({10, 10, 30, 30}, dir);
+        builder.m_fillType = PathFillType::evenodd;
+        const auto frame = builder.detach();
+        for (float d : {3.0f, -3.0f}) {
+            assert(matches(*frame, d, *round.offset(*frame, d)));
+        }
+    }
+    PathBuilder builder;
+    builder.move({0, 0});
+    builder.cubic({100, -60}, {100, 160}, {200, 100});
+    const auto loop = builder.detach();
+    for (float d : {6.0f, -6.0f}) {
+        assert(matches(*loop, d, *round.offset(*loop, d)));
+    }
+
+    // self-intersecting curves, with either fill: a star (whose middle is a
+    // hole with evenodd), and a figure eight (whose lobes wind opposite ways)
+    for (auto fill : {PathFillType::winding, PathFillType::evenodd}) {
+        Point tips[5];
+        for (int i = 0; i < 5; ++i) {
+            const float angle = i * 2 * (2 * 3.14159265f / 5);
+            tips[i] = Point{std::cos(angle), std::sin(angle)} * 40;
+        }
+        builder.move(tips[0]);
+        for (int i = 1; i <= 5; ++i) {
+            const Point a = tips[i - 1],
+                        b = tips[i % 5];
+            builder.quad((a + b) * 0.5f + (b - a).cw() * (6 / (b - a).length()), b);
+        }
+        builder.close();
+        builder.m_fillType = fill;
+        const auto star = builder.detach();
+
+        builder.move({-40, 0});
+        builder.cubic({-40, -30}, {40, 30}, {40, 0});
+        builder.cubic({40, -30}, {-40, 30}, {-40, 0});
+        builder.close();
+        builder.m_fillType = fill;
+        const auto eight = builder.detach();
+
+        for (float d : {4.0f, -2.0f}) {
+            assert(matches(*star, d, *round.offset(*star, d)));
+            assert(matches(*eight, d, *round.offset(*eight, d)));
+        }
+    }
+
+    // insetting a sharp spike whose tip curves back leaves a little loop
+    // outside the path, which is removed
+    builder.m_fillType = PathFillType::winding;
+    builder.move({0, 0});
+    builder.line({100, 50});
+    builder.quad({100, 54}, {80, 0});
+    builder.close();
+    const auto spike = builder.detach();
+    assert(matches(*spike, -3, *round.offset(*spike, -3)));
+
+    // the ends of a flat ellipse turn more tightly than the inset, so its
+    // offset has cusps and loops, which are removed
+    const auto ellipse = Path::Oval({-50, -10, 50, 10});
+    result = round.offset(*ellipse, -8);
+    assert(!result->empty());
+    assert(matches(*ellipse, -8, *result));
+    assert(round.offset(*ellipse, -11)->empty());
+
+    // the cache returns a result for any distance within half its tolerance
+    OffsetCache cache(4);
+    auto r0 = cache.offset(*ellipse, -5, StrokeJoin::round);
+    assert(matches(*ellipse, -5, *r0));
+    assert(cache.offset(*ellipse, -5.1f, StrokeJoin::round).get() == r0.get());
+    assert(cache.offset(*ellipse, -5.2f, StrokeJoin::round).get() != r0.get());
+    assert(cache.offset(*ellipse, -5, StrokeJoin::miter).get() != r0.get());
+    assert(cache.count() == 3);
+    for (int i = 0; i < 10; ++i) {
+        cache.offset(*ellipse, i * 0.5f, StrokeJoin::round);
+    }
+    assert(cache.count() <= 4);
+    cache.purgeAll();
+    assert(cache.count() == 0);
+#endif
+}
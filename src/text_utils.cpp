@@ -42,7 +42,7 @@ rcp<Font> pentrek::make_global_font(Font::GlobalFonts gf) {
 
 static void make_truns_proc(Span<const char> str, Span<const TextRun> truns,
                             std::vector<float>* xpos,
-                            std::function<void(const Path&, float scale, float tx)> proc) {
+                            std::function<void(rcp<Path>, float scale, float tx)> proc) {
     if (truns.size() == 0) {
         return;
     }
@@ -56,8 +56,7 @@ static void make_truns_proc(Span<const char> str, Span<const TextRun> truns,
 
     for (const auto& gr : gruns) {
         for (size_t i = 0; i < gr.m_glyphs.size(); ++i) {
-            proc(gr.m_font->glyphPath(gr.m_glyphs[i]).deref(), gr.m_size, gr.m_xpos[i]);
-            auto path = gr.m_font->glyphPath(gr.m_glyphs[i]);
+            proc(gr.m_font->glyphPath(gr.m_glyphs[i]), gr.m_size, gr.m_xpos[i]);
         }
         if (xpos) {
             xpos->insert(xpos->end(), gr.m_xpos.begin(), gr.m_xpos.end());
@@ -72,8 +71,9 @@ static Matrix scale_tx(float scale, float tx) {
 std::vector<rcp<Path>> pentrek::make_truns_paths(Span<const char> str, Span<const TextRun> truns,
                                                  std::vector<float>* xpos) {
     std::vector<rcp<Path>> paths;
-    make_truns_proc(str, truns, xpos, [&](const Path& path, float scale, float tx) {
-        paths.push_back(scale_tx(scale, tx) * path);
+    make_truns_proc(str, truns, xpos, [&](rcp<Path> path, float scale, float tx) {
+        // glyphPath() gives us our own path, so this transforms it in place
+        paths.push_back(scale_tx(scale, tx) * std::move(path));
     });
     return paths;
 }
@@ -86,8 +86,8 @@ std::vector<rcp<Path>> pentrek::make_string_paths(Span<const char> str, float si
     const TextRun trun = {font, size, (uint32_t)str.size()};
 
     std::vector<rcp<Path>> paths;
-    make_truns_proc(str, {&trun, 1}, nullptr, [&](const Path& path, float scale, float tx) {
-        paths.push_back(scale_tx(scale, tx) * path);
+    make_truns_proc(str, {&trun, 1}, nullptr, [&](rcp<Path> path, float scale, float tx) {
+        paths.push_back(scale_tx(scale, tx) * std::move(path));
     });
     return paths;
 }
@@ -100,8 +100,8 @@ rcp<Path> pentrek::make_string_path(Span<const char> str, float size, rcp<Font>
     const TextRun trun = {font, size, (uint32_t)str.size()};
 
     PathBuilder builder;
-    make_truns_proc(str, {&trun, 1}, nullptr, [&](const Path& src, float scale, float tx) {
-        builder.addPath(src, scale_tx(scale, tx));
+    make_truns_proc(str, {&trun, 1}, nullptr, [&](rcp<Path> src, float scale, float tx) {
+        builder.addPath({src, scale_tx(scale, tx)});
     });
     return builder.detach();
 }